@@ -0,0 +1,546 @@
+/**
+ * @file analytics.cpp
+ * @brief Estatísticas móveis incrementais e regras de evento por origem e campo.
+ *
+ * - A janela guarda as últimas @c ANALYTICS_WINDOW amostras válidas de cada campo;
+ *   a soma é atualizada na entrada/saída de amostras e mínimo/máximo vêm de filas
+ *   monotônicas (custo amortizado O(1)).
+ * - EWMA e desvio médio absoluto são mantidos em ponto fixo Q8.
+ * - As regras de limiar ficam na tabela @c kRules, no mesmo estilo das tabelas do
+ *   schema; a regra de anomalia vale para todo campo que não seja o timestamp.
+ * - O estado é protegido por seção crítica curta; os eventos são logados depois
+ *   de liberá-la, com @c LOG_CRIT (também vão à memória RTC).
+ */
+
+#include "analytics.h"
+#include <freertos/FreeRTOS.h>
+#include <string.h>
+#include "fmt.h"
+#include "logger.h"
+
+static const char *TAG = "ANALYTICS";
+
+#define Q8(v) ((int64_t)(v) * 256)
+
+/**
+ * @brief Regra de limiar de um campo de uma versão de payload.
+ *
+ * Para @c EVT_BELOW/@c EVT_ABOVE, @c limit e @c hysteresis estão em unidades
+ * brutas; para @c EVT_ERROR_RUN/@c EVT_FLAT, @c limit é o número de leituras seguidas.
+ */
+typedef struct
+{
+    uint8_t version;
+    uint8_t field;
+    AnalyticsEvent kind;
+    int32_t limit;
+    int32_t hysteresis;
+} Rule;
+
+static constexpr Rule kRules[] = {
+    /* versão  campo  evento          limite  histerese */
+    {1, 0, EVT_ERROR_RUN, 3, 0},     /* irradiância 0xFFFF em 3 leituras       */
+    {1, 0, EVT_FLAT, 12, 0},         /* irradiância travada em valor não nulo  */
+    {1, 1, EVT_BELOW, 3300, 50},     /* bateria < 3,300 V (normaliza >= 3,350) */
+    {1, 2, EVT_ABOVE, 600, 20},      /* temp. interna > 60,0 C (normaliza <= 58,0) */
+};
+
+static const char *const kEventNames[EVT_N_KINDS] = {
+    "abaixo do limiar", "acima do limiar", "erro repetido", "valor travado", "anomalia",
+};
+
+/**
+ * @brief Fila monotônica de sequências de amostras (índices na janela).
+ */
+typedef struct
+{
+    uint16_t seq[ANALYTICS_WINDOW];
+    uint8_t head;
+    uint8_t len;
+} MonoQueue;
+
+/**
+ * @brief Estado incremental de um campo.
+ */
+typedef struct
+{
+    int32_t win[ANALYTICS_WINDOW];  /* amostras válidas, indexadas por seq % janela */
+    MonoQueue minq;                 /* valores crescentes a partir da frente        */
+    MonoQueue maxq;                 /* valores decrescentes a partir da frente      */
+    uint16_t seq;                   /* amostras válidas já recebidas (com wrap)     */
+    uint8_t n;                      /* amostras na janela                           */
+    int64_t sum;
+    int64_t ewma_q;                 /* Q8                                           */
+    int64_t dev_q;                  /* desvio médio absoluto do EWMA, Q8            */
+    int32_t last;
+    uint32_t last_ts;               /* timestamp do nó da última amostra válida     */
+    int32_t rate_per_h;
+    uint16_t error_run;
+    uint16_t flat_run;
+    uint8_t active;                 /* bit k = evento k ativo                       */
+} FieldState;
+
+/**
+ * @brief Estado de uma origem (nó).
+ */
+typedef struct
+{
+    bool used;
+    uint8_t version;
+    uint16_t source;
+    uint16_t since_aggregate;   /* leituras desde a última leitura consolidada */
+    uint32_t last_seen;         /* contador global de leituras, para a substituição */
+    uint32_t timestamp;         /* timestamp da última leitura                 */
+    FieldState f[SCHEMA_MAX_FIELDS];
+} SourceState;
+
+/**
+ * @brief Transição de evento a ser logada fora da seção crítica.
+ */
+typedef struct
+{
+    uint8_t field;
+    AnalyticsEvent kind;
+    bool raised;
+    bool error;
+    int32_t value;
+} PendingEvent;
+
+static SourceState g_src[ANALYTICS_MAX_SOURCES];
+static AnalyticsStats g_stats;
+static portMUX_TYPE g_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/****************************** Funções privadas ******************************/
+
+static int32_t round_div(int64_t num, uint32_t den)
+{
+    const int64_t half = (int64_t)(den / 2u);
+    return (int32_t)((num >= 0 ? num + half : num - half) / (int64_t)den);
+}
+
+static inline uint16_t mq_at(const MonoQueue *q, uint8_t i)
+{
+    return q->seq[(q->head + i) % ANALYTICS_WINDOW];
+}
+
+/**
+ * @brief Insere a sequência @p seq, removendo do fim as que ela domina.
+ * @param less true para a fila de mínimo, false para a de máximo.
+ */
+static void mq_push(MonoQueue *q, const int32_t *win, uint16_t seq, bool less)
+{
+    const int32_t v = win[seq % ANALYTICS_WINDOW];
+
+    while (q->len)
+    {
+        const int32_t back = win[mq_at(q, (uint8_t)(q->len - 1u)) % ANALYTICS_WINDOW];
+
+        if (less ? back < v : back > v)
+        {
+            break;
+        }
+
+        q->len--;
+    }
+
+    q->seq[(q->head + q->len) % ANALYTICS_WINDOW] = seq;
+    q->len++;
+}
+
+/**
+ * @brief Remove da frente a sequência que saiu da janela ao chegar @p seq.
+ */
+static void mq_expire(MonoQueue *q, uint16_t seq)
+{
+    if (q->len && (uint16_t)(seq - q->seq[q->head]) >= ANALYTICS_WINDOW)
+    {
+        q->head = (uint8_t)((q->head + 1u) % ANALYTICS_WINDOW);
+        q->len--;
+    }
+}
+
+/**
+ * @brief Procura a origem; se ausente, ocupa um slot livre ou o menos recente.
+ */
+static SourceState *source_slot(uint16_t source, uint8_t version)
+{
+    SourceState *victim = nullptr;
+
+    for (uint8_t i = 0; i < ANALYTICS_MAX_SOURCES; ++i)
+    {
+        SourceState *s = &g_src[i];
+
+        if (s->used && s->source == source)
+        {
+            if (s->version == version)
+            {
+                return s;
+            }
+
+            victim = s;  /* schema mudou: recomeça as estatísticas no mesmo slot */
+            break;
+        }
+
+        if (!victim || (victim->used && (!s->used || s->last_seen < victim->last_seen)))
+        {
+            victim = s;
+        }
+    }
+
+    if (victim->used && victim->source != source)
+    {
+        g_stats.evicted++;
+    }
+
+    memset(victim, 0, sizeof(*victim));
+    victim->used = true;
+    victim->source = source;
+    victim->version = version;
+    return victim;
+}
+
+/**
+ * @brief Incorpora uma amostra válida às estatísticas do campo.
+ * @return true se a amostra foi anômala em relação ao EWMA anterior.
+ */
+static bool field_add(FieldState *f, int32_t v, uint32_t ts)
+{
+    bool anomaly = false;
+
+    if (f->n == ANALYTICS_WINDOW)
+    {
+        int64_t diff = Q8(v) - f->ewma_q;
+        diff = diff < 0 ? -diff : diff;
+        const int64_t dev = f->dev_q > Q8(1) ? f->dev_q : Q8(1);
+        anomaly = diff > ANALYTICS_ANOMALY_K * dev;
+    }
+
+    if (f->seq == 0 && f->n == 0)
+    {
+        f->ewma_q = Q8(v);
+    }
+    else
+    {
+        const int64_t diff = Q8(v) - f->ewma_q;
+        f->ewma_q += diff / (1 << ANALYTICS_EWMA_SHIFT);
+        f->dev_q += ((diff < 0 ? -diff : diff) - f->dev_q) / (1 << ANALYTICS_EWMA_SHIFT);
+
+        if (f->last_ts && ts > f->last_ts)
+        {
+            const int64_t rate = ((int64_t)v - f->last) * 3600 / (int64_t)(ts - f->last_ts);
+            f->rate_per_h = (rate > INT32_MAX) ? INT32_MAX
+                          : (rate < INT32_MIN) ? INT32_MIN : (int32_t)rate;
+        }
+    }
+
+    const uint16_t seq = f->seq++;
+    const uint8_t idx = seq % ANALYTICS_WINDOW;
+
+    mq_expire(&f->minq, seq);
+    mq_expire(&f->maxq, seq);
+
+    if (f->n == ANALYTICS_WINDOW)
+    {
+        f->sum -= f->win[idx];
+    }
+    else
+    {
+        f->n++;
+    }
+
+    f->win[idx] = v;
+    f->sum += v;
+    mq_push(&f->minq, f->win, seq, true);
+    mq_push(&f->maxq, f->win, seq, false);
+
+    f->flat_run = (f->last_ts && v == f->last) ? (uint16_t)(f->flat_run + 1u) : 1u;
+    f->last = v;
+    f->last_ts = ts ? ts : 1u;
+    return anomaly;
+}
+
+/**
+ * @brief Atualiza o bit de evento @p kind e registra a transição, se houver.
+ */
+static void set_event(FieldState *f, uint8_t field, AnalyticsEvent kind, bool on, bool error,
+                      int32_t value, PendingEvent *ev, uint8_t *n_ev)
+{
+    const uint8_t bit = (uint8_t)(1u << kind);
+
+    if (on == ((f->active & bit) != 0))
+    {
+        return;
+    }
+
+    f->active ^= bit;
+
+    if (on)
+    {
+        g_stats.events[kind]++;
+    }
+
+    ev[(*n_ev)++] = PendingEvent{field, kind, on, error, value};
+}
+
+/**
+ * @brief Avalia as regras da tabela para o campo @p i.
+ */
+static void eval_rules(const SourceState *s, FieldState *f, uint8_t i, bool error, int32_t v,
+                       PendingEvent *ev, uint8_t *n_ev)
+{
+    for (const Rule &rule : kRules)
+    {
+        if (rule.version != s->version || rule.field != i)
+        {
+            continue;
+        }
+
+        const bool active = (f->active >> rule.kind) & 1u;
+
+        switch (rule.kind)
+        {
+        case EVT_ERROR_RUN:
+            set_event(f, i, rule.kind, f->error_run >= (uint32_t)rule.limit, error, v, ev, n_ev);
+            break;
+
+        case EVT_FLAT:
+            if (!error)
+            {
+                set_event(f, i, rule.kind, v != 0 && f->flat_run >= (uint32_t)rule.limit, false,
+                          v, ev, n_ev);
+            }
+            break;
+
+        case EVT_BELOW:
+            if (!error)
+            {
+                const int32_t lim = active ? rule.limit + rule.hysteresis : rule.limit;
+                set_event(f, i, rule.kind, v < lim, false, v, ev, n_ev);
+            }
+            break;
+
+        case EVT_ABOVE:
+            if (!error)
+            {
+                const int32_t lim = active ? rule.limit - rule.hysteresis : rule.limit;
+                set_event(f, i, rule.kind, v > lim, false, v, ev, n_ev);
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Loga uma transição de evento com o valor em unidades físicas.
+ */
+static void log_event(uint16_t source, const PayloadSchema *sc, const PendingEvent *e)
+{
+    const FieldDesc *f = &sc->fields[e->field];
+    char v[FMT_FIXED_MAX + 1];
+
+    if (e->error)
+    {
+        *fmt_str(v, "ERRO") = '\0';
+    }
+    else
+    {
+        *payload_schema_render(f, e->value, f->log_decimals, v) = '\0';
+    }
+
+    LOG_CRIT(TAG, "EVENTO %s %s: no %u, %s = %s%s%s", kEventNames[e->kind],
+             e->raised ? "ATIVO" : "normalizado", (unsigned)source, f->label, v,
+             e->error ? "" : " ", e->error ? "" : f->unit);
+}
+
+/****************************** Funções públicas ******************************/
+
+/**
+ * @brief Incorpora uma leitura às estatísticas da sua origem e avalia as regras.
+ * @param r Leitura decodificada.
+ * @return Leituras da origem desde a última @c analytics_take_aggregate().
+ */
+uint16_t analytics_update(const SensorReading *r)
+{
+    const PayloadSchema *sc = payload_schema_by_version(r->version);
+
+    if (!sc)
+    {
+        return 0;
+    }
+
+    PendingEvent ev[SCHEMA_MAX_FIELDS * EVT_N_KINDS];
+    uint8_t n_ev = 0;
+
+    portENTER_CRITICAL(&g_mux);
+    g_stats.readings++;
+    SourceState *s = source_slot(r->source, r->version);
+    s->last_seen = g_stats.readings;
+    s->timestamp = r->timestamp;
+    s->since_aggregate++;
+
+    for (uint8_t i = 0; i < sc->n_fields; ++i)
+    {
+        if (i == sc->ts_index)
+        {
+            continue;
+        }
+
+        FieldState *f = &s->f[i];
+        const bool error = payload_schema_field_error(r, i);
+        const int32_t v = r->value[i];
+
+        if (error)
+        {
+            f->error_run++;
+        }
+        else
+        {
+            f->error_run = 0;
+            const bool anomaly = field_add(f, v, r->timestamp);
+            set_event(f, i, EVT_ANOMALY, anomaly, false, v, ev, &n_ev);
+        }
+
+        eval_rules(s, f, i, error, v, ev, &n_ev);
+    }
+
+    const uint16_t since = s->since_aggregate;
+    portEXIT_CRITICAL(&g_mux);
+
+    for (uint8_t k = 0; k < n_ev; ++k)
+    {
+        log_event(r->source, sc, &ev[k]);
+    }
+
+    return since;
+}
+
+/**
+ * @brief Monta a leitura consolidada de uma origem e zera sua contagem.
+ *
+ * @details Cada campo recebe a média da janela (em erro se a janela estiver vazia);
+ *          o timestamp é o da última leitura.
+ * @param source Nó de origem.
+ * @param out Leitura a ser preenchida.
+ * @return false se a origem não for acompanhada ou não houver leituras novas.
+ */
+bool analytics_take_aggregate(uint16_t source, SensorReading *out)
+{
+    bool ok = false;
+
+    portENTER_CRITICAL(&g_mux);
+
+    for (uint8_t k = 0; k < ANALYTICS_MAX_SOURCES && !ok; ++k)
+    {
+        SourceState *s = &g_src[k];
+        const PayloadSchema *sc = payload_schema_by_version(s->version);
+
+        if (!s->used || s->source != source || s->since_aggregate == 0 || !sc)
+        {
+            continue;
+        }
+
+        memset(out, 0, sizeof(*out));
+        out->version = s->version;
+        out->source = s->source;
+        out->timestamp = s->timestamp;
+
+        for (uint8_t i = 0; i < sc->n_fields; ++i)
+        {
+            if (i == sc->ts_index)
+            {
+                out->value[i] = (int32_t)s->timestamp;
+            }
+            else if (s->f[i].n == 0)
+            {
+                out->value[i] = (int32_t)sc->fields[i].sentinel;
+                out->error_mask |= 1u << i;
+            }
+            else
+            {
+                out->value[i] = round_div(s->f[i].sum, s->f[i].n);
+            }
+        }
+
+        s->since_aggregate = 0;
+        ok = true;
+    }
+
+    portEXIT_CRITICAL(&g_mux);
+    return ok;
+}
+
+/**
+ * @brief Copia as estatísticas de um campo de uma origem acompanhada.
+ * @param slot Índice da origem (0..ANALYTICS_MAX_SOURCES-1).
+ * @param field Índice do campo no schema.
+ * @param source Nó de origem (saída).
+ * @param version Versão do schema da origem (saída).
+ * @param out Estatísticas do campo.
+ * @return false se o slot estiver livre, o campo não existir, for o timestamp
+ *         ou ainda não tiver amostra válida.
+ */
+bool analytics_get_field(uint8_t slot, uint8_t field, uint16_t *source, uint8_t *version,
+                         AnalyticsField *out)
+{
+    if (slot >= ANALYTICS_MAX_SOURCES || field >= SCHEMA_MAX_FIELDS)
+    {
+        return false;
+    }
+
+    bool ok = false;
+
+    portENTER_CRITICAL(&g_mux);
+    const SourceState *s = &g_src[slot];
+    const PayloadSchema *sc = s->used ? payload_schema_by_version(s->version) : nullptr;
+
+    if (sc && field < sc->n_fields && field != sc->ts_index && s->f[field].n)
+    {
+        const FieldState *f = &s->f[field];
+        *source = s->source;
+        *version = s->version;
+        out->n = f->n;
+        out->last = f->last;
+        out->mean = round_div(f->sum, f->n);
+        out->min = f->win[mq_at(&f->minq, 0) % ANALYTICS_WINDOW];
+        out->max = f->win[mq_at(&f->maxq, 0) % ANALYTICS_WINDOW];
+        out->ewma = round_div(f->ewma_q, 256);
+        out->rate_per_h = f->rate_per_h;
+        out->active = f->active;
+        ok = true;
+    }
+
+    portEXIT_CRITICAL(&g_mux);
+    return ok;
+}
+
+/**
+ * @brief Nome curto de um tipo de evento (rótulo de métricas e do log).
+ */
+const char *analytics_event_name(AnalyticsEvent kind)
+{
+    static const char *const kMetricNames[EVT_N_KINDS] = {
+        "below", "above", "error_run", "flat", "anomaly",
+    };
+
+    return (kind < EVT_N_KINDS) ? kMetricNames[kind] : "?";
+}
+
+/**
+ * @brief Copia os contadores globais.
+ */
+void analytics_get_stats(AnalyticsStats *out)
+{
+    portENTER_CRITICAL(&g_mux);
+    *out = g_stats;
+    out->sources = 0;
+
+    for (uint8_t i = 0; i < ANALYTICS_MAX_SOURCES; ++i)
+    {
+        out->sources += g_src[i].used ? 1u : 0u;
+    }
+
+    portEXIT_CRITICAL(&g_mux);
+}
@@ -0,0 +1,79 @@
+/**
+ * @file analytics.h
+ * @brief Cabeçalho para as estatísticas móveis por nó de origem e por campo,
+ *        com regras de limiar e de anomalia avaliadas a cada leitura.
+ *
+ * Para cada par (origem, campo) são mantidos, em memória constante e com custo
+ * O(1) por leitura: média, mínimo e máximo de uma janela de @c ANALYTICS_WINDOW
+ * amostras válidas, EWMA e taxa de variação por hora. Eventos (limiar, sentinela
+ * repetida, valor travado, anomalia) são logados no momento da leitura que os
+ * dispara e, de novo, quando a condição deixa de valer.
+ */
+
+#ifndef ANALYTICS_H
+#define ANALYTICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "payload_schema.h"
+
+#define ANALYTICS_MAX_SOURCES  4    /* nós acompanhados; o menos recente é substituído */
+#define ANALYTICS_WINDOW       16   /* amostras válidas na janela móvel                */
+#define ANALYTICS_EWMA_SHIFT   3    /* alfa = 1/8                                      */
+#define ANALYTICS_ANOMALY_K    4    /* anomalia: |v - EWMA| > K * desvio médio         */
+
+/**
+ * @brief Com 1, cada origem envia aos sinks só a leitura consolidada (médias da
+ *        janela) a cada @c ANALYTICS_WINDOW leituras, no lugar das amostras brutas.
+ */
+#ifndef ANALYTICS_UPLOAD_AGGREGATES
+#define ANALYTICS_UPLOAD_AGGREGATES 0
+#endif
+
+/**
+ * @brief Tipos de evento.
+ */
+typedef enum : uint8_t
+{
+    EVT_BELOW,      /* abaixo do limiar                          */
+    EVT_ABOVE,      /* acima do limiar                           */
+    EVT_ERROR_RUN,  /* sentinela de erro em leituras seguidas    */
+    EVT_FLAT,       /* mesmo valor (não nulo) em leituras seguidas */
+    EVT_ANOMALY,    /* desvio do EWMA acima do esperado          */
+    EVT_N_KINDS
+} AnalyticsEvent;
+
+/**
+ * @brief Estatísticas de um campo, em unidades brutas do schema.
+ */
+typedef struct
+{
+    uint8_t n;            /* amostras válidas na janela     */
+    int32_t last;
+    int32_t mean;
+    int32_t min;
+    int32_t max;
+    int32_t ewma;
+    int32_t rate_per_h;   /* variação por hora de timestamp do nó */
+    uint8_t active;       /* bit k = evento k ativo          */
+} AnalyticsField;
+
+/**
+ * @brief Contadores globais.
+ */
+typedef struct
+{
+    uint32_t readings;                /* leituras processadas              */
+    uint32_t evicted;                 /* origens substituídas por falta de slot */
+    uint32_t events[EVT_N_KINDS];     /* eventos disparados, por tipo      */
+    uint8_t sources;                  /* origens acompanhadas              */
+} AnalyticsStats;
+
+uint16_t analytics_update(const SensorReading *r);
+bool analytics_take_aggregate(uint16_t source, SensorReading *out);
+bool analytics_get_field(uint8_t slot, uint8_t field, uint16_t *source, uint8_t *version,
+                         AnalyticsField *out);
+const char *analytics_event_name(AnalyticsEvent kind);
+void analytics_get_stats(AnalyticsStats *out);
+
+#endif /* ANALYTICS_H */
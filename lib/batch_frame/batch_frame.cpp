@@ -0,0 +1,298 @@
+/**
+ * @file batch_frame.cpp
+ * @brief Implementação do codificador/decodificador de quadros em lote com timestamps delta.
+ */
+
+#include "batch_frame.h"
+#include <string.h>
+#include "utils.h"
+
+#define TS_LEN 4
+
+/****************************** Funções privadas ******************************/
+
+/**
+ * @brief Tamanho, em bytes, de um valor bruto do tipo @p t.
+ */
+static inline size_t field_width(FieldType t)
+{
+    return (t == FIELD_U8) ? 1u : (t == FIELD_U32) ? 4u : 2u;
+}
+
+/**
+ * @brief Tamanho de uma amostra no lote: corpo sem timestamp e sem checksum.
+ */
+static inline size_t record_len(const PayloadSchema *s)
+{
+    return (size_t)s->body_len - 1u - TS_LEN;
+}
+
+/**
+ * @brief Lê um varint LEB128 de no máximo @c BATCH_VARINT_MAX bytes.
+ * @param buf Buffer de entrada.
+ * @param len Limite de leitura em @p buf.
+ * @param pos Posição corrente (avançada em caso de sucesso).
+ * @param out Valor decodificado.
+ * @return true se o varint for válido e couber em 32 bits.
+ */
+static bool varint_read(const uint8_t *buf, size_t len, size_t *pos, uint32_t *out)
+{
+    uint32_t v = 0;
+    size_t p = *pos;
+
+    for (uint8_t i = 0; i < BATCH_VARINT_MAX; ++i)
+    {
+        if (p >= len)
+        {
+            return false;
+        }
+
+        const uint8_t b = buf[p++];
+
+        if (i == BATCH_VARINT_MAX - 1 && b > 0x0F)
+        {
+            return false;
+        }
+
+        v |= (uint32_t)(b & 0x7F) << (7 * i);
+
+        if ((b & 0x80) == 0)
+        {
+            *pos = p;
+            *out = v;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Escreve @p v como varint LEB128.
+ * @return Número de bytes escritos; 0 se não couber em @p outlen.
+ */
+static size_t varint_write(uint32_t v, uint8_t *out, size_t outlen)
+{
+    size_t n = 0;
+
+    do
+    {
+        if (n >= outlen)
+        {
+            return 0;
+        }
+
+        uint8_t b = (uint8_t)(v & 0x7F);
+        v >>= 7;
+        out[n++] = v ? (uint8_t)(b | 0x80) : b;
+    } while (v);
+
+    return n;
+}
+
+/**
+ * @brief Escreve o valor bruto de um campo em little-endian.
+ */
+static void field_write(const FieldDesc *f, int32_t value, uint8_t *body)
+{
+    const uint32_t v = (uint32_t)value;
+
+    for (size_t i = 0; i < field_width(f->type); ++i)
+    {
+        body[f->offset + i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+/****************************** Funções públicas ******************************/
+
+/**
+ * @brief Informa se um quadro em claro é um lote.
+ * @param frame Quadro em claro.
+ * @param len Tamanho do quadro.
+ * @return true se o byte de tipo indicar lote e o tamanho comportar o cabeçalho.
+ *
+ * @note O quadro legado de 11 bytes começa pelo byte baixo da irradiância, que
+ *       pode valer @c BATCH_FRAME_TYPE (ex.: 176 W/m^2); tamanhos que já
+ *       correspondem a um schema nunca são tratados como lote.
+ */
+bool batch_frame_is_batch(const uint8_t *frame, size_t len)
+{
+    return frame && len > BATCH_HEADER_LEN + 1u && frame[0] == BATCH_FRAME_TYPE &&
+           !payload_schema_select(frame, len);
+}
+
+/**
+ * @brief Valida um lote por completo (checksum, contagem, varints e tamanho) e
+ *        prepara a iteração.
+ * @param d Decodificador a inicializar.
+ * @param frame Quadro em claro.
+ * @param len Tamanho do quadro.
+ * @return true se o lote for consistente; nenhuma amostra é entregue caso contrário.
+ */
+bool batch_decoder_init(BatchDecoder *d, const uint8_t *frame, size_t len)
+{
+    if (!d || !batch_frame_is_batch(frame, len))
+    {
+        return false;
+    }
+
+    const size_t body_end = len - 1u;
+
+    if (utils_checksum8(frame, body_end) != frame[body_end])
+    {
+        return false;
+    }
+
+    const PayloadSchema *s = payload_schema_by_version(frame[1]);
+    const uint8_t count = frame[2];
+
+    if (!s || s->fields[s->ts_index].type != FIELD_U32 ||
+        count == 0 || count > BATCH_MAX_SAMPLES)
+    {
+        return false;
+    }
+
+    /* Percorre o lote inteiro antes de entregar qualquer amostra. */
+    size_t pos = BATCH_HEADER_LEN;
+
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        uint32_t delta;
+
+        if (!varint_read(frame, body_end, &pos, &delta) || body_end - pos < record_len(s))
+        {
+            return false;
+        }
+
+        pos += record_len(s);
+    }
+
+    if (pos != body_end)
+    {
+        return false;
+    }
+
+    d->buf = frame;
+    d->len = body_end;
+    d->pos = BATCH_HEADER_LEN;
+    d->schema = s;
+    d->count = count;
+    d->index = 0;
+    d->checksum = frame[body_end];
+    d->ts = utils_rd_le_u32(&frame[3]);
+    return true;
+}
+
+/**
+ * @brief Decodifica a próxima amostra do lote.
+ * @param d Decodificador inicializado por @c batch_decoder_init().
+ * @param out Leitura a ser preenchida.
+ * @return true se uma amostra foi entregue; false ao fim do lote.
+ */
+bool batch_decoder_next(BatchDecoder *d, SensorReading *out)
+{
+    if (!d || !out || d->index >= d->count)
+    {
+        return false;
+    }
+
+    const PayloadSchema *s = d->schema;
+    const size_t ts_off = s->fields[s->ts_index].offset;
+    const size_t rec = record_len(s);
+    uint32_t delta;
+
+    if (!varint_read(d->buf, d->len, &d->pos, &delta))
+    {
+        return false;
+    }
+
+    d->ts += delta;
+
+    /* Remonta o corpo da versão para reutilizar o decodificador gerado pelo schema. */
+    uint8_t body[UINT8_MAX];
+    const uint8_t *r = d->buf + d->pos;
+    memcpy(body, r, ts_off);
+    body[ts_off + 0] = (uint8_t)(d->ts);
+    body[ts_off + 1] = (uint8_t)(d->ts >> 8);
+    body[ts_off + 2] = (uint8_t)(d->ts >> 16);
+    body[ts_off + 3] = (uint8_t)(d->ts >> 24);
+    memcpy(body + ts_off + TS_LEN, r + ts_off, rec - ts_off);
+    d->pos += rec;
+    d->index++;
+
+    s->decode(body, out);
+    out->version = s->version;
+    out->checksum = d->checksum;
+    out->source = 0;
+    out->timestamp = d->ts;
+    return true;
+}
+
+/**
+ * @brief Codifica @p n leituras em um lote.
+ * @param s Schema das amostras (timestamp deve ser u32).
+ * @param samples Leituras em ordem não decrescente de timestamp.
+ * @param n Número de leituras (1..BATCH_MAX_SAMPLES).
+ * @param out Buffer de saída.
+ * @param outlen Tamanho de @p out.
+ * @return Tamanho do lote em bytes; 0 se os parâmetros forem inválidos ou não couberem.
+ */
+size_t batch_frame_encode(const PayloadSchema *s, const SensorReading *samples, uint8_t n,
+                          uint8_t *out, size_t outlen)
+{
+    if (!s || !samples || !out || n == 0 || n > BATCH_MAX_SAMPLES ||
+        s->fields[s->ts_index].type != FIELD_U32 || outlen < BATCH_HEADER_LEN + 1u)
+    {
+        return 0;
+    }
+
+    const size_t ts_off = s->fields[s->ts_index].offset;
+    const size_t rec = record_len(s);
+    uint32_t prev = samples[0].timestamp;
+
+    out[0] = BATCH_FRAME_TYPE;
+    out[1] = s->version;
+    out[2] = n;
+    out[3] = (uint8_t)(prev);
+    out[4] = (uint8_t)(prev >> 8);
+    out[5] = (uint8_t)(prev >> 16);
+    out[6] = (uint8_t)(prev >> 24);
+    size_t pos = BATCH_HEADER_LEN;
+
+    for (uint8_t i = 0; i < n; ++i)
+    {
+        const SensorReading *r = &samples[i];
+
+        if (r->timestamp < prev)
+        {
+            return 0;
+        }
+
+        const size_t vn = varint_write(r->timestamp - prev, out + pos, outlen - pos);
+
+        if (vn == 0 || outlen - pos - vn < rec + 1u)
+        {
+            return 0;
+        }
+
+        pos += vn;
+        prev = r->timestamp;
+
+        uint8_t body[UINT8_MAX];
+
+        for (uint8_t f = 0; f < s->n_fields; ++f)
+        {
+            if (f != s->ts_index)
+            {
+                field_write(&s->fields[f], r->value[f], body);
+            }
+        }
+
+        memcpy(out + pos, body, ts_off);
+        memcpy(out + pos + ts_off, body + ts_off + TS_LEN, rec - ts_off);
+        pos += rec;
+    }
+
+    out[pos] = utils_checksum8(out, pos);
+    return pos + 1u;
+}
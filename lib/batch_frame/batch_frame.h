@@ -0,0 +1,50 @@
+/**
+ * @file batch_frame.h
+ * @brief Cabeçalho para quadros em lote (várias amostras por quadro LoRa).
+ *
+ * Layout do quadro em claro (após descriptografia):
+ *
+ *   [0]      BATCH_FRAME_TYPE
+ *   [1]      versão do schema das amostras
+ *   [2]      N = número de amostras (1..BATCH_MAX_SAMPLES)
+ *   [3..6]   timestamp base (u32, little-endian)
+ *   N vezes: delta de timestamp em varint (LEB128, relativo à amostra anterior)
+ *            + corpo da amostra sem timestamp e sem checksum
+ *   [último] checksum 8-bit de todos os bytes anteriores
+ */
+
+#ifndef BATCH_FRAME_H
+#define BATCH_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "payload_schema.h"
+
+#define BATCH_FRAME_TYPE    0xB0
+#define BATCH_MAX_SAMPLES   32
+#define BATCH_HEADER_LEN    7
+#define BATCH_VARINT_MAX    5
+
+/**
+ * @brief Estado do decodificador de lote (sem alocação; aponta para o quadro).
+ */
+typedef struct
+{
+    const uint8_t *buf;           /* quadro em claro                   */
+    size_t len;                   /* tamanho do quadro (sem checksum)  */
+    size_t pos;                   /* posição de leitura corrente       */
+    const PayloadSchema *schema;  /* schema das amostras               */
+    uint8_t count;                /* número de amostras no lote        */
+    uint8_t index;                /* próxima amostra a decodificar     */
+    uint8_t checksum;             /* checksum do quadro                */
+    uint32_t ts;                  /* timestamp da última amostra       */
+} BatchDecoder;
+
+bool batch_frame_is_batch(const uint8_t *frame, size_t len);
+bool batch_decoder_init(BatchDecoder *d, const uint8_t *frame, size_t len);
+bool batch_decoder_next(BatchDecoder *d, SensorReading *out);
+size_t batch_frame_encode(const PayloadSchema *s, const SensorReading *samples, uint8_t n,
+                          uint8_t *out, size_t outlen);
+
+#endif /* BATCH_FRAME_H */
@@ -0,0 +1,87 @@
+/**
+ * @file boot_timeline.cpp
+ * @brief Registro do início e da duração de cada fase do boot, em ms desde o reset.
+ *
+ * Cada fase é marcada por uma única tarefa; o log é emitido depois que todas
+ * terminam, quando o SD já pode recebê-lo.
+ */
+
+#include "boot_timeline.h"
+#include <esp_timer.h>
+#include "logger.h"
+
+static const char *TAG = "BOOT";
+
+static const char *const kPhaseNames[BOOT_N_PHASES] = {
+    "logger", "crypto", "radio", "wifi", "uplink", "rtc", "sd_mount", "sd_open",
+};
+
+static volatile uint32_t g_start_us[BOOT_N_PHASES];
+static volatile uint32_t g_end_us[BOOT_N_PHASES];
+static volatile uint32_t g_done_mask = 0;
+
+/****************************** Funções públicas ******************************/
+
+/**
+ * @brief Marca o início da fase @p p.
+ */
+void boot_phase_start(BootPhase p)
+{
+    g_start_us[p] = (uint32_t)esp_timer_get_time();
+}
+
+/**
+ * @brief Marca o fim da fase @p p.
+ */
+void boot_phase_end(BootPhase p)
+{
+    g_end_us[p] = (uint32_t)esp_timer_get_time();
+    __atomic_or_fetch(&g_done_mask, 1u << p, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Informa se todas as fases já terminaram.
+ */
+bool boot_timeline_complete(void)
+{
+    return __atomic_load_n(&g_done_mask, __ATOMIC_ACQUIRE) == (1u << BOOT_N_PHASES) - 1u;
+}
+
+/**
+ * @brief Loga início e duração de cada fase concluída, em ordem de início.
+ */
+void boot_timeline_log(void)
+{
+    bool listed[BOOT_N_PHASES] = {false};
+    const uint32_t done = __atomic_load_n(&g_done_mask, __ATOMIC_ACQUIRE);
+    uint32_t last_end = 0;
+
+    for (uint8_t n = 0; n < BOOT_N_PHASES; ++n)
+    {
+        int8_t next = -1;
+
+        for (uint8_t i = 0; i < BOOT_N_PHASES; ++i)
+        {
+            if (!listed[i] && ((done >> i) & 1u) &&
+                (next < 0 || g_start_us[i] < g_start_us[(uint8_t)next]))
+            {
+                next = (int8_t)i;
+            }
+        }
+
+        if (next < 0)
+        {
+            break;
+        }
+
+        const uint8_t i = (uint8_t)next;
+        listed[i] = true;
+        last_end = (g_end_us[i] > last_end) ? g_end_us[i] : last_end;
+        LOG(TAG, "%-9s inicio %5lu ms  duracao %5lu ms", kPhaseNames[i],
+            (unsigned long)(g_start_us[i] / 1000u),
+            (unsigned long)((g_end_us[i] - g_start_us[i]) / 1000u));
+    }
+
+    LOG(TAG, "radio ouvindo em %lu ms, boot completo em %lu ms",
+        (unsigned long)(g_end_us[BOOT_RADIO] / 1000u), (unsigned long)(last_end / 1000u));
+}
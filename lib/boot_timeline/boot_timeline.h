@@ -0,0 +1,33 @@
+/**
+ * @file boot_timeline.h
+ * @brief Cabeçalho para o registro da duração de cada fase do boot.
+ */
+
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Fases do boot; as de segundo plano rodam em tarefas próprias.
+ */
+typedef enum : uint8_t
+{
+    BOOT_LOGGER,
+    BOOT_CRYPTO,
+    BOOT_RADIO,
+    BOOT_WIFI,
+    BOOT_UPLINK,
+    BOOT_RTC,
+    BOOT_SD_MOUNT,
+    BOOT_SD_OPEN,
+    BOOT_N_PHASES
+} BootPhase;
+
+void boot_phase_start(BootPhase p);
+void boot_phase_end(BootPhase p);
+bool boot_timeline_complete(void);
+void boot_timeline_log(void);
+
+#endif /* BOOT_TIMELINE_H */
@@ -5,11 +5,15 @@
 
 #include "crypto.h"
 #include <string.h>
-#include <mbedtls/aes.h>
 #include "logger.h"
 
 static const char *TAG = "CRYPTO";
-static uint8_t g_key[CRYPTO_KEY_SIZE];
+static CryptoKey g_fleet_key;  /* chave de @c credentials.h (quadros sem id de nó) */
+
+/* Rótulo fixo de derivação: chave de ACK = AES-CMAC_{chave do quadro}(rótulo). */
+static const uint8_t kAckLabel[] = {
+    'L', 'O', 'R', 'A', '-', 'A', 'C', 'K', '-', 'K', 'E', 'Y', '-', 'v', '1',
+};
 
 /****************************** Funções privadas ******************************/
 
@@ -46,20 +50,166 @@ static inline bool pkcs7_unpad(uint8_t *buf, size_t in_len, size_t *out_len)
     return true;
 }
 
+/**
+ * @brief Dobra um bloco em GF(2^128) (deslocamento de 1 bit e redução por 0x87),
+ *        como na geração das subchaves do CMAC (RFC 4493).
+ */
+static void cmac_dbl(const uint8_t in[CRYPTO_BLOCK_SIZE], uint8_t out[CRYPTO_BLOCK_SIZE])
+{
+    const uint8_t carry = (uint8_t)(in[0] >> 7);
+
+    for (size_t i = 0; i < CRYPTO_BLOCK_SIZE - 1; ++i)
+    {
+        out[i] = (uint8_t)((in[i] << 1) | (in[i + 1] >> 7));
+    }
+
+    out[CRYPTO_BLOCK_SIZE - 1] = (uint8_t)((in[CRYPTO_BLOCK_SIZE - 1] << 1) ^ (carry ? 0x87 : 0));
+}
+
+/**
+ * @brief Gera as subchaves K1/K2 do CMAC a partir de um contexto de cifra.
+ * @return Verdadeiro se a cifra do bloco nulo foi feita.
+ */
+static bool cmac_subkeys(mbedtls_aes_context *enc, uint8_t k1[CRYPTO_BLOCK_SIZE],
+                         uint8_t k2[CRYPTO_BLOCK_SIZE])
+{
+    uint8_t l[CRYPTO_BLOCK_SIZE] = {0};
+
+    if (mbedtls_aes_crypt_ecb(enc, MBEDTLS_AES_ENCRYPT, l, l) != 0)
+    {
+        return false;
+    }
+
+    cmac_dbl(l, k1);
+    cmac_dbl(k1, k2);
+    memset(l, 0, sizeof(l));
+    return true;
+}
+
+/**
+ * @brief AES-CMAC (RFC 4493) de uma mensagem de qualquer tamanho.
+ * @param enc Contexto de cifra da chave do MAC.
+ * @param k1 Subchave para o último bloco completo.
+ * @param k2 Subchave para o último bloco com padding.
+ * @param msg Mensagem.
+ * @param len Tamanho da mensagem (pode ser 0).
+ * @param out MAC de 16 bytes.
+ * @return Verdadeiro se todas as cifras de bloco foram feitas.
+ */
+static bool cmac(mbedtls_aes_context *enc, const uint8_t k1[CRYPTO_BLOCK_SIZE],
+                 const uint8_t k2[CRYPTO_BLOCK_SIZE], const uint8_t *msg, size_t len,
+                 uint8_t out[CRYPTO_BLOCK_SIZE])
+{
+    uint8_t x[CRYPTO_BLOCK_SIZE] = {0};
+
+    /* Todos os blocos menos o último entram no encadeamento CBC sem subchave. */
+    while (len > CRYPTO_BLOCK_SIZE)
+    {
+        for (size_t i = 0; i < CRYPTO_BLOCK_SIZE; ++i)
+        {
+            x[i] ^= msg[i];
+        }
+
+        if (mbedtls_aes_crypt_ecb(enc, MBEDTLS_AES_ENCRYPT, x, x) != 0)
+        {
+            return false;
+        }
+
+        msg += CRYPTO_BLOCK_SIZE;
+        len -= CRYPTO_BLOCK_SIZE;
+    }
+
+    /* Último bloco: completo com K1; parcial (ou mensagem vazia) com 10..0 e K2. */
+    const uint8_t *sub = (len == CRYPTO_BLOCK_SIZE) ? k1 : k2;
+
+    for (size_t i = 0; i < CRYPTO_BLOCK_SIZE; ++i)
+    {
+        const uint8_t m = (i < len) ? msg[i] : (i == len ? 0x80 : 0x00);
+        x[i] ^= (uint8_t)(m ^ sub[i]);
+    }
+
+    return mbedtls_aes_crypt_ecb(enc, MBEDTLS_AES_ENCRYPT, x, out) == 0;
+}
+
+/**
+ * @brief Deriva a chave de ACK da chave do quadro e expande seu key schedule.
+ * @return Verdadeiro se a derivação e a expansão foram feitas.
+ *
+ * @note A chave do quadro só cifra entradas fixas aqui (bloco nulo e rótulo); nada
+ *       que venha do ar é cifrado com ela.
+ */
+static bool derive_ack_key(CryptoKey *k, const uint8_t *key16)
+{
+    mbedtls_aes_context frame_enc;
+    uint8_t k1[CRYPTO_BLOCK_SIZE];
+    uint8_t k2[CRYPTO_BLOCK_SIZE];
+    uint8_t ack_key[CRYPTO_KEY_SIZE];
+
+    mbedtls_aes_init(&frame_enc);
+    bool ok = mbedtls_aes_setkey_enc(&frame_enc, key16, 128) == 0 &&
+              cmac_subkeys(&frame_enc, k1, k2) &&
+              cmac(&frame_enc, k1, k2, kAckLabel, sizeof(kAckLabel), ack_key);
+    mbedtls_aes_free(&frame_enc);
+
+    ok = ok && mbedtls_aes_setkey_enc(&k->ack, ack_key, 128) == 0 &&
+         cmac_subkeys(&k->ack, k->ack_k1, k->ack_k2);
+
+    memset(k1, 0, sizeof(k1));
+    memset(k2, 0, sizeof(k2));
+    memset(ack_key, 0, sizeof(ack_key));
+    return ok;
+}
+
 /****************************** Funções públicas ******************************/
 
 /**
  * @brief Inicializa o módulo de criptografia com a chave fornecida.
- * @param key16 Ponteiro para a chave AES de 16 bytes.
+ * @param key16 Ponteiro para a chave AES de 16 bytes (chave da frota, usada nos
+ *              quadros sem id de nó).
  */
 void crypto_init(const uint8_t *key16)
 {
-    memcpy(g_key, key16, CRYPTO_KEY_SIZE);
-    LOG(TAG, "AES-128-CBC inicializado");
+    if (crypto_key_init(&g_fleet_key, key16))
+    {
+        LOG(TAG, "AES-128-CBC inicializado");
+    }
+}
+
+/**
+ * @brief Expande o key schedule de decifra de uma chave e deriva dela a chave de ACK.
+ * @param k Chave a preencher (liberar com @c crypto_key_free()).
+ * @param key16 Chave AES de 16 bytes.
+ * @return Verdadeiro se a expansão e a derivação foram feitas.
+ */
+bool crypto_key_init(CryptoKey *k, const uint8_t *key16)
+{
+    mbedtls_aes_init(&k->dec);
+    mbedtls_aes_init(&k->ack);
+
+    if (mbedtls_aes_setkey_dec(&k->dec, key16, 128) != 0 || !derive_ack_key(k, key16))
+    {
+        LOG(TAG, "setkey falhou");
+        crypto_key_free(k);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Libera e zera os key schedules de uma chave.
+ */
+void crypto_key_free(CryptoKey *k)
+{
+    mbedtls_aes_free(&k->dec);
+    mbedtls_aes_free(&k->ack);
+    memset(k->ack_k1, 0, sizeof(k->ack_k1));
+    memset(k->ack_k2, 0, sizeof(k->ack_k2));
 }
 
 /**
  * @brief Descriptografa dados usando AES-128-CBC.
+ * @param k Chave já expandida; @c nullptr usa a chave da frota.
  * @param in Dados criptografados.
  * @param in_len Tamanho dos dados criptografados.
  * @param iv Vetor de inicialização.
@@ -67,7 +217,7 @@ void crypto_init(const uint8_t *key16)
  * @param out_len Ponteiro para armazenar o tamanho dos dados descriptografados.
  * @return Verdadeiro se a descriptografia foi bem-sucedida, falso caso contrário.
  */
-bool crypto_decrypt(const uint8_t *in, size_t in_len,
+bool crypto_decrypt(CryptoKey *k, const uint8_t *in, size_t in_len,
                     const uint8_t iv[CRYPTO_BLOCK_SIZE],
                     uint8_t *out, size_t *out_len)
 {
@@ -77,21 +227,11 @@ bool crypto_decrypt(const uint8_t *in, size_t in_len,
         return false;
     }
 
-    mbedtls_aes_context ctx;
-    mbedtls_aes_init(&ctx);
-
-    if (mbedtls_aes_setkey_dec(&ctx, g_key, 128) != 0)
-    {
-        LOG(TAG, "setkey_dec falhou");
-        mbedtls_aes_free(&ctx);
-        return false;
-    }
-
     uint8_t iv_copy[CRYPTO_BLOCK_SIZE];
     memcpy(iv_copy, iv, CRYPTO_BLOCK_SIZE);
 
-    int32_t rc = mbedtls_aes_crypt_cbc(&ctx, MBEDTLS_AES_DECRYPT, in_len, iv_copy, in, out);
-    mbedtls_aes_free(&ctx);
+    CryptoKey *key = k ? k : &g_fleet_key;
+    int32_t rc = mbedtls_aes_crypt_cbc(&key->dec, MBEDTLS_AES_DECRYPT, in_len, iv_copy, in, out);
 
     if (rc != 0)
     {
@@ -107,4 +247,30 @@ bool crypto_decrypt(const uint8_t *in, size_t in_len,
 
     LOG(TAG, "decrypt OK (plain_len=%u)", (unsigned)*out_len);
     return true;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Gera a etiqueta de ACK de um quadro: AES-CMAC, com a chave de ACK, do
+ *        quadro recebido inteiro (IV + ciphertext).
+ * @param k Chave que decifrou o quadro; @c nullptr usa a chave da frota.
+ * @param frame IV seguido do ciphertext, como chegaram no pacote.
+ * @param len Tamanho de @p frame em bytes.
+ * @param out Etiqueta de 16 bytes.
+ * @return Verdadeiro se a etiqueta foi gerada, falso caso contrário.
+ *
+ * @note Só quem tem a chave produz a etiqueta, e ela vale apenas para aquele quadro;
+ *       o nó calcula o mesmo CMAC sobre o que transmitiu e compara.
+ */
+bool crypto_ack_tag(CryptoKey *k, const uint8_t *frame, size_t len,
+                    uint8_t out[CRYPTO_BLOCK_SIZE])
+{
+    CryptoKey *key = k ? k : &g_fleet_key;
+
+    if (!cmac(&key->ack, key->ack_k1, key->ack_k2, frame, len, out))
+    {
+        LOG(TAG, "etiqueta de ACK falhou");
+        return false;
+    }
+
+    return true;
+}
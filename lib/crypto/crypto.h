@@ -9,13 +9,31 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <mbedtls/aes.h>
 
 #define CRYPTO_KEY_SIZE 16
 #define CRYPTO_BLOCK_SIZE 16
 
+/**
+ * @brief Chave com os key schedules já expandidos, para que nenhum pacote pague a
+ *        expansão: decifra dos quadros e cifra da chave de ACK, derivada da chave
+ *        do quadro e usada só no AES-CMAC da etiqueta (com as subchaves K1/K2).
+ */
+typedef struct
+{
+    mbedtls_aes_context dec;
+    mbedtls_aes_context ack;
+    uint8_t ack_k1[CRYPTO_BLOCK_SIZE];
+    uint8_t ack_k2[CRYPTO_BLOCK_SIZE];
+} CryptoKey;
+
 void crypto_init(const uint8_t *key16);
-bool crypto_decrypt(const uint8_t *in, size_t in_len,
+bool crypto_key_init(CryptoKey *k, const uint8_t *key16);
+void crypto_key_free(CryptoKey *k);
+bool crypto_decrypt(CryptoKey *k, const uint8_t *in, size_t in_len,
                     const uint8_t iv[CRYPTO_BLOCK_SIZE],
                     uint8_t *out, size_t *out_len);
+bool crypto_ack_tag(CryptoKey *k, const uint8_t *frame, size_t len,
+                    uint8_t out[CRYPTO_BLOCK_SIZE]);
 
 #endif /* CRYPTO_H */
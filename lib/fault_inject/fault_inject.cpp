@@ -0,0 +1,203 @@
+/**
+ * @file fault_inject.cpp
+ * @brief Injeção de atrasos e erros sorteados nos pontos de I/O do gateway, para
+ *        reproduzir em bancada travamentos vistos em campo.
+ *
+ * A configuração inicial vem das macros @c FAULT_<PONTO>_{ERR,DLY}_PM e
+ * @c FAULT_<PONTO>_{MIN,MAX}_MS, e pode ser alterada em execução pelo endpoint
+ * @c /fault (ex.: @c /fault?p=sd&err=0&dly=50&min=200&max=3000).
+ */
+
+#include "fault_inject.h"
+
+#if FAULT_INJECT
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <string.h>
+#include "logger.h"
+
+#ifndef FAULT_SD_ERR_PM
+#define FAULT_SD_ERR_PM     0
+#endif
+#ifndef FAULT_SD_DLY_PM
+#define FAULT_SD_DLY_PM     0
+#endif
+#ifndef FAULT_SD_MIN_MS
+#define FAULT_SD_MIN_MS     100
+#endif
+#ifndef FAULT_SD_MAX_MS
+#define FAULT_SD_MAX_MS     2000
+#endif
+#ifndef FAULT_HTTP_ERR_PM
+#define FAULT_HTTP_ERR_PM   0
+#endif
+#ifndef FAULT_HTTP_DLY_PM
+#define FAULT_HTTP_DLY_PM   0
+#endif
+#ifndef FAULT_HTTP_MIN_MS
+#define FAULT_HTTP_MIN_MS   1000
+#endif
+#ifndef FAULT_HTTP_MAX_MS
+#define FAULT_HTTP_MAX_MS   5000
+#endif
+#ifndef FAULT_RADIO_ERR_PM
+#define FAULT_RADIO_ERR_PM  0
+#endif
+#ifndef FAULT_RADIO_DLY_PM
+#define FAULT_RADIO_DLY_PM  0
+#endif
+#ifndef FAULT_RADIO_MIN_MS
+#define FAULT_RADIO_MIN_MS  10
+#endif
+#ifndef FAULT_RADIO_MAX_MS
+#define FAULT_RADIO_MAX_MS  500
+#endif
+#ifndef FAULT_WIFI_ERR_PM
+#define FAULT_WIFI_ERR_PM   0
+#endif
+
+static const char *TAG = "FAULT";
+
+static const char *const kPointNames[FAULT_N_POINTS] = {"sd", "http", "radio", "wifi"};
+
+static FaultConfig g_cfg[FAULT_N_POINTS] = {
+    {FAULT_SD_ERR_PM, FAULT_SD_DLY_PM, FAULT_SD_MIN_MS, FAULT_SD_MAX_MS},
+    {FAULT_HTTP_ERR_PM, FAULT_HTTP_DLY_PM, FAULT_HTTP_MIN_MS, FAULT_HTTP_MAX_MS},
+    {FAULT_RADIO_ERR_PM, FAULT_RADIO_DLY_PM, FAULT_RADIO_MIN_MS, FAULT_RADIO_MAX_MS},
+    {FAULT_WIFI_ERR_PM, 0, 0, 0},
+};
+
+static uint32_t g_hits[FAULT_N_POINTS];
+
+/****************************** Funções privadas ******************************/
+
+/**
+ * @brief Sorteia um evento com probabilidade @p permille / 1000.
+ */
+static bool roll(uint16_t permille)
+{
+    return permille && (esp_random() % 1000u) < permille;
+}
+
+/****************************** Funções públicas ******************************/
+
+/**
+ * @brief Substitui a configuração de um ponto de injeção.
+ */
+void fault_configure(FaultPoint p, const FaultConfig *cfg)
+{
+    if (p < FAULT_N_POINTS && cfg)
+    {
+        g_cfg[p] = *cfg;
+        LOG(TAG, "%s: err=%u/1000 atraso=%u/1000 (%lu..%lu ms)", kPointNames[p],
+            (unsigned)cfg->error_permille, (unsigned)cfg->delay_permille,
+            (unsigned long)cfg->delay_min_ms, (unsigned long)cfg->delay_max_ms);
+    }
+}
+
+/**
+ * @brief Aplica uma configuração no formato "p=sd&err=10&dly=50&min=100&max=2000".
+ * @param query Query string; chaves ausentes mantêm o valor corrente.
+ * @return false se o ponto @c p for desconhecido.
+ */
+bool fault_configure_query(const char *query)
+{
+    int8_t point = -1;
+    char buf[96];
+    strlcpy(buf, query ? query : "", sizeof(buf));
+
+    for (char *save = nullptr, *kv = strtok_r(buf, "&", &save); kv;
+         kv = strtok_r(nullptr, "&", &save))
+    {
+        if (strncmp(kv, "p=", 2) != 0)
+        {
+            continue;
+        }
+
+        for (uint8_t i = 0; i < FAULT_N_POINTS; ++i)
+        {
+            if (strcmp(kv + 2, kPointNames[i]) == 0)
+            {
+                point = (int8_t)i;
+            }
+        }
+    }
+
+    if (point < 0)
+    {
+        return false;
+    }
+
+    FaultConfig cfg = g_cfg[point];
+    strlcpy(buf, query, sizeof(buf));
+
+    for (char *save = nullptr, *kv = strtok_r(buf, "&", &save); kv;
+         kv = strtok_r(nullptr, "&", &save))
+    {
+        char *eq = strchr(kv, '=');
+
+        if (!eq)
+        {
+            continue;
+        }
+
+        *eq = '\0';
+        const uint32_t v = (uint32_t)strtoul(eq + 1, nullptr, 10);
+
+        if (strcmp(kv, "err") == 0)
+        {
+            cfg.error_permille = (uint16_t)(v > 1000 ? 1000 : v);
+        }
+        else if (strcmp(kv, "dly") == 0)
+        {
+            cfg.delay_permille = (uint16_t)(v > 1000 ? 1000 : v);
+        }
+        else if (strcmp(kv, "min") == 0)
+        {
+            cfg.delay_min_ms = v;
+        }
+        else if (strcmp(kv, "max") == 0)
+        {
+            cfg.delay_max_ms = v;
+        }
+    }
+
+    fault_configure((FaultPoint)point, &cfg);
+    return true;
+}
+
+/**
+ * @brief Avalia o ponto @p p: pode bloquear pelo atraso sorteado.
+ * @return true se a operação deve ser tratada como falha.
+ */
+bool fault_hit(FaultPoint p)
+{
+    const FaultConfig *c = &g_cfg[p];
+
+    if (roll(c->delay_permille))
+    {
+        const uint32_t span = (c->delay_max_ms > c->delay_min_ms)
+                                  ? c->delay_max_ms - c->delay_min_ms : 0;
+        delay(c->delay_min_ms + (span ? esp_random() % (span + 1u) : 0));
+        g_hits[p]++;
+    }
+
+    if (roll(c->error_permille))
+    {
+        g_hits[p]++;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Número de falhas (atrasos + erros) já injetadas no ponto @p p.
+ */
+uint32_t fault_count(FaultPoint p)
+{
+    return (p < FAULT_N_POINTS) ? g_hits[p] : 0;
+}
+
+#endif /* FAULT_INJECT */
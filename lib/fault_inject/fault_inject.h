@@ -0,0 +1,51 @@
+/**
+ * @file fault_inject.h
+ * @brief Cabeçalho para a injeção de falhas em bancada (SD, HTTP, rádio, Wi-Fi).
+ *
+ * Compilado apenas com @c -DFAULT_INJECT=1; caso contrário @c fault_hit() é uma
+ * função inline que retorna false e os pontos de injeção não custam nada.
+ */
+
+#ifndef FAULT_INJECT_H
+#define FAULT_INJECT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef FAULT_INJECT
+#define FAULT_INJECT 0
+#endif
+
+/**
+ * @brief Pontos do firmware onde falhas podem ser injetadas.
+ */
+typedef enum : uint8_t
+{
+    FAULT_SD_WRITE,  /* atraso/erro ao gravar uma linha no SD          */
+    FAULT_HTTP,      /* atraso/timeout no POST do ThingSpeak           */
+    FAULT_RADIO,     /* atraso no processamento/perda de pacote        */
+    FAULT_WIFI,      /* queda forçada do Wi-Fi (avaliada 1x por segundo) */
+    FAULT_N_POINTS
+} FaultPoint;
+
+/**
+ * @brief Parâmetros de um ponto de injeção; probabilidades em partes por mil.
+ */
+typedef struct
+{
+    uint16_t error_permille;  /* chance de a operação falhar          */
+    uint16_t delay_permille;  /* chance de a operação atrasar         */
+    uint32_t delay_min_ms;    /* atraso mínimo quando sorteado        */
+    uint32_t delay_max_ms;    /* atraso máximo quando sorteado        */
+} FaultConfig;
+
+#if FAULT_INJECT
+void fault_configure(FaultPoint p, const FaultConfig *cfg);
+bool fault_configure_query(const char *query);
+bool fault_hit(FaultPoint p);
+uint32_t fault_count(FaultPoint p);
+#else
+static inline bool fault_hit(FaultPoint) { return false; }
+#endif
+
+#endif /* FAULT_INJECT_H */
@@ -0,0 +1,229 @@
+/**
+ * @file fmt.cpp
+ * @brief Implementação da formatação de texto sem printf e sem ponto flutuante.
+ */
+
+#include "fmt.h"
+
+/* Pares de dígitos "00".."99": converte dois dígitos por divisão. */
+static const char kDigits2[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const char kHex[] = "0123456789ABCDEF";
+
+static const uint32_t kPow10[] = {
+    1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u, 1000000000u};
+
+/****************************** Funções privadas ******************************/
+
+/**
+ * @brief Escreve exatamente dois dígitos decimais (0..99).
+ */
+static inline char *put2(char *out, uint32_t v)
+{
+    out[0] = kDigits2[2 * v];
+    out[1] = kDigits2[2 * v + 1];
+    return out + 2;
+}
+
+/**
+ * @brief Escreve @p v em decimal, ao menos @p min_digits dígitos (zeros à esquerda).
+ */
+static char *put_u64(char *out, uint64_t v, uint8_t min_digits)
+{
+    char tmp[20];
+    char *p = tmp + sizeof(tmp);
+
+    while (v >= 100u)
+    {
+        const uint32_t r = (uint32_t)(v % 100u);
+        v /= 100u;
+        p -= 2;
+        put2(p, r);
+    }
+
+    if (v >= 10u)
+    {
+        p -= 2;
+        put2(p, (uint32_t)v);
+    }
+    else
+    {
+        *--p = (char)('0' + v);
+    }
+
+    while ((size_t)(tmp + sizeof(tmp) - p) < min_digits)
+    {
+        *--p = '0';
+    }
+
+    const size_t n = (size_t)(tmp + sizeof(tmp) - p);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        out[i] = p[i];
+    }
+
+    return out + n;
+}
+
+/****************************** Funções públicas ******************************/
+
+/**
+ * @brief Copia uma string terminada em zero (sem o terminador).
+ */
+char *fmt_str(char *out, const char *s)
+{
+    while (*s)
+    {
+        *out++ = *s++;
+    }
+
+    return out;
+}
+
+/**
+ * @brief Escreve um inteiro sem sinal em decimal.
+ */
+char *fmt_u32(char *out, uint32_t v)
+{
+    return put_u64(out, v, 1);
+}
+
+/**
+ * @brief Escreve um inteiro com sinal em decimal.
+ */
+char *fmt_i32(char *out, int32_t v)
+{
+    if (v < 0)
+    {
+        *out++ = '-';
+        return put_u64(out, (uint64_t)(-(int64_t)v), 1);
+    }
+
+    return put_u64(out, (uint64_t)v, 1);
+}
+
+/**
+ * @brief Escreve um inteiro sem sinal com zeros à esquerda até @p width dígitos.
+ */
+char *fmt_u32_pad(char *out, uint32_t v, uint8_t width)
+{
+    return put_u64(out, v, width);
+}
+
+/**
+ * @brief Escreve @p raw / 10^scale_exp com @p decimals casas decimais, sem float.
+ * @param out Buffer de saída (até @c FMT_FIXED_MAX caracteres).
+ * @param raw Valor bruto inteiro (ex.: mV, décimos de °C).
+ * @param scale_exp Expoente decimal da escala (0..9).
+ * @param decimals Casas decimais desejadas (0..9).
+ * @return Ponteiro após o último caractere escrito.
+ *
+ * @note Reduções de casas usam arredondamento "meio para o par", o mesmo que
+ *       @c printf("%.Nf") aplica a valores exatamente representáveis; o sinal
+ *       é mantido mesmo quando o resultado arredonda para zero ("-0.0").
+ */
+char *fmt_fixed(char *out, int32_t raw, uint8_t scale_exp, uint8_t decimals)
+{
+    if (scale_exp > 9)
+    {
+        scale_exp = 9;
+    }
+
+    if (decimals > 9)
+    {
+        decimals = 9;
+    }
+
+    uint64_t m = (raw < 0) ? (uint64_t)(-(int64_t)raw) : (uint64_t)raw;
+
+    if (raw < 0)
+    {
+        *out++ = '-';
+    }
+
+    if (decimals >= scale_exp)
+    {
+        m *= kPow10[decimals - scale_exp];
+    }
+    else
+    {
+        const uint32_t div = kPow10[scale_exp - decimals];
+        const uint64_t q = m / div;
+        const uint64_t r = m % div;
+        const uint64_t half = div / 2u;
+        m = q + ((r > half || (r == half && (q & 1u))) ? 1u : 0u);
+    }
+
+    const uint32_t unit = kPow10[decimals];
+    out = put_u64(out, m / unit, 1);
+
+    if (decimals)
+    {
+        *out++ = '.';
+        out = put_u64(out, m % unit, decimals);
+    }
+
+    return out;
+}
+
+/**
+ * @brief Escreve um byte como dois dígitos hexadecimais maiúsculos.
+ */
+char *fmt_hex8(char *out, uint8_t v)
+{
+    out[0] = kHex[v >> 4];
+    out[1] = kHex[v & 0x0F];
+    return out + 2;
+}
+
+/**
+ * @brief Escreve @p len bytes no formato "XX " (equivalente a @c "%02X " por byte).
+ * @param out Buffer de saída (3 * @p len caracteres).
+ */
+char *fmt_hex_bytes(char *out, const uint8_t *buf, size_t len)
+{
+    for (size_t i = 0; i < len; ++i)
+    {
+        out[0] = kHex[buf[i] >> 4];
+        out[1] = kHex[buf[i] & 0x0F];
+        out[2] = ' ';
+        out += 3;
+    }
+
+    return out;
+}
+
+/**
+ * @brief Escreve data/hora no formato "YYYY/MM/DD HH:MM:SS.mmm".
+ * @param out Buffer de saída (@c FMT_DATETIME_LEN caracteres).
+ * @param tm Data/hora local.
+ * @param ms Milissegundos (0..999).
+ */
+char *fmt_datetime(char *out, const struct tm *tm, uint32_t ms)
+{
+    out = put_u64(out, (uint64_t)(tm->tm_year + 1900), 4);
+    *out++ = '/';
+    out = put2(out, (uint32_t)(tm->tm_mon + 1));
+    *out++ = '/';
+    out = put2(out, (uint32_t)tm->tm_mday);
+    *out++ = ' ';
+    out = put2(out, (uint32_t)tm->tm_hour);
+    *out++ = ':';
+    out = put2(out, (uint32_t)tm->tm_min);
+    *out++ = ':';
+    out = put2(out, (uint32_t)tm->tm_sec);
+    *out++ = '.';
+    out[0] = (char)('0' + ms / 100u);
+    return put2(out + 1, ms % 100u);
+}
@@ -0,0 +1,31 @@
+/**
+ * @file fmt.h
+ * @brief Cabeçalho para formatação de texto sem printf (inteiros, ponto fixo, hex e data/hora).
+ *
+ * As funções escrevem a partir de @p out, não adicionam terminador e retornam o ponteiro
+ * para o primeiro caractere após o texto escrito. O chamador garante a capacidade do
+ * buffer usando os tamanhos máximos abaixo.
+ */
+
+#ifndef FMT_H
+#define FMT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+#define FMT_U32_MAX       10  /* "4294967295"                     */
+#define FMT_I32_MAX       11  /* "-2147483648"                    */
+#define FMT_FIXED_MAX     22  /* sinal + 10 dígitos + '.' + 9 casas */
+#define FMT_DATETIME_LEN  23  /* "YYYY/MM/DD HH:MM:SS.mmm"        */
+
+char *fmt_str(char *out, const char *s);
+char *fmt_u32(char *out, uint32_t v);
+char *fmt_i32(char *out, int32_t v);
+char *fmt_u32_pad(char *out, uint32_t v, uint8_t width);
+char *fmt_fixed(char *out, int32_t raw, uint8_t scale_exp, uint8_t decimals);
+char *fmt_hex8(char *out, uint8_t v);
+char *fmt_hex_bytes(char *out, const uint8_t *buf, size_t len);
+char *fmt_datetime(char *out, const struct tm *tm, uint32_t ms);
+
+#endif /* FMT_H */
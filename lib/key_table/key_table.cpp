@@ -0,0 +1,526 @@
+/**
+ * @file key_table.cpp
+ * @brief Implementação da tabela de chaves AES por nó.
+ *
+ * - Busca O(1): índice de endereçamento aberto (sondagem linear, ocupação <= 1/2)
+ *   apontando para as entradas; memória fixa em @c KEYTAB_MAX_NODES entradas.
+ * - Cada entrada guarda dois pares de key schedules (atual e anterior), de modo
+ *   que uma troca de chave nunca expande nada no caminho do pacote.
+ * - A tarefa de leitura só faz parse do arquivo; a tabela é alterada apenas em
+ *   @c keytab_tick(), no mesmo laço que decifra, sem trava no caminho quente.
+ */
+
+#include "key_table.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <string.h>
+#include "logger.h"
+#include "sd_card.h"
+
+static const char *TAG = "KEYTAB";
+
+#define KEYTAB_RETRY_MS  2000   /* releitura enquanto nenhum arquivo foi aplicado */
+#define KEYTAB_TASK_PRIO 1
+
+/**
+ * @brief Linha do arquivo já validada.
+ */
+typedef struct
+{
+    uint16_t node;
+    uint8_t key[CRYPTO_KEY_SIZE];
+} KeyLine;
+
+/**
+ * @brief Entrada da tabela; @c keys[cur] é a chave atual.
+ */
+typedef struct
+{
+    uint16_t node;                  /* 0 = livre                        */
+    uint8_t cur;
+    bool has_prev;                  /* keys[cur ^ 1] ainda aceita       */
+    uint8_t key[CRYPTO_KEY_SIZE];   /* para detectar troca na releitura */
+    CryptoKey keys[2];
+} KeyEntry;
+
+static constexpr uint32_t pow2_at_least(uint32_t n, uint32_t p = 1)
+{
+    return (p >= n) ? p : pow2_at_least(n, p * 2u);
+}
+
+static const uint32_t kBuckets = pow2_at_least(2u * KEYTAB_MAX_NODES);
+
+static KeyEntry g_entries[KEYTAB_MAX_NODES];
+static uint16_t g_index[kBuckets];          /* entrada + 1; 0 = balde vazio */
+static KeyTabStats g_stats;
+
+/* Arquivo lido pela tarefa, aguardando o laço aplicar. */
+static KeyLine g_pending[KEYTAB_MAX_NODES];
+static uint16_t g_pending_n = 0;
+static bool g_pending_ready = false;
+static portMUX_TYPE g_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/****************************** Funções privadas ******************************/
+
+static inline uint32_t bucket_of(uint16_t node)
+{
+    return ((uint32_t)node * 40503u) & (kBuckets - 1u);
+}
+
+/**
+ * @brief Procura a entrada de um nó.
+ * @return Entrada ou @c nullptr.
+ */
+static KeyEntry *find(uint16_t node)
+{
+    for (uint32_t b = bucket_of(node); g_index[b] != 0; b = (b + 1u) & (kBuckets - 1u))
+    {
+        KeyEntry *e = &g_entries[g_index[b] - 1u];
+
+        if (e->node == node)
+        {
+            return e;
+        }
+    }
+
+    return nullptr;
+}
+
+static void rebuild_index(void)
+{
+    memset(g_index, 0, sizeof(g_index));
+
+    for (uint32_t i = 0; i < KEYTAB_MAX_NODES; ++i)
+    {
+        if (g_entries[i].node == 0)
+        {
+            continue;
+        }
+
+        uint32_t b = bucket_of(g_entries[i].node);
+
+        while (g_index[b] != 0)
+        {
+            b = (b + 1u) & (kBuckets - 1u);
+        }
+
+        g_index[b] = (uint16_t)(i + 1u);
+    }
+}
+
+static void entry_free(KeyEntry *e)
+{
+    crypto_key_free(&e->keys[e->cur]);
+
+    if (e->has_prev)
+    {
+        crypto_key_free(&e->keys[e->cur ^ 1u]);
+    }
+
+    memset(e->key, 0, sizeof(e->key));
+    e->node = 0;
+    e->has_prev = false;
+}
+
+static int8_t hex_nibble(char c)
+{
+    if (c >= '0' && c <= '9') return (int8_t)(c - '0');
+    if (c >= 'a' && c <= 'f') return (int8_t)(c - 'a' + 10);
+    if (c >= 'A' && c <= 'F') return (int8_t)(c - 'A' + 10);
+    return -1;
+}
+
+/**
+ * @brief Faz o parse de uma linha "<id> <32 hex>".
+ * @return 1 se a linha tem chave, 0 se é vazia/comentário, -1 se inválida.
+ */
+static int parse_line(const char *p, const char *end, KeyLine *out)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+    {
+        ++p;
+    }
+
+    if (p == end || *p == '#')
+    {
+        return 0;
+    }
+
+    uint32_t id = 0;
+    const char *digits = p;
+
+    while (p < end && *p >= '0' && *p <= '9' && id <= 0xFFFFu)
+    {
+        id = id * 10u + (uint32_t)(*p++ - '0');
+    }
+
+    if (p == digits || id == 0 || id > 0xFFFFu || p == end || (*p != ' ' && *p != '\t'))
+    {
+        return -1;
+    }
+
+    while (p < end && (*p == ' ' || *p == '\t'))
+    {
+        ++p;
+    }
+
+    for (uint8_t i = 0; i < CRYPTO_KEY_SIZE; ++i)
+    {
+        const int8_t hi = (p + 1 < end) ? hex_nibble(p[0]) : -1;
+        const int8_t lo = (p + 1 < end) ? hex_nibble(p[1]) : -1;
+
+        if (hi < 0 || lo < 0)
+        {
+            return -1;
+        }
+
+        out->key[i] = (uint8_t)((hi << 4) | lo);
+        p += 2;
+    }
+
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+    {
+        ++p;
+    }
+
+    if (p != end && *p != '#')
+    {
+        return -1;
+    }
+
+    out->node = (uint16_t)id;
+    return 1;
+}
+
+/**
+ * @brief Aplica um arquivo à tabela: troca chaves alteradas (mantendo a anterior),
+ *        remove nós ausentes e acrescenta os novos.
+ */
+static void apply(const KeyLine *lines, uint16_t n)
+{
+    uint16_t rotated = 0;
+    uint16_t removed = 0;
+    uint16_t added = 0;
+    bool seen[KEYTAB_MAX_NODES] = {};
+    bool is_new[KEYTAB_MAX_NODES] = {};
+
+    for (uint16_t i = 0; i < n; ++i)
+    {
+        KeyEntry *e = find(lines[i].node);
+
+        if (!e)
+        {
+            is_new[i] = true;
+            continue;
+        }
+
+        seen[e - g_entries] = true;
+
+        if (memcmp(e->key, lines[i].key, CRYPTO_KEY_SIZE) == 0)
+        {
+            continue;
+        }
+
+        /* A chave vigente passa a anterior; a anterior mais antiga é descartada. */
+        const uint8_t next = e->cur ^ 1u;
+
+        if (e->has_prev)
+        {
+            crypto_key_free(&e->keys[next]);
+        }
+
+        if (!crypto_key_init(&e->keys[next], lines[i].key))
+        {
+            e->has_prev = false;
+            continue;
+        }
+
+        e->cur = next;
+        e->has_prev = true;
+        memcpy(e->key, lines[i].key, CRYPTO_KEY_SIZE);
+        ++rotated;
+    }
+
+    for (uint32_t i = 0; i < KEYTAB_MAX_NODES; ++i)
+    {
+        if (g_entries[i].node != 0 && !seen[i])
+        {
+            entry_free(&g_entries[i]);
+            ++removed;
+        }
+    }
+
+    uint32_t free_slot = 0;
+
+    for (uint16_t i = 0; i < n; ++i)
+    {
+        if (!is_new[i])
+        {
+            continue;
+        }
+
+        while (g_entries[free_slot].node != 0)
+        {
+            ++free_slot;
+        }
+
+        KeyEntry *e = &g_entries[free_slot];
+
+        if (crypto_key_init(&e->keys[0], lines[i].key))
+        {
+            e->node = lines[i].node;
+            e->cur = 0;
+            e->has_prev = false;
+            memcpy(e->key, lines[i].key, CRYPTO_KEY_SIZE);
+            ++added;
+        }
+    }
+
+    rebuild_index();
+
+    uint16_t nodes = 0;
+    uint16_t rotating = 0;
+
+    for (uint32_t i = 0; i < KEYTAB_MAX_NODES; ++i)
+    {
+        nodes += (g_entries[i].node != 0) ? 1u : 0u;
+        rotating += g_entries[i].has_prev ? 1u : 0u;
+    }
+
+    portENTER_CRITICAL(&g_mux);
+    g_stats.nodes = nodes;
+    g_stats.rotating = rotating;
+    g_stats.reloads++;
+    g_stats.rotations += rotated;
+    portEXIT_CRITICAL(&g_mux);
+
+    LOG(TAG, "tabela aplicada: %u no(s), %u novo(s), %u trocado(s), %u removido(s)",
+        (unsigned)nodes, (unsigned)added, (unsigned)rotated, (unsigned)removed);
+}
+
+/**
+ * @brief Tarefa que relê @c KEYTAB_PATH e entrega ao laço os arquivos alterados.
+ */
+static void poll_task(void *arg)
+{
+    (void)arg;
+    static char buf[KEYTAB_FILE_MAX];
+    uint32_t last_hash = 0;
+    bool loaded = false;
+
+    for (;;)
+    {
+        size_t len = 0;
+
+        if (sdcard_read(KEYTAB_PATH, buf, sizeof(buf), &len))
+        {
+            /* FNV-1a: só arquivos diferentes do último lido são processados. */
+            uint32_t h = 2166136261u;
+
+            for (size_t i = 0; i < len; ++i)
+            {
+                h = (h ^ (uint8_t)buf[i]) * 16777619u;
+            }
+
+            if (!loaded || h != last_hash)
+            {
+                (void)keytab_load(buf, len);
+                last_hash = h;
+                loaded = true;
+            }
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(loaded ? KEYTAB_POLL_MS : KEYTAB_RETRY_MS));
+    }
+}
+
+/****************************** Funções públicas ******************************/
+
+/**
+ * @brief Cria a tarefa que carrega e relê a tabela do SD.
+ *
+ * @note Até o primeiro arquivo ser aplicado, quadros com id de nó são descartados;
+ *       os quadros sem id seguem decifrados com a chave da frota.
+ */
+void keytab_begin(void)
+{
+    xTaskCreate(poll_task, "keytab", 3072, nullptr, KEYTAB_TASK_PRIO, nullptr);
+}
+
+/**
+ * @brief Valida o conteúdo de um arquivo de chaves e o deixa pendente para o
+ *        próximo @c keytab_tick().
+ * @param text Conteúdo do arquivo.
+ * @param len Tamanho de @p text.
+ * @return true se o arquivo inteiro for válido; caso contrário nada muda.
+ */
+bool keytab_load(const char *text, size_t len)
+{
+    static KeyLine lines[KEYTAB_MAX_NODES];
+    uint16_t n = 0;
+    uint32_t line_no = 0;
+    const char *p = text;
+    const char *end = text + len;
+
+    while (p < end)
+    {
+        const char *eol = (const char *)memchr(p, '\n', (size_t)(end - p));
+        const char *line_end = eol ? eol : end;
+        KeyLine kl;
+        ++line_no;
+        const int r = parse_line(p, line_end, &kl);
+        p = eol ? eol + 1 : end;
+
+        if (r == 0)
+        {
+            continue;
+        }
+
+        bool dup = false;
+
+        for (uint16_t i = 0; i < n && r > 0; ++i)
+        {
+            dup = dup || lines[i].node == kl.node;
+        }
+
+        if (r < 0 || dup || n == KEYTAB_MAX_NODES)
+        {
+            LOG(TAG, "%s recusado na linha %lu (%s)", KEYTAB_PATH, (unsigned long)line_no,
+                r < 0 ? "formato" : dup ? "id repetido" : "nos demais");
+            portENTER_CRITICAL(&g_mux);
+            g_stats.rejected++;
+            portEXIT_CRITICAL(&g_mux);
+            return false;
+        }
+
+        lines[n++] = kl;
+    }
+
+    portENTER_CRITICAL(&g_mux);
+    memcpy(g_pending, lines, n * sizeof(KeyLine));
+    g_pending_n = n;
+    g_pending_ready = true;
+    portEXIT_CRITICAL(&g_mux);
+
+    memset(lines, 0, sizeof(lines));
+    return true;
+}
+
+/**
+ * @brief Aplica o arquivo pendente, se houver; chamada pelo laço que decifra.
+ */
+void keytab_tick(void)
+{
+    static KeyLine lines[KEYTAB_MAX_NODES];
+    uint16_t n = 0;
+    bool ready;
+
+    portENTER_CRITICAL(&g_mux);
+    ready = g_pending_ready;
+
+    if (ready)
+    {
+        n = g_pending_n;
+        memcpy(lines, g_pending, n * sizeof(KeyLine));
+        memset(g_pending, 0, sizeof(g_pending));
+        g_pending_ready = false;
+    }
+
+    portEXIT_CRITICAL(&g_mux);
+
+    if (ready)
+    {
+        apply(lines, n);
+        memset(lines, 0, sizeof(lines));
+    }
+}
+
+/**
+ * @brief Informa se há chave para o nó.
+ */
+bool keytab_known(uint16_t node)
+{
+    return find(node) != nullptr;
+}
+
+/**
+ * @brief Decifra um quadro com a chave do nó (ou com a anterior, durante a troca).
+ * @param node Id do nó, lido do cabeçalho em claro.
+ * @param used Chave que decifrou o quadro, para a etiqueta de ACK e para
+ *             @c keytab_confirm().
+ * @return true se alguma das chaves do nó decifrou o quadro.
+ *
+ * @note Decifrar só prova que o padding é válido (1 em 256 quadros quaisquer passa);
+ *       a troca de chave não é concluída aqui, e sim em @c keytab_confirm().
+ */
+bool keytab_decrypt(uint16_t node, const uint8_t *in, size_t in_len,
+                    const uint8_t iv[CRYPTO_BLOCK_SIZE], uint8_t *out, size_t *out_len,
+                    CryptoKey **used)
+{
+    KeyEntry *e = find(node);
+
+    if (!e)
+    {
+        return false;
+    }
+
+    if (crypto_decrypt(&e->keys[e->cur], in, in_len, iv, out, out_len))
+    {
+        *used = &e->keys[e->cur];
+        return true;
+    }
+
+    if (e->has_prev && crypto_decrypt(&e->keys[e->cur ^ 1u], in, in_len, iv, out, out_len))
+    {
+        *used = &e->keys[e->cur ^ 1u];
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Registra que um quadro do nó passou pela validação do payload (checksum
+ *        ou lote) depois de decifrado com @p key.
+ * @param node Id do nó.
+ * @param key Chave devolvida por @c keytab_decrypt() para esse quadro.
+ *
+ * @note Um quadro válido com a chave atual encerra a troca e libera a anterior.
+ */
+void keytab_confirm(uint16_t node, const CryptoKey *key)
+{
+    KeyEntry *e = find(node);
+
+    if (!e || !e->has_prev)
+    {
+        return;
+    }
+
+    if (key == &e->keys[e->cur ^ 1u])
+    {
+        portENTER_CRITICAL(&g_mux);
+        g_stats.prev_hits++;
+        portEXIT_CRITICAL(&g_mux);
+        return;
+    }
+
+    if (key == &e->keys[e->cur])
+    {
+        crypto_key_free(&e->keys[e->cur ^ 1u]);
+        e->has_prev = false;
+        portENTER_CRITICAL(&g_mux);
+        g_stats.rotating--;
+        portEXIT_CRITICAL(&g_mux);
+        LOG(TAG, "no %u ja usa a chave nova", (unsigned)node);
+    }
+}
+
+/**
+ * @brief Copia os contadores da tabela.
+ */
+void keytab_get_stats(KeyTabStats *out)
+{
+    portENTER_CRITICAL(&g_mux);
+    *out = g_stats;
+    portEXIT_CRITICAL(&g_mux);
+}
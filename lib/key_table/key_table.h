@@ -0,0 +1,65 @@
+/**
+ * @file key_table.h
+ * @brief Cabeçalho para a tabela de chaves AES por nó, com key schedules já
+ *        expandidos, carregada de um arquivo no SD e trocada sem reboot.
+ *
+ * Quadros com id de nó levam 2 bytes em claro antes do IV:
+ *
+ *   [0..1]   id do nó (u16, little-endian, 1..65535)
+ *   [2..17]  IV
+ *   [18..]   ciphertext (múltiplo de 16)
+ *
+ * e são decifrados com a chave do nó (com 4 B, o id é seguido da sequência do
+ * quadro, ver @c link_quality.h); os demais (IV16 + CT) seguem usando a chave
+ * da frota de @c credentials.h.
+ *
+ * Arquivo @c KEYTAB_PATH, uma chave por linha ('#' inicia comentário):
+ *
+ *   <id decimal> <32 dígitos hex>
+ *
+ * O arquivo é relido a cada @c KEYTAB_POLL_MS por uma tarefa própria. Um nó cuja
+ * chave mudou continua aceito com a chave anterior até o primeiro quadro válido
+ * (payload conferido, ver @c keytab_confirm()) com a nova; nós ausentes do arquivo
+ * novo são removidos.
+ */
+
+#ifndef KEY_TABLE_H
+#define KEY_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "crypto.h"
+
+#ifndef KEYTAB_MAX_NODES
+#define KEYTAB_MAX_NODES  32             /* nós com chave própria              */
+#endif
+#define KEYTAB_PATH       "/chaves.txt"
+#define KEYTAB_POLL_MS    30000
+#define KEYTAB_FILE_MAX   (KEYTAB_MAX_NODES * 48)
+#define KEYTAB_HDR_LEN    2              /* id do nó em claro antes do IV      */
+
+/**
+ * @brief Contadores da tabela.
+ */
+typedef struct
+{
+    uint16_t nodes;        /* nós com chave                              */
+    uint16_t rotating;     /* nós ainda aceitos com a chave anterior     */
+    uint32_t reloads;      /* arquivos aplicados                         */
+    uint32_t rejected;     /* arquivos recusados (linha inválida/cheio)  */
+    uint32_t rotations;    /* chaves trocadas                            */
+    uint32_t prev_hits;    /* quadros válidos com a chave anterior       */
+} KeyTabStats;
+
+void keytab_begin(void);
+bool keytab_load(const char *text, size_t len);
+void keytab_tick(void);
+bool keytab_known(uint16_t node);
+bool keytab_decrypt(uint16_t node, const uint8_t *in, size_t in_len,
+                    const uint8_t iv[CRYPTO_BLOCK_SIZE], uint8_t *out, size_t *out_len,
+                    CryptoKey **used);
+void keytab_confirm(uint16_t node, const CryptoKey *key);
+void keytab_get_stats(KeyTabStats *out);
+
+#endif /* KEY_TABLE_H */
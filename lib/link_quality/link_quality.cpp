@@ -0,0 +1,290 @@
+/**
+ * @file link_quality.cpp
+ * @brief Registro de qualidade de enlace por nó: histogramas de RSSI/SNR de baldes
+ *        fixos, perdas estimadas pelas lacunas de sequência e últimas N amostras.
+ *
+ * - O balde é calculado a partir do valor (largura fixa), sem busca; a origem é
+ *   procurada entre no máximo @c LINKQ_MAX_SOURCES slots, como em @c analytics.
+ * - Sequência u16 com wrap: avanço de d > 1 conta d - 1 perdidos; repetição conta
+ *   duplicado; recuo curto é quadro atrasado (desconta uma perda); recuo longo ou
+ *   salto maior que @c LINKQ_GAP_MAX é tratado como reinício do nó.
+ * - Só a tarefa do loop escreve; leituras de outras tarefas copiam o slot sob a
+ *   seção crítica. A gravação na NVS também roda no loop, sem cópia.
+ */
+
+#include "link_quality.h"
+#include <Preferences.h>
+#include <freertos/FreeRTOS.h>
+#include <string.h>
+#include <time.h>
+#include "logger.h"
+
+static const char *TAG = "LINKQ";
+
+#define LINKQ_STORE_VERSION 1
+
+/**
+ * @brief Blob gravado na NVS.
+ */
+typedef struct
+{
+    uint8_t version;
+    uint8_t n_sources;
+    uint16_t source_size;
+    LinkSource src[LINKQ_MAX_SOURCES];
+} LinkStore;
+
+static LinkStore g_store;
+static LinkSource *const g_src = g_store.src;
+static uint32_t g_dirty;              /* quadros desde a última gravação */
+static uint32_t g_last_persist_ms;
+static portMUX_TYPE g_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/****************************** Funções privadas ******************************/
+
+static inline uint8_t bucket(int32_t v, int32_t le0, int32_t step, uint8_t n)
+{
+    if (v <= le0)
+    {
+        return 0;
+    }
+
+    const int32_t i = (v - le0 + step - 1) / step;
+    return (uint8_t)((i < n - 1) ? i : n - 1);
+}
+
+/**
+ * @brief Procura a origem; se ausente, ocupa um slot livre ou o visto há mais tempo.
+ */
+static LinkSource *source_slot(uint16_t node)
+{
+    LinkSource *victim = nullptr;
+
+    for (uint8_t i = 0; i < LINKQ_MAX_SOURCES; ++i)
+    {
+        LinkSource *s = &g_src[i];
+
+        if (s->used && s->node == node)
+        {
+            return s;
+        }
+
+        if (!victim || (victim->used && (!s->used || s->last_seen < victim->last_seen)))
+        {
+            victim = s;
+        }
+    }
+
+    memset(victim, 0, sizeof(*victim));
+    victim->used = 1;
+    victim->node = node;
+    victim->rssi_min = INT16_MAX;
+    victim->rssi_max = INT16_MIN;
+    return victim;
+}
+
+/**
+ * @brief Contabiliza a sequência @p seq do nó; retorna false para duplicado.
+ */
+static bool track_seq(LinkSource *s, uint16_t seq)
+{
+    if (!s->has_seq)
+    {
+        s->has_seq = 1;
+        s->last_seq = seq;
+        return true;
+    }
+
+    const uint16_t ahead = (uint16_t)(seq - s->last_seq);
+    const uint16_t behind = (uint16_t)(s->last_seq - seq);
+
+    if (ahead == 0)
+    {
+        s->duplicates++;
+        return false;
+    }
+
+    if (behind <= LINKQ_REORDER_MAX)
+    {
+        /* Atrasado: já foi contado como perdido quando a sequência saltou. */
+        if (s->lost)
+        {
+            s->lost--;
+        }
+
+        return true;
+    }
+
+    if (ahead <= LINKQ_GAP_MAX)
+    {
+        s->lost += ahead - 1u;
+    }
+    else
+    {
+        s->resyncs++;
+    }
+
+    s->last_seq = seq;
+    return true;
+}
+
+static void log_source(const LinkSource *s)
+{
+    const uint32_t total = s->frames + s->lost;
+    const uint32_t per_pm = total ? (uint32_t)((uint64_t)s->lost * 1000u / total) : 0;
+    const int32_t rssi_avg = s->frames ? (int32_t)(s->rssi_sum / (int64_t)s->frames) : 0;
+    const int32_t snr_avg = s->frames ? (int32_t)(s->snr_sum / (int64_t)s->frames) : 0;
+
+    LOG(TAG, "no %u: quadros=%lu perdidos=%lu (%lu.%lu%%) dup=%lu ressinc=%lu "
+             "rssi med/min/max=%ld/%d/%d dBm snr med=%ld.%02lu dB",
+        (unsigned)s->node, (unsigned long)s->frames, (unsigned long)s->lost,
+        (unsigned long)(per_pm / 10u), (unsigned long)(per_pm % 10u),
+        (unsigned long)s->duplicates, (unsigned long)s->resyncs, (long)rssi_avg,
+        (int)s->rssi_min, (int)s->rssi_max, (long)(snr_avg / 100),
+        (unsigned long)((snr_avg < 0 ? -snr_avg : snr_avg) % 100));
+}
+
+static void persist(void)
+{
+    Preferences prefs;
+
+    if (!prefs.begin("linkq", false))
+    {
+        LOG(TAG, "Falha ao abrir a NVS");
+        return;
+    }
+
+    /* Só o loop escreve em g_store, e esta função roda nele: não precisa de cópia. */
+    const size_t n = prefs.putBytes("fontes", &g_store, sizeof(g_store));
+    prefs.end();
+
+    if (n != sizeof(g_store))
+    {
+        LOG(TAG, "Falha ao gravar %u B na NVS", (unsigned)sizeof(g_store));
+    }
+}
+
+/****************************** Funções públicas ******************************/
+
+/**
+ * @brief Restaura o registro salvo na NVS (descarta se o layout mudou).
+ */
+void linkq_begin(void)
+{
+    Preferences prefs;
+    size_t n = 0;
+
+    if (prefs.begin("linkq", true))
+    {
+        n = prefs.getBytes("fontes", &g_store, sizeof(g_store));
+        prefs.end();
+    }
+
+    if (n != sizeof(g_store) || g_store.version != LINKQ_STORE_VERSION ||
+        g_store.n_sources != LINKQ_MAX_SOURCES || g_store.source_size != sizeof(LinkSource))
+    {
+        memset(&g_store, 0, sizeof(g_store));
+        g_store.version = LINKQ_STORE_VERSION;
+        g_store.n_sources = LINKQ_MAX_SOURCES;
+        g_store.source_size = sizeof(LinkSource);
+        return;
+    }
+
+    uint8_t used = 0;
+
+    for (uint8_t i = 0; i < LINKQ_MAX_SOURCES; ++i)
+    {
+        used += g_src[i].used ? 1u : 0u;
+    }
+
+    LOG(TAG, "%u no(s) restaurado(s) da NVS", (unsigned)used);
+}
+
+/**
+ * @brief Registra um quadro validado (payload conferido) do nó @p node (0 = sem id).
+ * @param has_seq true se o quadro trouxe sequência no cabeçalho.
+ * @param snr_centi SNR em centésimos de dB.
+ * @return false se a sequência repete a última recebida (o nó reenviou um quadro
+ *         cujo ACK perdeu); o quadro só conta como duplicado.
+ */
+bool linkq_update(uint16_t node, bool has_seq, uint16_t seq, int16_t rssi, int32_t snr_centi)
+{
+    const uint32_t now = (uint32_t)time(nullptr);
+
+    portENTER_CRITICAL(&g_mux);
+    LinkSource *s = source_slot(node);
+
+    if (has_seq && !track_seq(s, seq))
+    {
+        s->last_seen = now;
+        portEXIT_CRITICAL(&g_mux);
+        return false;
+    }
+
+    s->frames++;
+    s->last_seen = now;
+    s->rssi_sum += rssi;
+    s->snr_sum += snr_centi;
+    s->rssi_min = (rssi < s->rssi_min) ? rssi : s->rssi_min;
+    s->rssi_max = (rssi > s->rssi_max) ? rssi : s->rssi_max;
+    s->rssi_hist[bucket(rssi, LINKQ_RSSI_LE0, LINKQ_RSSI_STEP, LINKQ_RSSI_BUCKETS)]++;
+    s->snr_hist[bucket(snr_centi, LINKQ_SNR_LE0, LINKQ_SNR_STEP, LINKQ_SNR_BUCKETS)]++;
+
+    LinkSample *a = &s->last[s->next_sample];
+    a->time = now;
+    a->rssi = rssi;
+    a->snr_centi = (int16_t)snr_centi;
+    a->seq = has_seq ? seq : 0;
+    s->next_sample = (uint8_t)((s->next_sample + 1u) % LINKQ_LAST_N);
+    s->n_samples = (s->n_samples < LINKQ_LAST_N) ? (uint8_t)(s->n_samples + 1u) : s->n_samples;
+    g_dirty++;
+    portEXIT_CRITICAL(&g_mux);
+    return true;
+}
+
+/**
+ * @brief Copia o slot @p slot (0..LINKQ_MAX_SOURCES-1); false se vazio.
+ */
+bool linkq_get(uint8_t slot, LinkSource *out)
+{
+    if (slot >= LINKQ_MAX_SOURCES)
+    {
+        return false;
+    }
+
+    portENTER_CRITICAL(&g_mux);
+    *out = g_src[slot];
+    portEXIT_CRITICAL(&g_mux);
+    return out->used != 0;
+}
+
+/**
+ * @brief Chamada pelo loop: a cada @c LINKQ_PERSIST_MS, loga o resumo por nó e grava
+ *        na NVS se houve quadros novos (desgaste de flash).
+ */
+void linkq_tick(uint32_t now_ms)
+{
+    if ((uint32_t)(now_ms - g_last_persist_ms) < LINKQ_PERSIST_MS)
+    {
+        return;
+    }
+
+    g_last_persist_ms = now_ms;
+
+    if (!g_dirty)
+    {
+        return;
+    }
+
+    g_dirty = 0;
+
+    for (uint8_t i = 0; i < LINKQ_MAX_SOURCES; ++i)
+    {
+        if (g_src[i].used)
+        {
+            log_source(&g_src[i]);
+        }
+    }
+
+    persist();
+}
@@ -0,0 +1,79 @@
+/**
+ * @file link_quality.h
+ * @brief Cabeçalho para o registro de qualidade de enlace por nó de origem:
+ *        histogramas de RSSI/SNR, perdas estimadas pela sequência e últimas amostras.
+ *
+ * Atualizado em O(1) a cada quadro validado (baldes calculados, não procurados),
+ * salvo na NVS a cada @c LINKQ_PERSIST_MS e exposto em @c GET /enlace, para que a
+ * escolha de SF e a posição das antenas sigam dados de campo.
+ *
+ * A sequência vem do cabeçalho em claro com id e sequência do nó (comprimento
+ * % 16 == 4, ver @c rx_pipeline); quadros sem ela contam apenas RSSI/SNR.
+ */
+
+#ifndef LINK_QUALITY_H
+#define LINK_QUALITY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define LINKQ_MAX_SOURCES   16     /* nós acompanhados; o visto há mais tempo é substituído */
+#define LINKQ_LAST_N        8      /* últimas amostras guardadas por nó               */
+#define LINKQ_PERSIST_MS    600000 /* gravação na NVS (só se houve quadros)           */
+#define LINKQ_SEQ_LEN       2      /* sequência (u16 LE) após o id do nó              */
+#define LINKQ_REORDER_MAX   32     /* recuo maior que isso na sequência = nó reiniciou */
+#define LINKQ_GAP_MAX       1024   /* salto maior que isso também ressincroniza       */
+
+/* Baldes de RSSI: limite superior -135 dBm, -130, ..., -50 e +Inf. */
+#define LINKQ_RSSI_LE0      (-135)
+#define LINKQ_RSSI_STEP     5
+#define LINKQ_RSSI_BUCKETS  19
+
+/* Baldes de SNR (centésimos de dB): -20,00, -17,50, ..., +10,00 e +Inf. */
+#define LINKQ_SNR_LE0       (-2000)
+#define LINKQ_SNR_STEP      250
+#define LINKQ_SNR_BUCKETS   14
+
+/**
+ * @brief Amostra individual de um quadro.
+ */
+typedef struct
+{
+    uint32_t time;        /* time() da recepção (s)          */
+    int16_t rssi;         /* dBm                             */
+    int16_t snr_centi;    /* centésimos de dB                */
+    uint16_t seq;         /* sequência (0 se o quadro não tem) */
+    uint16_t reserved;
+} LinkSample;
+
+/**
+ * @brief Estado de um nó de origem (layout gravado na NVS).
+ */
+typedef struct
+{
+    uint16_t node;                         /* 0 = quadros sem id               */
+    uint8_t used;
+    uint8_t has_seq;
+    uint16_t last_seq;
+    uint8_t next_sample;                   /* próxima posição em @c last       */
+    uint8_t n_samples;
+    uint32_t frames;                       /* quadros validados                */
+    uint32_t lost;                         /* lacunas na sequência             */
+    uint32_t duplicates;
+    uint32_t resyncs;                      /* reinícios/saltos de sequência    */
+    uint32_t last_seen;                    /* time() do último quadro          */
+    int16_t rssi_min;
+    int16_t rssi_max;
+    int64_t rssi_sum;
+    int64_t snr_sum;                       /* centésimos de dB                 */
+    uint32_t rssi_hist[LINKQ_RSSI_BUCKETS];
+    uint32_t snr_hist[LINKQ_SNR_BUCKETS];
+    LinkSample last[LINKQ_LAST_N];
+} LinkSource;
+
+void linkq_begin(void);
+bool linkq_update(uint16_t node, bool has_seq, uint16_t seq, int16_t rssi, int32_t snr_centi);
+bool linkq_get(uint8_t slot, LinkSource *out);
+void linkq_tick(uint32_t now_ms);
+
+#endif /* LINK_QUALITY_H */
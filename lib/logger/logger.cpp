@@ -5,27 +5,57 @@
 
 #include "logger.h"
 #include <Arduino.h>
+#include "fmt.h"
+#include "rtc_stage.h"
 #include "sd_card.h"
+#include "time_service.h"
+
+/* Maior rótulo copiado para o prefixo da linha. */
+#define LOG_TAG_MAX 16
+/* Prefixo "YYYY/MM/DD HH:MM:SS.mmm [TAG] ". */
+#define LOG_PREFIX_MAX (FMT_DATETIME_LEN + LOG_TAG_MAX + 4)
 
 static bool g_log_ready = false;
-static char s_line[256];
+static char s_line[LOG_PREFIX_MAX + 256 + 1];
 
 /****************************** Funções privadas ******************************/
 
 /**
- * @brief Formata o timestamp atual em horário local com milissegundos.
- * @param out Buffer de saída para a string de timestamp.
- * @param outlen Tamanho do buffer @p out, em bytes.
+ * @brief Escreve o prefixo "timestamp [TAG] " de uma linha de log.
+ * @param out Buffer de saída (@c LOG_PREFIX_MAX caracteres).
+ * @param tag Rótulo (truncado em @c LOG_TAG_MAX caracteres).
+ * @return Ponteiro após o último caractere escrito.
  */
-static void format_timestamp(char *out, size_t outlen)
+static char *format_prefix(char *out, const char *tag)
 {
-    time_t now = time(nullptr);
-    struct tm tm_local;
-    localtime_r(&now, &tm_local);
-    uint32_t ms = (uint32_t)(millis() % 1000U);
-    snprintf(out, outlen, "%04d/%02d/%02d %02d:%02d:%02d.%03u",
-             tm_local.tm_year + 1900, tm_local.tm_mon + 1, tm_local.tm_mday,
-             tm_local.tm_hour, tm_local.tm_min, tm_local.tm_sec, ms);
+    out = timesvc_format_now(out);
+    *out++ = ' ';
+    *out++ = '[';
+
+    for (uint32_t i = 0; i < LOG_TAG_MAX && tag[i]; ++i)
+    {
+        *out++ = tag[i];
+    }
+
+    *out++ = ']';
+    *out++ = ' ';
+    return out;
+}
+
+/**
+ * @brief Emite uma linha completa (terminada em '\n') na Serial e no SD.
+ * @param line Linha formatada.
+ * @param len Tamanho, incluindo o '\n' final.
+ * @return true se o SD aceitou a linha (false: descartada com o anel cheio).
+ */
+static bool emit_line(const char *line, size_t len)
+{
+    if (Serial)
+    {
+        Serial.write((const uint8_t *)line, len);
+    }
+
+    return sdcard_write(line, len);
 }
 
 /****************************** Funções públicas ******************************/
@@ -43,28 +73,51 @@ void logger_init_epoch0()
 
 /**
  * @brief Inicializa o logger, garantindo a Serial e registrando mensagem "pronto".
+ *
+ * @note Não aguarda a Serial: a UART fica pronta logo após @c begin() e o boot
+ *       não deve atrasar o rádio esperando um terminal.
  */
 void logger_begin()
 {
     if (!Serial)
     {
         Serial.begin(115200);
-        uint32_t t0 = millis();
-        while (!Serial && (millis() - t0) < 800)
-        {
-        }
     }
 
     g_log_ready = true;
-    char ts[40];
-    format_timestamp(ts, sizeof(ts));
+    sdcard_lock();
+    char *p = fmt_str(format_prefix(s_line, "LOGGER"), "pronto\n");
+    (void)emit_line(s_line, (size_t)(p - s_line));
+    sdcard_unlock();
+}
 
-    if (Serial)
+/**
+ * @brief Formata e emite uma linha de log (chamada com @c sdcard_lock()).
+ * @param accepted Se não nulo, recebe se o SD aceitou a linha.
+ * @return Tamanho da linha em @c s_line, incluindo o '\n' final.
+ */
+static size_t log_line(const char *tag, const char *fmt, va_list ap, bool *accepted)
+{
+    char *p = format_prefix(s_line, tag ? tag : "LOG");
+    const size_t room = sizeof(s_line) - (size_t)(p - s_line) - 1u;
+    int n = vsnprintf(p, room, fmt, ap);
+
+    if (n < 0)
     {
-        Serial.printf("%s [LOGGER] pronto\n", ts);
+        n = 0;
     }
 
-    sdcard_printf("%s [LOGGER] pronto\n", ts);
+    p += ((size_t)n < room) ? (size_t)n : room - 1u;
+    *p++ = '\n';
+    const size_t len = (size_t)(p - s_line);
+    const bool ok = emit_line(s_line, len);
+
+    if (accepted)
+    {
+        *accepted = ok;
+    }
+
+    return len;
 }
 
 /**
@@ -72,6 +125,10 @@ void logger_begin()
  * @param tag Rótulo do subsistema/área (ex.: "MAIN", "LORA"); se @c nullptr, usa "LOG".
  * @param fmt String de formato no estilo @c printf().
  * @param ... Argumentos variáveis correspondentes a @p fmt.
+ *
+ * @note Apenas a mensagem passa por @c vsnprintf; o prefixo é montado sem printf.
+ *       A linha é montada e emitida sob @c sdcard_lock(), podendo ser chamada de
+ *       qualquer tarefa.
  */
 void logger_log(const char *tag, const char *fmt, ...)
 {
@@ -80,24 +137,34 @@ void logger_log(const char *tag, const char *fmt, ...)
         return;
     }
 
-    const char *t = tag ? tag : "LOG";
+    sdcard_lock();
     va_list ap;
     va_start(ap, fmt);
-    vsnprintf(s_line, sizeof(s_line), fmt, ap);
+    (void)log_line(tag, fmt, ap, nullptr);
     va_end(ap);
-    char ts[40];
-    format_timestamp(ts, sizeof(ts));
+    sdcard_unlock();
+}
 
-    if (Serial)
+/**
+ * @brief Como @c logger_log(), e também copia a linha para o estágio na memória
+ *        RTC, de onde é recuperada se um reset ocorrer antes do flush no SD (ou
+ *        regravada, se o anel do SD estava cheio e a descartou).
+ */
+void logger_log_crit(const char *tag, const char *fmt, ...)
+{
+    if (!g_log_ready)
     {
-        Serial.print(ts);
-        Serial.print(" [");
-        Serial.print(t);
-        Serial.print("] ");
-        Serial.println(s_line);
+        return;
     }
 
-    sdcard_printf("%s [%s] %s\n", ts, t, s_line);
+    sdcard_lock();
+    va_list ap;
+    va_start(ap, fmt);
+    bool accepted = false;
+    const size_t len = log_line(tag, fmt, ap, &accepted);
+    va_end(ap);
+    rtc_stage_log(s_line, len, accepted);
+    sdcard_unlock();
 }
 
 /**
@@ -114,34 +181,26 @@ void logger_hexdump(const char *tag, const uint8_t *buf, size_t len)
         return;
     }
 
-    char ts[40];
-    format_timestamp(ts, sizeof(ts));
-    const char *t = tag ? tag : "LOG";
-
-    if (Serial)
+    if (!g_log_ready)
     {
-        Serial.printf("%s [%s] HEXDUMP (%u bytes):\n", ts, t, (unsigned)len);
+        return;
     }
 
-    sdcard_printf("%s [%s] HEXDUMP (%u bytes):\n", ts, t, (unsigned)len);
+    /* O prefixo é formatado uma vez e reaproveitado em todas as linhas. */
+    sdcard_lock();
+    char *body = format_prefix(s_line, tag ? tag : "LOG");
+    char *p = fmt_str(body, "HEXDUMP (");
+    p = fmt_u32(p, (uint32_t)len);
+    p = fmt_str(p, " bytes):\n");
+    (void)emit_line(s_line, (size_t)(p - s_line));
 
     for (size_t off = 0; off < len; off += 16)
     {
-        uint32_t pos = 0;
-        char line[3 * 16 + 1];
-
-        for (size_t i = 0; i < 16 && (off + i) < len; ++i)
-        {
-            pos += snprintf(line + pos, sizeof(line) - (size_t)pos, "%02X ", buf[off + i]);
-        }
-
-        line[(pos < (uint32_t)sizeof(line)) ? pos : (uint32_t)sizeof(line) - 1] = '\0';
-
-        if (Serial)
-        {
-            Serial.printf("%s [%s] %s\n", ts, t, line);
-        }
-
-        sdcard_printf("%s [%s] %s\n", ts, t, line);
+        const size_t n = (len - off < 16) ? (len - off) : 16;
+        p = fmt_hex_bytes(body, buf + off, n);
+        *p++ = '\n';
+        (void)emit_line(s_line, (size_t)(p - s_line));
     }
+
+    sdcard_unlock();
 }
@@ -0,0 +1,947 @@
+/**
+ * @file metrics.cpp
+ * @brief Contadores atômicos de recepção/descarte, histogramas de tamanho, RSSI e
+ *        SNR, endpoint HTTP @c /metrics (texto Prometheus) e resumo periódico no log.
+ *
+ * O caminho do rádio só faz incrementos relaxados; a formatação acontece apenas
+ * quando o endpoint é consultado ou no resumo periódico.
+ */
+
+#include "metrics.h"
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <esp_http_server.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include "analytics.h"
+#include "fault_inject.h"
+#include "fmt.h"
+#include "key_table.h"
+#include "link_quality.h"
+#include "logger.h"
+#include "rtc_stage.h"
+#include "sd_card.h"
+#include "spi_bus.h"
+#include "sx1278_lora.h"
+#include "uplink.h"
+#include "wifi_manager.h"
+
+#if UPLINK_ENABLE_THINGSPEAK
+#include "thingspeak_client.h"
+#endif
+
+#if UPLINK_ENABLE_MQTT
+#include "mqtt_client.h"
+#endif
+
+#if UPLINK_ENABLE_SD_RAW
+#include "record_log.h"
+#endif
+
+#define METRICS_PAGE_MAX 8192
+
+static const char *TAG = "METRICS";
+
+static const char *const kDropNames[DROP_N_REASONS] = {
+    "short", "ct_align", "aes", "batch", "unpad", "checksum", "overrun", "injected",
+    "no_key", "duplicate",
+};
+
+/* Limites superiores ("le") dos histogramas; o último balde é +Inf. */
+static const int32_t kSizeLe[] = {16, 32, 48, 64, 96, 128, 192, 255};
+static const int32_t kRssiLe[] = {-120, -110, -100, -90, -80, -70, -60, -50};
+static const int32_t kSnrLe[] = {-1500, -1000, -500, 0, 500, 1000};  /* centésimos de dB */
+
+#define N_LE(a) (sizeof(a) / sizeof((a)[0]))
+
+/* Latência: baldes log2 com 4 subdivisões (erro relativo <= 25%), até 2^32 us. */
+#define LAT_BUCKETS 124
+
+static uint32_t g_rx_packets = 0;
+static uint32_t g_rx_bytes = 0;
+static uint32_t g_readings = 0;
+static uint32_t g_drops[DROP_N_REASONS];
+static uint32_t g_size_hist[N_LE(kSizeLe) + 1];
+static uint32_t g_rssi_hist[N_LE(kRssiLe) + 1];
+static uint32_t g_snr_hist[N_LE(kSnrLe) + 1];
+static int64_t g_rssi_sum = 0;
+static int64_t g_snr_sum = 0;
+static uint32_t g_lat_hist[LAT_BUCKETS];
+static uint32_t g_lat_max_us = 0;
+static uint32_t g_acks[ACK_N_RESULTS];
+static uint32_t g_ack_turn_last_us = 0;
+static uint32_t g_ack_turn_max_us = 0;
+static uint32_t g_ack_air_max_us = 0;
+static uint32_t g_pickup_n = 0;           /* pacotes retirados pelo laço           */
+static uint64_t g_pickup_sum_us = 0;      /* soma dos atrasos RxDone -> laço       */
+static uint32_t g_pickup_max_us = 0;
+static uint32_t g_loop_wakeups = 0;
+static uint64_t g_loop_busy_us = 0;       /* tempo do laço acordado                */
+
+static httpd_handle_t g_httpd = nullptr;
+static char g_page[METRICS_PAGE_MAX];
+static uint32_t g_next_snapshot_ms = METRICS_SNAPSHOT_MS;
+static uint32_t g_heap_min_mark = 0;      /* min-free no último resumo (0 = sem base) */
+static uint32_t g_heap_largest_base = 0;  /* maior bloco ao fim do boot               */
+
+/****************************** Funções privadas ******************************/
+
+static inline void inc(uint32_t *c, uint32_t n)
+{
+    __atomic_fetch_add(c, n, __ATOMIC_RELAXED);
+}
+
+static inline uint32_t load(const uint32_t *c)
+{
+    return __atomic_load_n(c, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Incrementa o primeiro balde cujo limite comporta @p v.
+ */
+static void observe(const int32_t *le, size_t n, uint32_t *hist, int32_t v)
+{
+    size_t i = 0;
+
+    while (i < n && v > le[i])
+    {
+        ++i;
+    }
+
+    inc(&hist[i], 1);
+}
+
+/**
+ * @brief Índice do balde de latência de @p us.
+ */
+static uint8_t lat_bucket(uint32_t us)
+{
+    if (us < 4)
+    {
+        return (uint8_t)us;
+    }
+
+    const uint8_t msb = (uint8_t)(31 - __builtin_clz(us));
+    return (uint8_t)((msb - 1u) * 4u + ((us >> (msb - 2u)) & 3u));
+}
+
+/**
+ * @brief Maior valor (us) contido no balde @p idx.
+ */
+static uint32_t lat_upper(uint8_t idx)
+{
+    if (idx < 4)
+    {
+        return idx;
+    }
+
+    const uint8_t shift = (uint8_t)(idx / 4u - 1u);
+    const uint64_t lower = (uint64_t)(4u + idx % 4u) << shift;
+    return (uint32_t)(lower + (1ull << shift) - 1u);
+}
+
+/**
+ * @brief Acumulador de texto com limite; deixa de escrever ao encher.
+ */
+typedef struct
+{
+    char *p;
+    char *end;
+} Page;
+
+static void put(Page *pg, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void put(Page *pg, const char *fmt, ...)
+{
+    const size_t room = (size_t)(pg->end - pg->p);
+
+    if (room <= 1)
+    {
+        return;
+    }
+
+    va_list ap;
+    va_start(ap, fmt);
+    const int n = vsnprintf(pg->p, room, fmt, ap);
+    va_end(ap);
+
+    if (n > 0)
+    {
+        pg->p += ((size_t)n < room) ? (size_t)n : room - 1;
+    }
+}
+
+/**
+ * @brief Escreve um valor em escala 10^-scale como decimal ("-12.50").
+ */
+static void put_scaled(Page *pg, int64_t v, uint8_t scale)
+{
+    if (scale == 0)
+    {
+        put(pg, "%lld", (long long)v);
+        return;
+    }
+
+    const char *sign = (v < 0) ? "-" : "";
+    const uint64_t a = (uint64_t)(v < 0 ? -v : v);
+    const uint64_t div = (scale == 1) ? 10u : 100u;
+    put(pg, "%s%llu.%0*llu", sign, (unsigned long long)(a / div), (int)scale,
+        (unsigned long long)(a % div));
+}
+
+/**
+ * @brief Escreve um histograma Prometheus (baldes cumulativos, _sum e _count).
+ */
+static void put_histogram(Page *pg, const char *name, const char *help, const int32_t *le,
+                          size_t n, const uint32_t *hist, int64_t sum, uint8_t scale)
+{
+    uint32_t cum = 0;
+
+    put(pg, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        cum += load(&hist[i]);
+        put(pg, "%s_bucket{le=\"", name);
+        put_scaled(pg, le[i], scale);
+        put(pg, "\"} %lu\n", (unsigned long)cum);
+    }
+
+    cum += load(&hist[n]);
+    put(pg, "%s_bucket{le=\"+Inf\"} %lu\n%s_sum ", name, (unsigned long)cum, name);
+    put_scaled(pg, sum, scale);
+    put(pg, "\n%s_count %lu\n", name, (unsigned long)cum);
+}
+
+/**
+ * @brief Escreve as estatísticas móveis (em unidades físicas) e os eventos por tipo.
+ */
+static void put_analytics(Page *pg)
+{
+    static const char *const kNames[5] = {"mean", "min", "max", "ewma", "rate_per_hour"};
+    AnalyticsStats st;
+    analytics_get_stats(&st);
+
+    put(pg, "# TYPE analytics_events_total counter\n");
+
+    for (uint8_t k = 0; k < EVT_N_KINDS; ++k)
+    {
+        put(pg, "analytics_events_total{event=\"%s\"} %lu\n",
+            analytics_event_name((AnalyticsEvent)k), (unsigned long)st.events[k]);
+    }
+
+    put(pg, "# TYPE analytics_sources gauge\nanalytics_sources %u\n"
+            "# TYPE analytics_evicted_total counter\nanalytics_evicted_total %lu\n",
+        (unsigned)st.sources, (unsigned long)st.evicted);
+
+    for (uint8_t m = 0; m < 5; ++m)
+    {
+        put(pg, "# TYPE analytics_%s gauge\n", kNames[m]);
+
+        for (uint8_t slot = 0; slot < ANALYTICS_MAX_SOURCES; ++slot)
+        {
+            for (uint8_t i = 0; i < SCHEMA_MAX_FIELDS; ++i)
+            {
+                AnalyticsField af;
+                uint16_t source;
+                uint8_t version;
+
+                if (!analytics_get_field(slot, i, &source, &version, &af))
+                {
+                    continue;
+                }
+
+                const FieldDesc *f = &payload_schema_by_version(version)->fields[i];
+                const int32_t v[5] = {af.mean, af.min, af.max, af.ewma, af.rate_per_h};
+                char txt[FMT_FIXED_MAX + 1];
+                *fmt_fixed(txt, v[m], f->scale_exp, f->log_decimals) = '\0';
+                put(pg, "analytics_%s{source=\"%u\",field=\"%s\"} %s\n", kNames[m],
+                    (unsigned)source, f->label, txt);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Handler de @c GET /metrics.
+ */
+static esp_err_t metrics_get_handler(httpd_req_t *req)
+{
+    const size_t n = metrics_render(g_page, sizeof(g_page));
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    return httpd_resp_send(req, g_page, (long)n);
+}
+
+#if FAULT_INJECT
+/**
+ * @brief Handler de @c GET /fault?p=...: reconfigura um ponto de injeção.
+ */
+static esp_err_t fault_get_handler(httpd_req_t *req)
+{
+    char query[96] = "";
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        !fault_configure_query(query))
+    {
+        return httpd_resp_send(req, "use p=sd|http|radio|wifi&err=&dly=&min=&max=\n", -1);
+    }
+
+    return httpd_resp_send(req, "ok\n", -1);
+}
+#endif
+
+/**
+ * @brief Handler de @c GET /enlace: registro de qualidade de enlace por nó.
+ */
+static esp_err_t link_get_handler(httpd_req_t *req)
+{
+    const size_t n = metrics_render_link(g_page, sizeof(g_page));
+    httpd_resp_set_type(req, "text/plain");
+    return httpd_resp_send(req, g_page, (long)n);
+}
+
+/****************************** Funções públicas ******************************/
+
+/**
+ * @brief Contabiliza um pacote recebido pelo rádio.
+ * @param len Tamanho em bytes.
+ * @param rssi RSSI do pacote (dBm).
+ * @param snr_centi SNR do pacote em centésimos de dB.
+ */
+void metrics_rx_packet(uint16_t len, int16_t rssi, int32_t snr_centi)
+{
+    inc(&g_rx_packets, 1);
+    inc(&g_rx_bytes, len);
+    observe(kSizeLe, N_LE(kSizeLe), g_size_hist, len);
+    observe(kRssiLe, N_LE(kRssiLe), g_rssi_hist, rssi);
+    observe(kSnrLe, N_LE(kSnrLe), g_snr_hist, snr_centi);
+    __atomic_fetch_add(&g_rssi_sum, (int64_t)rssi, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&g_snr_sum, (int64_t)snr_centi, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Contabiliza um pacote descartado.
+ * @param reason Motivo do descarte.
+ */
+void metrics_drop(DropReason reason)
+{
+    if (reason < DROP_N_REASONS)
+    {
+        inc(&g_drops[reason], 1);
+    }
+}
+
+/**
+ * @brief Contabiliza @p n pacotes descartados pelo mesmo motivo.
+ */
+void metrics_drop_n(DropReason reason, uint32_t n)
+{
+    if (reason < DROP_N_REASONS)
+    {
+        inc(&g_drops[reason], n);
+    }
+}
+
+/**
+ * @brief Registra a latência de processamento de um pacote (da ISR ao flush).
+ * @param us Latência em microssegundos.
+ *
+ * @note Chamada apenas pelo laço principal; o máximo não precisa de CAS.
+ */
+void metrics_latency_us(uint32_t us)
+{
+    inc(&g_lat_hist[lat_bucket(us)], 1);
+
+    if (us > __atomic_load_n(&g_lat_max_us, __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(&g_lat_max_us, us, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Registra um ACK de downlink e seus tempos.
+ * @param result Desfecho do ACK.
+ * @param turnaround_us Do RxDone do quadro ao início da transmissão.
+ * @param airtime_us Duração da transmissão (0 se não houve).
+ *
+ * @note Chamada apenas pelo laço principal; os máximos não precisam de CAS.
+ */
+void metrics_ack(AckResult result, uint32_t turnaround_us, uint32_t airtime_us)
+{
+    if (result >= ACK_N_RESULTS)
+    {
+        return;
+    }
+
+    inc(&g_acks[result], 1);
+    __atomic_store_n(&g_ack_turn_last_us, turnaround_us, __ATOMIC_RELAXED);
+
+    if (turnaround_us > __atomic_load_n(&g_ack_turn_max_us, __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(&g_ack_turn_max_us, turnaround_us, __ATOMIC_RELAXED);
+    }
+
+    if (airtime_us > __atomic_load_n(&g_ack_air_max_us, __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(&g_ack_air_max_us, airtime_us, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Registra o atraso entre o RxDone e o início do processamento no laço.
+ * @param us Atraso em microssegundos.
+ *
+ * @note Chamada apenas pelo laço principal; o máximo não precisa de CAS.
+ */
+void metrics_pickup_us(uint32_t us)
+{
+    inc(&g_pickup_n, 1);
+    __atomic_fetch_add(&g_pickup_sum_us, (uint64_t)us, __ATOMIC_RELAXED);
+
+    if (us > __atomic_load_n(&g_pickup_max_us, __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(&g_pickup_max_us, us, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Registra um despertar do laço principal e quanto tempo ele ficou acordado.
+ * @param busy_us Do retorno de @c xTaskNotifyWait() ao fim do tratamento.
+ */
+void metrics_loop_wake(uint32_t busy_us)
+{
+    inc(&g_loop_wakeups, 1);
+    __atomic_fetch_add(&g_loop_busy_us, (uint64_t)busy_us, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Estima um percentil da latência (limite superior do balde).
+ * @param permille Percentil em partes por mil (500 = p50, 999 = p99,9).
+ * @return Latência em us; 0 se nada foi registrado.
+ */
+uint32_t metrics_latency_percentile(uint16_t permille)
+{
+    uint32_t counts[LAT_BUCKETS];
+    uint64_t total = 0;
+
+    for (uint8_t i = 0; i < LAT_BUCKETS; ++i)
+    {
+        counts[i] = load(&g_lat_hist[i]);
+        total += counts[i];
+    }
+
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    const uint64_t rank = (total * permille + 999u) / 1000u;
+    uint64_t cum = 0;
+
+    for (uint8_t i = 0; i < LAT_BUCKETS; ++i)
+    {
+        cum += counts[i];
+
+        if (cum >= rank)
+        {
+            const uint32_t up = lat_upper(i);
+            const uint32_t max = __atomic_load_n(&g_lat_max_us, __ATOMIC_RELAXED);
+            return (up < max) ? up : max;
+        }
+    }
+
+    return __atomic_load_n(&g_lat_max_us, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Contabiliza @p n leituras válidas (1 por quadro simples, N por lote).
+ */
+void metrics_readings(uint32_t n)
+{
+    inc(&g_readings, n);
+}
+
+/**
+ * @brief Gera a página de métricas no formato texto do Prometheus.
+ * @param out Buffer de saída.
+ * @param outlen Tamanho de @p out.
+ * @return Número de caracteres escritos (sem o terminador).
+ */
+size_t metrics_render(char *out, size_t outlen)
+{
+    Page pg = {out, out + outlen};
+
+    if (!out || outlen == 0)
+    {
+        return 0;
+    }
+
+    out[0] = '\0';
+
+    put(&pg, "# TYPE gateway_uptime_seconds gauge\ngateway_uptime_seconds %lu\n",
+        (unsigned long)(millis() / 1000u));
+    put(&pg, "# TYPE lora_rx_packets_total counter\nlora_rx_packets_total %lu\n",
+        (unsigned long)load(&g_rx_packets));
+    put(&pg, "# TYPE lora_rx_bytes_total counter\nlora_rx_bytes_total %lu\n",
+        (unsigned long)load(&g_rx_bytes));
+    put(&pg, "# TYPE lora_readings_total counter\nlora_readings_total %lu\n",
+        (unsigned long)load(&g_readings));
+
+    put(&pg, "# HELP lora_drops_total Pacotes descartados por motivo\n"
+             "# TYPE lora_drops_total counter\n");
+
+    for (uint8_t i = 0; i < DROP_N_REASONS; ++i)
+    {
+        put(&pg, "lora_drops_total{reason=\"%s\"} %lu\n", kDropNames[i],
+            (unsigned long)load(&g_drops[i]));
+    }
+
+    put_histogram(&pg, "lora_packet_size_bytes", "Tamanho dos pacotes recebidos",
+                  kSizeLe, N_LE(kSizeLe), g_size_hist, (int64_t)load(&g_rx_bytes), 0);
+    put_histogram(&pg, "lora_rssi_dbm", "RSSI dos pacotes recebidos", kRssiLe, N_LE(kRssiLe),
+                  g_rssi_hist, __atomic_load_n(&g_rssi_sum, __ATOMIC_RELAXED), 0);
+    put_histogram(&pg, "lora_snr_db", "SNR dos pacotes recebidos", kSnrLe, N_LE(kSnrLe),
+                  g_snr_hist, __atomic_load_n(&g_snr_sum, __ATOMIC_RELAXED), 2);
+
+    put(&pg, "# HELP lora_processing_latency_seconds Da ISR ao fim do processamento\n"
+             "# TYPE lora_processing_latency_seconds summary\n");
+    static const uint16_t kQuantiles[] = {500, 990, 999};
+    static const char *const kQuantileLabels[] = {"0.5", "0.99", "0.999"};
+
+    for (uint8_t i = 0; i < 3; ++i)
+    {
+        const uint32_t us = metrics_latency_percentile(kQuantiles[i]);
+        put(&pg, "lora_processing_latency_seconds{quantile=\"%s\"} %lu.%06lu\n",
+            kQuantileLabels[i], (unsigned long)(us / 1000000u), (unsigned long)(us % 1000000u));
+    }
+
+    put(&pg, "# TYPE lora_processing_latency_max_seconds gauge\n"
+             "lora_processing_latency_max_seconds %lu.%06lu\n",
+        (unsigned long)(__atomic_load_n(&g_lat_max_us, __ATOMIC_RELAXED) / 1000000u),
+        (unsigned long)(__atomic_load_n(&g_lat_max_us, __ATOMIC_RELAXED) % 1000000u));
+
+    put(&pg, "# HELP lora_pickup_latency_us Do RxDone ao inicio do processamento no laco\n"
+             "# TYPE lora_pickup_latency_us summary\n"
+             "lora_pickup_latency_us_sum %llu\nlora_pickup_latency_us_count %lu\n"
+             "# TYPE lora_pickup_latency_max_us gauge\nlora_pickup_latency_max_us %lu\n"
+             "# TYPE loop_wakeups_total counter\nloop_wakeups_total %lu\n"
+             "# TYPE loop_busy_us_total counter\nloop_busy_us_total %llu\n",
+        (unsigned long long)__atomic_load_n(&g_pickup_sum_us, __ATOMIC_RELAXED),
+        (unsigned long)load(&g_pickup_n), (unsigned long)load(&g_pickup_max_us),
+        (unsigned long)load(&g_loop_wakeups),
+        (unsigned long long)__atomic_load_n(&g_loop_busy_us, __ATOMIC_RELAXED));
+
+#if FAULT_INJECT
+    static const char *const kFaultNames[FAULT_N_POINTS] = {"sd", "http", "radio", "wifi"};
+    put(&pg, "# TYPE fault_injected_total counter\n");
+
+    for (uint8_t i = 0; i < FAULT_N_POINTS; ++i)
+    {
+        put(&pg, "fault_injected_total{point=\"%s\"} %lu\n", kFaultNames[i],
+            (unsigned long)fault_count((FaultPoint)i));
+    }
+#endif
+
+    /* Amostras de cada família contíguas, como exige o formato texto. */
+    UplinkStats st[UPLINK_MAX_SINKS];
+    const uint8_t n_sinks = uplink_count();
+
+    for (uint8_t i = 0; i < n_sinks; ++i)
+    {
+        (void)uplink_get_stats(i, &st[i]);
+    }
+
+    static const char *const kUplinkNames[] = {
+        "uplink_submitted_total", "uplink_delivered_total", "uplink_failed_total",
+        "uplink_retries_total", "uplink_dropped_total", "uplink_send_errors_total",
+        "uplink_wifi_waits_total", "uplink_queue_depth",
+    };
+
+    for (uint8_t m = 0; m < 8; ++m)
+    {
+        put(&pg, "# TYPE %s %s\n", kUplinkNames[m], (m == 7) ? "gauge" : "counter");
+
+        for (uint8_t i = 0; i < n_sinks; ++i)
+        {
+            const uint32_t v[8] = {st[i].submitted, st[i].delivered, st[i].failed,
+                                   st[i].retries, st[i].dropped, st[i].send_errors,
+                                   st[i].wifi_waits, st[i].depth};
+            put(&pg, "%s{sink=\"%s\"} %lu\n", kUplinkNames[m], uplink_name(i),
+                (unsigned long)v[m]);
+        }
+    }
+
+#if UPLINK_ENABLE_THINGSPEAK
+    ThingSpeakStats ts;
+    thingspeak_get_stats(&ts);
+    put(&pg, "# TYPE thingspeak_updates_total counter\n"
+             "thingspeak_updates_total{result=\"accepted\"} %lu\n"
+             "thingspeak_updates_total{result=\"rejected\"} %lu\n"
+             "thingspeak_updates_total{result=\"failed\"} %lu\n",
+        (unsigned long)ts.accepted, (unsigned long)ts.rejected, (unsigned long)ts.failed);
+
+#if THINGSPEAK_TLS
+    TlsStats tls;
+    thingspeak_get_tls_stats(&tls);
+    put(&pg, "# HELP tls_handshakes_total Handshakes TLS do uplink por tipo\n"
+             "# TYPE tls_handshakes_total counter\n"
+             "tls_handshakes_total{kind=\"full\"} %lu\n"
+             "tls_handshakes_total{kind=\"resumed\"} %lu\n"
+             "tls_handshakes_total{kind=\"failed\"} %lu\n"
+             "# TYPE tls_handshake_ms_total counter\n"
+             "tls_handshake_ms_total{kind=\"full\"} %lu\n"
+             "tls_handshake_ms_total{kind=\"resumed\"} %lu\n"
+             "# TYPE tls_handshake_max_ms gauge\n"
+             "tls_handshake_max_ms{kind=\"full\"} %lu\n"
+             "tls_handshake_max_ms{kind=\"resumed\"} %lu\n",
+        (unsigned long)tls.full, (unsigned long)tls.resumed, (unsigned long)tls.failed,
+        (unsigned long)tls.full_ms_sum, (unsigned long)tls.resumed_ms_sum,
+        (unsigned long)tls.full_max_ms, (unsigned long)tls.resumed_max_ms);
+#endif
+#endif
+
+#if UPLINK_ENABLE_MQTT
+    MqttStats mq;
+    mqtt_get_stats(&mq);
+    put(&pg, "# TYPE mqtt_published_total counter\nmqtt_published_total %lu\n"
+             "# TYPE mqtt_acked_total counter\nmqtt_acked_total %lu\n"
+             "# TYPE mqtt_retransmitted_total counter\nmqtt_retransmitted_total %lu\n"
+             "# TYPE mqtt_inflight gauge\nmqtt_inflight %u\n",
+        (unsigned long)mq.published, (unsigned long)mq.acked,
+        (unsigned long)mq.retransmitted, (unsigned)mq.inflight);
+#endif
+
+#if UPLINK_ENABLE_SD_RAW
+    RecLogStats rl;
+    reclog_get_stats(&rl);
+    put(&pg, "# TYPE reclog_open gauge\nreclog_open %u\n"
+             "# TYPE reclog_records_total counter\nreclog_records_total %lu\n"
+             "# TYPE reclog_block_writes_total counter\nreclog_block_writes_total %lu\n"
+             "# TYPE reclog_write_errors_total counter\nreclog_write_errors_total %lu\n"
+             "# TYPE reclog_next_block gauge\nreclog_next_block %lu\n"
+             "# TYPE reclog_recovery_reads gauge\nreclog_recovery_reads %lu\n"
+             "# TYPE reclog_recovery_us gauge\nreclog_recovery_us %lu\n",
+        rl.open ? 1u : 0u, (unsigned long)rl.records, (unsigned long)rl.block_writes,
+        (unsigned long)rl.write_errors, (unsigned long)rl.next_seq,
+        (unsigned long)rl.recovery_reads, (unsigned long)rl.recovery_us);
+#endif
+
+#if LORA_ACK_ENABLE
+    put(&pg, "# TYPE lora_acks_total counter\n"
+             "lora_acks_total{result=\"sent\"} %lu\n"
+             "lora_acks_total{result=\"late\"} %lu\n"
+             "lora_acks_total{result=\"failed\"} %lu\n"
+             "# TYPE lora_ack_turnaround_us gauge\nlora_ack_turnaround_us %lu\n"
+             "# TYPE lora_ack_turnaround_max_us gauge\nlora_ack_turnaround_max_us %lu\n"
+             "# TYPE lora_ack_airtime_max_us gauge\nlora_ack_airtime_max_us %lu\n",
+        (unsigned long)load(&g_acks[ACK_SENT]), (unsigned long)load(&g_acks[ACK_LATE]),
+        (unsigned long)load(&g_acks[ACK_FAILED]), (unsigned long)load(&g_ack_turn_last_us),
+        (unsigned long)load(&g_ack_turn_max_us), (unsigned long)load(&g_ack_air_max_us));
+#endif
+
+    WifiReconnectStats ws;
+    wifi_get_reconnect_stats(&ws);
+    put(&pg, "# TYPE wifi_connected gauge\nwifi_connected %u\n"
+             "# TYPE wifi_reconnects_total counter\nwifi_reconnects_total %lu\n",
+        wifi_is_connected() ? 1u : 0u, (unsigned long)ws.count);
+
+    SdStats sd;
+    sdcard_get_stats(&sd);
+    put(&pg, "# TYPE sd_card_ok gauge\nsd_card_ok %u\n"
+             "# TYPE sd_log_held_bytes gauge\nsd_log_held_bytes %lu\n"
+             "# TYPE sd_log_held_peak_bytes gauge\nsd_log_held_peak_bytes %lu\n"
+             "# TYPE sd_log_dropped_bytes_total counter\nsd_log_dropped_bytes_total %lu\n"
+             "# TYPE sd_log_written_bytes_total counter\nsd_log_written_bytes_total %lu\n"
+             "# TYPE sd_write_errors_total counter\nsd_write_errors_total %lu\n"
+             "# TYPE sd_remounts_total counter\nsd_remounts_total %lu\n"
+             "# TYPE sd_stalls_total counter\nsd_stalls_total %lu\n",
+        sd.card_ok ? 1u : 0u, (unsigned long)sd.held_bytes, (unsigned long)sd.ring_peak,
+        (unsigned long)sd.dropped_bytes, (unsigned long)sd.written_bytes,
+        (unsigned long)sd.write_errors, (unsigned long)sd.remounts, (unsigned long)sd.stalls);
+
+    RtcStageStats rs;
+    rtc_stage_get_stats(&rs);
+    put(&pg, "# TYPE rtc_stage_pending gauge\nrtc_stage_pending %u\n"
+             "# TYPE rtc_stage_staged_total counter\nrtc_stage_staged_total %lu\n"
+             "# TYPE rtc_stage_replayed_total counter\nrtc_stage_replayed_total %lu\n"
+             "# TYPE rtc_stage_lost_total counter\nrtc_stage_lost_total %lu\n",
+        (unsigned)rs.pending, (unsigned long)rs.staged, (unsigned long)rs.replayed,
+        (unsigned long)rs.lost);
+
+    SpiBusStats sb;
+    spi_bus_get_stats(&sb);
+    put(&pg, "# TYPE spi_radio_waits_total counter\nspi_radio_waits_total %lu\n"
+             "# TYPE spi_radio_over_budget_total counter\nspi_radio_over_budget_total %lu\n"
+             "# TYPE spi_radio_wait_max_us gauge\nspi_radio_wait_max_us %lu\n"
+             "# TYPE spi_sd_hold_max_us gauge\nspi_sd_hold_max_us %lu\n",
+        (unsigned long)sb.radio_waits, (unsigned long)sb.radio_over_budget,
+        (unsigned long)sb.radio_wait_max_us, (unsigned long)sb.sd_hold_max_us);
+
+    KeyTabStats kt;
+    keytab_get_stats(&kt);
+    put(&pg, "# TYPE keytab_nodes gauge\nkeytab_nodes %u\n"
+             "# TYPE keytab_rotating gauge\nkeytab_rotating %u\n"
+             "# TYPE keytab_reloads_total counter\nkeytab_reloads_total %lu\n"
+             "# TYPE keytab_rejected_total counter\nkeytab_rejected_total %lu\n"
+             "# TYPE keytab_rotations_total counter\nkeytab_rotations_total %lu\n"
+             "# TYPE keytab_prev_key_frames_total counter\nkeytab_prev_key_frames_total %lu\n",
+        (unsigned)kt.nodes, (unsigned)kt.rotating, (unsigned long)kt.reloads,
+        (unsigned long)kt.rejected, (unsigned long)kt.rotations, (unsigned long)kt.prev_hits);
+
+    put_analytics(&pg);
+
+    put(&pg, "# TYPE heap_free_bytes gauge\nheap_free_bytes %lu\n"
+             "# TYPE heap_min_free_bytes gauge\nheap_min_free_bytes %lu\n"
+             "# TYPE heap_largest_free_block_bytes gauge\nheap_largest_free_block_bytes %lu\n",
+        (unsigned long)heap_caps_get_free_size(MALLOC_CAP_8BIT),
+        (unsigned long)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+        (unsigned long)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+
+    return (size_t)(pg.p - out);
+}
+
+/**
+ * @brief Gera a página do registro de enlace, uma linha por campo e nó.
+ *
+ * @details Texto tabular em vez de Prometheus: 16 nós com histogramas por nó não
+ *          caberiam na página no formato de uma amostra por balde. Os histogramas
+ *          são contagens por balde (não cumulativas), na ordem dos limites do
+ *          cabeçalho; as últimas amostras vão da mais antiga à mais recente.
+ * @param out Buffer de saída.
+ * @param outlen Tamanho de @p out.
+ * @return Número de caracteres escritos (sem o terminador).
+ */
+size_t metrics_render_link(char *out, size_t outlen)
+{
+    Page pg = {out, out + outlen};
+
+    if (!out || outlen == 0)
+    {
+        return 0;
+    }
+
+    out[0] = '\0';
+    put(&pg, "# enlace por no (no 0 = quadros sem id); per = perdidos/(quadros+perdidos)\n"
+             "# rssi_le");
+
+    for (int32_t i = 0; i < LINKQ_RSSI_BUCKETS - 1; ++i)
+    {
+        put(&pg, " %ld", (long)(LINKQ_RSSI_LE0 + i * LINKQ_RSSI_STEP));
+    }
+
+    put(&pg, " +Inf\n# snr_le");
+
+    for (int32_t i = 0; i < LINKQ_SNR_BUCKETS - 1; ++i)
+    {
+        put(&pg, " ");
+        put_scaled(&pg, LINKQ_SNR_LE0 + i * LINKQ_SNR_STEP, 2);
+    }
+
+    put(&pg, " +Inf\n# ultimas seq:rssi:snr\n");
+    LinkSource s;
+
+    for (uint8_t slot = 0; slot < LINKQ_MAX_SOURCES; ++slot)
+    {
+        if (!linkq_get(slot, &s))
+        {
+            continue;
+        }
+
+        const uint32_t total = s.frames + s.lost;
+        const uint32_t per_pm = total ? (uint32_t)((uint64_t)s.lost * 1000u / total) : 0;
+        const int64_t frames = s.frames ? (int64_t)s.frames : 1;
+        put(&pg, "no %u quadros %lu perdidos %lu duplicados %lu ressinc %lu per %lu.%lu%% "
+                 "rssi_med %ld rssi_min %d rssi_max %d snr_med ",
+            (unsigned)s.node, (unsigned long)s.frames, (unsigned long)s.lost,
+            (unsigned long)s.duplicates, (unsigned long)s.resyncs,
+            (unsigned long)(per_pm / 10u), (unsigned long)(per_pm % 10u),
+            (long)(s.rssi_sum / frames), s.frames ? (int)s.rssi_min : 0,
+            s.frames ? (int)s.rssi_max : 0);
+        put_scaled(&pg, s.snr_sum / frames, 2);
+        put(&pg, " visto %lu\nrssi %u", (unsigned long)s.last_seen, (unsigned)s.node);
+
+        for (uint8_t i = 0; i < LINKQ_RSSI_BUCKETS; ++i)
+        {
+            put(&pg, " %lu", (unsigned long)s.rssi_hist[i]);
+        }
+
+        put(&pg, "\nsnr %u", (unsigned)s.node);
+
+        for (uint8_t i = 0; i < LINKQ_SNR_BUCKETS; ++i)
+        {
+            put(&pg, " %lu", (unsigned long)s.snr_hist[i]);
+        }
+
+        put(&pg, "\nultimas %u", (unsigned)s.node);
+
+        for (uint8_t i = 0; i < s.n_samples; ++i)
+        {
+            const uint8_t k = (uint8_t)((s.next_sample + LINKQ_LAST_N - s.n_samples + i) %
+                                        LINKQ_LAST_N);
+            put(&pg, " %u:%d:", (unsigned)s.last[k].seq, (int)s.last[k].rssi);
+            put_scaled(&pg, s.last[k].snr_centi, 2);
+        }
+
+        put(&pg, "\n");
+    }
+
+    return (size_t)(pg.p - out);
+}
+
+/**
+ * @brief Inicia o servidor HTTP com os endpoints @c GET /metrics e @c GET /enlace.
+ * @param port Porta TCP do servidor.
+ * @return true se o servidor foi iniciado.
+ */
+bool metrics_http_start(uint16_t port)
+{
+    if (g_httpd)
+    {
+        return true;
+    }
+
+    httpd_config_t cfg = HTTPD_DEFAULT_CONFIG();
+    cfg.server_port = port;
+
+    if (httpd_start(&g_httpd, &cfg) != ESP_OK)
+    {
+        LOG(TAG, "httpd_start falhou (porta %u)", (unsigned)port);
+        g_httpd = nullptr;
+        return false;
+    }
+
+    httpd_uri_t uri = {};
+    uri.uri = "/metrics";
+    uri.method = HTTP_GET;
+    uri.handler = metrics_get_handler;
+    httpd_register_uri_handler(g_httpd, &uri);
+
+    httpd_uri_t link = {};
+    link.uri = "/enlace";
+    link.method = HTTP_GET;
+    link.handler = link_get_handler;
+    httpd_register_uri_handler(g_httpd, &link);
+
+#if FAULT_INJECT
+    httpd_uri_t fault = {};
+    fault.uri = "/fault";
+    fault.method = HTTP_GET;
+    fault.handler = fault_get_handler;
+    httpd_register_uri_handler(g_httpd, &fault);
+#endif
+
+    LOG(TAG, "endpoints /metrics e /enlace na porta %u", (unsigned)port);
+    return true;
+}
+
+/**
+ * @brief Fixa as marcas de heap ao fim da inicialização.
+ *
+ * @details Em regime o gateway não deve alocar: a partir daqui, queda do
+ *          mínimo livre ou do maior bloco livre é registrada no resumo periódico.
+ */
+void metrics_heap_baseline(void)
+{
+    g_heap_min_mark = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    g_heap_largest_base = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    LOG(TAG, "heap apos boot: livre=%lu min=%lu maior_bloco=%lu",
+        (unsigned long)heap_caps_get_free_size(MALLOC_CAP_8BIT),
+        (unsigned long)g_heap_min_mark, (unsigned long)g_heap_largest_base);
+}
+
+/**
+ * @brief Registra, a cada @c METRICS_SNAPSHOT_MS, uma linha de resumo no log/SD.
+ * @param now_ms Tempo corrente (millis()).
+ */
+void metrics_tick(uint32_t now_ms)
+{
+    if ((int32_t)(now_ms - g_next_snapshot_ms) < 0)
+    {
+        return;
+    }
+
+    g_next_snapshot_ms = now_ms + METRICS_SNAPSHOT_MS;
+    LOG(TAG, "latencia us: p50=%lu p99=%lu p999=%lu max=%lu sobrescritos=%lu",
+        (unsigned long)metrics_latency_percentile(500),
+        (unsigned long)metrics_latency_percentile(990),
+        (unsigned long)metrics_latency_percentile(999),
+        (unsigned long)__atomic_load_n(&g_lat_max_us, __ATOMIC_RELAXED),
+        (unsigned long)load(&g_drops[DROP_OVERRUN]));
+    const uint32_t picked = load(&g_pickup_n);
+    LOG(TAG, "laco: despertares=%lu acordado=%lu ms, RxDone->laco us: media=%lu max=%lu",
+        (unsigned long)load(&g_loop_wakeups),
+        (unsigned long)(__atomic_load_n(&g_loop_busy_us, __ATOMIC_RELAXED) / 1000u),
+        (unsigned long)(picked ? __atomic_load_n(&g_pickup_sum_us, __ATOMIC_RELAXED) / picked : 0u),
+        (unsigned long)load(&g_pickup_max_us));
+    LOG(TAG, "rx=%lu bytes=%lu leituras=%lu descartes: curto=%lu ct=%lu aes=%lu "
+             "lote=%lu unpad=%lu chk=%lu",
+        (unsigned long)load(&g_rx_packets), (unsigned long)load(&g_rx_bytes),
+        (unsigned long)load(&g_readings), (unsigned long)load(&g_drops[DROP_SHORT]),
+        (unsigned long)load(&g_drops[DROP_CT_ALIGN]), (unsigned long)load(&g_drops[DROP_AES]),
+        (unsigned long)load(&g_drops[DROP_BATCH]), (unsigned long)load(&g_drops[DROP_UNPAD]),
+        (unsigned long)load(&g_drops[DROP_CHECKSUM]));
+
+    for (uint8_t i = 0; i < uplink_count(); ++i)
+    {
+        UplinkStats us;
+        (void)uplink_get_stats(i, &us);
+        LOG(TAG, "uplink %s: entregues=%lu falhas_envio=%lu esperas_wifi=%lu descartadas=%lu",
+            uplink_name(i), (unsigned long)us.delivered, (unsigned long)us.send_errors,
+            (unsigned long)us.wifi_waits, (unsigned long)(us.failed + us.dropped));
+    }
+
+#if UPLINK_ENABLE_THINGSPEAK && THINGSPEAK_TLS
+    TlsStats tls;
+    thingspeak_get_tls_stats(&tls);
+    LOG(TAG, "tls: completos=%lu (media %lu ms) retomados=%lu (media %lu ms) falhas=%lu",
+        (unsigned long)tls.full, (unsigned long)(tls.full ? tls.full_ms_sum / tls.full : 0u),
+        (unsigned long)tls.resumed,
+        (unsigned long)(tls.resumed ? tls.resumed_ms_sum / tls.resumed : 0u),
+        (unsigned long)tls.failed);
+#endif
+
+#if UPLINK_ENABLE_SD_RAW
+    RecLogStats rl;
+    reclog_get_stats(&rl);
+    LOG(TAG, "reclog: aberto=%u leituras=%lu blocos=%lu falhas=%lu proximo=%lu pendentes=%u",
+        rl.open ? 1u : 0u, (unsigned long)rl.records, (unsigned long)rl.block_writes,
+        (unsigned long)rl.write_errors, (unsigned long)rl.next_seq, (unsigned)rl.pending);
+#endif
+
+    SdStats sd;
+    sdcard_get_stats(&sd);
+    LOG(TAG, "sd: ok=%u retidos=%lu (pico %lu) descartados=%lu falhas=%lu remontagens=%lu",
+        sd.card_ok ? 1u : 0u, (unsigned long)sd.held_bytes, (unsigned long)sd.ring_peak,
+        (unsigned long)sd.dropped_bytes, (unsigned long)sd.write_errors,
+        (unsigned long)sd.remounts);
+
+    SpiBusStats sb;
+    spi_bus_get_stats(&sb);
+    LOG(TAG, "spi: radio esperou %lu vezes (max %lu us, acima do limite %lu), SD max %lu us",
+        (unsigned long)sb.radio_waits, (unsigned long)sb.radio_wait_max_us,
+        (unsigned long)sb.radio_over_budget, (unsigned long)sb.sd_hold_max_us);
+
+    const uint32_t heap_min = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    const uint32_t heap_largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    LOG(TAG, "heap: livre=%lu min=%lu maior_bloco=%lu",
+        (unsigned long)heap_caps_get_free_size(MALLOC_CAP_8BIT),
+        (unsigned long)heap_min, (unsigned long)heap_largest);
+
+    if (g_heap_min_mark == 0)
+    {
+        return;
+    }
+
+    if (heap_min < g_heap_min_mark)
+    {
+        LOG(TAG, "AVISO: min-free caiu %lu bytes desde o ultimo resumo",
+            (unsigned long)(g_heap_min_mark - heap_min));
+        g_heap_min_mark = heap_min;
+    }
+
+    if (heap_largest < g_heap_largest_base)
+    {
+        LOG(TAG, "AVISO: maior bloco livre %lu bytes abaixo do boot (fragmentacao)",
+            (unsigned long)(g_heap_largest_base - heap_largest));
+    }
+}
@@ -0,0 +1,65 @@
+/**
+ * @file metrics.h
+ * @brief Cabeçalho para os contadores de saúde do gateway e sua exposição
+ *        no formato texto do Prometheus.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define METRICS_HTTP_PORT       80
+#define METRICS_SNAPSHOT_MS     300000  /* linha de resumo no log/SD a cada 5 min */
+
+/**
+ * @brief Motivos de descarte de um pacote no caminho do rádio.
+ *
+ * @note Falha de upload e falta de Wi-Fi não descartam a leitura: ela fica na fila
+ *       (ou na janela) do sink. São contadas por sink em @c uplink_send_errors_total
+ *       e @c uplink_wifi_waits_total (@c UplinkStats).
+ */
+typedef enum : uint8_t
+{
+    DROP_SHORT,      /* menor que IV16 + CT16               */
+    DROP_CT_ALIGN,   /* ciphertext não múltiplo de 16       */
+    DROP_AES,        /* falha na descriptografia/padding    */
+    DROP_BATCH,      /* lote com checksum/estrutura inválida */
+    DROP_UNPAD,      /* tamanho sem schema correspondente   */
+    DROP_CHECKSUM,   /* checksum/estrutura do payload       */
+    DROP_OVERRUN,    /* sobrescrito antes do loop consumir  */
+    DROP_INJECTED,   /* perda injetada (FAULT_INJECT)       */
+    DROP_NO_KEY,     /* id de nó sem chave na tabela        */
+    DROP_DUPLICATE,  /* sequência já recebida (reenvio)     */
+    DROP_N_REASONS
+} DropReason;
+
+/**
+ * @brief Desfecho de um ACK de downlink.
+ */
+typedef enum : uint8_t
+{
+    ACK_SENT,        /* transmitido dentro da janela          */
+    ACK_LATE,        /* janela do nó já encerrada, não enviado */
+    ACK_FAILED,      /* falha na etiqueta ou na transmissão   */
+    ACK_N_RESULTS
+} AckResult;
+
+void metrics_rx_packet(uint16_t len, int16_t rssi, int32_t snr_centi);
+void metrics_drop(DropReason reason);
+void metrics_drop_n(DropReason reason, uint32_t n);
+void metrics_latency_us(uint32_t us);
+uint32_t metrics_latency_percentile(uint16_t permille);
+void metrics_readings(uint32_t n);
+void metrics_ack(AckResult result, uint32_t turnaround_us, uint32_t airtime_us);
+void metrics_pickup_us(uint32_t us);
+void metrics_loop_wake(uint32_t busy_us);
+size_t metrics_render(char *out, size_t outlen);
+size_t metrics_render_link(char *out, size_t outlen);
+bool metrics_http_start(uint16_t port);
+void metrics_heap_baseline(void);
+void metrics_tick(uint32_t now_ms);
+
+#endif /* METRICS_H */
@@ -0,0 +1,551 @@
+/**
+ * @file mqtt_client.cpp
+ * @brief Implementação de um cliente MQTT 3.1.1 mínimo sobre @c WiFiClient.
+ *
+ * - Conexão de longa duração com sessão persistente (Clean Session = 0): o broker
+ *   guarda a sessão entre reconexões e as publicações sem PUBACK são reenviadas
+ *   com DUP ao reconectar.
+ * - Cada leitura vira um PUBLISH QoS 1 com o mesmo corpo "fieldN=valor&..." do
+ *   ThingSpeak; a janela de publicações sem PUBACK é limitada a @c MQTT_WINDOW.
+ * - Sem alocação dinâmica: janela, buffers de TX/RX e configuração são estáticos.
+ */
+
+#include "mqtt_client.h"
+#include <WiFi.h>
+#include <string.h>
+#include "logger.h"
+#include "wifi_manager.h"
+
+/* Tipos de pacote (nibble alto do cabeçalho fixo) */
+#define MQTT_CONNECT        0x10
+#define MQTT_CONNACK        0x20
+#define MQTT_PUBLISH        0x30
+#define MQTT_PUBACK         0x40
+#define MQTT_PINGREQ        0xC0
+#define MQTT_PINGRESP       0xD0
+
+#define MQTT_QOS1           0x02
+#define MQTT_DUP            0x08
+
+/* Temporizações */
+#define MQTT_CONNECT_TIMEOUT_MS   3000
+#define MQTT_RECONNECT_MS         5000
+#define MQTT_ACK_TIMEOUT_MS       20000
+
+static const char *TAG = "MQTT";
+
+/**
+ * @brief Entrada da janela de publicações QoS 1.
+ */
+typedef struct
+{
+    bool used;        /* slot ocupado                        */
+    bool sent;        /* já enviado ao menos uma vez         */
+    uint16_t pid;     /* packet identifier                   */
+    uint8_t len;      /* tamanho do payload                  */
+    uint32_t sent_ms; /* instante do último envio            */
+    uint8_t payload[MQTT_MAX_PAYLOAD];
+} InflightSlot;
+
+static WiFiClient g_client;
+static char g_host[64];
+static uint16_t g_port = 1883;
+static char g_client_id[32];
+static char g_user[32];
+static char g_pass[64];
+static char g_topic[MQTT_MAX_TOPIC];
+static bool g_configured = false;
+static bool g_connected = false;
+static uint32_t g_next_connect_ms = 0;
+static uint32_t g_last_tx_ms = 0;
+static bool g_ping_outstanding = false;
+static uint32_t g_ping_sent_ms = 0;
+static uint16_t g_next_pid = 1;
+static InflightSlot g_win[MQTT_WINDOW];
+static MqttStats g_stats;
+static uint8_t g_tx[5 + 2 + MQTT_MAX_TOPIC + 2 + MQTT_MAX_PAYLOAD];
+
+/* Estado do leitor de pacotes recebidos */
+static uint8_t g_rx_type = 0;
+static uint32_t g_rx_rem = 0;
+static uint8_t g_rx_shift = 0;
+static uint8_t g_rx_stage = 0;  /* 0 = tipo, 1 = comprimento, 2 = corpo */
+static uint8_t g_rx_buf[4];
+static uint8_t g_rx_n = 0;
+
+/****************************** Funções privadas ******************************/
+
+/**
+ * @brief Codifica o "remaining length" do cabeçalho fixo.
+ * @return Número de bytes escritos (1..4).
+ */
+static size_t put_rem_len(uint8_t *p, uint32_t len)
+{
+    size_t n = 0;
+
+    do
+    {
+        uint8_t b = (uint8_t)(len & 0x7F);
+        len >>= 7;
+        p[n++] = len ? (uint8_t)(b | 0x80) : b;
+    } while (len && n < 4);
+
+    return n;
+}
+
+/**
+ * @brief Escreve uma string MQTT (comprimento u16 big-endian + bytes).
+ * @return Número de bytes escritos.
+ */
+static size_t put_str(uint8_t *p, const char *s)
+{
+    const size_t n = strlen(s);
+    p[0] = (uint8_t)(n >> 8);
+    p[1] = (uint8_t)n;
+    memcpy(p + 2, s, n);
+    return n + 2;
+}
+
+/**
+ * @brief Envia bytes pelo socket e contabiliza.
+ * @return true se todos os bytes foram aceitos.
+ */
+static bool send_raw(const uint8_t *buf, size_t len, uint32_t now_ms)
+{
+    const size_t n = g_client.write(buf, len);
+    g_stats.bytes_out += (uint32_t)n;
+    g_last_tx_ms = now_ms;
+    return n == len;
+}
+
+/**
+ * @brief Fecha a conexão; a janela é preservada para reenvio na próxima sessão.
+ */
+static void drop_connection(const char *why, uint32_t now_ms)
+{
+    if (g_connected)
+    {
+        LOG(TAG, "conexao encerrada (%s), %u em voo", why, (unsigned)g_stats.inflight);
+    }
+
+    g_client.stop();
+    g_connected = false;
+    g_ping_outstanding = false;
+    g_rx_stage = 0;
+    g_next_connect_ms = now_ms + MQTT_RECONNECT_MS;
+}
+
+/**
+ * @brief Envia (ou reenvia, com DUP) o PUBLISH QoS 1 de um slot.
+ */
+static bool send_publish(InflightSlot *s, uint32_t now_ms)
+{
+    const bool dup = s->sent;
+    const uint32_t rem = 2u + (uint32_t)strlen(g_topic) + 2u + s->len;
+    size_t n = 0;
+
+    g_tx[n++] = (uint8_t)(MQTT_PUBLISH | MQTT_QOS1 | (dup ? MQTT_DUP : 0));
+    n += put_rem_len(&g_tx[n], rem);
+    n += put_str(&g_tx[n], g_topic);
+    g_tx[n++] = (uint8_t)(s->pid >> 8);
+    g_tx[n++] = (uint8_t)s->pid;
+    memcpy(&g_tx[n], s->payload, s->len);
+    n += s->len;
+
+    if (!send_raw(g_tx, n, now_ms))
+    {
+        return false;
+    }
+
+    if (dup)
+    {
+        g_stats.retransmitted++;
+    }
+    else
+    {
+        g_stats.published++;
+    }
+
+    s->sent = true;
+    s->sent_ms = now_ms;
+    return true;
+}
+
+/**
+ * @brief Envia os slots pendentes (na reconexão, reenvia também os já enviados).
+ * @param include_sent Reenviar os que aguardam PUBACK da sessão anterior.
+ */
+static void flush_window(bool include_sent, uint32_t now_ms)
+{
+    for (uint8_t i = 0; i < MQTT_WINDOW && g_connected; ++i)
+    {
+        InflightSlot *s = &g_win[i];
+
+        if (s->used && (!s->sent || include_sent) && !send_publish(s, now_ms))
+        {
+            drop_connection("falha de escrita", now_ms);
+        }
+    }
+}
+
+/**
+ * @brief Trata um pacote completo recebido do broker.
+ */
+static void handle_packet(uint8_t type, const uint8_t *body, uint8_t n)
+{
+    if ((type & 0xF0) == MQTT_PUBACK && n >= 2)
+    {
+        const uint16_t pid = (uint16_t)((body[0] << 8) | body[1]);
+
+        for (uint8_t i = 0; i < MQTT_WINDOW; ++i)
+        {
+            if (g_win[i].used && g_win[i].pid == pid)
+            {
+                g_win[i].used = false;
+                g_stats.inflight--;
+                g_stats.acked++;
+                break;
+            }
+        }
+    }
+    else if ((type & 0xF0) == MQTT_PINGRESP)
+    {
+        g_ping_outstanding = false;
+    }
+}
+
+/**
+ * @brief Lê e processa os bytes disponíveis no socket, sem bloquear.
+ *
+ * @details Apenas os 4 primeiros bytes do corpo são guardados (suficiente para
+ *          CONNACK/PUBACK); o restante de pacotes inesperados é descartado.
+ * @return Tipo do último pacote completo recebido, ou 0.
+ */
+static uint8_t rx_poll(void)
+{
+    uint8_t last = 0;
+
+    while (g_client.available() > 0)
+    {
+        const int c = g_client.read();
+
+        if (c < 0)
+        {
+            break;
+        }
+
+        const uint8_t b = (uint8_t)c;
+
+        if (g_rx_stage == 0)
+        {
+            g_rx_type = b;
+            g_rx_rem = 0;
+            g_rx_shift = 0;
+            g_rx_n = 0;
+            g_rx_stage = 1;
+            continue;
+        }
+
+        if (g_rx_stage == 1)
+        {
+            g_rx_rem |= (uint32_t)(b & 0x7F) << g_rx_shift;
+            g_rx_shift += 7;
+
+            if (b & 0x80)
+            {
+                continue;
+            }
+
+            g_rx_stage = 2;
+        }
+        else
+        {
+            if (g_rx_n < sizeof(g_rx_buf))
+            {
+                g_rx_buf[g_rx_n] = b;
+            }
+
+            g_rx_n++;
+            g_rx_rem--;
+        }
+
+        if (g_rx_stage == 2 && g_rx_rem == 0)
+        {
+            const uint8_t kept = (g_rx_n < sizeof(g_rx_buf)) ? g_rx_n : sizeof(g_rx_buf);
+            handle_packet(g_rx_type, g_rx_buf, kept);
+            last = g_rx_type;
+            g_rx_stage = 0;
+        }
+    }
+
+    return last;
+}
+
+/**
+ * @brief Abre o socket, envia CONNECT (sessão persistente) e aguarda o CONNACK.
+ * @return true se o broker aceitou a conexão.
+ */
+static bool do_connect(uint32_t now_ms)
+{
+    if (!g_client.connect(g_host, g_port, MQTT_CONNECT_TIMEOUT_MS))
+    {
+        LOG(TAG, "TCP %s:%u falhou", g_host, (unsigned)g_port);
+        return false;
+    }
+
+    g_client.setNoDelay(true);
+    uint8_t flags = 0x00;  /* Clean Session = 0: retoma a sessão no broker */
+    uint32_t rem = 10u + 2u + (uint32_t)strlen(g_client_id);
+
+    if (g_user[0])
+    {
+        flags |= 0x80;
+        rem += 2u + (uint32_t)strlen(g_user);
+    }
+
+    if (g_pass[0])
+    {
+        flags |= 0x40;
+        rem += 2u + (uint32_t)strlen(g_pass);
+    }
+
+    size_t n = 0;
+    g_tx[n++] = MQTT_CONNECT;
+    n += put_rem_len(&g_tx[n], rem);
+    n += put_str(&g_tx[n], "MQTT");
+    g_tx[n++] = 4;  /* nível de protocolo 3.1.1 */
+    g_tx[n++] = flags;
+    g_tx[n++] = (uint8_t)(MQTT_KEEPALIVE_S >> 8);
+    g_tx[n++] = (uint8_t)MQTT_KEEPALIVE_S;
+    n += put_str(&g_tx[n], g_client_id);
+
+    if (g_user[0])
+    {
+        n += put_str(&g_tx[n], g_user);
+    }
+
+    if (g_pass[0])
+    {
+        n += put_str(&g_tx[n], g_pass);
+    }
+
+    g_rx_stage = 0;
+
+    if (!send_raw(g_tx, n, now_ms))
+    {
+        g_client.stop();
+        return false;
+    }
+
+    const uint32_t t0 = millis();
+
+    while ((millis() - t0) < MQTT_CONNECT_TIMEOUT_MS)
+    {
+        if ((rx_poll() & 0xF0) == MQTT_CONNACK)
+        {
+            const bool session_present = (g_rx_buf[0] & 0x01) != 0;
+            const uint8_t rc = g_rx_buf[1];
+
+            if (rc != 0)
+            {
+                LOG(TAG, "CONNACK recusado (rc=%u)", (unsigned)rc);
+                g_client.stop();
+                return false;
+            }
+
+            g_stats.connects++;
+            g_stats.resumed += session_present ? 1u : 0u;
+            LOG(TAG, "conectado a %s:%u (sessao %s, %u em voo)", g_host, (unsigned)g_port,
+                session_present ? "retomada" : "nova", (unsigned)g_stats.inflight);
+            return true;
+        }
+
+        delay(10);
+    }
+
+    LOG(TAG, "CONNACK nao recebido");
+    g_client.stop();
+    return false;
+}
+
+/****************************** Funções públicas ******************************/
+
+/**
+ * @brief Configura o cliente; a conexão é feita em @c mqtt_tick() quando houver Wi-Fi.
+ * @param host Endereço do broker.
+ * @param port Porta TCP do broker.
+ * @param client_id Identificador do cliente (chave da sessão persistente).
+ * @param user Usuário (opcional, @c nullptr ou vazio para omitir).
+ * @param pass Senha (opcional).
+ * @param topic Tópico de publicação das leituras.
+ */
+void mqtt_begin(const char *host, uint16_t port, const char *client_id,
+                const char *user, const char *pass, const char *topic)
+{
+    strlcpy(g_host, host ? host : "", sizeof(g_host));
+    strlcpy(g_client_id, client_id ? client_id : "", sizeof(g_client_id));
+    strlcpy(g_user, user ? user : "", sizeof(g_user));
+    strlcpy(g_pass, pass ? pass : "", sizeof(g_pass));
+    strlcpy(g_topic, topic ? topic : "", sizeof(g_topic));
+    g_port = port;
+    g_configured = g_host[0] && g_client_id[0] && g_topic[0];
+    memset(g_win, 0, sizeof(g_win));
+    memset(&g_stats, 0, sizeof(g_stats));
+    LOG(TAG, "init (broker=%s:%u, topico=%s)", g_host, (unsigned)g_port, g_topic);
+}
+
+/**
+ * @brief Coloca uma leitura na janela QoS 1 e a publica se houver sessão.
+ * @param r Leitura decodificada.
+ * @return true se aceita; false se a janela estiver cheia (nada é descartado da janela).
+ */
+bool mqtt_publish_reading(const SensorReading *r)
+{
+    if (!g_configured)
+    {
+        return false;
+    }
+
+    InflightSlot *slot = nullptr;
+
+    for (uint8_t i = 0; i < MQTT_WINDOW; ++i)
+    {
+        if (!g_win[i].used)
+        {
+            slot = &g_win[i];
+            break;
+        }
+    }
+
+    if (!slot)
+    {
+        g_stats.rejected++;
+        return false;
+    }
+
+    const size_t len = payload_schema_upload_fields(r, (char *)slot->payload,
+                                                    sizeof(slot->payload));
+
+    if (len == 0)
+    {
+        return false;
+    }
+
+    slot->used = true;
+    slot->sent = false;
+    slot->len = (uint8_t)len;
+    slot->pid = g_next_pid;
+    g_next_pid = (g_next_pid == 0xFFFF) ? 1 : (uint16_t)(g_next_pid + 1);
+    g_stats.inflight++;
+
+    const uint32_t now = millis();
+
+    if (g_connected && !send_publish(slot, now))
+    {
+        drop_connection("falha de escrita", now);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Mantém a sessão: conexão/reconexão, PUBACKs, keep-alive e envio pendente.
+ * @param now_ms Tempo corrente (millis()).
+ */
+void mqtt_tick(uint32_t now_ms)
+{
+    if (!g_configured)
+    {
+        return;
+    }
+
+    if (!wifi_is_connected())
+    {
+        if (g_connected)
+        {
+            drop_connection("sem Wi-Fi", now_ms);
+        }
+
+        return;
+    }
+
+    if (!g_connected)
+    {
+        if ((int32_t)(now_ms - g_next_connect_ms) < 0)
+        {
+            return;
+        }
+
+        g_connected = do_connect(now_ms);
+
+        if (!g_connected)
+        {
+            g_next_connect_ms = now_ms + MQTT_RECONNECT_MS;
+            return;
+        }
+
+        g_ping_outstanding = false;
+        flush_window(true, now_ms);
+        return;
+    }
+
+    if (!g_client.connected())
+    {
+        drop_connection("socket fechado", now_ms);
+        return;
+    }
+
+    (void)rx_poll();
+
+    if (g_ping_outstanding && (now_ms - g_ping_sent_ms) > MQTT_KEEPALIVE_S * 1000u)
+    {
+        drop_connection("PINGRESP ausente", now_ms);
+        return;
+    }
+
+    if (!g_ping_outstanding && (now_ms - g_last_tx_ms) >= MQTT_KEEPALIVE_S * 500u)
+    {
+        const uint8_t ping[2] = {MQTT_PINGREQ, 0x00};
+
+        if (!send_raw(ping, sizeof(ping), now_ms))
+        {
+            drop_connection("falha de escrita", now_ms);
+            return;
+        }
+
+        g_ping_outstanding = true;
+        g_ping_sent_ms = now_ms;
+    }
+
+    for (uint8_t i = 0; i < MQTT_WINDOW; ++i)
+    {
+        if (g_win[i].used && g_win[i].sent && (now_ms - g_win[i].sent_ms) > MQTT_ACK_TIMEOUT_MS)
+        {
+            /* Em 3.1.1 o reenvio ocorre na reconexão; derruba a sessão para forçá-lo. */
+            drop_connection("PUBACK atrasado", now_ms);
+            return;
+        }
+    }
+
+    flush_window(false, now_ms);
+}
+
+/**
+ * @brief Informa se há sessão MQTT ativa.
+ */
+bool mqtt_is_connected(void)
+{
+    return g_connected;
+}
+
+/**
+ * @brief Copia os contadores do cliente.
+ * @param out Estrutura de destino.
+ */
+void mqtt_get_stats(MqttStats *out)
+{
+    if (out)
+    {
+        *out = g_stats;
+    }
+}
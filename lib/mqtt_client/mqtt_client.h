@@ -0,0 +1,40 @@
+/**
+ * @file mqtt_client.h
+ * @brief Cabeçalho para o cliente MQTT 3.1.1 mínimo (QoS 1, sessão persistente).
+ */
+
+#ifndef MQTT_CLIENT_H
+#define MQTT_CLIENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "payload_schema.h"
+
+#define MQTT_WINDOW         8     /* publicações QoS 1 aguardando PUBACK */
+#define MQTT_MAX_PAYLOAD    128
+#define MQTT_MAX_TOPIC      64
+#define MQTT_KEEPALIVE_S    60
+
+/**
+ * @brief Contadores do cliente MQTT.
+ */
+typedef struct
+{
+    uint32_t published;      /* PUBLISH enviados pela primeira vez        */
+    uint32_t acked;          /* PUBACK recebidos                          */
+    uint32_t retransmitted;  /* reenvios com DUP após reconexão           */
+    uint32_t rejected;       /* leituras recusadas por janela cheia       */
+    uint32_t connects;       /* sessões estabelecidas (CONNACK aceito)    */
+    uint32_t resumed;        /* CONNACK com sessão presente               */
+    uint32_t bytes_out;      /* bytes MQTT enviados (cabeçalhos + dados)  */
+    uint8_t inflight;        /* ocupação atual da janela                  */
+} MqttStats;
+
+void mqtt_begin(const char *host, uint16_t port, const char *client_id,
+                const char *user, const char *pass, const char *topic);
+bool mqtt_publish_reading(const SensorReading *r);
+void mqtt_tick(uint32_t now_ms);
+bool mqtt_is_connected(void);
+void mqtt_get_stats(MqttStats *out);
+
+#endif /* MQTT_CLIENT_H */
@@ -0,0 +1,244 @@
+/**
+ * @file payload_schema.cpp
+ * @brief Implementação das tabelas de campos do payload e das rotinas de parse, log e upload.
+ */
+
+#include "payload_schema.h"
+#include "fmt.h"
+#include "logger.h"
+#include "sx1278_lora.h"
+#include "utils.h"
+
+/**
+ * @brief Versão 1: layout de @c PayloadPacked (11 bytes), enviado sem byte de versão.
+ *
+ * Para adicionar um campo, acrescente uma linha e ajuste @c body_len da versão.
+ */
+static constexpr FieldDesc kFieldsV1[] = {
+    /* rótulo         unid.    off  tipo       exp  log  up   sent.  valor   fieldN */
+    {"Irradiancia", "W/m^2", 0, FIELD_U16, 0, 0, 1, true, 0xFFFF, 1},
+    {"Bateria", "V", 2, FIELD_U16, 3, 3, 3, false, 0, 2},
+    {"Temp. int.", "C", 4, FIELD_I16, 1, 1, 1, false, 0, 3},
+    {"Timestamp", "s", 6, FIELD_U32, 0, 0, 0, false, 0, 4},
+};
+
+static_assert(kFieldsV1[0].offset == offsetof(PayloadPacked, irradiance), "offset irradiance");
+static_assert(kFieldsV1[1].offset == offsetof(PayloadPacked, battery_voltage), "offset bateria");
+static_assert(kFieldsV1[2].offset == offsetof(PayloadPacked, internal_temperature), "offset temp");
+static_assert(kFieldsV1[3].offset == offsetof(PayloadPacked, timestamp), "offset timestamp");
+
+#define N_FIELDS(tbl) (sizeof(tbl) / sizeof((tbl)[0]))
+
+/**
+ * @brief Versões conhecidas. A primeira entrada também é aceita sem byte de versão
+ *        (formato legado, identificado pelo tamanho).
+ */
+static const PayloadSchema kSchemas[] = {
+    {1, sizeof(PayloadPacked), N_FIELDS(kFieldsV1), 3, kFieldsV1,
+     schema_decode<kFieldsV1, N_FIELDS(kFieldsV1)>},
+};
+
+/* Maior par "&fieldN=valor" gerado por campo. */
+#define UPLOAD_PAIR_MAX (10 + FMT_FIXED_MAX)
+static_assert(SCHEMA_MAX_FIELDS * UPLOAD_PAIR_MAX < SCHEMA_UPLOAD_MAX,
+              "SCHEMA_UPLOAD_MAX nao comporta todos os pares de upload");
+
+/****************************** Funções privadas ******************************/
+
+/**
+ * @brief Retorna o tamanho do cabeçalho de versão presente no quadro.
+ * @param s Schema selecionado.
+ * @param len Tamanho do quadro.
+ * @return 0 para o formato legado (sem versão) ou 1.
+ */
+static inline size_t header_len(const PayloadSchema *s, size_t len)
+{
+    return (len == s->body_len) ? 0 : 1;
+}
+
+
+/****************************** Funções públicas ******************************/
+
+/**
+ * @brief Seleciona o schema de um quadro já descriptografado.
+ * @param frame Quadro em claro.
+ * @param len Tamanho do quadro.
+ * @return Schema correspondente ou @c nullptr se tamanho/versão não forem reconhecidos.
+ */
+const PayloadSchema *payload_schema_select(const uint8_t *frame, size_t len)
+{
+    if (!frame || len == 0)
+    {
+        return nullptr;
+    }
+
+    if (len == kSchemas[0].body_len)
+    {
+        return &kSchemas[0];
+    }
+
+    const PayloadSchema *s = payload_schema_by_version(frame[0]);
+    return (s && len == (size_t)s->body_len + 1u) ? s : nullptr;
+}
+
+/**
+ * @brief Procura o schema pelo número de versão.
+ * @param version Versão desejada.
+ * @return Schema correspondente ou @c nullptr.
+ */
+const PayloadSchema *payload_schema_by_version(uint8_t version)
+{
+    for (size_t i = 0; i < N_FIELDS(kSchemas); ++i)
+    {
+        if (kSchemas[i].version == version)
+        {
+            return &kSchemas[i];
+        }
+    }
+
+    return nullptr;
+}
+
+/**
+ * @brief Valida o checksum e decodifica o quadro conforme o schema.
+ * @param s Schema retornado por @c payload_schema_select().
+ * @param frame Quadro em claro.
+ * @param len Tamanho do quadro.
+ * @param out Leitura a ser preenchida.
+ * @return true se o checksum conferir, false caso contrário.
+ */
+bool payload_schema_decode(const PayloadSchema *s, const uint8_t *frame, size_t len,
+                           SensorReading *out)
+{
+    if (!s || !frame || !out || len < s->body_len)
+    {
+        return false;
+    }
+
+    const size_t ck_off = len - 1u;
+
+    if (utils_checksum8(frame, ck_off) != frame[ck_off])
+    {
+        return false;
+    }
+
+    s->decode(frame + header_len(s, len), out);
+    out->version = s->version;
+    out->checksum = frame[ck_off];
+    out->source = 0;
+    out->timestamp = (uint32_t)out->value[s->ts_index];
+    return true;
+}
+
+/**
+ * @brief Escreve o valor físico de um campo em ponto fixo (sem float).
+ * @param f Descritor do campo.
+ * @param v Valor bruto.
+ * @param decimals Casas decimais.
+ * @param out Buffer de saída (até @c FMT_FIXED_MAX caracteres).
+ * @return Ponteiro após o último caractere escrito.
+ */
+char *payload_schema_render(const FieldDesc *f, int32_t v, uint8_t decimals, char *out)
+{
+    if (f->type == FIELD_U32)
+    {
+        return fmt_u32(out, (uint32_t)v);
+    }
+
+    return fmt_fixed(out, v, f->scale_exp, decimals);
+}
+
+/**
+ * @brief Informa se o campo @p idx contém o valor sentinela de erro.
+ */
+bool payload_schema_field_error(const SensorReading *r, uint8_t idx)
+{
+    return (r->error_mask >> idx) & 1u;
+}
+
+/**
+ * @brief Loga os campos decodificados de uma leitura.
+ * @param tag Rótulo do subsistema usado no log.
+ * @param r Leitura decodificada.
+ */
+void payload_schema_log(const char *tag, const SensorReading *r)
+{
+    const PayloadSchema *s = payload_schema_by_version(r->version);
+
+    if (!s)
+    {
+        return;
+    }
+
+    LOG(tag, "---- Pacote decodificado ----");
+
+    for (uint8_t i = 0; i < s->n_fields; ++i)
+    {
+        const FieldDesc *f = &s->fields[i];
+
+        if (payload_schema_field_error(r, i))
+        {
+            LOG(tag, "%-12s: ERRO (0x%lX)", f->label, (unsigned long)f->sentinel);
+            continue;
+        }
+
+        char v[FMT_FIXED_MAX + 1];
+        *payload_schema_render(f, r->value[i], f->log_decimals, v) = '\0';
+        LOG(tag, "%-12s: %s %s", f->label, v, f->unit);
+    }
+
+    LOG(tag, "%-12s: 0x%02X", "Checksum", r->checksum);
+    LOG(tag, "-----------------------------");
+}
+
+/**
+ * @brief Monta os pares "fieldN=valor" de upload, separados por '&'.
+ * @param r Leitura decodificada.
+ * @param out Buffer de saída.
+ * @param outlen Tamanho do buffer @p out.
+ * @return Número de caracteres escritos (sem o terminador); 0 em caso de erro.
+ *
+ * @note Campos com valor sentinela são enviados como -1.
+ */
+size_t payload_schema_upload_fields(const SensorReading *r, char *out, size_t outlen)
+{
+    const PayloadSchema *s = payload_schema_by_version(r->version);
+
+    if (!s || !out || outlen == 0)
+    {
+        return 0;
+    }
+
+    char *p = out;
+
+    for (uint8_t i = 0; i < s->n_fields; ++i)
+    {
+        const FieldDesc *f = &s->fields[i];
+
+        if (f->upload_field == 0)
+        {
+            continue;
+        }
+
+        if (outlen - (size_t)(p - out) <= UPLOAD_PAIR_MAX)
+        {
+            out[0] = '\0';
+            return 0;
+        }
+
+        if (p != out)
+        {
+            *p++ = '&';
+        }
+
+        p = fmt_str(p, "field");
+        p = fmt_u32(p, f->upload_field);
+        *p++ = '=';
+        p = payload_schema_field_error(r, i)
+                ? fmt_fixed(p, -1, 0, f->upload_decimals)
+                : payload_schema_render(f, r->value[i], f->upload_decimals, p);
+    }
+
+    *p = '\0';
+    return (size_t)(p - out);
+}
@@ -0,0 +1,160 @@
+/**
+ * @file payload_schema.h
+ * @brief Cabeçalho para a descrição, em tempo de compilação, dos campos do payload LoRa.
+ *
+ * Cada versão de payload é descrita por uma tabela @c constexpr de @c FieldDesc
+ * (offset, tipo, escala, sentinela de erro e campo de upload). O parse, o log e o
+ * corpo de upload são gerados a partir dessa tabela, de modo que adicionar um campo
+ * de sensor é uma linha na tabela da versão correspondente.
+ */
+
+#ifndef PAYLOAD_SCHEMA_H
+#define PAYLOAD_SCHEMA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define SCHEMA_MAX_FIELDS 8
+/* Buffer suficiente para o corpo de upload de qualquer versão (com terminador). */
+#define SCHEMA_UPLOAD_MAX (SCHEMA_MAX_FIELDS * 32 + 1)
+
+/**
+ * @brief Tipo (largura/sinal) do valor bruto de um campo, sempre little-endian.
+ */
+typedef enum : uint8_t
+{
+    FIELD_U8,
+    FIELD_U16,
+    FIELD_I16,
+    FIELD_U32
+} FieldType;
+
+/**
+ * @brief Descritor de um campo do payload.
+ *
+ * O valor físico é @c bruto / 10^scale_exp; @c log_decimals e @c upload_decimals
+ * definem quantas casas decimais são exibidas no log e enviadas ao canal IoT.
+ */
+typedef struct
+{
+    const char *label;       /* rótulo no log (até 12 caracteres)      */
+    const char *unit;        /* unidade física                         */
+    uint8_t offset;          /* deslocamento no corpo, em bytes        */
+    FieldType type;          /* tipo do valor bruto                    */
+    uint8_t scale_exp;       /* físico = bruto / 10^scale_exp          */
+    uint8_t log_decimals;    /* casas decimais no log                  */
+    uint8_t upload_decimals; /* casas decimais no upload               */
+    bool has_sentinel;       /* campo possui valor de erro             */
+    uint32_t sentinel;       /* valor bruto que indica erro do sensor  */
+    uint8_t upload_field;    /* fieldN do ThingSpeak (0 = não enviar)  */
+} FieldDesc;
+
+/**
+ * @brief Leitura decodificada, independente da versão do payload.
+ */
+typedef struct
+{
+    uint8_t version;                   /* versão do schema de origem            */
+    uint8_t checksum;                  /* checksum recebido                     */
+    uint16_t source;                   /* nó de origem (0 = quadro sem id)      */
+    uint32_t error_mask;               /* bit i = campo i com valor sentinela   */
+    uint32_t timestamp;                /* timestamp do nó (s)                   */
+    int32_t value[SCHEMA_MAX_FIELDS];  /* valores brutos, na ordem da tabela    */
+} SensorReading;
+
+/**
+ * @brief Descrição de uma versão de payload.
+ */
+typedef struct
+{
+    uint8_t version;        /* byte de cabeçalho que seleciona a versão */
+    uint8_t body_len;       /* tamanho do corpo, incluindo o checksum   */
+    uint8_t n_fields;       /* número de entradas em @c fields          */
+    uint8_t ts_index;       /* índice do campo de timestamp             */
+    const FieldDesc *fields;
+    void (*decode)(const uint8_t *body, SensorReading *out);
+} PayloadSchema;
+
+/**
+ * @brief Leitores de valor bruto especializados por tipo.
+ */
+template <FieldType T> struct FieldReader;
+
+template <> struct FieldReader<FIELD_U8>
+{
+    static inline int32_t read(const uint8_t *b) { return (int32_t)b[0]; }
+};
+
+template <> struct FieldReader<FIELD_U16>
+{
+    static inline int32_t read(const uint8_t *b)
+    {
+        return (int32_t)((uint16_t)b[0] | ((uint16_t)b[1] << 8));
+    }
+};
+
+template <> struct FieldReader<FIELD_I16>
+{
+    static inline int32_t read(const uint8_t *b)
+    {
+        return (int32_t)(int16_t)((uint16_t)b[0] | ((uint16_t)b[1] << 8));
+    }
+};
+
+template <> struct FieldReader<FIELD_U32>
+{
+    static inline int32_t read(const uint8_t *b)
+    {
+        return (int32_t)((uint32_t)b[0] | ((uint32_t)b[1] << 8) |
+                         ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24));
+    }
+};
+
+/**
+ * @brief Expande, em tempo de compilação, a leitura de cada campo da tabela @p F.
+ *
+ * Cada campo vira uma leitura de offset fixo; a sentinela de erro é acumulada
+ * em @c error_mask sem desvios.
+ */
+template <const FieldDesc *F, size_t I, size_t N>
+struct SchemaDecoder
+{
+    static inline void run(const uint8_t *body, SensorReading *out)
+    {
+        const int32_t v = FieldReader<F[I].type>::read(body + F[I].offset);
+        out->value[I] = v;
+        out->error_mask |= (uint32_t)(F[I].has_sentinel && (uint32_t)v == F[I].sentinel) << I;
+        SchemaDecoder<F, I + 1, N>::run(body, out);
+    }
+};
+
+template <const FieldDesc *F, size_t N>
+struct SchemaDecoder<F, N, N>
+{
+    static inline void run(const uint8_t *, SensorReading *) {}
+};
+
+/**
+ * @brief Função de decodificação gerada para a tabela @p F com @p N campos.
+ * @param body Corpo do payload (sem byte de versão).
+ * @param out Leitura a ser preenchida.
+ */
+template <const FieldDesc *F, size_t N>
+void schema_decode(const uint8_t *body, SensorReading *out)
+{
+    static_assert(N <= SCHEMA_MAX_FIELDS, "Campos demais para SensorReading");
+    out->error_mask = 0;
+    SchemaDecoder<F, 0, N>::run(body, out);
+}
+
+const PayloadSchema *payload_schema_select(const uint8_t *frame, size_t len);
+const PayloadSchema *payload_schema_by_version(uint8_t version);
+bool payload_schema_decode(const PayloadSchema *s, const uint8_t *frame, size_t len,
+                           SensorReading *out);
+char *payload_schema_render(const FieldDesc *f, int32_t v, uint8_t decimals, char *out);
+bool payload_schema_field_error(const SensorReading *r, uint8_t idx);
+void payload_schema_log(const char *tag, const SensorReading *r);
+size_t payload_schema_upload_fields(const SensorReading *r, char *out, size_t outlen);
+
+#endif /* PAYLOAD_SCHEMA_H */
@@ -0,0 +1,412 @@
+/**
+ * @file record_log.cpp
+ * @brief Log circular de leituras em setores brutos: blocos de 512 B numerados e
+ *        com CRC, gravados só para frente, e recuperação da cabeça por busca binária.
+ *
+ * - As leituras se acumulam em um bloco na RAM; o bloco vai ao cartão quando enche
+ *   ou quando a mais antiga passa de @c RECLOG_FLUSH_MS (@c reclog_tick()). Cada
+ *   gravação é um setor novo: não há leitura-modificação-escrita, FAT, diretório
+ *   nem atualização de tamanho de arquivo.
+ * - O bloco de sequência @c s fica no índice @c s % blocos. Como a gravação é
+ *   sequencial, os índices 0..cabeça-1 têm a volta atual (@c s0 + i) e os demais,
+ *   a anterior ou nada; a primeira posição que quebra @c seq == s0 + i é a cabeça,
+ *   achada em O(log n) leituras. Uma gravação interrompida deixa o bloco com CRC
+ *   inválido, o que também a marca como cabeça: ela é simplesmente regravada.
+ * - Só a tarefa do sink chama as funções de escrita; os contadores são copiados
+ *   sob a seção crítica para as métricas.
+ */
+
+#include "record_log.h"
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <string.h>
+#include "logger.h"
+#include "sd_card.h"
+#include "utils.h"
+
+static const char *TAG = "RECLOG";
+
+#define RECLOG_BLOCK_MAGIC  0x474F4C52u   /* "RLOG" */
+#define RECLOG_SB_MAGIC     0x42534C52u   /* "RLSB" */
+#define RECLOG_SB_VERSION   1
+#define RECLOG_CRC_OFF      (RECLOG_SECTOR - 4)
+#define RECLOG_MIN_BLOCKS   8
+
+static_assert(RECLOG_PER_BLOCK >= 1, "Leitura maior que o bloco");
+
+static uint8_t g_block[RECLOG_SECTOR];     /* bloco em montagem          */
+static uint8_t g_io[RECLOG_SECTOR];        /* leituras do cartão         */
+static uint32_t g_log_id;
+static uint32_t g_pending_since_ms;
+static RecLogStats g_stats;
+static portMUX_TYPE g_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/****************************** Funções privadas ******************************/
+
+static inline uint32_t block_lba(uint32_t seq)
+{
+    return g_stats.part_start + 1u + seq % g_stats.blocks;
+}
+
+/**
+ * @brief Grava o CRC-32 de [0..508) nos últimos 4 bytes do setor.
+ */
+static void seal(uint8_t *sec)
+{
+    utils_wr_le_u32(sec + RECLOG_CRC_OFF, utils_crc32(sec, RECLOG_CRC_OFF));
+}
+
+static bool sealed(const uint8_t *sec)
+{
+    return utils_rd_le_u32(sec + RECLOG_CRC_OFF) == utils_crc32(sec, RECLOG_CRC_OFF);
+}
+
+/**
+ * @brief Lê o bloco de índice @p idx e devolve sua sequência se ele for válido.
+ */
+static bool probe(uint32_t idx, uint32_t *seq)
+{
+    if (!sdcard_read_raw(g_stats.part_start + 1u + idx, g_io) || !sealed(g_io) ||
+        utils_rd_le_u32(g_io) != RECLOG_BLOCK_MAGIC || utils_rd_le_u32(g_io + 4) != g_log_id)
+    {
+        return false;
+    }
+
+    const uint32_t s = utils_rd_le_u32(g_io + 8);
+    const uint8_t count = g_io[12];
+
+    if (s % g_stats.blocks != idx || count == 0 || count > RECLOG_PER_BLOCK)
+    {
+        return false;
+    }
+
+    *seq = s;
+    return true;
+}
+
+/**
+ * @brief Procura na MBR a partição do tipo @c RECLOG_PART_TYPE.
+ */
+static bool find_partition(uint32_t *start, uint32_t *sectors)
+{
+    if (!sdcard_read_raw(0, g_io) || g_io[510] != 0x55 || g_io[511] != 0xAA)
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < 4; ++i)
+    {
+        const uint8_t *e = g_io + 446 + 16 * i;
+
+        if (e[4] == RECLOG_PART_TYPE)
+        {
+            *start = utils_rd_le_u32(e + 8);
+            *sectors = utils_rd_le_u32(e + 12);
+            return *start != 0;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Valida o superbloco; se ausente ou de outro tamanho de partição, formata
+ *        com um id novo (os blocos antigos deixam de valer sem apagar o cartão).
+ */
+static bool load_superblock(void)
+{
+    if (!sdcard_read_raw(g_stats.part_start, g_io))
+    {
+        return false;
+    }
+
+    if (sealed(g_io) && utils_rd_le_u32(g_io) == RECLOG_SB_MAGIC &&
+        utils_rd_le_u32(g_io + 4) == RECLOG_SB_VERSION &&
+        utils_rd_le_u32(g_io + 12) == g_stats.blocks)
+    {
+        g_log_id = utils_rd_le_u32(g_io + 8);
+        return true;
+    }
+
+    g_log_id = esp_random();
+    memset(g_io, 0, sizeof(g_io));
+    utils_wr_le_u32(g_io, RECLOG_SB_MAGIC);
+    utils_wr_le_u32(g_io + 4, RECLOG_SB_VERSION);
+    utils_wr_le_u32(g_io + 8, g_log_id);
+    utils_wr_le_u32(g_io + 12, g_stats.blocks);
+    seal(g_io);
+    LOG(TAG, "Formatando a particao: %lu blocos, id 0x%08lX", (unsigned long)g_stats.blocks,
+        (unsigned long)g_log_id);
+    return sdcard_write_raw(g_stats.part_start, g_io);
+}
+
+/**
+ * @brief Acha a próxima sequência a gravar (ver o comentário do arquivo).
+ * @param reads Setores lidos na busca.
+ */
+static uint32_t recover_head(uint32_t *reads)
+{
+    const uint32_t n = g_stats.blocks;
+    uint32_t s0;
+    uint32_t s;
+
+    *reads = 1;
+
+    if (!probe(0, &s0))
+    {
+        /* Índice 0 vazio ou interrompido: a volta anterior termina no último índice. */
+        *reads = 2;
+        return probe(n - 1u, &s) ? s + 1u : 0;
+    }
+
+    uint32_t lo = 1;   /* primeiro índice ainda não confirmado */
+    uint32_t hi = n;   /* primeiro índice sabidamente fora da volta atual */
+
+    while (lo < hi)
+    {
+        const uint32_t mid = lo + (hi - lo) / 2u;
+        ++*reads;
+
+        if (probe(mid, &s) && s == s0 + mid)
+        {
+            lo = mid + 1u;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return s0 + lo;
+}
+
+static void encode(uint8_t *p, const SensorReading *r)
+{
+    p[0] = r->version;
+    p[1] = r->checksum;
+    utils_wr_le_u16(p + 2, r->source);
+    utils_wr_le_u32(p + 4, r->error_mask);
+    utils_wr_le_u32(p + 8, r->timestamp);
+
+    for (uint8_t i = 0; i < SCHEMA_MAX_FIELDS; ++i)
+    {
+        utils_wr_le_u32(p + 12 + 4 * i, (uint32_t)r->value[i]);
+    }
+}
+
+static void decode(const uint8_t *p, SensorReading *r)
+{
+    r->version = p[0];
+    r->checksum = p[1];
+    r->source = utils_rd_le_u16(p + 2);
+    r->error_mask = utils_rd_le_u32(p + 4);
+    r->timestamp = utils_rd_le_u32(p + 8);
+
+    for (uint8_t i = 0; i < SCHEMA_MAX_FIELDS; ++i)
+    {
+        r->value[i] = (int32_t)utils_rd_le_u32(p + 12 + 4 * i);
+    }
+}
+
+/****************************** Funções públicas ******************************/
+
+/**
+ * @brief Localiza a partição, valida ou formata o superbloco e recupera a cabeça.
+ * @return true se o log está pronto para @c reclog_append().
+ *
+ * @note O cartão precisa estar montado (@c sdcard_begin()); sem a partição na MBR
+ *       o log fica desligado e a função pode ser chamada de novo depois.
+ */
+bool reclog_open(void)
+{
+    if (g_stats.open)
+    {
+        return true;
+    }
+
+    uint32_t start = 0;
+    uint32_t sectors = 0;
+
+    if (!find_partition(&start, &sectors) || sectors < RECLOG_MIN_BLOCKS + 1u)
+    {
+        LOG(TAG, "Particao do tipo 0x%02X nao encontrada na MBR", (unsigned)RECLOG_PART_TYPE);
+        return false;
+    }
+
+    RecLogStats st;
+    memset(&st, 0, sizeof(st));
+    st.part_start = start;
+    st.blocks = sectors - 1u;
+
+    portENTER_CRITICAL(&g_mux);
+    g_stats = st;
+    portEXIT_CRITICAL(&g_mux);
+
+    if (!load_superblock())
+    {
+        LOG(TAG, "Falha ao ler/gravar o superbloco no setor %lu", (unsigned long)start);
+        return false;
+    }
+
+    uint32_t reads = 0;
+    const int64_t t0 = esp_timer_get_time();
+    const uint32_t next = recover_head(&reads);
+    const uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+
+    memset(g_block, 0, sizeof(g_block));
+
+    portENTER_CRITICAL(&g_mux);
+    g_stats.next_seq = next;
+    g_stats.oldest_seq = (next > g_stats.blocks) ? next - g_stats.blocks : 0;
+    g_stats.recovery_reads = reads;
+    g_stats.recovery_us = us;
+    g_stats.open = true;
+    portEXIT_CRITICAL(&g_mux);
+
+    LOG(TAG, "Particao no setor %lu, %lu blocos; proximo bloco %lu (%lu leituras de setor, "
+             "%lu us)",
+        (unsigned long)start, (unsigned long)g_stats.blocks, (unsigned long)next,
+        (unsigned long)reads, (unsigned long)us);
+    return true;
+}
+
+/**
+ * @brief Grava o bloco pendente e desliga o log (ferramentas de host e desmontagem).
+ */
+void reclog_close(void)
+{
+    if (g_stats.open)
+    {
+        (void)reclog_flush();
+    }
+
+    portENTER_CRITICAL(&g_mux);
+    g_stats.open = false;
+    portEXIT_CRITICAL(&g_mux);
+}
+
+/**
+ * @brief Acrescenta uma leitura ao bloco em RAM; grava o bloco quando ele enche.
+ * @return false se o log está fechado ou se o bloco cheio não pôde ser gravado
+ *         (a leitura não foi aceita e pode ser reenviada).
+ */
+bool reclog_append(const SensorReading *r)
+{
+    if (!g_stats.open)
+    {
+        return false;
+    }
+
+    if (g_stats.pending == RECLOG_PER_BLOCK && !reclog_flush())
+    {
+        return false;
+    }
+
+    if (g_stats.pending == 0)
+    {
+        g_pending_since_ms = millis();
+    }
+
+    encode(g_block + RECLOG_HDR_LEN + RECLOG_REC_LEN * g_stats.pending, r);
+
+    portENTER_CRITICAL(&g_mux);
+    g_stats.pending++;
+    g_stats.records++;
+    portEXIT_CRITICAL(&g_mux);
+
+    if (g_stats.pending == RECLOG_PER_BLOCK)
+    {
+        (void)reclog_flush();   /* em falha, fica na RAM e é tentado de novo */
+    }
+
+    return true;
+}
+
+/**
+ * @brief Grava o bloco pendente, mesmo incompleto, como um bloco novo.
+ * @return true se não havia nada pendente ou se a gravação funcionou.
+ */
+bool reclog_flush(void)
+{
+    if (!g_stats.open || g_stats.pending == 0)
+    {
+        return true;
+    }
+
+    const uint32_t seq = g_stats.next_seq;
+    utils_wr_le_u32(g_block, RECLOG_BLOCK_MAGIC);
+    utils_wr_le_u32(g_block + 4, g_log_id);
+    utils_wr_le_u32(g_block + 8, seq);
+    g_block[12] = g_stats.pending;
+    g_block[13] = RECLOG_REC_FORMAT;
+    g_block[14] = 0;
+    g_block[15] = 0;
+    seal(g_block);
+
+    if (!sdcard_write_raw(block_lba(seq), g_block))
+    {
+        portENTER_CRITICAL(&g_mux);
+        g_stats.write_errors++;
+        portEXIT_CRITICAL(&g_mux);
+        return false;
+    }
+
+    memset(g_block, 0, sizeof(g_block));
+
+    portENTER_CRITICAL(&g_mux);
+    g_stats.next_seq = seq + 1u;
+    g_stats.oldest_seq = (seq + 1u > g_stats.blocks) ? seq + 1u - g_stats.blocks : 0;
+    g_stats.block_writes++;
+    g_stats.pending = 0;
+    portEXIT_CRITICAL(&g_mux);
+    return true;
+}
+
+/**
+ * @brief Chamada pela tarefa do sink: grava o bloco parcial mais velho que
+ *        @c RECLOG_FLUSH_MS.
+ */
+void reclog_tick(uint32_t now_ms)
+{
+    if (g_stats.pending && (uint32_t)(now_ms - g_pending_since_ms) >= RECLOG_FLUSH_MS)
+    {
+        (void)reclog_flush();
+    }
+}
+
+/**
+ * @brief Lê o bloco de sequência @p seq (entre @c oldest_seq e @c next_seq - 1).
+ * @param out Destino de até @c RECLOG_PER_BLOCK leituras.
+ * @param count Leituras no bloco.
+ * @return false se o bloco está fora da janela, ilegível ou corrompido.
+ */
+bool reclog_read_block(uint32_t seq, SensorReading *out, uint8_t *count)
+{
+    uint32_t s;
+
+    if (!g_stats.open || seq < g_stats.oldest_seq || seq >= g_stats.next_seq ||
+        !probe(seq % g_stats.blocks, &s) || s != seq)
+    {
+        return false;
+    }
+
+    *count = g_io[12];
+
+    for (uint8_t i = 0; i < *count; ++i)
+    {
+        decode(g_io + RECLOG_HDR_LEN + RECLOG_REC_LEN * i, &out[i]);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Copia o estado e os contadores do log.
+ */
+void reclog_get_stats(RecLogStats *out)
+{
+    portENTER_CRITICAL(&g_mux);
+    *out = g_stats;
+    portEXIT_CRITICAL(&g_mux);
+}
@@ -0,0 +1,66 @@
+/**
+ * @file record_log.h
+ * @brief Cabeçalho para o log circular de leituras em setores brutos do SD, fora
+ *        do sistema de arquivos.
+ *
+ * Usa a partição da MBR do tipo @c RECLOG_PART_TYPE (criada ao lado do volume FAT,
+ * ex.: @c sfdisk com tipo @c da). Setor 0 da partição é o superbloco; os demais
+ * são blocos de 512 B gravados em ordem circular, um setor por gravação:
+ *
+ *   [0..3]     "RLOG"
+ *   [4..7]     id do log (do superbloco; blocos de uma formatação antiga não valem)
+ *   [8..11]    sequência do bloco (u32; posição = sequência % blocos)
+ *   [12]       leituras no bloco (1..RECLOG_PER_BLOCK)
+ *   [13]       formato da leitura (@c RECLOG_REC_FORMAT)
+ *   [14..15]   reservado
+ *   [16..]     leituras de @c RECLOG_REC_LEN bytes, little-endian:
+ *              versão u8, checksum u8, origem u16, máscara de erro u32,
+ *              timestamp u32, valor[SCHEMA_MAX_FIELDS] i32
+ *   [508..511] CRC-32 dos bytes 0..507
+ *
+ * Inteiros little-endian. Um bloco nunca é regravado na mesma volta: um flush
+ * parcial ocupa um bloco próprio. A cabeça é achada no boot por busca binária.
+ */
+
+#ifndef RECORD_LOG_H
+#define RECORD_LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "payload_schema.h"
+
+#define RECLOG_SECTOR       512
+#define RECLOG_PART_TYPE    0xDA     /* "dados sem sistema de arquivos" na MBR   */
+#define RECLOG_HDR_LEN      16
+#define RECLOG_REC_LEN      (12 + 4 * SCHEMA_MAX_FIELDS)
+#define RECLOG_PER_BLOCK    ((RECLOG_SECTOR - RECLOG_HDR_LEN - 4) / RECLOG_REC_LEN)
+#define RECLOG_REC_FORMAT   1
+#define RECLOG_FLUSH_MS     30000    /* idade máxima de leituras só na RAM       */
+
+/**
+ * @brief Estado e contadores do log.
+ */
+typedef struct
+{
+    bool open;                /* partição encontrada e cabeça recuperada      */
+    uint32_t part_start;      /* LBA da partição                              */
+    uint32_t blocks;          /* blocos de dados (setores - superbloco)       */
+    uint32_t next_seq;        /* sequência do próximo bloco                   */
+    uint32_t oldest_seq;      /* bloco mais antigo ainda no cartão            */
+    uint32_t recovery_reads;  /* setores lidos para achar a cabeça            */
+    uint32_t recovery_us;
+    uint32_t records;         /* leituras gravadas desde o boot               */
+    uint32_t block_writes;
+    uint32_t write_errors;
+    uint8_t pending;          /* leituras no bloco em RAM                     */
+} RecLogStats;
+
+bool reclog_open(void);
+void reclog_close(void);
+bool reclog_append(const SensorReading *r);
+bool reclog_flush(void);
+void reclog_tick(uint32_t now_ms);
+bool reclog_read_block(uint32_t seq, SensorReading *out, uint8_t *count);
+void reclog_get_stats(RecLogStats *out);
+
+#endif /* RECORD_LOG_H */
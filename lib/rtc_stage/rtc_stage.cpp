@@ -0,0 +1,364 @@
+/**
+ * @file rtc_stage.cpp
+ * @brief Anel de registros em @c RTC_NOINIT_ATTR, com CRC por registro.
+ *
+ * - O registro de sequência @c s ocupa o slot @c s % RTC_STAGE_SLOTS; um slot só é
+ *   válido se o CRC confere e a sequência gravada é a esperada, de modo que um
+ *   reset no meio de uma cópia invalida apenas aquele registro.
+ * - O cabeçalho guarda só a primeira sequência não confirmada (e seu complemento);
+ *   a próxima sequência livre é recalculada no boot a partir dos slots válidos.
+ */
+
+#include "rtc_stage.h"
+#include <esp_attr.h>
+#include <esp32/rom/crc.h>
+#include <freertos/FreeRTOS.h>
+#include <string.h>
+#include "sd_card.h"
+
+#define STAGE_MAGIC 0x52535447u  /* "RSTG" */
+
+/**
+ * @brief Tipos de registro.
+ */
+typedef enum : uint8_t
+{
+    STAGE_READING = 1,
+    STAGE_LOG = 2,
+} StageKind;
+
+/* Flag: a linha do registro foi descartada pelo anel do SD; falta regravá-la. */
+#define STAGE_UNLOGGED 0x0001u
+
+/**
+ * @brief Um registro no anel.
+ */
+typedef struct
+{
+    uint32_t seq;
+    uint32_t pos;        /* sdcard_write_pos() logo após o registro ir ao log */
+    uint8_t kind;
+    uint8_t len;         /* bytes de texto (STAGE_LOG)                         */
+    uint16_t flags;      /* STAGE_UNLOGGED                                     */
+    union
+    {
+        SensorReading reading;
+        char text[RTC_STAGE_TEXT_MAX];
+    } u;
+    uint32_t crc;        /* crc32 de todos os campos anteriores                */
+} StageSlot;
+
+/**
+ * @brief Cabeçalho: primeira sequência não confirmada.
+ */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t commit_seq;
+    uint32_t commit_inv;  /* ~commit_seq */
+} StageHeader;
+
+RTC_NOINIT_ATTR static StageHeader g_hdr;
+RTC_NOINIT_ATTR static StageSlot g_slots[RTC_STAGE_SLOTS];
+
+static portMUX_TYPE g_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t g_next_seq = 0;
+static uint32_t g_replay_from = 0;
+static uint32_t g_replay_to = 0;
+static RtcStageStats g_stats;
+
+/****************************** Funções privadas ******************************/
+
+static uint32_t slot_crc(const StageSlot *s)
+{
+    return crc32_le(0, (const uint8_t *)s, (uint32_t)offsetof(StageSlot, crc));
+}
+
+/**
+ * @brief Informa se o slot contém um registro íntegro de sequência @p seq.
+ */
+static bool slot_valid(const StageSlot *s, uint32_t seq)
+{
+    return s->seq == seq && (s->kind == STAGE_READING || s->kind == STAGE_LOG) &&
+           s->crc == slot_crc(s);
+}
+
+static void set_commit(uint32_t seq)
+{
+    g_hdr.commit_seq = seq;
+    g_hdr.commit_inv = ~seq;
+}
+
+/**
+ * @brief Grava um registro na próxima sequência (chamada com @c g_mux).
+ */
+static void stage_put(StageSlot *tmp)
+{
+    if (g_next_seq - g_hdr.commit_seq >= RTC_STAGE_SLOTS)
+    {
+        /* O mais antigo ainda não confirmado vai ser sobrescrito. */
+        set_commit(g_next_seq - RTC_STAGE_SLOTS + 1u);
+        g_stats.lost++;
+    }
+
+    tmp->seq = g_next_seq;
+    tmp->crc = slot_crc(tmp);
+    memcpy(&g_slots[g_next_seq % RTC_STAGE_SLOTS], tmp, sizeof(*tmp));
+    g_next_seq++;
+    g_stats.staged++;
+}
+
+/**
+ * @brief Grava de novo no log a linha de um registro que o anel do SD descartou.
+ * @return true se o SD aceitou a linha desta vez.
+ */
+static bool relog_slot(const StageSlot *s, bool (*relog)(const SensorReading *r))
+{
+    if (s->kind == STAGE_LOG)
+    {
+        return sdcard_write(s->u.text, s->len);
+    }
+
+    return relog && relog(&s->u.reading);
+}
+
+/****************************** Funções públicas ******************************/
+
+/**
+ * @brief Valida o anel herdado do boot anterior; deve ser chamada antes de
+ *        qualquer registro desta sessão.
+ * @return Número de registros não confirmados a repassar com @c rtc_stage_replay().
+ *
+ * @note Após um power-on a memória RTC tem conteúdo arbitrário; cabeçalho inválido
+ *       zera o anel.
+ */
+uint16_t rtc_stage_begin(void)
+{
+    memset(&g_stats, 0, sizeof(g_stats));
+
+    if (g_hdr.magic != STAGE_MAGIC || g_hdr.commit_inv != ~g_hdr.commit_seq)
+    {
+        memset(g_slots, 0, sizeof(g_slots));
+        g_hdr.magic = STAGE_MAGIC;
+        set_commit(0);
+        g_next_seq = g_replay_from = g_replay_to = 0;
+        return 0;
+    }
+
+    /* Pendentes: até a maior sequência válida na janela; slots corrompidos por um
+       reset no meio da cópia são pulados no replay. */
+    uint32_t end = g_hdr.commit_seq;
+    uint16_t valid = 0;
+
+    for (uint32_t seq = g_hdr.commit_seq; seq - g_hdr.commit_seq < RTC_STAGE_SLOTS; ++seq)
+    {
+        if (slot_valid(&g_slots[seq % RTC_STAGE_SLOTS], seq))
+        {
+            end = seq + 1u;
+            valid++;
+        }
+    }
+
+    g_replay_from = g_hdr.commit_seq;
+    g_replay_to = end;
+    g_next_seq = end;
+    return valid;
+}
+
+/**
+ * @brief Copia uma leitura decodificada para o estágio.
+ * @param r Leitura; deve ser chamada depois de a leitura ir ao log do SD.
+ * @param logged false se alguma linha da leitura foi descartada pelo anel do SD;
+ *               o registro então não é confirmado até ser regravado.
+ */
+void rtc_stage_reading(const SensorReading *r, bool logged)
+{
+    StageSlot tmp;
+    memset(&tmp, 0, sizeof(tmp));
+    tmp.kind = STAGE_READING;
+    tmp.flags = logged ? 0 : STAGE_UNLOGGED;
+    tmp.pos = sdcard_write_pos();
+    tmp.u.reading = *r;
+
+    portENTER_CRITICAL(&g_mux);
+    stage_put(&tmp);
+    portEXIT_CRITICAL(&g_mux);
+}
+
+/**
+ * @brief Copia uma linha de log crítica (já enviada ao SD) para o estágio.
+ * @param line Linha formatada, com '\n' final; truncada em @c RTC_STAGE_TEXT_MAX.
+ * @param len Tamanho de @p line.
+ * @param logged false se o anel do SD descartou a linha.
+ */
+void rtc_stage_log(const char *line, size_t len, bool logged)
+{
+    StageSlot tmp;
+    memset(&tmp, 0, sizeof(tmp));
+    tmp.kind = STAGE_LOG;
+    tmp.flags = logged ? 0 : STAGE_UNLOGGED;
+    tmp.pos = sdcard_write_pos();
+    tmp.len = (uint8_t)((len < RTC_STAGE_TEXT_MAX) ? len : RTC_STAGE_TEXT_MAX);
+    memcpy(tmp.u.text, line, tmp.len);
+
+    if (tmp.len && tmp.u.text[tmp.len - 1] != '\n')
+    {
+        tmp.u.text[tmp.len - 1] = '\n';
+    }
+
+    portENTER_CRITICAL(&g_mux);
+    stage_put(&tmp);
+    portEXIT_CRITICAL(&g_mux);
+}
+
+/**
+ * @brief Repassa os registros não confirmados do boot anterior, em ordem.
+ * @param on_reading Destino das leituras (log no SD e sinks de uplink).
+ * @param on_log Destino das linhas de log (arquivo do SD).
+ * @return Número de registros repassados.
+ *
+ * @details Cada registro repassado é novamente estagiado com a posição atual do
+ *          log, ficando protegido até o próximo flush desta sessão.
+ */
+uint16_t rtc_stage_replay(void (*on_reading)(const SensorReading *r),
+                          void (*on_log)(const char *line, size_t len))
+{
+    uint16_t n = 0;
+
+    for (uint32_t seq = g_replay_from; seq != g_replay_to; ++seq)
+    {
+        StageSlot tmp;
+
+        portENTER_CRITICAL(&g_mux);
+        const bool ok = slot_valid(&g_slots[seq % RTC_STAGE_SLOTS], seq);
+        memcpy(&tmp, &g_slots[seq % RTC_STAGE_SLOTS], sizeof(tmp));
+
+        if ((int32_t)(seq + 1u - g_hdr.commit_seq) > 0)
+        {
+            set_commit(seq + 1u);
+        }
+
+        portEXIT_CRITICAL(&g_mux);
+
+        if (!ok)
+        {
+            continue;  /* sobrescrito por um registro desta sessão */
+        }
+
+        const uint32_t drops = sdcard_dropped_lines();
+
+        if (tmp.kind == STAGE_READING && on_reading)
+        {
+            on_reading(&tmp.u.reading);
+        }
+        else if (tmp.kind == STAGE_LOG && on_log)
+        {
+            on_log(tmp.u.text, tmp.len);
+        }
+
+        tmp.flags = (sdcard_dropped_lines() == drops) ? 0 : STAGE_UNLOGGED;
+        tmp.pos = sdcard_write_pos();
+        portENTER_CRITICAL(&g_mux);
+        stage_put(&tmp);
+        portEXIT_CRITICAL(&g_mux);
+        n++;
+    }
+
+    g_stats.replayed += n;
+    g_replay_from = g_replay_to;
+    return n;
+}
+
+/**
+ * @brief Confirma os registros cujas linhas de log já passaram por flush.
+ * @param durable_pos Valor corrente de @c sdcard_durable_pos().
+ * @param relog Regrava no log uma leitura cuja linha o anel do SD descartou e
+ *              informa se o SD a aceitou (@c nullptr: tais leituras esperam).
+ * @return Registros ainda pendentes.
+ *
+ * @details Um registro marcado como não gravado interrompe a confirmação; sua linha
+ *          é regravada e ele volta ao fim do anel com a posição nova. Se o anel do
+ *          SD ainda estiver cheio, fica pendente até a próxima chamada.
+ */
+uint16_t rtc_stage_commit(uint32_t durable_pos, bool (*relog)(const SensorReading *r))
+{
+    uint16_t pending = 0;
+
+    for (uint32_t round = 0; round <= RTC_STAGE_SLOTS; ++round)
+    {
+        StageSlot tmp;
+        bool unlogged = false;
+
+        portENTER_CRITICAL(&g_mux);
+
+        /* Os do boot anterior só são confirmados pelo replay. */
+        if (g_replay_from == g_replay_to)
+        {
+            uint32_t seq = g_hdr.commit_seq;
+
+            while (seq != g_next_seq)
+            {
+                const StageSlot *s = &g_slots[seq % RTC_STAGE_SLOTS];
+
+                if (s->seq == seq && (s->flags & STAGE_UNLOGGED))
+                {
+                    memcpy(&tmp, s, sizeof(tmp));
+                    unlogged = true;
+                    break;
+                }
+
+                if (s->seq == seq && (int32_t)(durable_pos - s->pos) < 0)
+                {
+                    break;
+                }
+
+                seq++;
+            }
+
+            set_commit(seq);
+        }
+
+        pending = (uint16_t)(g_next_seq - g_hdr.commit_seq);
+        g_stats.pending = pending;
+        portEXIT_CRITICAL(&g_mux);
+
+        if (!unlogged || !relog_slot(&tmp, relog))
+        {
+            break;
+        }
+
+        /* Gravado agora: o registro antigo sai e uma cópia espera o próximo flush. */
+        const uint32_t old_seq = tmp.seq;
+        tmp.flags = 0;
+        tmp.pos = sdcard_write_pos();
+
+        portENTER_CRITICAL(&g_mux);
+
+        if (g_hdr.commit_seq == old_seq)
+        {
+            set_commit(old_seq + 1u);
+            stage_put(&tmp);
+        }
+
+        portEXIT_CRITICAL(&g_mux);
+    }
+
+    return pending;
+}
+
+/**
+ * @brief Copia os contadores do estágio.
+ * @param out Estrutura de destino.
+ */
+void rtc_stage_get_stats(RtcStageStats *out)
+{
+    if (!out)
+    {
+        return;
+    }
+
+    portENTER_CRITICAL(&g_mux);
+    *out = g_stats;
+    out->pending = (uint16_t)(g_next_seq - g_hdr.commit_seq);
+    portEXIT_CRITICAL(&g_mux);
+}
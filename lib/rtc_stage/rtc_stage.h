@@ -0,0 +1,44 @@
+/**
+ * @file rtc_stage.h
+ * @brief Cabeçalho para o estágio de registros em memória RTC, que sobrevive a
+ *        resets por watchdog, brownout ou pânico.
+ *
+ * Leituras decodificadas e linhas de log críticas são copiadas para um anel com
+ * CRC na memória RTC lenta. Um registro é confirmado quando as linhas do SD
+ * aceitas até ele passam por flush (@c sdcard_durable_pos()); no boot seguinte,
+ * os não confirmados são repassados ao SD e aos sinks de uplink. Um registro cuja
+ * linha o anel do SD descartou fica pendente até ser regravado no log.
+ */
+
+#ifndef RTC_STAGE_H
+#define RTC_STAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "payload_schema.h"
+
+#define RTC_STAGE_SLOTS     32
+#define RTC_STAGE_TEXT_MAX  96   /* linha de log crítica, truncada  */
+#define RTC_STAGE_FLUSH_AT  24   /* pendentes que antecipam o flush */
+
+/**
+ * @brief Contadores do estágio.
+ */
+typedef struct
+{
+    uint32_t staged;     /* registros copiados para a RTC nesta sessão      */
+    uint32_t replayed;   /* registros do boot anterior repassados           */
+    uint32_t lost;       /* sobrescritos antes de confirmados               */
+    uint16_t pending;    /* registros ainda não confirmados                 */
+} RtcStageStats;
+
+uint16_t rtc_stage_begin(void);
+void rtc_stage_reading(const SensorReading *r, bool logged);
+void rtc_stage_log(const char *line, size_t len, bool logged);
+uint16_t rtc_stage_replay(void (*on_reading)(const SensorReading *r),
+                          void (*on_log)(const char *line, size_t len));
+uint16_t rtc_stage_commit(uint32_t durable_pos, bool (*relog)(const SensorReading *r));
+void rtc_stage_get_stats(RtcStageStats *out);
+
+#endif /* RTC_STAGE_H */
@@ -0,0 +1,323 @@
+/**
+ * @file rx_pipeline.cpp
+ * @brief Caminho de um pacote recebido: log do RX, validação, descriptografia,
+ *        ACK opcional, decodificação (simples ou lote) e entrega das leituras.
+ *
+ * As linhas mantêm o rótulo "MAIN" (e "LORA" para o RX), o mesmo de quando este
+ * código vivia no laço principal, para não mudar o formato do log.
+ */
+
+#include "rx_pipeline.h"
+#include <esp_timer.h>
+#include <math.h>
+#include "analytics.h"
+#include "batch_frame.h"
+#include "crypto.h"
+#include "fault_inject.h"
+#include "fmt.h"
+#include "key_table.h"
+#include "link_quality.h"
+#include "logger.h"
+#include "metrics.h"
+#include "payload_schema.h"
+#include "rtc_stage.h"
+#include "sd_card.h"
+#include "sx1278_lora.h"
+#include "uplink.h"
+#include "utils.h"
+
+static const char *TAG = "MAIN";
+
+/******************************** Protótipos **********************************/
+
+/**
+ * @brief Loga os campos de uma leitura decodificada e a entrega aos sinks de uplink.
+ * @param r Leitura vinda de um quadro simples ou de um lote.
+ */
+static void process_reading(const SensorReading *r);
+
+/**
+ * @brief Valida, descriptografa e decodifica um pacote (simples ou lote).
+ * @param buf Pacote bruto ([id do nó [+ sequência]] + IV16 + ciphertext).
+ * @param len Tamanho do pacote em bytes.
+ * @param rssi RSSI do pacote (dBm), para o registro de enlace.
+ * @param snr_centi SNR do pacote (centésimos de dB).
+ * @param rx_us Instante do RxDone, base da janela do ACK.
+ */
+static void process_packet(const uint8_t *buf, uint16_t len, int16_t rssi, int32_t snr_centi,
+                           int64_t rx_us);
+
+/**
+ * @brief Registra um quadro cujo payload foi validado: confirma a chave do nó e
+ *        o conta no registro de enlace.
+ * @return false se o quadro repete a última sequência do nó (reenvio).
+ */
+static bool frame_validated(bool has_node, uint16_t node, CryptoKey *key, bool has_seq,
+                            uint16_t seq, int16_t rssi, int32_t snr_centi);
+
+#if LORA_ACK_ENABLE
+/**
+ * @brief Confirma um quadro válido ao nó, se ainda dentro da janela de ACK.
+ * @param key Chave que decifrou o quadro (@c nullptr = chave da frota).
+ * @param frame IV + ciphertext do quadro (a etiqueta do ACK é o MAC deles).
+ * @param frame_len Tamanho de @p frame em bytes.
+ * @param rx_us Instante do RxDone do quadro.
+ */
+static void send_ack(CryptoKey *key, const uint8_t *frame, size_t frame_len, int64_t rx_us);
+#endif
+
+/****************************** Funções privadas ******************************/
+
+static void process_reading(const SensorReading *r)
+{
+    /* Log amigável dos campos decodificados (rótulos/escalas vêm do schema). */
+    const uint32_t drops = sdcard_dropped_lines();
+    payload_schema_log(TAG, r);
+
+    /* Protegida contra reset até o log acima passar por flush no SD; se o anel do
+     * SD descartou alguma linha dela, fica pendente até ser regravada. */
+    rtc_stage_reading(r, sdcard_dropped_lines() == drops);
+
+    /* Estatísticas móveis e eventos de limiar/anomalia, logados na hora. */
+    const uint16_t since_aggregate = analytics_update(r);
+    metrics_readings(1);
+
+    /* Não bloqueia: cada sink entrega a leitura na própria tarefa. */
+#if ANALYTICS_UPLOAD_AGGREGATES
+    SensorReading agg;
+
+    if (since_aggregate >= ANALYTICS_WINDOW && analytics_take_aggregate(r->source, &agg))
+    {
+        uplink_submit(&agg);
+    }
+#else
+    (void)since_aggregate;
+    uplink_submit(r);
+#endif
+}
+
+static bool frame_validated(bool has_node, uint16_t node, CryptoKey *key, bool has_seq,
+                            uint16_t seq, int16_t rssi, int32_t snr_centi)
+{
+    /* Só um payload conferido confirma a chave do nó (e encerra uma troca). */
+    if (has_node)
+    {
+        keytab_confirm(node, key);
+    }
+
+    return linkq_update(node, has_seq, seq, rssi, snr_centi);
+}
+
+#if LORA_ACK_ENABLE
+static void send_ack(CryptoKey *key, const uint8_t *frame, size_t frame_len, int64_t rx_us)
+{
+    uint8_t ack[LORA_ACK_LEN];
+    ack[0] = LORA_ACK_TYPE;
+
+    if (!crypto_ack_tag(key, frame, frame_len, &ack[1]))
+    {
+        metrics_ack(ACK_FAILED, 0, 0);
+        return;
+    }
+
+    const int64_t tx_us = esp_timer_get_time();
+    const uint32_t turnaround_us = (uint32_t)(tx_us - rx_us);
+
+    if (turnaround_us > LORA_ACK_WINDOW_US)
+    {
+        LOG(TAG, "ACK nao enviado: %lu us apos o RX (janela %lu us)",
+            (unsigned long)turnaround_us, (unsigned long)LORA_ACK_WINDOW_US);
+        metrics_ack(ACK_LATE, turnaround_us, 0);
+        return;
+    }
+
+    if (!lora_send(ack, sizeof(ack)))
+    {
+        LOG(TAG, "ACK: falha na transmissao");
+        metrics_ack(ACK_FAILED, turnaround_us, 0);
+        return;
+    }
+
+    const uint32_t airtime_us = (uint32_t)(esp_timer_get_time() - tx_us);
+    metrics_ack(ACK_SENT, turnaround_us, airtime_us);
+    LOG(TAG, "ACK enviado (turnaround=%lu us, TX=%lu us)", (unsigned long)turnaround_us,
+        (unsigned long)airtime_us);
+}
+#endif
+
+static void process_packet(const uint8_t *buf, uint16_t len, int16_t rssi, int32_t snr_centi,
+                           int64_t rx_us)
+{
+    /* Quadros com id de nó levam 2 B em claro antes do IV (ver key_table.h), ou 4 B
+     * quando o nó também envia a sequência usada no registro de enlace. */
+    const uint8_t hdr_len = (uint8_t)(len % 16u);
+    const bool has_seq = hdr_len == KEYTAB_HDR_LEN + LINKQ_SEQ_LEN;
+    const bool has_node = has_seq || hdr_len == KEYTAB_HDR_LEN;
+    const uint16_t node = has_node ? utils_rd_le_u16(buf) : 0;
+    const uint16_t seq = has_seq ? utils_rd_le_u16(&buf[KEYTAB_HDR_LEN]) : 0;
+
+    if (has_node)
+    {
+        buf += hdr_len;
+        len = (uint16_t)(len - hdr_len);
+    }
+
+    /* Tamanho mínimo: 16 B de IV + ao menos 16 B de ciphertext. */
+    if (len < 32u)
+    {
+        LOG(TAG, "Pacote curto (IV16 + CT16+), DESCARTADO");
+        metrics_drop(DROP_SHORT);
+        return;
+    }
+
+    /* Separação de IV e CT (modo de operação definido pela lib de crypto). */
+    const uint8_t *iv = &buf[0];
+    const uint8_t *ct = &buf[16];
+    const uint16_t ct_len = (uint16_t)(len - 16u);
+
+    /* AES opera em blocos de 16 bytes; ciphertext deve ser múltiplo de 16. */
+    if ((ct_len % 16u) != 0u)
+    {
+        LOG(TAG, "Ciphertext nao multiplo de 16, DESCARTADO");
+        metrics_drop(DROP_CT_ALIGN);
+        return;
+    }
+
+    if (has_node && !keytab_known(node))
+    {
+        LOG(TAG, "No %u sem chave na tabela, DESCARTADO", (unsigned)node);
+        metrics_drop(DROP_NO_KEY);
+        return;
+    }
+
+    /* Descriptografia para buffer plano, com a chave do nó ou a da frota. */
+    uint8_t plain[LORA_MAX_PACKET_LEN];
+    size_t  plain_len = 0;
+    CryptoKey *key = nullptr;
+    const bool decrypted = has_node
+        ? keytab_decrypt(node, ct, (size_t)ct_len, iv, plain, &plain_len, &key)
+        : crypto_decrypt(nullptr, ct, (size_t)ct_len, iv, plain, &plain_len);
+
+    if (!decrypted)
+    {
+        LOG(TAG, "AES fail, DESCARTADO");
+        metrics_drop(DROP_AES);
+        return;
+    }
+
+    /* Quadro em lote: N amostras com timestamps delta, desempacotadas uma a uma. */
+    if (batch_frame_is_batch(plain, plain_len))
+    {
+        BatchDecoder dec;
+
+        if (!batch_decoder_init(&dec, plain, plain_len))
+        {
+            LOG(TAG, "Lote invalido (checksum/estrutura), DESCARTADO");
+            metrics_drop(DROP_BATCH);
+            return;
+        }
+
+        const bool fresh = frame_validated(has_node, node, key, has_seq, seq, rssi, snr_centi);
+#if LORA_ACK_ENABLE
+        send_ack(key, buf, len, rx_us);
+#endif
+
+        /* Reenvio de um lote já entregue (o nó perdeu o ACK): só o ACK sai de novo. */
+        if (!fresh)
+        {
+            LOG(TAG, "Lote repetido do no %u (seq %u), nao reprocessado", (unsigned)node,
+                (unsigned)seq);
+            metrics_drop(DROP_DUPLICATE);
+            return;
+        }
+
+        LOG(TAG, "Lote com %u amostras", (unsigned)dec.count);
+        SensorReading r;
+
+        while (batch_decoder_next(&dec, &r))
+        {
+            r.source = node;
+            process_reading(&r);
+        }
+
+        return;
+    }
+
+    /* Após remoção de padding, o tamanho/versão deve corresponder a um schema conhecido. */
+    const PayloadSchema *schema = payload_schema_select(plain, plain_len);
+
+    if (!schema)
+    {
+        LOG(TAG, "Tamanho apos unpad invalido (%u), DESCARTADO", (unsigned)plain_len);
+        metrics_drop(DROP_UNPAD);
+        return;
+    }
+
+    /* Validação estrutural e de checksum do payload. */
+    SensorReading r;
+
+    if (!lora_parse_payload(schema, plain, plain_len, &r))
+    {
+        LOG(TAG, "Payload invalido (checksum/estrutura), DESCARTADO");
+        metrics_drop(DROP_CHECKSUM);
+        return;
+    }
+
+    r.source = node;
+    const bool fresh = frame_validated(has_node, node, key, has_seq, seq, rssi, snr_centi);
+
+    /* O ACK sai antes do log/entrega da leitura, para caber na janela do nó. */
+#if LORA_ACK_ENABLE
+    send_ack(key, buf, len, rx_us);
+#else
+    (void)rx_us;
+#endif
+
+    /* Reenvio de um quadro já entregue (o nó perdeu o ACK): só o ACK sai de novo. */
+    if (!fresh)
+    {
+        LOG(TAG, "Quadro repetido do no %u (seq %u), nao reprocessado", (unsigned)node,
+            (unsigned)seq);
+        metrics_drop(DROP_DUPLICATE);
+        return;
+    }
+
+    process_reading(&r);
+}
+
+/****************************** Funções públicas ******************************/
+
+/**
+ * @brief Trata um pacote copiado do buffer da tarefa do rádio.
+ * @param buf Pacote bruto ([id do nó [+ sequência]] + IV16 + ciphertext).
+ * @param len Tamanho do pacote em bytes (> 0).
+ * @param rssi RSSI do pacote (dBm).
+ * @param snr SNR do pacote (dB).
+ * @param rx_us Instante do RxDone (µs desde o boot), base do ACK e da latência.
+ *
+ * @note Chamada apenas pelo laço principal; pode bloquear no log e no ACK.
+ */
+void rx_pipeline_handle(const uint8_t *buf, uint16_t len, int16_t rssi, float snr, int64_t rx_us)
+{
+    /* Log dos metadados do pacote recebido. */
+    const int32_t snr_centi = (int32_t)lroundf(snr * 100.0f);
+    metrics_rx_packet(len, rssi, snr_centi);
+
+    char snr_txt[FMT_FIXED_MAX + 1];
+    *fmt_fixed(snr_txt, snr_centi, 2, 1) = '\0';
+    LOG("LORA", "RX [%u B]  RSSI=%d  SNR=%s", (unsigned)len, (int)rssi, snr_txt);
+    LOGHEX("LORA", buf, len);
+
+    if (fault_hit(FAULT_RADIO))
+    {
+        LOG(TAG, "Perda de pacote injetada, DESCARTADO");
+        metrics_drop(DROP_INJECTED);
+    }
+    else
+    {
+        process_packet(buf, len, rssi, snr_centi, rx_us);
+    }
+
+    /* Latência de ponta a ponta: do DIO0 até o fim do processamento. */
+    metrics_latency_us((uint32_t)(esp_timer_get_time() - rx_us));
+}
@@ -0,0 +1,17 @@
+/**
+ * @file rx_pipeline.h
+ * @brief Cabeçalho para o tratamento de um pacote LoRa recebido, do log do RX à
+ *        entrega das leituras aos sinks de uplink.
+ *
+ * Separado do laço principal para que o mesmo caminho seja exercitado fora do
+ * ESP32 (simulador de rede em @c tools/netsim).
+ */
+
+#ifndef RX_PIPELINE_H
+#define RX_PIPELINE_H
+
+#include <stdint.h>
+
+void rx_pipeline_handle(const uint8_t *buf, uint16_t len, int16_t rssi, float snr, int64_t rx_us);
+
+#endif /* RX_PIPELINE_H */
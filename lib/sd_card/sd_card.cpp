@@ -1,32 +1,174 @@
 /**
  * @file sd_card.cpp
  * @brief Rotina de registro em cartão SD com rotação diária e cabeçalho de sessão.
+ *
+ * - @c sdcard_write() apenas copia a linha para um anel em RAM (linhas inteiras),
+ *   sem tocar no cartão; quem chama nunca espera pelo SD.
+ * - Uma tarefa de gravação esvazia o anel em ordem, faz o flush, a rotação diária
+ *   e, se o cartão falhar ou sumir, desmonta e tenta remontar periodicamente,
+ *   retomando do ponto em que parou.
+ * - Os bytes só saem do anel após o flush (ou o fechamento) do arquivo, confirmado
+ *   por uma consulta ao cartão; se o cartão falhar antes disso, são regravados no
+ *   arquivo novo. As posições acumuladas @c sdcard_write_pos() e
+ *   @c sdcard_durable_pos() dizem o que já é persistente.
+ * - O barramento SPI é tomado só em volta de cada operação no cartão (abertura,
+ *   bloco gravado, flush, consulta, fechamento); a hora é lida antes, sem ele.
+ * - Com o anel cheio as linhas novas são descartadas e contadas; uma linha de aviso
+ *   marca a lacuna no arquivo.
  */
 
 #include "sd_card.h"
 #include <SPI.h>
 #include <SD.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include "fault_inject.h"
 #include "pins.h"
+#include "spi_bus.h"
+#include "time_service.h"
 
-#define SD_FLUSH_EVERY_N_LINES 8
+#define SD_RING_LEN             16384  /* linhas aguardando o cartão          */
+#define SD_DRAIN_CHUNK          1024   /* bytes copiados do anel por gravação */
+#define SD_FLUSH_EVERY_BYTES    8192   /* flush mesmo sem pedido explícito    */
+#define SD_FLUSH_PERIOD_MS      30000  /* idade máxima de bytes sem flush     */
+#define SD_WRITER_PERIOD_MS     250
+#define SD_REMOUNT_MS           5000
+#define SD_STALL_MS             500    /* gravação de um bloco acima disso    */
+#define SD_WRITER_PRIO          1
 
 static FS *g_fs = &SD;
 static File g_file;
+static char g_file_name[40];
 static uint8_t g_cs = 0xFF;
 static bool g_sd_ok = false;
 static int g_cur_ymd = -1;
-static uint32_t g_lines_since_flush = 0;
+static uint32_t g_day_gen = 0;
+static uint32_t g_last_flush_ms = 0;
+static SemaphoreHandle_t g_lock = nullptr;     /* anel e estado; seções curtas   */
+static SemaphoreHandle_t g_io_lock = nullptr;  /* acesso ao cartão; pode demorar */
+static bool g_mounted = false;
+static bool g_started = false;
+static volatile bool g_flush_req = false;
+static TaskHandle_t g_writer = nullptr;
+static uint32_t g_next_remount_ms = 0;
+static unsigned long g_epoch0_next = 0;  /* próximo 19700101_000000_<n>.log */
+
+static char g_ring[SD_RING_LEN];
+static size_t g_ring_head = 0;   /* próximo byte a gravar */
+static size_t g_ring_len = 0;
+static size_t g_ring_sent = 0;      /* gravados no arquivo, aguardando flush   */
+static uint32_t g_put_pos = 0;      /* bytes aceitos no anel desde o boot      */
+static uint32_t g_durable_pos = 0;  /* bytes persistidos (flush) desde o boot  */
+static uint32_t g_gap_bytes = 0; /* descartados desde a última marca de lacuna */
+static char g_out[SD_DRAIN_CHUNK];
+static SdStats g_stats;
+
+/**
+ * @brief Cópia do estado do serviço de hora tirada sob @c sdcard_lock().
+ */
+typedef struct
+{
+    struct tm tm;
+    int ymd;
+    uint32_t day_gen;
+} TimeSnap;
 
 /****************************** Funções privadas ******************************/
 
 /**
- * @brief Verifica se uma @c struct tm representa a data 1970-01-01 (época zero).
- * @param tm Referência constante para a estrutura de tempo local.
- * @return true se a data for exatamente 1970-01-01, false caso contrário.
+ * @brief Copia @p len bytes para o fim do anel (espaço já verificado).
+ */
+static void ring_put(const char *buf, size_t len)
+{
+    size_t tail = (g_ring_head + g_ring_len) % SD_RING_LEN;
+    const size_t first = (len < SD_RING_LEN - tail) ? len : SD_RING_LEN - tail;
+    memcpy(&g_ring[tail], buf, first);
+    memcpy(&g_ring[0], buf + first, len - first);
+    g_ring_len += len;
+    g_put_pos += (uint32_t)len;
+
+    if (g_ring_len > g_stats.ring_peak)
+    {
+        g_stats.ring_peak = (uint32_t)g_ring_len;
+    }
+}
+
+/**
+ * @brief Acrescenta uma linha inteira ao anel ou a descarta se não couber.
+ *
+ * @details Antes da primeira linha aceita após um descarte, grava uma linha
+ *          informando quantos bytes foram perdidos naquele ponto.
+ * @return true se a linha entrou no anel.
+ */
+static bool ring_append_line(const char *buf, size_t len)
+{
+    char gap[64];
+    size_t gap_len = 0;
+
+    if (g_gap_bytes)
+    {
+        gap_len = (size_t)snprintf(gap, sizeof(gap), "(%lu bytes de log perdidos)\n",
+                                   (unsigned long)g_gap_bytes);
+    }
+
+    if (gap_len + len > SD_RING_LEN - g_ring_len)
+    {
+        g_gap_bytes += (uint32_t)len;
+        g_stats.dropped_bytes += (uint32_t)len;
+        g_stats.dropped_lines++;
+        return false;
+    }
+
+    if (gap_len)
+    {
+        ring_put(gap, gap_len);
+        g_gap_bytes = 0;
+    }
+
+    ring_put(buf, len);
+    return true;
+}
+
+/**
+ * @brief Copia até @p max bytes ainda não gravados do anel, sem consumi-los.
+ */
+static size_t ring_peek(char *out, size_t max)
+{
+    const size_t pending = g_ring_len - g_ring_sent;
+    const size_t n = (pending < max) ? pending : max;
+    const size_t from = (g_ring_head + g_ring_sent) % SD_RING_LEN;
+    const size_t first = (n < SD_RING_LEN - from) ? n : SD_RING_LEN - from;
+    memcpy(out, &g_ring[from], first);
+    memcpy(out + first, &g_ring[0], n - first);
+    return n;
+}
+
+/**
+ * @brief Libera do anel os bytes gravados, após o flush ou o fechamento do arquivo.
+ */
+static void ring_mark_durable()
+{
+    xSemaphoreTakeRecursive(g_lock, portMAX_DELAY);
+    g_ring_head = (g_ring_head + g_ring_sent) % SD_RING_LEN;
+    g_ring_len -= g_ring_sent;
+    __atomic_store_n(&g_durable_pos, g_durable_pos + (uint32_t)g_ring_sent, __ATOMIC_RELEASE);
+    g_ring_sent = 0;
+    xSemaphoreGiveRecursive(g_lock);
+}
+
+/**
+ * @brief Lê o serviço de hora sob @c sdcard_lock(), a mesma trava do logger, que o
+ *        atualiza de outras tarefas; o cache dele não é protegido por si só.
  */
-static inline bool tm_is_epoch0(const struct tm &tm)
+static void time_snapshot(TimeSnap *out)
 {
-    return (tm.tm_year + 1900) == 1970 && (tm.tm_mon + 1) == 1 && tm.tm_mday == 1;
+    sdcard_lock();
+    out->tm = *timesvc_now_tm();
+    out->ymd = timesvc_ymd();
+    out->day_gen = timesvc_day_generation();
+    sdcard_unlock();
 }
 
 /**
@@ -46,6 +188,77 @@ static void make_filename_from_tm(const struct tm *tm, char *out, size_t outlen)
              tm->tm_sec);
 }
 
+/**
+ * @brief Grava @p len bytes em @p f em blocos de até @c SPI_BUS_SD_CHUNK, liberando o
+ *        barramento entre eles para que o rádio não espere por uma gravação longa.
+ * @return Quantidade de bytes gravados.
+ */
+static size_t write_chunked(File &f, const uint8_t *buf, size_t len)
+{
+    size_t done = 0;
+
+    while (done < len)
+    {
+        const size_t n = (len - done < SPI_BUS_SD_CHUNK) ? (len - done) : SPI_BUS_SD_CHUNK;
+        spi_bus_acquire(SPI_DEV_SD);
+        const size_t w = f.write(buf + done, n);
+        spi_bus_release(SPI_DEV_SD);
+        done += w;
+
+        if (w != n)
+        {
+            break;
+        }
+    }
+
+    return done;
+}
+
+/**
+ * @brief Devolve ao anel os bytes gravados sem flush, para regravá-los no próximo arquivo.
+ */
+static void ring_rewind_sent()
+{
+    xSemaphoreTakeRecursive(g_lock, portMAX_DELAY);
+    g_ring_sent = 0;
+    xSemaphoreGiveRecursive(g_lock);
+}
+
+/**
+ * @brief Confere, após um flush, se o arquivo de log ainda está no cartão.
+ *
+ * @details @c File::flush() não informa erro: com o cartão retirado entre a
+ *          gravação e o flush, os bytes nunca chegam a ele. Só o que passou por
+ *          esta verificação sai do anel.
+ */
+static bool file_persisted()
+{
+    spi_bus_acquire(SPI_DEV_SD);
+    const bool kept = g_fs->exists(g_file_name);
+    spi_bus_release(SPI_DEV_SD);
+    return kept;
+}
+
+/**
+ * @brief Flush do arquivo atual, com o barramento só durante a chamada.
+ */
+static void file_flush()
+{
+    spi_bus_acquire(SPI_DEV_SD);
+    g_file.flush();
+    spi_bus_release(SPI_DEV_SD);
+}
+
+/**
+ * @brief Fecha o arquivo atual, com o barramento só durante a chamada.
+ */
+static void file_close()
+{
+    spi_bus_acquire(SPI_DEV_SD);
+    g_file.close();
+    spi_bus_release(SPI_DEV_SD);
+}
+
 /**
  * @brief Fecha o arquivo atual de log, efetuando @c flush antes.
  */
@@ -53,163 +266,172 @@ static void close_file()
 {
     if (g_file)
     {
-        g_file.flush();
-        g_file.close();
+        file_flush();
+        const bool kept = file_persisted();
+        file_close();
+
+        if (kept)
+        {
+            ring_mark_durable();
+        }
+        else
+        {
+            ring_rewind_sent();
+        }
     }
 }
 
 /**
  * @brief Escreve no início do arquivo uma linha de cabeçalho com data/hora de início de log.
+ * @param tm_local Data/hora local usada na abertura do arquivo.
  */
-static void write_header_line()
+static void write_header_line(const struct tm *tm_local)
 {
-    time_t now = time(nullptr);
-    struct tm tm_local;
-    localtime_r(&now, &tm_local);
     char hdr[128];
     snprintf(hdr, sizeof(hdr),
              "=== LOG START %04d-%02d-%02d %02d:%02d:%02d ===\n",
-             tm_local.tm_year + 1900, tm_local.tm_mon + 1, tm_local.tm_mday,
-             tm_local.tm_hour, tm_local.tm_min, tm_local.tm_sec);
+             tm_local->tm_year + 1900, tm_local->tm_mon + 1, tm_local->tm_mday,
+             tm_local->tm_hour, tm_local->tm_min, tm_local->tm_sec);
+    spi_bus_acquire(SPI_DEV_SD);
     g_file.print(hdr);
-    g_file.flush();
-    g_lines_since_flush = 0;
+    spi_bus_release(SPI_DEV_SD);
+    file_flush();
 }
 
 /**
- * @brief Obtém um inteiro no formato @c YYYYMMDD a partir de @c struct tm.
- * @param tm Ponteiro para a estrutura de tempo local.
- * @return int Data compactada como @c YYYYMMDD.
+ * @brief Extrai a sequência de um nome no padrão @c 19700101_000000_<seq>.log.
+ * @param nm Nome da entrada (com ou sem '/' inicial).
+ * @param seq Sequência lida.
+ * @return true se o nome segue o padrão.
  */
-static int current_ymd_from_tm(const struct tm *tm)
+static bool parse_epoch0_name(const char *nm, unsigned long *seq)
 {
-    return (tm->tm_year + 1900) * 10000 + (tm->tm_mon + 1) * 100 + tm->tm_mday;
+    const char *name = (nm[0] == '/') ? nm + 1 : nm;
+    const char *prefix = "19700101_000000_";
+    const size_t prefix_len = strlen(prefix);
+    const size_t name_len = strlen(name);
+    const char *suffix = ".log";
+    const size_t suffix_len = 4;
+
+    if (name_len <= prefix_len + suffix_len ||
+        strncmp(name, prefix, prefix_len) != 0 ||
+        strcmp(name + name_len - suffix_len, suffix) != 0)
+    {
+        return false;
+    }
+
+    unsigned long val = 0;
+
+    for (const char *p = name + prefix_len; p < name + name_len - suffix_len; ++p)
+    {
+        if (!isdigit((unsigned char)*p))
+        {
+            return false;
+        }
+
+        val = val * 10UL + (unsigned)(*p - '0');
+    }
+
+    *seq = val;
+    return true;
 }
 
 /**
- * @brief Busca a próxima sequência disponível para arquivos com data época-zero.
- * @return unsigned long Próxima sequência disponível; retorna @c 0
- *         se nenhum arquivo no padrão for encontrado.
+ * @brief Calcula, na montagem, a próxima sequência livre para arquivos com data
+ *        época-zero (chamada com @c g_io_lock, sem o barramento).
+ *
+ * @details Percorre a raiz uma vez, tomando o barramento só durante cada acesso
+ *          ao cartão; o rádio nunca espera pela varredura inteira. As aberturas
+ *          seguintes apenas incrementam @c g_epoch0_next.
  */
-static unsigned long find_next_epoch0_seq()
+static void scan_epoch0_seq()
 {
-    unsigned long max_seq = (unsigned long)0;
-    bool found_any = false;
+    unsigned long next = 0;
 
+    spi_bus_acquire(SPI_DEV_SD);
     File root = g_fs->open("/");
+    spi_bus_release(SPI_DEV_SD);
 
-    if (!root)
-    {
-        return 0;
-    }
-
-    while (true)
+    while (root)
     {
+        spi_bus_acquire(SPI_DEV_SD);
         File entry = root.openNextFile();
+        spi_bus_release(SPI_DEV_SD);
 
         if (!entry)
         {
             break;
         }
 
-        if (!entry.isDirectory())
-        {
-            const char *nm = entry.name();
-            const char *name = nm;
-
-            if (name[0] == '/')
-            {
-                name++;
-            }
-
-            const char *prefix = "19700101_000000_";
-            const size_t prefix_len = strlen(prefix);
-            const size_t name_len = strlen(name);
-            const char *suffix = ".log";
-            const size_t suffix_len = 4;
+        unsigned long seq = 0;
 
-            if (name_len > prefix_len + suffix_len &&
-                strncmp(name, prefix, prefix_len) == 0 &&
-                strcmp(name + name_len - suffix_len, suffix) == 0)
-            {
-                const char *p = name + prefix_len;
-                bool ok_digits = true;
-                unsigned long val = 0;
-
-                while (*p && (p < name + name_len - suffix_len))
-                {
-                    if (!isdigit((unsigned char)*p))
-                    {
-                        ok_digits = false;
-                        break;
-                    }
-
-                    unsigned digit = (unsigned)(*p - '0');
-                    val = val * 10UL + digit;
-                    p++;
-                }
-
-                if (ok_digits)
-                {
-                    if (!found_any || val > max_seq)
-                    {
-                        max_seq = val;
-                        found_any = true;
-                    }
-                }
-            }
+        if (!entry.isDirectory() && parse_epoch0_name(entry.name(), &seq) && seq + 1UL > next)
+        {
+            next = seq + 1UL;
         }
+
+        spi_bus_acquire(SPI_DEV_SD);
         entry.close();
+        spi_bus_release(SPI_DEV_SD);
+    }
+
+    if (root)
+    {
+        spi_bus_acquire(SPI_DEV_SD);
+        root.close();
+        spi_bus_release(SPI_DEV_SD);
     }
 
-    root.close();
-    return found_any ? (max_seq + 1UL) : 0UL;
+    g_epoch0_next = next;
 }
 
 /**
  * @brief Abre um novo arquivo de log baseado no horário atual ou no esquema de época-zero.
+ *
+ * @details Chamada com @c g_io_lock e sem o barramento: a hora é lida antes (sob
+ *          @c sdcard_lock(), que o logger pode segurar durante a saída serial) e
+ *          cada operação no cartão toma o barramento só durante a chamada.
  * @return true se o arquivo foi aberto com sucesso, false se a abertura falhar.
  */
 static bool open_new_file_for_now()
 {
-    time_t now = time(nullptr);
-    struct tm tm_local;
-    localtime_r(&now, &tm_local);
     char fn[80];
+    TimeSnap now;
+    time_snapshot(&now);
+    g_day_gen = now.day_gen;
+    const bool epoch0 = now.ymd == 19700101;
 
-    if (tm_is_epoch0(tm_local))
+    if (epoch0)
     {
-        unsigned long seq = find_next_epoch0_seq();
-        snprintf(fn, sizeof(fn), "/19700101_000000_%lu.log", seq);
-        close_file();
-        g_file = g_fs->open(fn, FILE_WRITE);
-
-        if (!g_file)
-        {
-            return false;
-        }
-
-        g_cur_ymd = 19700101;
-        write_header_line();
-        return true;
+        snprintf(fn, sizeof(fn), "/19700101_000000_%lu.log", g_epoch0_next);
+    }
+    else
+    {
+        make_filename_from_tm(&now.tm, fn, sizeof(fn));
     }
 
-    make_filename_from_tm(&tm_local, fn, sizeof(fn));
     close_file();
+    spi_bus_acquire(SPI_DEV_SD);
     g_file = g_fs->open(fn, FILE_WRITE);
+    spi_bus_release(SPI_DEV_SD);
 
     if (!g_file)
     {
         return false;
     }
 
-    g_cur_ymd = current_ymd_from_tm(&tm_local);
-    write_header_line();
+    strlcpy(g_file_name, fn, sizeof(g_file_name));
+    g_epoch0_next += epoch0 ? 1UL : 0UL;
+    g_cur_ymd = now.ymd;
+    write_header_line(&now.tm);
     return true;
 }
 
 /**
  * @brief Garante que existe um arquivo aberto para o "dia de hoje", rotacionando se necessário.
+ *
+ * @details O caso comum é uma comparação com a geração de dia do serviço de hora;
+ *          a data só é reavaliada quando ela muda.
  */
 static void ensure_file_for_today()
 {
@@ -218,54 +440,467 @@ static void ensure_file_for_today()
         return;
     }
 
-    time_t now = time(nullptr);
-    struct tm tm_local;
-    localtime_r(&now, &tm_local);
-
     if (!g_file)
     {
         (void)open_new_file_for_now();
         return;
     }
 
-    if (tm_is_epoch0(tm_local))
+    TimeSnap now;
+    time_snapshot(&now);
+
+    if (now.day_gen == g_day_gen)
     {
         return;
     }
 
-    int ymd = current_ymd_from_tm(&tm_local);
+    g_day_gen = now.day_gen;
 
-    if (g_cur_ymd != ymd)
+    if (now.ymd == 19700101)
+    {
+        return;
+    }
+
+    if (g_cur_ymd != now.ymd)
     {
         (void)open_new_file_for_now();
     }
 }
 
-/****************************** Funções públicas ******************************/
+/**
+ * @brief Flush do arquivo de log e liberação dos bytes gravados (chamada com @c g_io_lock).
+ * @return false se o arquivo sumiu do cartão; os bytes ficam no anel.
+ */
+static bool flush_file()
+{
+    file_flush();
+    const bool kept = file_persisted();
+
+    if (!kept)
+    {
+        return false;
+    }
+
+    ring_mark_durable();
+    g_last_flush_ms = millis();
+    return true;
+}
 
 /**
- * @brief Inicializa a interface com o cartão SD e abre o primeiro arquivo de log.
+ * @brief Marca o cartão como ausente após uma falha de gravação (chamada com
+ *        @c g_io_lock); a tarefa de gravação tentará remontá-lo.
  */
-void sdcard_begin()
+static void card_lost(uint32_t now_ms)
+{
+    file_close();
+    spi_bus_acquire(SPI_DEV_SD);
+    SD.end();
+    spi_bus_release(SPI_DEV_SD);
+
+    /* O que não passou por flush é regravado no arquivo da remontagem. */
+    ring_rewind_sent();
+    g_sd_ok = false;
+    g_mounted = false;
+    g_next_remount_ms = now_ms + SD_REMOUNT_MS;
+    g_stats.write_errors++;
+}
+
+/**
+ * @brief Monta o cartão e calcula a sequência dos arquivos época-zero (chamada
+ *        com @c g_io_lock).
+ */
+static bool mount_locked()
 {
     g_cs = SD_SPI_CS;
     pinMode(g_cs, OUTPUT);
     digitalWrite(g_cs, HIGH);
-    g_sd_ok = SD.begin(g_cs, SPI, 20000000);
+    spi_bus_acquire(SPI_DEV_SD);
+    g_mounted = SD.begin(g_cs, SPI, 20000000);
+    spi_bus_release(SPI_DEV_SD);
+
+    if (g_mounted)
+    {
+        scan_epoch0_seq();
+    }
+
+    return g_mounted;
+}
+
+/**
+ * @brief Tenta remontar o cartão e abrir um novo arquivo (chamada com @c g_io_lock).
+ */
+static void try_remount(uint32_t now_ms)
+{
+    if ((int32_t)(now_ms - g_next_remount_ms) < 0)
+    {
+        return;
+    }
+
+    g_next_remount_ms = now_ms + SD_REMOUNT_MS;
+    spi_bus_acquire(SPI_DEV_SD);
+    SD.end();
+    spi_bus_release(SPI_DEV_SD);
+
+    if (!mount_locked())
+    {
+        return;
+    }
+
     g_sd_ok = open_new_file_for_now();
+
+    if (g_sd_ok)
+    {
+        g_stats.remounts++;
+    }
 }
 
 /**
- * @brief Rotina periódica para avaliar rotação diária do arquivo de log.
+ * @brief Grava no arquivo o conteúdo do anel, em ordem, até esvaziá-lo ou falhar.
+ *        Os bytes só saem do anel depois do flush.
+ */
+static void drain_ring()
+{
+    for (;;)
+    {
+        xSemaphoreTakeRecursive(g_lock, portMAX_DELAY);
+        const size_t n = ring_peek(g_out, sizeof(g_out));
+        xSemaphoreGiveRecursive(g_lock);
+
+        if (n == 0)
+        {
+            return;
+        }
+
+        const uint32_t t0 = millis();
+        const bool fail = fault_hit(FAULT_SD_WRITE);
+        const size_t w = fail ? 0 : write_chunked(g_file, (const uint8_t *)g_out, n);
+
+        if ((millis() - t0) > SD_STALL_MS)
+        {
+            g_stats.stalls++;
+        }
+
+        if (w != n)
+        {
+            card_lost(millis());
+            return;
+        }
+
+        xSemaphoreTakeRecursive(g_lock, portMAX_DELAY);
+        g_ring_sent += n;
+        xSemaphoreGiveRecursive(g_lock);
+        g_stats.written_bytes += (uint32_t)n;
+    }
+}
+
+/**
+ * @brief Tarefa de gravação: esvazia o anel, faz flush e rotação, remonta o cartão.
+ */
+static void writer_task(void *arg)
+{
+    (void)arg;
+
+    for (;;)
+    {
+        (void)ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SD_WRITER_PERIOD_MS));
+        xSemaphoreTake(g_io_lock, portMAX_DELAY);
+
+        if (!g_sd_ok)
+        {
+            try_remount(millis());
+        }
+
+        if (g_sd_ok)
+        {
+            ensure_file_for_today();
+            drain_ring();
+        }
+
+        const bool due = g_ring_sent >= SD_FLUSH_EVERY_BYTES ||
+                         (g_ring_sent && (millis() - g_last_flush_ms) >= SD_FLUSH_PERIOD_MS);
+
+        if (g_sd_ok && (g_flush_req || due))
+        {
+            g_flush_req = false;
+
+            if (!flush_file())
+            {
+                card_lost(millis());
+            }
+        }
+
+        xSemaphoreGive(g_io_lock);
+    }
+}
+
+/****************************** Funções públicas ******************************/
+
+/**
+ * @brief Prepara o módulo sem acessar o cartão: cria os mutexes e passa a reter em
+ *        RAM as linhas escritas até que @c sdcard_begin() abra o arquivo de log.
+ */
+void sdcard_init()
+{
+    if (!g_lock)
+    {
+        g_lock = xSemaphoreCreateRecursiveMutex();
+        g_io_lock = xSemaphoreCreateMutex();
+    }
+
+    sdcard_lock();
+    g_ring_head = 0;
+    g_ring_len = 0;
+    g_gap_bytes = 0;
+    memset(&g_stats, 0, sizeof(g_stats));
+    sdcard_unlock();
+}
+
+/**
+ * @brief Monta o cartão SD (pode levar centenas de ms; não abre arquivo).
+ * @return true se o cartão respondeu.
+ */
+bool sdcard_mount()
+{
+    if (!g_lock)
+    {
+        sdcard_init();
+    }
+
+    xSemaphoreTake(g_io_lock, portMAX_DELAY);
+    const bool ok = g_mounted || mount_locked();
+    xSemaphoreGive(g_io_lock);
+    return ok;
+}
+
+/**
+ * @brief Monta o cartão (se ainda não montado), abre o primeiro arquivo de log e
+ *        inicia a tarefa que grava as linhas retidas desde @c sdcard_init().
+ *
+ * @details Se o cartão não responder, a tarefa segue tentando remontá-lo a cada
+ *          @c SD_REMOUNT_MS, e as linhas continuam retidas no anel.
+ */
+void sdcard_begin()
+{
+    if (!g_lock)
+    {
+        sdcard_init();
+    }
+
+    xSemaphoreTake(g_io_lock, portMAX_DELAY);
+
+    if (!g_mounted)
+    {
+        (void)mount_locked();
+    }
+
+    g_sd_ok = g_mounted && open_new_file_for_now();
+    g_next_remount_ms = millis() + SD_REMOUNT_MS;
+    xSemaphoreGive(g_io_lock);
+
+    if (!g_started)
+    {
+        g_started = true;
+        xTaskCreate(writer_task, "sd_writer", 4096, nullptr, SD_WRITER_PRIO, &g_writer);
+    }
+}
+
+/**
+ * @brief Acorda a tarefa de gravação quando o dia muda, para rotacionar o arquivo.
  */
 void sdcard_tick_rotate()
 {
-    if (!g_sd_ok)
+    if (!g_writer)
     {
         return;
     }
 
-    ensure_file_for_today();
+    sdcard_lock();
+    const uint32_t gen = timesvc_day_generation();
+    sdcard_unlock();
+
+    if (gen != __atomic_load_n(&g_day_gen, __ATOMIC_RELAXED))
+    {
+        xTaskNotifyGive(g_writer);
+    }
+}
+
+/**
+ * @brief Enfileira uma linha já formatada para o arquivo de log.
+ * @param buf Bytes da linha (incluindo o '\n' final).
+ * @param len Quantidade de bytes em @p buf.
+ * @return true se a linha foi aceita; false se foi descartada com o anel cheio
+ *         (e nunca chegará ao cartão).
+ *
+ * @note Não acessa o cartão; com o anel cheio a linha é descartada e contada.
+ */
+bool sdcard_write(const char *buf, size_t len)
+{
+    if (len == 0)
+    {
+        return true;
+    }
+
+    sdcard_lock();
+    const bool accepted = ring_append_line(buf, len);
+    const bool wake = g_ring_len >= SD_RING_LEN / 2u;
+    sdcard_unlock();
+
+    if (wake && g_writer)
+    {
+        xTaskNotifyGive(g_writer);
+    }
+
+    return accepted;
+}
+
+/**
+ * @brief Acrescenta bytes a um arquivo auxiliar (ex.: exportação de leituras).
+ * @param path Caminho absoluto do arquivo no SD.
+ * @param buf Bytes a gravar.
+ * @param len Quantidade de bytes em @p buf.
+ * @return true se todos os bytes foram gravados (false com o cartão ausente).
+ */
+bool sdcard_append(const char *path, const char *buf, size_t len)
+{
+    bool ok = false;
+
+    if (!g_io_lock)
+    {
+        return false;
+    }
+
+    xSemaphoreTake(g_io_lock, portMAX_DELAY);
+
+    if (g_sd_ok)
+    {
+        spi_bus_acquire(SPI_DEV_SD);
+        File f = g_fs->open(path, FILE_APPEND);
+        spi_bus_release(SPI_DEV_SD);
+
+        if (f)
+        {
+            ok = write_chunked(f, (const uint8_t *)buf, len) == len;
+            spi_bus_acquire(SPI_DEV_SD);
+            f.close();
+            spi_bus_release(SPI_DEV_SD);
+        }
+    }
+
+    xSemaphoreGive(g_io_lock);
+    return ok;
+}
+
+/**
+ * @brief Lê um arquivo auxiliar inteiro (ex.: tabela de chaves), em blocos de até
+ *        @c SPI_BUS_SD_CHUNK para não segurar o barramento do rádio.
+ * @param path Caminho absoluto do arquivo no SD.
+ * @param buf Buffer de destino.
+ * @param max Capacidade de @p buf.
+ * @param out_len Bytes lidos.
+ * @return true se o arquivo existir e couber inteiro em @p buf.
+ */
+bool sdcard_read(const char *path, char *buf, size_t max, size_t *out_len)
+{
+    bool ok = false;
+    *out_len = 0;
+
+    if (!g_io_lock)
+    {
+        return false;
+    }
+
+    xSemaphoreTake(g_io_lock, portMAX_DELAY);
+
+    if (g_sd_ok)
+    {
+        spi_bus_acquire(SPI_DEV_SD);
+        File f = g_fs->open(path, FILE_READ);
+        const size_t size = f ? (size_t)f.size() : 0;
+        spi_bus_release(SPI_DEV_SD);
+
+        if (f)
+        {
+            ok = size <= max;
+
+            while (ok && *out_len < size)
+            {
+                const size_t want = size - *out_len;
+                const size_t n = (want < SPI_BUS_SD_CHUNK) ? want : SPI_BUS_SD_CHUNK;
+                spi_bus_acquire(SPI_DEV_SD);
+                const int r = f.read((uint8_t *)buf + *out_len, n);
+                spi_bus_release(SPI_DEV_SD);
+                ok = (r == (int)n);
+                *out_len += ok ? n : 0;
+            }
+
+            spi_bus_acquire(SPI_DEV_SD);
+            f.close();
+            spi_bus_release(SPI_DEV_SD);
+        }
+    }
+
+    xSemaphoreGive(g_io_lock);
+    return ok;
+}
+
+/**
+ * @brief Lê um setor de 512 B do cartão, fora do sistema de arquivos (ex.: a
+ *        partição bruta do @c record_log).
+ * @param sector Setor absoluto no cartão (LBA).
+ * @param buf Destino de 512 bytes.
+ * @return true se o cartão está montado e a leitura funcionou.
+ */
+bool sdcard_read_raw(uint32_t sector, uint8_t *buf)
+{
+    bool ok = false;
+
+    if (!g_io_lock)
+    {
+        return false;
+    }
+
+    xSemaphoreTake(g_io_lock, portMAX_DELAY);
+
+    if (g_mounted)
+    {
+        spi_bus_acquire(SPI_DEV_SD);
+        ok = SD.readRAW(buf, sector);
+        spi_bus_release(SPI_DEV_SD);
+    }
+
+    xSemaphoreGive(g_io_lock);
+    return ok;
+}
+
+/**
+ * @brief Grava um setor de 512 B do cartão, fora do sistema de arquivos.
+ * @param sector Setor absoluto no cartão (LBA); não deve pertencer ao volume FAT.
+ * @param buf Origem de 512 bytes.
+ * @return true se o cartão está montado e a gravação funcionou.
+ *
+ * @note Um setor é uma única transação de @c SPI_BUS_SD_CHUNK bytes, como os
+ *       blocos de @c write_chunked().
+ */
+bool sdcard_write_raw(uint32_t sector, const uint8_t *buf)
+{
+    bool ok = false;
+
+    if (!g_io_lock)
+    {
+        return false;
+    }
+
+    xSemaphoreTake(g_io_lock, portMAX_DELAY);
+
+    if (g_mounted && !fault_hit(FAULT_SD_WRITE))
+    {
+        spi_bus_acquire(SPI_DEV_SD);
+        ok = SD.writeRAW(const_cast<uint8_t *>(buf), sector);
+        spi_bus_release(SPI_DEV_SD);
+    }
+
+    xSemaphoreGive(g_io_lock);
+    return ok;
 }
 
 /**
@@ -275,12 +910,6 @@ void sdcard_tick_rotate()
  */
 void sdcard_vprintf(const char *fmt, va_list ap)
 {
-    if (!g_sd_ok || !g_file)
-    {
-        return;
-    }
-
-    ensure_file_for_today();
     char line[512];
     va_list ap2;
     va_copy(ap2, ap);
@@ -293,13 +922,7 @@ void sdcard_vprintf(const char *fmt, va_list ap)
     }
 
     size_t to_write = (n < (int)sizeof(line)) ? (size_t)n : (sizeof(line) - 1);
-    g_file.write((const uint8_t *)line, to_write);
-
-    if (++g_lines_since_flush >= SD_FLUSH_EVERY_N_LINES)
-    {
-        g_file.flush();
-        g_lines_since_flush = 0;
-    }
+    (void)sdcard_write(line, to_write);
 }
 
 /**
@@ -309,11 +932,6 @@ void sdcard_vprintf(const char *fmt, va_list ap)
  */
 void sdcard_printf(const char *fmt, ...)
 {
-    if (!g_sd_ok || !g_file)
-    {
-        return;
-    }
-
     va_list ap;
     va_start(ap, fmt);
     sdcard_vprintf(fmt, ap);
@@ -321,23 +939,116 @@ void sdcard_printf(const char *fmt, ...)
 }
 
 /**
- * @brief Força a gravação (flush) do arquivo de log atual.
+ * @brief Pede à tarefa de gravação que esvazie o anel e faça o flush do arquivo.
+ *
+ * @note Não bloqueia; a gravação acontece na tarefa @c sd_writer.
  */
 void sdcard_flush()
 {
-    if (!g_sd_ok || !g_file)
+    g_flush_req = true;
+
+    if (g_writer)
     {
-        return;
+        xTaskNotifyGive(g_writer);
     }
-
-    g_file.flush();
 }
 
 /**
  * @brief Encerra o subsistema de SD, fechando o arquivo atual e desabilitando o uso.
+ *
+ * @note Linhas ainda no anel permanecem nele e são gravadas se o cartão voltar.
  */
 void sdcard_end()
 {
+    if (!g_io_lock)
+    {
+        return;
+    }
+
+    xSemaphoreTake(g_io_lock, portMAX_DELAY);
     close_file();
     g_sd_ok = false;
+    g_mounted = false;
+    xSemaphoreGive(g_io_lock);
+}
+
+/**
+ * @brief Posição acumulada (bytes desde o boot) do fim da última linha aceita.
+ */
+uint32_t sdcard_write_pos()
+{
+    sdcard_lock();
+    const uint32_t pos = g_put_pos;
+    sdcard_unlock();
+    return pos;
+}
+
+/**
+ * @brief Posição acumulada até a qual as linhas já passaram por flush no cartão.
+ *
+ * @details Uma linha aceita em @c sdcard_write_pos() == P está persistente quando
+ *          esta posição alcança P (comparação com aritmética modular).
+ */
+uint32_t sdcard_durable_pos()
+{
+    return __atomic_load_n(&g_durable_pos, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Total de linhas descartadas com o anel cheio desde o boot.
+ *
+ * @details Quem precisa saber se as linhas de um trecho chegaram ao anel compara o
+ *          valor antes e depois de emiti-las (um descarte de outra tarefa no meio
+ *          só produz um falso positivo).
+ */
+uint32_t sdcard_dropped_lines()
+{
+    sdcard_lock();
+    const uint32_t n = g_stats.dropped_lines;
+    sdcard_unlock();
+    return n;
+}
+
+/**
+ * @brief Copia os contadores do módulo.
+ * @param out Estrutura de destino.
+ */
+void sdcard_get_stats(SdStats *out)
+{
+    if (!out)
+    {
+        return;
+    }
+
+    sdcard_lock();
+    *out = g_stats;
+    out->held_bytes = (uint32_t)g_ring_len;
+    out->card_ok = g_sd_ok;
+    sdcard_unlock();
+}
+
+/**
+ * @brief Adquire o mutex (recursivo) que protege o anel de linhas.
+ *
+ * @details O logger também o utiliza para proteger seu buffer de linha e o serviço
+ *          de hora, de modo que tarefas distintas podem registrar com segurança.
+ *          Nunca é mantido durante um acesso ao cartão.
+ */
+void sdcard_lock()
+{
+    if (g_lock)
+    {
+        xSemaphoreTakeRecursive(g_lock, portMAX_DELAY);
+    }
+}
+
+/**
+ * @brief Libera o mutex adquirido em @c sdcard_lock().
+ */
+void sdcard_unlock()
+{
+    if (g_lock)
+    {
+        xSemaphoreGiveRecursive(g_lock);
+    }
 }
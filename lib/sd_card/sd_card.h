@@ -8,12 +8,44 @@
 #define SD_CARD_H
 
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
+/**
+ * @brief Contadores do registro no SD.
+ */
+typedef struct
+{
+    uint32_t held_bytes;     /* bytes no anel aguardando o cartão          */
+    uint32_t ring_peak;      /* maior ocupação do anel                     */
+    uint32_t dropped_bytes;  /* bytes descartados com o anel cheio         */
+    uint32_t dropped_lines;  /* linhas descartadas com o anel cheio        */
+    uint32_t written_bytes;  /* bytes gravados no arquivo de log           */
+    uint32_t write_errors;   /* falhas de gravação (cartão marcado ausente) */
+    uint32_t remounts;       /* remontagens bem-sucedidas após falha       */
+    uint32_t stalls;         /* gravações de um bloco acima de 500 ms      */
+    bool card_ok;            /* arquivo de log aberto e gravável           */
+} SdStats;
+
+void sdcard_init();
+bool sdcard_mount();
 void sdcard_begin();
 void sdcard_tick_rotate();
 void sdcard_printf(const char *fmt, ...) __attribute__((format(printf,1,2)));
 void sdcard_vprintf(const char *fmt, va_list ap);
+bool sdcard_write(const char *buf, size_t len);
+bool sdcard_append(const char *path, const char *buf, size_t len);
+bool sdcard_read(const char *path, char *buf, size_t max, size_t *out_len);
+bool sdcard_read_raw(uint32_t sector, uint8_t *buf);
+bool sdcard_write_raw(uint32_t sector, const uint8_t *buf);
 void sdcard_flush();
 void sdcard_end();
+void sdcard_lock();
+void sdcard_unlock();
+void sdcard_get_stats(SdStats *out);
+uint32_t sdcard_write_pos();
+uint32_t sdcard_durable_pos();
+uint32_t sdcard_dropped_lines();
 
 #endif /* SD_CARD_H */
@@ -0,0 +1,123 @@
+/**
+ * @file spi_bus.cpp
+ * @brief Mutex do barramento SPI com medição da espera do rádio e da duração
+ *        das transações do SD.
+ *
+ * O mutex é recursivo (uma mesma tarefa pode aninhar transações, ex.: abrir
+ * arquivo durante uma gravação) e herda prioridade: uma tarefa de baixa
+ * prioridade segurando o barramento é promovida até liberá-lo ao rádio.
+ */
+
+#include "spi_bus.h"
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+static SemaphoreHandle_t g_lock = nullptr;
+static TaskHandle_t g_owner = nullptr;
+static uint8_t g_depth = 0;
+static int64_t g_taken_us = 0;
+static SpiBusStats g_stats;
+
+/****************************** Funções privadas ******************************/
+
+/**
+ * @brief Atualiza @p slot com @p v se for maior (leitores concorrentes no /metrics).
+ */
+static void store_max(uint32_t *slot, uint32_t v)
+{
+    if (v > __atomic_load_n(slot, __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(slot, v, __ATOMIC_RELAXED);
+    }
+}
+
+/****************************** Funções públicas ******************************/
+
+/**
+ * @brief Cria o mutex do barramento; deve ser chamada antes do primeiro acesso SPI.
+ */
+void spi_bus_init(void)
+{
+    if (!g_lock)
+    {
+        g_lock = xSemaphoreCreateRecursiveMutex();
+    }
+}
+
+/**
+ * @brief Toma o barramento para uma transação de @p dev.
+ * @param dev Dispositivo que fará a transação.
+ */
+void spi_bus_acquire(SpiDevice dev)
+{
+    if (!g_lock)
+    {
+        return;
+    }
+
+    const int64_t t0 = esp_timer_get_time();
+    xSemaphoreTakeRecursive(g_lock, portMAX_DELAY);
+
+    if (g_depth++ == 0)
+    {
+        g_owner = xTaskGetCurrentTaskHandle();
+        g_taken_us = esp_timer_get_time();
+
+        const uint32_t wait_us = (uint32_t)(g_taken_us - t0);
+
+        /* Abaixo de ~50 us o mutex estava livre; não conta como contenção. */
+        if (dev == SPI_DEV_RADIO && wait_us > 50u)
+        {
+            __atomic_add_fetch(&g_stats.radio_waits, 1u, __ATOMIC_RELAXED);
+            store_max(&g_stats.radio_wait_max_us, wait_us);
+
+            if (wait_us > SPI_BUS_RADIO_BUDGET_US)
+            {
+                __atomic_add_fetch(&g_stats.radio_over_budget, 1u, __ATOMIC_RELAXED);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Libera o barramento tomado em @c spi_bus_acquire().
+ * @param dev Dispositivo que encerrou a transação.
+ */
+void spi_bus_release(SpiDevice dev)
+{
+    if (!g_lock || g_owner != xTaskGetCurrentTaskHandle())
+    {
+        return;
+    }
+
+    if (--g_depth == 0)
+    {
+        if (dev == SPI_DEV_SD)
+        {
+            store_max(&g_stats.sd_hold_max_us, (uint32_t)(esp_timer_get_time() - g_taken_us));
+        }
+
+        g_owner = nullptr;
+    }
+
+    xSemaphoreGiveRecursive(g_lock);
+}
+
+/**
+ * @brief Copia os contadores do barramento.
+ * @param out Estrutura de destino.
+ */
+void spi_bus_get_stats(SpiBusStats *out)
+{
+    if (!out)
+    {
+        return;
+    }
+
+    out->radio_waits = __atomic_load_n(&g_stats.radio_waits, __ATOMIC_RELAXED);
+    out->radio_over_budget = __atomic_load_n(&g_stats.radio_over_budget, __ATOMIC_RELAXED);
+    out->radio_wait_max_us = __atomic_load_n(&g_stats.radio_wait_max_us, __ATOMIC_RELAXED);
+    out->sd_hold_max_us = __atomic_load_n(&g_stats.sd_hold_max_us, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,48 @@
+/**
+ * @file spi_bus.h
+ * @brief Cabeçalho para a arbitragem do barramento SPI compartilhado entre o
+ *        rádio SX1278 e o cartão SD.
+ *
+ * Cada dispositivo toma o barramento por transação (@c spi_bus_acquire() /
+ * @c spi_bus_release()). O rádio é lido por uma tarefa de prioridade maior que a
+ * de qualquer escritor do SD; como o mutex entrega o barramento ao solicitante de
+ * maior prioridade, a espera do rádio fica limitada a uma transação do SD, e o SD
+ * grava em blocos de até @c SPI_BUS_SD_CHUNK bytes.
+ */
+
+#ifndef SPI_BUS_H
+#define SPI_BUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SPI_BUS_SD_CHUNK        512    /* maior gravação no SD por transação      */
+#define SPI_BUS_RADIO_BUDGET_US 5000   /* espera máxima tolerada pelo rádio       */
+
+/**
+ * @brief Dispositivos no barramento.
+ */
+typedef enum : uint8_t
+{
+    SPI_DEV_RADIO,
+    SPI_DEV_SD,
+    SPI_DEV_N
+} SpiDevice;
+
+/**
+ * @brief Contadores de uso do barramento.
+ */
+typedef struct
+{
+    uint32_t radio_waits;        /* aquisições do rádio que encontraram o bus ocupado */
+    uint32_t radio_over_budget;  /* esperas acima de @c SPI_BUS_RADIO_BUDGET_US       */
+    uint32_t radio_wait_max_us;  /* maior espera do rádio                              */
+    uint32_t sd_hold_max_us;     /* maior transação contínua do SD                     */
+} SpiBusStats;
+
+void spi_bus_init(void);
+void spi_bus_acquire(SpiDevice dev);
+void spi_bus_release(SpiDevice dev);
+void spi_bus_get_stats(SpiBusStats *out);
+
+#endif /* SPI_BUS_H */
@@ -10,6 +10,7 @@
 #include "pins.h"
 #include "crypto.h"
 #include "credentials.h"
+#include "spi_bus.h"
 #include "utils.h"
 
 static const char *TAG = "LORA";
@@ -27,14 +28,22 @@ bool lora_begin(void)
     LoRa.setSPI(SPI);
     LoRa.setPins(SX1278_SPI_SS, SX1278_RST, SX1278_DIO0);
 
-    if (!LoRa.begin(433E6))
+    spi_bus_acquire(SPI_DEV_RADIO);
+    const bool ok = LoRa.begin(433E6);
+
+    if (ok)
+    {
+        LoRa.setSyncWord(0xA5);
+    }
+
+    spi_bus_release(SPI_DEV_RADIO);
+
+    if (!ok)
     {
         LOG(TAG, "begin(433E6) falhou");
         return false;
     }
 
-    LoRa.setSyncWord(0xA5);
-
     LOG(TAG, "inicializado: freq=433MHz, sync=0xA5");
     return true;
 }
@@ -46,6 +55,9 @@ bool lora_begin(void)
  * @param out_rssi Ponteiro opcional para armazenar o valor do RSSI do pacote (dBm).
  * @param out_snr Ponteiro opcional para armazenar o valor do SNR do pacote (dB).
  * @return Número de bytes efetivamente lidos (0 se nenhum pacote foi recebido).
+ *
+ * @note Deve ser chamada com o barramento tomado (@c SPI_DEV_RADIO). Não registra
+ *       log: o logger toma o mutex do SD, que pode estar esperando o barramento.
  */
 uint32_t lora_read_packet(uint8_t *buf, uint16_t max_len, int16_t *out_rssi, float *out_snr)
 {
@@ -78,39 +90,63 @@ uint32_t lora_read_packet(uint8_t *buf, uint16_t max_len, int16_t *out_rssi, flo
         *out_snr = LoRa.packetSnr();
     }
 
-    LOG(TAG, "RX %u bytes (RSSI=%d, SNR=%.1f)", (unsigned)n,
-         out_rssi ? *out_rssi : 0, out_snr ? *out_snr : 0.0f);
     return n;
 }
 
 /**
- * @brief Faz o parse de um payload bruto para a estrutura PayloadPacked.
- * @param buf Ponteiro para o buffer com os dados recebidos.
- * @param len Tamanho do buffer (deve ser exatamente sizeof(PayloadPacked)).
- * @param out Ponteiro para a estrutura PayloadPacked a ser preenchida.
+ * @brief Transmite um quadro curto e devolve o rádio à recepção contínua.
+ * @param buf Quadro a transmitir.
+ * @param len Tamanho do quadro (até @c LORA_MAX_PACKET_LEN).
+ * @return Verdadeiro se a transmissão terminou, falso caso contrário.
+ *
+ * @note Bloqueia durante o tempo no ar com o barramento tomado; enquanto transmite,
+ *       o rádio não recebe, então a tarefa do rádio não disputa o barramento. Não
+ *       registra log, pelo mesmo motivo de @c lora_read_packet().
+ */
+bool lora_send(const uint8_t *buf, size_t len)
+{
+    if (!buf || len == 0 || len > LORA_MAX_PACKET_LEN)
+    {
+        return false;
+    }
+
+    spi_bus_acquire(SPI_DEV_RADIO);
+    bool ok = LoRa.beginPacket() == 1;
+
+    if (ok)
+    {
+        ok = LoRa.write(buf, len) == len && LoRa.endPacket() == 1;
+    }
+
+    LoRa.receive();
+    spi_bus_release(SPI_DEV_RADIO);
+    return ok;
+}
+
+/**
+ * @brief Valida e decodifica um payload em claro conforme o schema selecionado.
+ * @param schema Schema retornado por @c payload_schema_select().
+ * @param buf Ponteiro para o buffer com os dados descriptografados.
+ * @param len Tamanho do buffer.
+ * @param out Ponteiro para a leitura a ser preenchida.
  * @return true se o payload for válido e o parse bem-sucedido, false caso contrário.
  */
-bool lora_parse_payload(const uint8_t *buf, size_t len, PayloadPacked *out)
+bool lora_parse_payload(const PayloadSchema *schema, const uint8_t *buf, size_t len,
+                        SensorReading *out)
 {
-    if (!buf || !out || len != sizeof(PayloadPacked))
+    if (!schema || !buf || !out || len < schema->body_len)
     {
         LOG(TAG, "parse_payload: tamanho invalido (len=%u, esperado=%u)",
-             (unsigned)len, (unsigned)sizeof(PayloadPacked));
+             (unsigned)len, schema ? (unsigned)schema->body_len : 0u);
         return false;
     }
 
-    uint8_t calc = utils_checksum8(buf, sizeof(PayloadPacked) - 1);
-
-    if (calc != buf[sizeof(PayloadPacked) - 1])
+    if (!payload_schema_decode(schema, buf, len, out))
     {
-        LOG(TAG, "checksum invalido (calc=0x%02X, rx=0x%02X)", calc, buf[10]);
+        LOG(TAG, "checksum invalido (calc=0x%02X, rx=0x%02X)",
+             utils_checksum8(buf, len - 1), buf[len - 1]);
         return false;
     }
 
-    out->irradiance = utils_rd_le_u16(&buf[0]);
-    out->battery_voltage = utils_rd_le_u16(&buf[2]);
-    out->internal_temperature = utils_rd_le_i16(&buf[4]);
-    out->timestamp = utils_rd_le_u32(&buf[6]);
-    out->checksum = buf[10];
     return true;
-}
\ No newline at end of file
+}
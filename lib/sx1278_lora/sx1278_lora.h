@@ -9,9 +9,31 @@
 #include <Arduino.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include "payload_schema.h"
+
+/* Maior pacote aceito pelo SX1278 (FIFO de 256 B, comprimento em 8 bits). */
+#define LORA_MAX_PACKET_LEN 255
+
+/**
+ * @brief Com 1, o gateway confirma cada quadro válido com um ACK curto
+ *        [LORA_ACK_TYPE][etiqueta de 16 B] e volta à recepção contínua.
+ *
+ * A etiqueta é o AES-CMAC do IV + ciphertext do quadro sob a chave de ACK, que é
+ * AES-CMAC_{chave do quadro}("LORA-ACK-KEY-v1") (ver @c crypto_ack_tag()).
+ */
+#ifndef LORA_ACK_ENABLE
+#define LORA_ACK_ENABLE 0
+#endif
+
+#define LORA_ACK_TYPE       0xAC
+#define LORA_ACK_LEN        17
+#define LORA_ACK_WINDOW_US  250000  /* após o RxDone; depois disso o nó já desistiu */
 
 /**
  * @brief Estrutura para o payload compactado enviado via LoRa.
+ *
+ * @details Layout de fio da versão 1; a decodificação é feita pela tabela
+ *          de campos em @c payload_schema.cpp.
  */
 typedef struct __attribute__((packed))
 {
@@ -25,6 +47,8 @@ _Static_assert(sizeof(PayloadPacked) == 11, "Payload deve ter 11 bytes");
 
 bool lora_begin(void);
 uint32_t lora_read_packet(uint8_t *buf, uint16_t max_len, int16_t *out_rssi, float *out_snr);
-bool lora_parse_payload(const uint8_t *buf, size_t len, PayloadPacked *out);
+bool lora_send(const uint8_t *buf, size_t len);
+bool lora_parse_payload(const PayloadSchema *schema, const uint8_t *buf, size_t len,
+                        SensorReading *out);
 
 #endif /* SX1278_LORA_H */
@@ -1,77 +1,735 @@
 /**
  * @file thingspeak_client.cpp
- * @brief Implementação do cliente ThingSpeak (HTTP).
+ * @brief Implementação do cliente ThingSpeak (HTTPS) com agregação por janela.
+ *
+ * - @c thingspeak_add() incorpora a leitura à janela corrente (sem rede).
+ * - @c thingspeak_tick() envia a janela consolidada quando o instante permitido
+ *   pelo canal chega: média dos campos válidos e timestamp da última leitura nos
+ *   fieldN, e mínimo..máximo de cada campo no texto de @c status da entrada.
+ * - A resposta do canal é o id da entrada criada; "0" indica atualização recusada.
+ * - O POST usa um socket direto e buffers estáticos, e a conexão (com TLS, já
+ *   negociada) fica aberta entre os envios enquanto o servidor aceitar keep-alive.
+ *   Só uma reconexão faz handshake, e só ele aloca (o estado temporário do
+ *   mbedtls); o contexto SSL é criado uma vez e a sessão anterior é oferecida para
+ *   retomada. O endereço resolvido é guardado até um connect falhar.
+ * - O certificado do servidor é sempre verificado (@c THINGSPEAK_CA_PEM); só
+ *   @c THINGSPEAK_TLS_INSECURE_NO_VERIFY=1 desliga a verificação.
  */
 
 #include "thingspeak_client.h"
 #include <WiFi.h>
-#include <HTTPClient.h>
+#include <ctype.h>
+#include <lwip/sockets.h>
+#include <stdlib.h>
+#include <string.h>
+#include "credentials.h"
+#include "fault_inject.h"
+#include "fmt.h"
 #include "wifi_manager.h"
 #include "logger.h"
+#include "thingspeak_ca.h"
+
+/* Sobrescrevíveis em credentials.h (ex.: servidor local de teste com CA própria). */
+#ifndef THINGSPEAK_HOST
+#define THINGSPEAK_HOST     "api.thingspeak.com"
+#endif
+#ifndef THINGSPEAK_PORT
+#define THINGSPEAK_PORT     (THINGSPEAK_TLS ? 443 : 80)
+#endif
+#ifndef THINGSPEAK_CA_PEM
+#define THINGSPEAK_CA_PEM   kThingSpeakRootCaPem   /* raízes DigiCert (thingspeak_ca.h) */
+#endif
+/* 1 = aceita qualquer certificado (só para testes locais; expõe a chave de escrita
+ * a quem interceptar a conexão). Sem CA e sem esta opção, o TLS é recusado. */
+#ifndef THINGSPEAK_TLS_INSECURE_NO_VERIFY
+#define THINGSPEAK_TLS_INSECURE_NO_VERIFY 0
+#endif
+#define TS_IO_TIMEOUT_MS    5000
+#define TS_ERR_CONNECT      (-1)   /* DNS, socket ou connect    */
+#define TS_ERR_TIMEOUT      (-11)  /* envio ou resposta ausente */
+#define TS_STATUS_PAIR_MAX  (8 + 2 * FMT_FIXED_MAX + 2)   /* "%2C+fN+" mín ".." máx */
 
 static const char *TAG = "TS";
 
+/**
+ * @brief Agregado das leituras recebidas desde a última atualização aceita.
+ */
+typedef struct
+{
+    uint8_t version;                     /* schema das leituras agregadas       */
+    uint32_t count;                      /* leituras na janela                  */
+    uint8_t checksum;                    /* checksum da última leitura          */
+    uint32_t valid[SCHEMA_MAX_FIELDS];   /* amostras sem sentinela, por campo   */
+    int64_t sum[SCHEMA_MAX_FIELDS];
+    int32_t min[SCHEMA_MAX_FIELDS];
+    int32_t max[SCHEMA_MAX_FIELDS];
+    int32_t last[SCHEMA_MAX_FIELDS];
+    uint32_t timestamp;                  /* timestamp da última leitura         */
+} Window;
+
+static const char *g_api_key = "";
+static Window g_win;
+static bool g_sent_once = false;
+static bool g_wifi_wait = false;   /* janela pronta esperando o Wi-Fi */
+static uint32_t g_next_ms = 0;
+static ThingSpeakStats g_stats;
+static IPAddress g_host_ip;
+static int g_fd = -1;      /* conexão mantida entre envios (-1 = fechada)      */
+static char g_hdr[160];    /* cabeçalho do POST; descarte do corpo da resposta */
+static char g_resp[256];   /* uma linha de cabeçalho por vez; id da entrada     */
+#if THINGSPEAK_TLS
+static TlsTransport g_tls;
+#endif
+
 /****************************** Funções privadas ******************************/
 
 /**
- * @brief Executa um POST simples (form-urlencoded).
- * @param url URL de destino.
- * @param body Corpo do POST no formato "k=v&...".
- * @return true em caso de HTTP 200 com payload; false caso contrário.
+ * @brief Resolve o host do canal, reaproveitando o endereço da última conexão.
+ * @return true se @c g_host_ip contém um endereço válido.
  */
-static bool http_post_form(const String &url, const String &body)
+static bool host_resolve(void)
 {
-    if (!wifi_is_connected())
+    if ((uint32_t)g_host_ip != 0u)
     {
+        return true;
+    }
+
+    return WiFi.hostByName(THINGSPEAK_HOST, g_host_ip) == 1;
+}
+
+#if !THINGSPEAK_TLS
+/**
+ * @brief Envia todo o buffer pelo socket.
+ */
+static bool sock_send_all(int fd, const char *buf, size_t len)
+{
+    while (len)
+    {
+        const ssize_t n = send(fd, buf, len, 0);
+
+        if (n <= 0)
+        {
+            return false;
+        }
+
+        buf += n;
+        len -= (size_t)n;
+    }
+
+    return true;
+}
+#endif
+
+/**
+ * @brief Abre a conexão com o canal: endereço em cache, socket, connect e, com TLS,
+ *        o handshake (oferecendo a sessão anterior).
+ * @return true se @c g_fd está conectado.
+ */
+static bool conn_open(void)
+{
+    if (!host_resolve())
+    {
+        LOG(TAG, "DNS de %s falhou", THINGSPEAK_HOST);
         return false;
     }
 
-    HTTPClient http;
-    WiFiClient client;
+    const int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
 
-    if (!http.begin(client, url))
+    if (fd < 0)
     {
-        LOG(TAG, "http.begin() falhou");
+        LOG(TAG, "socket() falhou");
         return false;
     }
 
-    http.addHeader("Content-Type", "application/x-www-form-urlencoded");
+    const struct timeval tv = { TS_IO_TIMEOUT_MS / 1000, 0 };
+    (void)setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    (void)setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(THINGSPEAK_PORT);
+    addr.sin_addr.s_addr = (uint32_t)g_host_ip;
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        /* O endereço pode ter mudado: resolve de novo na próxima tentativa. */
+        g_host_ip = IPAddress((uint32_t)0);
+        close(fd);
+        LOG(TAG, "connect() falhou");
+        return false;
+    }
+
+#if THINGSPEAK_TLS
+    /* Em falha, o transporte já fechou o socket e descartou a sessão guardada. */
+    if (!tls_connect(&g_tls, fd))
+    {
+        return false;
+    }
+#endif
+
+    g_fd = fd;
+    return true;
+}
+
+/**
+ * @brief Envia pela conexão aberta (TLS ou o socket direto).
+ */
+static bool conn_send_all(const char *buf, size_t len)
+{
+#if THINGSPEAK_TLS
+    return tls_send_all(&g_tls, buf, len);
+#else
+    return sock_send_all(g_fd, buf, len);
+#endif
+}
+
+/**
+ * @brief Lê da conexão aberta; <= 0 indica fim ou erro.
+ */
+static ssize_t conn_recv(char *buf, size_t len)
+{
+#if THINGSPEAK_TLS
+    return tls_recv(&g_tls, buf, len);
+#else
+    return recv(g_fd, buf, len, 0);
+#endif
+}
+
+static void conn_close(void)
+{
+    if (g_fd < 0)
+    {
+        return;
+    }
+
+#if THINGSPEAK_TLS
+    tls_close(&g_tls);
+#else
+    close(g_fd);
+#endif
+    g_fd = -1;
+}
+
+/**
+ * @brief Se @p line começa pelo cabeçalho @p name (sem distinção de caixa),
+ *        devolve o valor, sem os espaços iniciais.
+ */
+static const char *header_value(const char *line, const char *name)
+{
+    for (; *name; ++name, ++line)
+    {
+        if (tolower((unsigned char)*line) != tolower((unsigned char)*name))
+        {
+            return nullptr;
+        }
+    }
+
+    while (*line == ' ' || *line == '\t')
+    {
+        line++;
+    }
+
+    return line;
+}
+
+/**
+ * @brief Lê a resposta inteira, uma linha de cabeçalho por vez em @c g_resp.
+ * @param code Recebe o status HTTP.
+ * @param entry_id Recebe o id da entrada (corpo da resposta).
+ * @param keep Recebe true se o servidor mantém a conexão para o próximo envio.
+ * @param got_any Recebe true se algum byte da resposta chegou.
+ * @return false se a conexão caiu antes do fim da resposta ou se ela é inválida.
+ *
+ * @details Os cabeçalhos são descartados à medida que são lidos, de modo que o
+ *          buffer só precisa comportar a maior linha; do corpo, só o início
+ *          (o id da entrada) é guardado. Sem @c Content-Length, o corpo vai até o
+ *          servidor fechar a conexão.
+ */
+static bool read_response(int32_t *code, long *entry_id, bool *keep, bool *got_any)
+{
+    size_t used = 0;
+    bool status = false;
+    long body_len = -1;
+    *keep = false;
+    *got_any = false;
+
+    for (;;)
+    {
+        char *eol = (char *)memchr(g_resp, '\n', used);
+
+        if (!eol)
+        {
+            if (used >= sizeof(g_resp) - 1u)
+            {
+                LOG(TAG, "linha de cabecalho longa demais");
+                return false;
+            }
+
+            const ssize_t n = conn_recv(g_resp + used, sizeof(g_resp) - 1u - used);
+
+            if (n <= 0)
+            {
+                return false;
+            }
+
+            used += (size_t)n;
+            *got_any = true;
+            continue;
+        }
+
+        const size_t line_len = (size_t)(eol + 1 - g_resp);
+        *eol = '\0';
+
+        if (eol > g_resp && eol[-1] == '\r')
+        {
+            eol[-1] = '\0';
+        }
+
+        const char *v;
+
+        if (!status)
+        {
+            /* "HTTP/1.x NNN ..." */
+            const char *sp = strchr(g_resp, ' ');
+
+            if (strncmp(g_resp, "HTTP/", 5) != 0 || !sp)
+            {
+                LOG(TAG, "resposta HTTP invalida");
+                return false;
+            }
+
+            *code = (int32_t)strtol(sp + 1, nullptr, 10);
+            status = true;
+        }
+        else if (g_resp[0] == '\0')
+        {
+            memmove(g_resp, g_resp + line_len, used - line_len);
+            used -= line_len;
+            break;
+        }
+        else if ((v = header_value(g_resp, "Content-Length:")) != nullptr)
+        {
+            body_len = strtol(v, nullptr, 10);
+        }
+        else if ((v = header_value(g_resp, "Connection:")) != nullptr)
+        {
+            *keep = header_value(v, "keep-alive") != nullptr;
+        }
+
+        memmove(g_resp, g_resp + line_len, used - line_len);
+        used -= line_len;
+    }
+
+    /* Corpo: guarda o início, descarta o resto. */
+    const size_t keep_max = sizeof(g_resp) - 1u;
+    size_t got = used;
+
+    while (body_len < 0 || got < (size_t)body_len)
+    {
+        char *dst = (used < keep_max) ? g_resp + used : g_hdr;
+        const size_t room = (used < keep_max) ? keep_max - used : sizeof(g_hdr);
+        const ssize_t n = conn_recv(dst, room);
+
+        if (n <= 0)
+        {
+            if (body_len >= 0)
+            {
+                return false;
+            }
 
-    int32_t code = http.POST(body);
-    String payload = http.getString();
-    http.end();
+            break;
+        }
 
-    LOG(TAG, "HTTP %d, payload_len=%d", code, payload.length());
-    return (code == 200) && payload.length() > 0;
+        got += (size_t)n;
+        used += (dst == g_hdr) ? 0u : (size_t)n;
+    }
+
+    g_resp[used] = '\0';
+    *entry_id = strtol(g_resp, nullptr, 10);
+    *keep = *keep && body_len >= 0;
+    return true;
+}
+
+/**
+ * @brief Envia cabeçalho e corpo e lê a resposta pela conexão aberta.
+ */
+static bool exchange(size_t hdr_len, const char *body, size_t body_len, int32_t *code,
+                     long *entry_id, bool *keep, bool *got_any)
+{
+    *got_any = false;
+    return conn_send_all(g_hdr, hdr_len) && conn_send_all(body, body_len) &&
+           read_response(code, entry_id, keep, got_any);
+}
+
+/**
+ * @brief Executa um POST simples (form-urlencoded) em /update.
+ * @param body Corpo do POST no formato "k=v&...".
+ * @param body_len Tamanho do corpo.
+ * @param entry_id Recebe o id da entrada criada (0 = recusada pelo canal).
+ * @return Código HTTP (negativo em erro de conexão).
+ *
+ * @details Socket lwip direto (com o transporte TLS por cima, se habilitado), sem
+ *          HTTPClient/String: cabeçalho e resposta usam buffers estáticos. A conexão
+ *          fica aberta enquanto o servidor aceitar keep-alive, e o próximo envio
+ *          não refaz connect nem handshake. Se o servidor já tiver fechado a conexão
+ *          ociosa (nada da resposta chega), ela é reaberta e o POST reenviado uma vez.
+ */
+static int32_t http_post_form(const char *body, size_t body_len, long *entry_id)
+{
+    *entry_id = 0;
+
+    if (fault_hit(FAULT_HTTP))
+    {
+        LOG(TAG, "timeout HTTP injetado");
+        conn_close();
+        return TS_ERR_TIMEOUT;
+    }
+
+    const bool reused = g_fd >= 0;
+
+    if (!reused && !conn_open())
+    {
+        return TS_ERR_CONNECT;
+    }
+
+    /* HTTP/1.0 com keep-alive: o servidor responde com Content-Length (sem chunked)
+     * ou fecha a conexão ao fim da resposta. */
+    char *p = fmt_str(g_hdr, "POST /update HTTP/1.0\r\n"
+                             "Host: " THINGSPEAK_HOST "\r\n"
+                             "Connection: keep-alive\r\n"
+                             "Content-Type: application/x-www-form-urlencoded\r\n"
+                             "Content-Length: ");
+    p = fmt_u32(p, (uint32_t)body_len);
+    p = fmt_str(p, "\r\n\r\n");
+    const size_t hdr_len = (size_t)(p - g_hdr);
+
+    int32_t code = 0;
+    bool keep = false;
+    bool got_any = false;
+    bool ok = exchange(hdr_len, body, body_len, &code, entry_id, &keep, &got_any);
+
+    if (!ok && reused && !got_any)
+    {
+        LOG(TAG, "conexao mantida caiu, reabrindo");
+        conn_close();
+
+        if (!conn_open())
+        {
+            return TS_ERR_CONNECT;
+        }
+
+        ok = exchange(hdr_len, body, body_len, &code, entry_id, &keep, &got_any);
+    }
+
+    if (!ok)
+    {
+        conn_close();
+        LOG(TAG, "%s falhou", got_any ? "resposta" : "envio");
+        return TS_ERR_TIMEOUT;
+    }
+
+    if (!keep)
+    {
+        conn_close();
+    }
+
+    LOG(TAG, "HTTP %d, entry=%ld", code, *entry_id);
+    return code;
+}
+
+/**
+ * @brief Divisão inteira arredondada ao mais próximo (meio afastado de zero).
+ */
+static int32_t round_div(int64_t num, uint32_t den)
+{
+    const int64_t half = (int64_t)(den / 2u);
+    return (int32_t)((num >= 0 ? num + half : num - half) / (int64_t)den);
+}
+
+/**
+ * @brief Monta a leitura consolidada da janela: média dos campos válidos,
+ *        timestamp da última leitura; campos sem amostra válida ficam em erro.
+ */
+static void window_consolidate(const PayloadSchema *s, SensorReading *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->version = g_win.version;
+    out->checksum = g_win.checksum;
+    out->timestamp = g_win.timestamp;
+
+    for (uint8_t i = 0; i < s->n_fields; ++i)
+    {
+        if (g_win.valid[i] == 0)
+        {
+            out->value[i] = (int32_t)s->fields[i].sentinel;
+            out->error_mask |= 1u << i;
+        }
+        else if (i == s->ts_index)
+        {
+            out->value[i] = g_win.last[i];
+        }
+        else
+        {
+            out->value[i] = round_div(g_win.sum[i], g_win.valid[i]);
+        }
+    }
+}
+
+/**
+ * @brief Loga último/média/mínimo/máximo de cada campo da janela.
+ */
+static void window_log(const PayloadSchema *s, const SensorReading *mean)
+{
+    LOG(TAG, "janela com %u leituras", (unsigned)g_win.count);
+
+    for (uint8_t i = 0; i < s->n_fields; ++i)
+    {
+        const FieldDesc *f = &s->fields[i];
+
+        if (i == s->ts_index || g_win.valid[i] == 0)
+        {
+            continue;
+        }
+
+        char v_last[FMT_FIXED_MAX + 1], v_mean[FMT_FIXED_MAX + 1];
+        char v_min[FMT_FIXED_MAX + 1], v_max[FMT_FIXED_MAX + 1];
+        *payload_schema_render(f, g_win.last[i], f->log_decimals, v_last) = '\0';
+        *payload_schema_render(f, mean->value[i], f->log_decimals, v_mean) = '\0';
+        *payload_schema_render(f, g_win.min[i], f->log_decimals, v_min) = '\0';
+        *payload_schema_render(f, g_win.max[i], f->log_decimals, v_max) = '\0';
+        LOG(TAG, "%-12s: ult %s  med %s  min %s  max %s %s",
+            f->label, v_last, v_mean, v_min, v_max, f->unit);
+    }
+}
+
+/**
+ * @brief Acrescenta ao corpo o @c status da entrada com o mínimo e o máximo de cada
+ *        campo enviado, na escala do upload ("12 leituras, min..max f1 0..1980, f2 ...").
+ * @param p Fim atual do corpo.
+ * @param end Último byte utilizável do buffer (reservado para o terminador).
+ * @return Novo fim do corpo; @p p se nenhum campo tiver amostra ou couber.
+ */
+static char *window_status(const PayloadSchema *s, char *p, const char *end)
+{
+    if ((size_t)(end - p) <= 40u + TS_STATUS_PAIR_MAX)
+    {
+        return p;
+    }
+
+    char *q = fmt_str(p, "&status=");
+    q = fmt_u32(q, g_win.count);
+    q = fmt_str(q, "+leituras%2C+min..max");
+    bool any = false;
+
+    for (uint8_t i = 0; i < s->n_fields; ++i)
+    {
+        const FieldDesc *f = &s->fields[i];
+
+        if (f->upload_field == 0 || i == s->ts_index || g_win.valid[i] == 0)
+        {
+            continue;
+        }
+
+        if ((size_t)(end - q) <= TS_STATUS_PAIR_MAX)
+        {
+            break;
+        }
+
+        q = fmt_str(q, any ? "%2C+f" : "+f");
+        q = fmt_u32(q, f->upload_field);
+        *q++ = '+';
+        q = payload_schema_render(f, g_win.min[i], f->upload_decimals, q);
+        q = fmt_str(q, "..");
+        q = payload_schema_render(f, g_win.max[i], f->upload_decimals, q);
+        any = true;
+    }
+
+    if (!any)
+    {
+        *p = '\0';
+        return p;
+    }
+
+    *q = '\0';
+    return q;
 }
 
 /****************************** Funções públicas ******************************/
 
 /**
- * @brief Envia 4 campos para o ThingSpeak.
- * @param api_key Chave de escrita do canal.
- * @param field1_irradiance_Wm2 Irradiância (W/m^2). Use -1.0 em caso de erro.
- * @param field2_batt_V Tensão da bateria (V).
- * @param field3_temp_C Temperatura interna (°C).
- * @param field4_timestamp_s Timestamp em segundos.
- * @return true se resposta HTTP 200 e payload não vazio; false caso contrário.
+ * @brief Define a chave de escrita do canal e zera a janela e os contadores.
+ * @param api_key Chave de escrita do canal (deve permanecer válida).
+ */
+void thingspeak_begin(const char *api_key)
+{
+    g_api_key = api_key ? api_key : "";
+    memset(&g_win, 0, sizeof(g_win));
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_sent_once = false;
+    g_wifi_wait = false;
+    conn_close();
+#if THINGSPEAK_TLS
+    (void)tls_init(&g_tls, THINGSPEAK_HOST, THINGSPEAK_CA_PEM,
+                   THINGSPEAK_TLS_INSECURE_NO_VERIFY != 0);
+#endif
+}
+
+/**
+ * @brief Incorpora uma leitura à janela corrente.
+ * @param r Leitura decodificada.
+ *
+ * @note Uma leitura de outra versão de schema descarta a janela pendente.
  */
-bool thingspeak_update(const char *api_key,
-                       float field1_irradiance_Wm2,
-                       float field2_batt_V,
-                       float field3_temp_C,
-                       uint32_t field4_timestamp_s)
+void thingspeak_add(const SensorReading *r)
 {
+    const PayloadSchema *s = payload_schema_by_version(r->version);
+
+    if (!s)
+    {
+        return;
+    }
+
+    if (g_win.count && g_win.version != r->version)
+    {
+        LOG(TAG, "versao do payload mudou, janela de %u leituras descartada",
+            (unsigned)g_win.count);
+        g_stats.superseded++;
+        g_win.count = 0;
+    }
+
+    if (g_win.count == 0)
+    {
+        memset(&g_win, 0, sizeof(g_win));
+        g_win.version = r->version;
+    }
+
+    for (uint8_t i = 0; i < s->n_fields; ++i)
+    {
+        if (payload_schema_field_error(r, i))
+        {
+            continue;
+        }
+
+        const int32_t v = r->value[i];
+
+        if (g_win.valid[i] == 0 || v < g_win.min[i])
+        {
+            g_win.min[i] = v;
+        }
+
+        if (g_win.valid[i] == 0 || v > g_win.max[i])
+        {
+            g_win.max[i] = v;
+        }
+
+        g_win.sum[i] += v;
+        g_win.last[i] = v;
+        g_win.valid[i]++;
+    }
+
+    g_win.checksum = r->checksum;
+    g_win.timestamp = r->timestamp;
+    g_win.count++;
+    g_stats.aggregated++;
+}
+
+/**
+ * @brief Envia a janela consolidada se houver leituras e o canal já permitir.
+ * @param now_ms Tempo corrente (millis()).
+ * @return true se uma atualização foi aceita nesta chamada.
+ *
+ * @details Recusas e falhas mantêm a janela (novas leituras continuam sendo
+ *          agregadas) e reagendam o envio para o próximo intervalo permitido.
+ */
+bool thingspeak_tick(uint32_t now_ms)
+{
+    if (g_win.count == 0 || (g_sent_once && (int32_t)(now_ms - g_next_ms) < 0))
+    {
+        return false;
+    }
+
     if (!wifi_is_connected())
     {
-        LOG(TAG, "sem Wi-Fi, Nao enviado");
+        g_stats.wifi_waits += g_wifi_wait ? 0u : 1u;
+        g_wifi_wait = true;
+        return false;
+    }
+
+    g_wifi_wait = false;
+    const PayloadSchema *s = payload_schema_by_version(g_win.version);
+    SensorReading mean;
+    window_consolidate(s, &mean);
+    window_log(s, &mean);
+
+    char buf[384];
+    const size_t key_len = strlen(g_api_key);
+
+    if (key_len + 16u > sizeof(buf))
+    {
+        LOG(TAG, "api_key longa demais");
+        return false;
+    }
+
+    char *p = fmt_str(fmt_str(buf, "api_key="), g_api_key);
+    *p++ = '&';
+
+    const size_t n = payload_schema_upload_fields(&mean, p, sizeof(buf) - (size_t)(p - buf));
+
+    if (n == 0)
+    {
+        LOG(TAG, "corpo do POST nao coube no buffer");
+        return false;
+    }
+
+    p = window_status(s, p + n, buf + sizeof(buf) - 1u);
+
+    long entry = 0;
+    const int32_t code = http_post_form(buf, (size_t)(p - buf), &entry);
+
+    /* O canal conta o intervalo a partir da última requisição, aceita ou não. */
+    g_sent_once = true;
+    g_next_ms = millis() + THINGSPEAK_MIN_INTERVAL_MS;
+
+    if (code != 200)
+    {
+        g_stats.failed++;
+        LOG(TAG, "FALHA no envio, janela mantida");
+        return false;
+    }
+
+    if (entry <= 0)
+    {
+        g_stats.rejected++;
+        LOG(TAG, "atualizacao recusada pelo canal (aceitas=%lu, recusadas=%lu)",
+            (unsigned long)g_stats.accepted, (unsigned long)g_stats.rejected);
         return false;
     }
 
-    char buf[256];
-    snprintf(buf, sizeof(buf),
-             "api_key=%s&field1=%.1f&field2=%.3f&field3=%.1f&field4=%lu",
-             api_key, field1_irradiance_Wm2, field2_batt_V, field3_temp_C,
-             (uint32_t)field4_timestamp_s);
-    return http_post_form("http://api.thingspeak.com/update", String(buf));
+    g_stats.accepted++;
+    g_win.count = 0;
+    return true;
+}
+
+/**
+ * @brief Copia os contadores do cliente.
+ * @param out Estrutura de destino.
+ */
+void thingspeak_get_stats(ThingSpeakStats *out)
+{
+    if (out)
+    {
+        *out = g_stats;
+    }
+}
+
+#if THINGSPEAK_TLS
+/**
+ * @brief Copia os contadores de handshake TLS (completos x retomados).
+ * @param out Estrutura de destino.
+ */
+void thingspeak_get_tls_stats(TlsStats *out)
+{
+    tls_get_stats(&g_tls, out);
 }
+#endif
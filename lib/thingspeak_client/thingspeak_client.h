@@ -1,6 +1,19 @@
 /**
  * @file thingspeak_client.h
- * @brief Cabeçalho para as funções de cliente ThingSpeak (HTTP).
+ * @brief Cabeçalho para as funções de cliente ThingSpeak (HTTPS, ou HTTP com
+ *        @c THINGSPEAK_TLS=0).
+ *
+ * O canal aceita no máximo uma atualização a cada ~15 s; as leituras recebidas entre
+ * duas janelas são agregadas (último, média, mínimo, máximo por campo) e enviadas
+ * como uma única atualização consolidada quando a janela abre: a média em cada
+ * fieldN e o mínimo..máximo de cada campo no @c status da entrada.
+ *
+ * A conexão fica aberta entre as atualizações enquanto o servidor aceitar
+ * keep-alive. Com TLS, ao reconectar, a sessão anterior é oferecida para retomada
+ * (ver @c tls_transport.h) e o certificado é verificado contra as raízes de
+ * @c thingspeak_ca.h. O host, a porta e a CA (@c THINGSPEAK_CA_PEM) podem ser
+ * trocados em @c credentials.h, por exemplo para um servidor local com certificado
+ * autoassinado; sem CA, o TLS só é aceito com @c THINGSPEAK_TLS_INSECURE_NO_VERIFY=1.
  */
 
 #ifndef THINGSPEAK_CLIENT_H
@@ -8,11 +21,36 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "payload_schema.h"
 
-bool thingspeak_update(const char *api_key,
-                       float field1_irradiance_Wm2,
-                       float field2_batt_V,
-                       float field3_temp_C,
-                       uint32_t field4_timestamp_s);
+#define THINGSPEAK_MIN_INTERVAL_MS 15500  /* limite do canal + margem */
+
+#ifndef THINGSPEAK_TLS
+#define THINGSPEAK_TLS 1
+#endif
+
+/**
+ * @brief Contadores do cliente ThingSpeak.
+ */
+typedef struct
+{
+    uint32_t aggregated;  /* leituras incorporadas às janelas             */
+    uint32_t accepted;    /* atualizações aceitas (entry id > 0)          */
+    uint32_t rejected;    /* atualizações recusadas pelo canal (entry 0)  */
+    uint32_t failed;      /* falhas de rede/HTTP                          */
+    uint32_t wifi_waits;  /* janelas prontas adiadas por falta de Wi-Fi   */
+    uint32_t superseded;  /* janelas descartadas por troca de versão      */
+} ThingSpeakStats;
+
+void thingspeak_begin(const char *api_key);
+void thingspeak_add(const SensorReading *r);
+bool thingspeak_tick(uint32_t now_ms);
+void thingspeak_get_stats(ThingSpeakStats *out);
+
+#if THINGSPEAK_TLS
+#include "tls_transport.h"
+
+void thingspeak_get_tls_stats(TlsStats *out);
+#endif
 
 #endif /* THINGSPEAK_CLIENT_H */
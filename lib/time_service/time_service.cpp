@@ -0,0 +1,109 @@
+/**
+ * @file time_service.cpp
+ * @brief Serviço de hora local em cache: data quebrada e prefixo de timestamp
+ *        recalculados no máximo uma vez por segundo.
+ *
+ * O cache é invalidado sempre que @c time() muda, para frente ou para trás, de modo
+ * que saltos como epoch0 -> hora do DS1307 são refletidos na chamada seguinte.
+ *
+ * O cache não tem trava própria: toda chamada é feita sob @c sdcard_lock() (o
+ * logger já a detém ao formatar; o SD a toma na abertura e na rotação do arquivo).
+ */
+
+#include "time_service.h"
+#include <Arduino.h>
+#include <string.h>
+#include "fmt.h"
+
+/* "YYYY/MM/DD HH:MM:SS." (sem os milissegundos). */
+#define TS_PREFIX_LEN (FMT_DATETIME_LEN - 3)
+
+static time_t g_sec = (time_t)-1;
+static struct tm g_tm;
+static char g_prefix[FMT_DATETIME_LEN];
+static int g_ymd = -1;
+static uint32_t g_day_gen = 0;
+
+/****************************** Funções privadas ******************************/
+
+/**
+ * @brief Atualiza o cache se o segundo corrente mudou.
+ *
+ * Caminho comum: uma chamada a @c time() e uma comparação. Na troca de segundo,
+ * recalcula @c localtime_r(), o prefixo renderizado e a data @c YYYYMMDD; uma
+ * mudança de data incrementa a geração de dia.
+ */
+static void refresh(void)
+{
+    const time_t now = time(nullptr);
+
+    if (now == g_sec)
+    {
+        return;
+    }
+
+    g_sec = now;
+    localtime_r(&now, &g_tm);
+    (void)fmt_datetime(g_prefix, &g_tm, 0);
+
+    const int ymd = (g_tm.tm_year + 1900) * 10000 + (g_tm.tm_mon + 1) * 100 + g_tm.tm_mday;
+
+    if (ymd != g_ymd)
+    {
+        g_ymd = ymd;
+        g_day_gen++;
+    }
+}
+
+/****************************** Funções públicas ******************************/
+
+/**
+ * @brief Escreve o timestamp atual no formato "YYYY/MM/DD HH:MM:SS.mmm".
+ * @param out Buffer de saída (@c FMT_DATETIME_LEN caracteres, sem terminador).
+ * @return Ponteiro após o último caractere escrito.
+ */
+char *timesvc_format_now(char *out)
+{
+    refresh();
+    memcpy(out, g_prefix, TS_PREFIX_LEN);
+    return fmt_u32_pad(out + TS_PREFIX_LEN, (uint32_t)(millis() % 1000U), 3);
+}
+
+/**
+ * @brief Retorna a data/hora local do segundo corrente.
+ * @return Ponteiro para a estrutura em cache (válida até a próxima chamada do serviço).
+ */
+const struct tm *timesvc_now_tm(void)
+{
+    refresh();
+    return &g_tm;
+}
+
+/**
+ * @brief Retorna um contador incrementado a cada mudança de data local.
+ *
+ * @details Consumidores guardam o último valor visto; um valor diferente indica que
+ *          o dia mudou (inclusive pelo salto epoch0 -> hora válida).
+ */
+uint32_t timesvc_day_generation(void)
+{
+    refresh();
+    return g_day_gen;
+}
+
+/**
+ * @brief Retorna a data local corrente como @c YYYYMMDD.
+ */
+int timesvc_ymd(void)
+{
+    refresh();
+    return g_ymd;
+}
+
+/**
+ * @brief Informa se a data local corrente é 1970-01-01 (RTC ainda não sincronizado).
+ */
+bool timesvc_is_epoch0(void)
+{
+    return timesvc_ymd() == 19700101;
+}
@@ -0,0 +1,19 @@
+/**
+ * @file time_service.h
+ * @brief Cabeçalho para o serviço de hora local em cache (logger e rotação do SD).
+ */
+
+#ifndef TIME_SERVICE_H
+#define TIME_SERVICE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+char *timesvc_format_now(char *out);
+const struct tm *timesvc_now_tm(void);
+uint32_t timesvc_day_generation(void);
+int timesvc_ymd(void);
+bool timesvc_is_epoch0(void);
+
+#endif /* TIME_SERVICE_H */
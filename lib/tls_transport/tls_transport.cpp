@@ -0,0 +1,315 @@
+/**
+ * @file tls_transport.cpp
+ * @brief Transporte TLS sobre um socket lwip, com cache de uma sessão e tempos de
+ *        handshake separados entre completos e retomados.
+ *
+ * - O BIO usa o socket do chamador, com os timeouts que ele já configurou
+ *   (@c SO_RCVTIMEO/@c SO_SNDTIMEO); um timeout encerra o handshake com erro.
+ * - A sessão é oferecida por id e, se o mbedtls tiver suporte, por ticket; o
+ *   servidor decide se retoma. O handshake é contado como retomado quando o
+ *   master secret negociado é o da sessão oferecida (mbedtls 2.x do core
+ *   Arduino-ESP32, em que @c mbedtls_ssl_session expõe @c master).
+ * - Uma falha de handshake descarta a sessão guardada: a próxima conexão faz o
+ *   handshake completo, sem insistir em um id ou ticket que o servidor recusa.
+ */
+
+#include "tls_transport.h"
+#include <errno.h>
+#include <esp_timer.h>
+#include <lwip/sockets.h>
+#include <mbedtls/net_sockets.h>
+#include <string.h>
+#include "logger.h"
+
+static const char *TAG = "TLS";
+
+/****************************** Funções privadas ******************************/
+
+static int bio_send(void *ctx, const unsigned char *buf, size_t len)
+{
+    const int fd = *(const int *)ctx;
+    const ssize_t n = send(fd, buf, len, 0);
+
+    if (n >= 0)
+    {
+        return (int)n;
+    }
+
+    if (errno == EINTR)
+    {
+        return MBEDTLS_ERR_SSL_WANT_WRITE;
+    }
+
+    return (errno == EAGAIN || errno == EWOULDBLOCK) ? MBEDTLS_ERR_SSL_TIMEOUT
+                                                     : MBEDTLS_ERR_NET_SEND_FAILED;
+}
+
+static int bio_recv(void *ctx, unsigned char *buf, size_t len)
+{
+    const int fd = *(const int *)ctx;
+    const ssize_t n = recv(fd, buf, len, 0);
+
+    if (n >= 0)
+    {
+        return (int)n;   /* 0 = conexão fechada pelo servidor */
+    }
+
+    if (errno == EINTR)
+    {
+        return MBEDTLS_ERR_SSL_WANT_READ;
+    }
+
+    return (errno == EAGAIN || errno == EWOULDBLOCK) ? MBEDTLS_ERR_SSL_TIMEOUT
+                                                     : MBEDTLS_ERR_NET_RECV_FAILED;
+}
+
+static inline bool want_retry(int rc)
+{
+    return rc == MBEDTLS_ERR_SSL_WANT_READ || rc == MBEDTLS_ERR_SSL_WANT_WRITE;
+}
+
+static void close_fd(TlsTransport *t)
+{
+    if (t->fd >= 0)
+    {
+        close(t->fd);
+        t->fd = -1;
+    }
+}
+
+/****************************** Funções públicas ******************************/
+
+/**
+ * @brief Prepara RNG, CA e contexto SSL (alocados uma única vez).
+ * @param t Transporte em memória zerada (estático); chamadas repetidas não refazem nada.
+ * @param host Nome do servidor, usado no SNI e na verificação do certificado.
+ * @param ca_pem Certificado(s) PEM confiável(is).
+ * @param insecure_no_verify Com @p ca_pem nulo, aceita o servidor sem verificá-lo
+ *                           (só testes); sem esta opção, falta de CA é erro.
+ * @return true se o transporte está pronto para @c tls_connect().
+ */
+bool tls_init(TlsTransport *t, const char *host, const char *ca_pem, bool insecure_no_verify)
+{
+    if (t->ready)
+    {
+        return true;
+    }
+
+    if (!ca_pem && !insecure_no_verify)
+    {
+        LOG(TAG, "Sem CA para %s: TLS recusado (verificacao obrigatoria)", host);
+        return false;
+    }
+
+    mbedtls_entropy_init(&t->entropy);
+    mbedtls_ctr_drbg_init(&t->drbg);
+    mbedtls_x509_crt_init(&t->ca);
+    mbedtls_ssl_config_init(&t->conf);
+    mbedtls_ssl_init(&t->ssl);
+    mbedtls_ssl_session_init(&t->session);
+    t->has_session = false;
+    t->fd = -1;
+    memset(&t->stats, 0, sizeof(t->stats));
+
+    static const char kPers[] = "lora-gw-tls";
+    int rc = mbedtls_ctr_drbg_seed(&t->drbg, mbedtls_entropy_func, &t->entropy,
+                                   (const unsigned char *)kPers, sizeof(kPers) - 1u);
+
+    if (rc == 0)
+    {
+        rc = mbedtls_ssl_config_defaults(&t->conf, MBEDTLS_SSL_IS_CLIENT,
+                                         MBEDTLS_SSL_TRANSPORT_STREAM,
+                                         MBEDTLS_SSL_PRESET_DEFAULT);
+    }
+
+    if (rc == 0 && ca_pem)
+    {
+        /* Para PEM, o tamanho inclui o terminador. */
+        rc = mbedtls_x509_crt_parse(&t->ca, (const unsigned char *)ca_pem, strlen(ca_pem) + 1u);
+    }
+
+    if (rc != 0)
+    {
+        LOG(TAG, "Falha ao preparar o TLS: -0x%04x", (unsigned)-rc);
+        return false;
+    }
+
+    if (ca_pem)
+    {
+        mbedtls_ssl_conf_ca_chain(&t->conf, &t->ca, nullptr);
+        mbedtls_ssl_conf_authmode(&t->conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    }
+    else
+    {
+        mbedtls_ssl_conf_authmode(&t->conf, MBEDTLS_SSL_VERIFY_NONE);
+        LOG(TAG, "AVISO: modo inseguro, certificado de %s NAO verificado", host);
+    }
+
+    mbedtls_ssl_conf_rng(&t->conf, mbedtls_ctr_drbg_random, &t->drbg);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    mbedtls_ssl_conf_session_tickets(&t->conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+
+    rc = mbedtls_ssl_setup(&t->ssl, &t->conf);
+
+    if (rc == 0)
+    {
+        rc = mbedtls_ssl_set_hostname(&t->ssl, host);
+    }
+
+    if (rc != 0)
+    {
+        LOG(TAG, "Falha ao criar o contexto SSL: -0x%04x", (unsigned)-rc);
+        return false;
+    }
+
+    t->ready = true;
+    return true;
+}
+
+/**
+ * @brief Faz o handshake sobre @p fd, oferecendo a última sessão guardada.
+ * @param fd Socket TCP já conectado; passa a pertencer ao transporte (fechado
+ *           em @c tls_close() ou aqui, em caso de falha).
+ * @return true se o canal TLS está estabelecido.
+ */
+bool tls_connect(TlsTransport *t, int fd)
+{
+    t->fd = fd;
+
+    if (!t->ready)
+    {
+        close_fd(t);
+        return false;
+    }
+
+    mbedtls_ssl_session_reset(&t->ssl);
+    mbedtls_ssl_set_bio(&t->ssl, &t->fd, bio_send, bio_recv, nullptr);
+    const bool offered = t->has_session && mbedtls_ssl_set_session(&t->ssl, &t->session) == 0;
+
+    const int64_t t0 = esp_timer_get_time();
+    int rc;
+
+    do
+    {
+        rc = mbedtls_ssl_handshake(&t->ssl);
+    } while (want_retry(rc));
+
+    const uint32_t ms = (uint32_t)((esp_timer_get_time() - t0) / 1000);
+
+    if (rc != 0)
+    {
+        t->stats.failed++;
+        LOG(TAG, "Handshake falhou: -0x%04x, verificacao=0x%lx (%lu ms)", (unsigned)-rc,
+            (unsigned long)mbedtls_ssl_get_verify_result(&t->ssl), (unsigned long)ms);
+        tls_forget_session(t);
+        close_fd(t);
+        return false;
+    }
+
+    const bool resumed = offered && memcmp(t->ssl.session->master, t->session.master,
+                                           sizeof(t->session.master)) == 0;
+    TlsStats *st = &t->stats;
+    st->last_ms = ms;
+
+    if (resumed)
+    {
+        st->resumed++;
+        st->resumed_ms_sum += ms;
+        st->resumed_max_ms = (ms > st->resumed_max_ms) ? ms : st->resumed_max_ms;
+    }
+    else
+    {
+        st->full++;
+        st->full_ms_sum += ms;
+        st->full_max_ms = (ms > st->full_max_ms) ? ms : st->full_max_ms;
+    }
+
+    /* Guarda a sessão (com o ticket novo, se o servidor emitiu) para a próxima conexão. */
+    mbedtls_ssl_session_free(&t->session);
+    mbedtls_ssl_session_init(&t->session);
+    t->has_session = mbedtls_ssl_get_session(&t->ssl, &t->session) == 0;
+
+    LOG(TAG, "Handshake %s em %lu ms (%s)", resumed ? "retomado" : "completo",
+        (unsigned long)ms, mbedtls_ssl_get_ciphersuite(&t->ssl));
+    return true;
+}
+
+/**
+ * @brief Envia todo o buffer pelo canal TLS.
+ */
+bool tls_send_all(TlsTransport *t, const void *buf, size_t len)
+{
+    const unsigned char *p = (const unsigned char *)buf;
+
+    while (len)
+    {
+        const int rc = mbedtls_ssl_write(&t->ssl, p, len);
+
+        if (want_retry(rc))
+        {
+            continue;
+        }
+
+        if (rc <= 0)
+        {
+            return false;
+        }
+
+        p += rc;
+        len -= (size_t)rc;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Lê do canal TLS.
+ * @return Bytes lidos; 0 se o servidor encerrou; negativo em erro ou timeout.
+ */
+int tls_recv(TlsTransport *t, void *buf, size_t len)
+{
+    int rc;
+
+    do
+    {
+        rc = mbedtls_ssl_read(&t->ssl, (unsigned char *)buf, len);
+    } while (want_retry(rc));
+
+    return (rc == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) ? 0 : rc;
+}
+
+/**
+ * @brief Encerra a conexão (close_notify + fecha o socket); a sessão é mantida.
+ */
+void tls_close(TlsTransport *t)
+{
+    if (t->fd < 0)
+    {
+        return;
+    }
+
+    (void)mbedtls_ssl_close_notify(&t->ssl);
+    close_fd(t);
+}
+
+/**
+ * @brief Descarta a sessão guardada; o próximo handshake será completo.
+ */
+void tls_forget_session(TlsTransport *t)
+{
+    mbedtls_ssl_session_free(&t->session);
+    mbedtls_ssl_session_init(&t->session);
+    t->has_session = false;
+}
+
+/**
+ * @brief Copia os contadores de handshake.
+ */
+void tls_get_stats(const TlsTransport *t, TlsStats *out)
+{
+    if (out)
+    {
+        *out = t->stats;
+    }
+}
@@ -0,0 +1,64 @@
+/**
+ * @file tls_transport.h
+ * @brief Cabeçalho para o transporte TLS (mbedtls) dos clientes de uplink, com
+ *        retomada de sessão entre conexões e medição do tempo de handshake.
+ *
+ * O transporte recebe um socket TCP já conectado. Após cada handshake, a sessão
+ * (id e/ou ticket) é guardada e oferecida na conexão seguinte; se o servidor
+ * aceitar, o handshake abreviado dispensa a troca de chaves e a verificação do
+ * certificado. O contexto SSL e seus buffers são alocados uma vez, em
+ * @c tls_init(), e reaproveitados (@c mbedtls_ssl_session_reset()).
+ */
+
+#ifndef TLS_TRANSPORT_H
+#define TLS_TRANSPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/x509_crt.h>
+
+/**
+ * @brief Contadores e tempos de handshake.
+ */
+typedef struct
+{
+    uint32_t full;              /* handshakes completos                     */
+    uint32_t resumed;           /* handshakes com sessão retomada           */
+    uint32_t failed;            /* handshakes que falharam                  */
+    uint32_t full_ms_sum;
+    uint32_t resumed_ms_sum;
+    uint32_t full_max_ms;
+    uint32_t resumed_max_ms;
+    uint32_t last_ms;           /* último handshake, completo ou retomado   */
+} TlsStats;
+
+/**
+ * @brief Estado de um transporte (uma conexão por vez).
+ */
+typedef struct
+{
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_x509_crt ca;
+    mbedtls_ssl_config conf;
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_session session;   /* última sessão, oferecida no próximo handshake */
+    bool has_session;
+    bool ready;                    /* tls_init() concluída */
+    int fd;                        /* -1 = sem conexão     */
+    TlsStats stats;
+} TlsTransport;
+
+bool tls_init(TlsTransport *t, const char *host, const char *ca_pem, bool insecure_no_verify);
+bool tls_connect(TlsTransport *t, int fd);
+bool tls_send_all(TlsTransport *t, const void *buf, size_t len);
+int tls_recv(TlsTransport *t, void *buf, size_t len);
+void tls_close(TlsTransport *t);
+void tls_forget_session(TlsTransport *t);
+void tls_get_stats(const TlsTransport *t, TlsStats *out);
+
+#endif /* TLS_TRANSPORT_H */
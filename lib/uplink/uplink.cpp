@@ -0,0 +1,278 @@
+/**
+ * @file uplink.cpp
+ * @brief Distribuição de leituras aos sinks registrados: fila e tarefa por destino.
+ *
+ * - @c uplink_submit() nunca bloqueia: copia a leitura para a fila de cada sink e,
+ *   se uma fila estiver cheia, descarta a leitura mais antiga dela.
+ * - A tarefa de cada sink entrega as leituras em ordem, com espera exponencial
+ *   entre tentativas, limitada por @c retry_max_ms.
+ */
+
+#include "uplink.h"
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include "logger.h"
+#include "wifi_manager.h"
+
+#define UPLINK_TASK_PRIO 1
+
+static const char *TAG = "UPLINK";
+
+/**
+ * @brief Estado de execução de um sink registrado.
+ */
+typedef struct
+{
+    const UplinkSink *sink;
+    QueueHandle_t queue;
+    TaskHandle_t task;
+    UplinkStats stats;
+} SinkSlot;
+
+static SinkSlot g_slots[UPLINK_MAX_SINKS];
+static uint8_t g_count = 0;
+static bool g_started = false;
+
+/****************************** Funções privadas ******************************/
+
+/**
+ * @brief Espera @p ms chamando @c idle() a cada @c idle_ms.
+ */
+static void wait_with_idle(const UplinkSink *s, uint32_t ms)
+{
+    const uint32_t t0 = millis();
+
+    while ((millis() - t0) < ms)
+    {
+        if (s->idle)
+        {
+            s->idle(millis());
+        }
+
+        const uint32_t left = ms - (millis() - t0);
+        vTaskDelay(pdMS_TO_TICKS(left < s->idle_ms ? left : s->idle_ms));
+    }
+}
+
+/**
+ * @brief Entrega uma leitura, repetindo conforme a política do sink.
+ */
+static void deliver(SinkSlot *slot, const SensorReading *r)
+{
+    const UplinkSink *s = slot->sink;
+    uint32_t backoff = s->retry_min_ms;
+    uint8_t attempt = 0;
+    bool waiting = false;
+
+    for (;;)
+    {
+        if (s->needs_wifi && !wifi_is_connected())
+        {
+            /* Sem rede não há tentativa; a fila limitada absorve o acúmulo. */
+            slot->stats.wifi_waits += waiting ? 0u : 1u;
+            waiting = true;
+            wait_with_idle(s, s->idle_ms);
+            continue;
+        }
+
+        waiting = false;
+        attempt++;
+
+        if (s->send(r))
+        {
+            slot->stats.delivered++;
+            slot->stats.last_ok_ms = millis();
+            return;
+        }
+
+        slot->stats.send_errors++;
+
+        if (s->max_attempts && attempt >= s->max_attempts)
+        {
+            slot->stats.failed++;
+            LOG(s->name, "FALHA no envio, leitura descartada apos %u tentativas",
+                (unsigned)attempt);
+            return;
+        }
+
+        slot->stats.retries++;
+        LOG(s->name, "FALHA no envio, nova tentativa em %lu ms", (unsigned long)backoff);
+        wait_with_idle(s, backoff);
+        backoff = (backoff >= s->retry_max_ms / 2u) ? s->retry_max_ms : backoff * 2u;
+    }
+}
+
+/**
+ * @brief Tarefa de um sink: consome a fila e chama @c idle() a cada iteração.
+ * @param arg Ponteiro para o @c SinkSlot.
+ */
+static void sink_task(void *arg)
+{
+    SinkSlot *slot = (SinkSlot *)arg;
+    const UplinkSink *s = slot->sink;
+    SensorReading r;
+
+    for (;;)
+    {
+        if (xQueueReceive(slot->queue, &r, pdMS_TO_TICKS(s->idle_ms)) == pdTRUE)
+        {
+            deliver(slot, &r);
+        }
+
+        /* Também após cada entrega, para não ser adiada por um fluxo contínuo. */
+        if (s->idle)
+        {
+            s->idle(millis());
+        }
+    }
+}
+
+/****************************** Funções públicas ******************************/
+
+/**
+ * @brief Registra um sink; deve ser chamada antes de @c uplink_start().
+ * @param sink Descrição do destino (deve permanecer válida).
+ * @return false se não houver espaço ou se a distribuição já foi iniciada.
+ */
+bool uplink_register(const UplinkSink *sink)
+{
+    if (!sink || !sink->send || g_started || g_count >= UPLINK_MAX_SINKS)
+    {
+        return false;
+    }
+
+    g_slots[g_count].sink = sink;
+    g_slots[g_count].queue = nullptr;
+    g_slots[g_count].task = nullptr;
+    g_count++;
+    return true;
+}
+
+/**
+ * @brief Cria a fila e a tarefa de cada sink registrado.
+ * @return true se todos os sinks foram iniciados.
+ */
+bool uplink_start(void)
+{
+    bool ok = true;
+
+    for (uint8_t i = 0; i < g_count; ++i)
+    {
+        SinkSlot *slot = &g_slots[i];
+        const UplinkSink *s = slot->sink;
+        slot->queue = xQueueCreate(s->queue_len, sizeof(SensorReading));
+
+        if (!slot->queue ||
+            xTaskCreate(sink_task, s->name, s->stack_bytes, slot, UPLINK_TASK_PRIO,
+                        &slot->task) != pdPASS)
+        {
+            LOG(TAG, "falha ao iniciar sink %s", s->name);
+            slot->queue = nullptr;
+            ok = false;
+            continue;
+        }
+
+        LOG(TAG, "sink %s ativo (fila=%u)", s->name, (unsigned)s->queue_len);
+    }
+
+    g_started = true;
+    return ok;
+}
+
+/**
+ * @brief Copia uma leitura para a fila de cada sink, sem bloquear.
+ * @param r Leitura decodificada.
+ */
+void uplink_submit(const SensorReading *r)
+{
+    for (uint8_t i = 0; i < g_count; ++i)
+    {
+        SinkSlot *slot = &g_slots[i];
+
+        if (!slot->queue)
+        {
+            continue;
+        }
+
+        if (xQueueSend(slot->queue, r, 0) != pdTRUE)
+        {
+            /* Fila cheia: a leitura mais antiga dá lugar à mais recente. */
+            SensorReading oldest;
+            (void)xQueueReceive(slot->queue, &oldest, 0);
+            slot->stats.dropped++;
+            (void)xQueueSend(slot->queue, r, 0);
+        }
+
+        slot->stats.submitted++;
+    }
+}
+
+/**
+ * @brief Número de sinks registrados.
+ */
+uint8_t uplink_count(void)
+{
+    return g_count;
+}
+
+/**
+ * @brief Nome do sink de índice @p idx, ou @c nullptr.
+ */
+const char *uplink_name(uint8_t idx)
+{
+    return (idx < g_count) ? g_slots[idx].sink->name : nullptr;
+}
+
+/**
+ * @brief Copia os contadores do sink de índice @p idx.
+ * @param idx Índice do sink (ordem de registro).
+ * @param out Estrutura de destino.
+ * @return false se o índice for inválido.
+ */
+bool uplink_get_stats(uint8_t idx, UplinkStats *out)
+{
+    if (idx >= g_count || !out)
+    {
+        return false;
+    }
+
+    *out = g_slots[idx].stats;
+    out->depth = g_slots[idx].queue ? (uint8_t)uxQueueMessagesWaiting(g_slots[idx].queue) : 0;
+    return true;
+}
+
+/**
+ * @brief Conta um evento do sink cuja tarefa está em execução.
+ * @param ev Evento ocorrido.
+ *
+ * @details Para sinks que enviam fora de @c send (ex.: o ThingSpeak, cujo envio
+ *          consolidado ocorre em @c idle); chamada fora da tarefa de um sink é
+ *          ignorada. Só a tarefa dona altera os contadores do seu slot.
+ */
+void uplink_report(UplinkEvent ev)
+{
+    const TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+    for (uint8_t i = 0; i < g_count; ++i)
+    {
+        SinkSlot *slot = &g_slots[i];
+
+        if (slot->task != self)
+        {
+            continue;
+        }
+
+        if (ev == UPLINK_EV_SEND_ERROR)
+        {
+            slot->stats.send_errors++;
+        }
+        else
+        {
+            slot->stats.wifi_waits++;
+        }
+
+        return;
+    }
+}
@@ -0,0 +1,114 @@
+/**
+ * @file uplink.h
+ * @brief Cabeçalho para a distribuição de leituras a destinos de uplink (sinks).
+ *
+ * Cada sink (ThingSpeak, MQTT, UDP local, exportação no SD, log em setores brutos) possui fila limitada,
+ * tarefa, política de retentativa e contadores próprios; um destino lento ou em
+ * falha nunca atrasa os demais nem o caminho do rádio. Os sinks são selecionados
+ * em tempo de compilação pelas macros @c UPLINK_ENABLE_*.
+ */
+
+#ifndef UPLINK_H
+#define UPLINK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "payload_schema.h"
+
+#ifndef UPLINK_ENABLE_THINGSPEAK
+#define UPLINK_ENABLE_THINGSPEAK 1
+#endif
+
+#ifndef UPLINK_ENABLE_MQTT
+#define UPLINK_ENABLE_MQTT 0
+#endif
+
+#ifndef UPLINK_ENABLE_UDP
+#define UPLINK_ENABLE_UDP 0
+#endif
+
+#ifndef UPLINK_ENABLE_SD_EXPORT
+#define UPLINK_ENABLE_SD_EXPORT 0
+#endif
+
+#ifndef UPLINK_ENABLE_SD_RAW
+#define UPLINK_ENABLE_SD_RAW 0
+#endif
+
+#define UPLINK_MAX_SINKS 5
+
+/**
+ * @brief Descrição de um destino de uplink.
+ *
+ * @details @c send é chamada apenas na tarefa do sink; @c idle (opcional) também,
+ *          após cada leitura, a cada @c idle_ms sem leituras e entre retentativas.
+ */
+typedef struct
+{
+    const char *name;                       /* rótulo no log e nas estatísticas       */
+    bool (*send)(const SensorReading *r);   /* true = leitura entregue                */
+    void (*idle)(uint32_t now_ms);          /* manutenção periódica (opcional)        */
+    bool needs_wifi;                        /* aguarda Wi-Fi antes de tentar enviar   */
+    uint8_t queue_len;                      /* profundidade da fila                   */
+    uint8_t max_attempts;                   /* tentativas por leitura (0 = sem limite)*/
+    uint32_t retry_min_ms;                  /* espera após a primeira falha           */
+    uint32_t retry_max_ms;                  /* teto da espera exponencial             */
+    uint16_t idle_ms;                       /* período de @c idle e da espera de Wi-Fi */
+    uint16_t stack_bytes;                   /* pilha da tarefa                        */
+} UplinkSink;
+
+/**
+ * @brief Eventos que um sink relata de dentro da própria tarefa (@c send ou
+ *        @c idle), quando o envio não passa pelo retorno de @c send.
+ */
+typedef enum : uint8_t
+{
+    UPLINK_EV_SEND_ERROR,   /* envio falhou                     */
+    UPLINK_EV_WIFI_WAIT     /* envio adiado por falta de Wi-Fi  */
+} UplinkEvent;
+
+/**
+ * @brief Contadores de um sink.
+ */
+typedef struct
+{
+    uint32_t submitted;   /* leituras colocadas na fila                     */
+    uint32_t delivered;   /* leituras entregues                             */
+    uint32_t failed;      /* leituras abandonadas após @c max_attempts      */
+    uint32_t retries;     /* tentativas repetidas                           */
+    uint32_t dropped;     /* leituras mais antigas descartadas (fila cheia) */
+    uint32_t send_errors; /* envios que falharam (tentativas, ou do @c idle) */
+    uint32_t wifi_waits;  /* esperas por Wi-Fi com leitura ou janela pendente */
+    uint32_t last_ok_ms;  /* millis() da última entrega                     */
+    uint8_t depth;        /* ocupação atual da fila                         */
+} UplinkStats;
+
+bool uplink_register(const UplinkSink *sink);
+bool uplink_start(void);
+void uplink_submit(const SensorReading *r);
+uint8_t uplink_count(void);
+const char *uplink_name(uint8_t idx);
+bool uplink_get_stats(uint8_t idx, UplinkStats *out);
+void uplink_report(UplinkEvent ev);
+
+#if UPLINK_ENABLE_THINGSPEAK
+const UplinkSink *uplink_thingspeak_sink(const char *api_key);
+#endif
+
+#if UPLINK_ENABLE_MQTT
+const UplinkSink *uplink_mqtt_sink(void);
+#endif
+
+#if UPLINK_ENABLE_UDP
+const UplinkSink *uplink_udp_sink(const char *host, uint16_t port);
+#endif
+
+#if UPLINK_ENABLE_SD_EXPORT
+const UplinkSink *uplink_sd_export_sink(const char *path);
+#endif
+
+#if UPLINK_ENABLE_SD_RAW
+const UplinkSink *uplink_sd_raw_sink(void);
+#endif
+
+#endif /* UPLINK_H */
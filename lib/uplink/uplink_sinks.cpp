@@ -0,0 +1,242 @@
+/**
+ * @file uplink_sinks.cpp
+ * @brief Sinks de uplink disponíveis; cada um só é compilado se habilitado
+ *        pela respectiva macro @c UPLINK_ENABLE_*.
+ */
+
+#include "uplink.h"
+#include <Arduino.h>
+
+#if UPLINK_ENABLE_THINGSPEAK
+#include "thingspeak_client.h"
+#endif
+
+#if UPLINK_ENABLE_MQTT
+#include "mqtt_client.h"
+#endif
+
+#if UPLINK_ENABLE_UDP
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#endif
+
+#if UPLINK_ENABLE_SD_EXPORT
+#include "sd_card.h"
+#endif
+
+#if UPLINK_ENABLE_SD_RAW
+#include "record_log.h"
+#endif
+
+/******************************** ThingSpeak **********************************/
+
+#if UPLINK_ENABLE_THINGSPEAK
+static bool ts_send(const SensorReading *r)
+{
+    thingspeak_add(r);
+    return true;
+}
+
+/**
+ * @brief Envia a janela quando o canal permite e relata falhas e esperas de Wi-Fi,
+ *        que não passam pelo retorno de @c ts_send.
+ */
+static void ts_idle(uint32_t now_ms)
+{
+    ThingSpeakStats before, after;
+    thingspeak_get_stats(&before);
+    (void)thingspeak_tick(now_ms);
+    thingspeak_get_stats(&after);
+
+    if (after.failed != before.failed)
+    {
+        uplink_report(UPLINK_EV_SEND_ERROR);
+    }
+
+    if (after.wifi_waits != before.wifi_waits)
+    {
+        uplink_report(UPLINK_EV_WIFI_WAIT);
+    }
+}
+
+/**
+ * @brief Sink HTTP(S) do ThingSpeak.
+ *
+ * @details A entrega na fila apenas agrega a leitura na janela do cliente; o envio
+ *          consolidado ocorre em @c idle quando o canal permite (~15 s), e recusas
+ *          ou falhas de rede mantêm a janela para a próxima oportunidade.
+ * @param api_key Chave de escrita do canal (deve permanecer válida).
+ */
+const UplinkSink *uplink_thingspeak_sink(const char *api_key)
+{
+    static const UplinkSink sink = {
+        "TS", ts_send, ts_idle, false,
+        16,          /* queue_len    */
+        1,           /* max_attempts */
+        0,           /* retry_min_ms */
+        0,           /* retry_max_ms */
+        500,         /* idle_ms      */
+        THINGSPEAK_TLS ? 12288 : 8192   /* stack_bytes (handshake TLS) */
+    };
+
+    thingspeak_begin(api_key);
+    return &sink;
+}
+#endif
+
+/*********************************** MQTT *************************************/
+
+#if UPLINK_ENABLE_MQTT
+/**
+ * @brief Sink MQTT; @c mqtt_begin() deve ter sido chamada antes de @c uplink_start().
+ *
+ * @details A janela QoS 1 do cliente já guarda e reenvia as publicações; a fila do
+ *          sink só retém leituras enquanto a janela estiver cheia. Todo o cliente
+ *          MQTT roda na tarefa do sink (@c mqtt_tick() como @c idle).
+ */
+const UplinkSink *uplink_mqtt_sink(void)
+{
+    static const UplinkSink sink = {
+        "MQTT", mqtt_publish_reading, mqtt_tick, false,
+        16,          /* queue_len    */
+        0,           /* max_attempts */
+        1000,        /* retry_min_ms */
+        10000,       /* retry_max_ms */
+        100,         /* idle_ms      */
+        4096         /* stack_bytes  */
+    };
+
+    return &sink;
+}
+#endif
+
+/******************************** UDP local ***********************************/
+
+#if UPLINK_ENABLE_UDP
+static const char *g_udp_host = "";
+static uint16_t g_udp_port = 0;
+static WiFiUDP g_udp;
+
+/**
+ * @brief Envia a leitura como um datagrama "field1=...&field2=...\n".
+ */
+static bool udp_send(const SensorReading *r)
+{
+    char line[SCHEMA_UPLOAD_MAX + 1];
+    const size_t n = payload_schema_upload_fields(r, line, sizeof(line) - 1u);
+
+    if (n == 0 || !g_udp.beginPacket(g_udp_host, g_udp_port))
+    {
+        return false;
+    }
+
+    line[n] = '\n';
+    g_udp.write((const uint8_t *)line, n + 1u);
+    return g_udp.endPacket() == 1;
+}
+
+/**
+ * @brief Sink UDP para um coletor na rede local.
+ * @param host Endereço do coletor (deve permanecer válido).
+ * @param port Porta UDP do coletor.
+ */
+const UplinkSink *uplink_udp_sink(const char *host, uint16_t port)
+{
+    static const UplinkSink sink = {
+        "UDP", udp_send, nullptr, true,
+        16,          /* queue_len    */
+        2,           /* max_attempts */
+        1000,        /* retry_min_ms */
+        2000,        /* retry_max_ms */
+        500,         /* idle_ms      */
+        3072         /* stack_bytes  */
+    };
+
+    g_udp_host = host;
+    g_udp_port = port;
+    return &sink;
+}
+#endif
+
+/****************************** Exportação no SD ******************************/
+
+#if UPLINK_ENABLE_SD_EXPORT
+static const char *g_export_path = "";
+
+/**
+ * @brief Acrescenta a leitura ao arquivo de exportação, uma linha por leitura.
+ */
+static bool sd_export_send(const SensorReading *r)
+{
+    char line[SCHEMA_UPLOAD_MAX + 1];
+    const size_t n = payload_schema_upload_fields(r, line, sizeof(line) - 1u);
+
+    if (n == 0)
+    {
+        return false;
+    }
+
+    line[n] = '\n';
+    return sdcard_append(g_export_path, line, n + 1u);
+}
+
+/**
+ * @brief Sink de exportação das leituras em arquivo próprio no SD.
+ * @param path Caminho do arquivo (deve permanecer válido).
+ */
+const UplinkSink *uplink_sd_export_sink(const char *path)
+{
+    static const UplinkSink sink = {
+        "SDX", sd_export_send, nullptr, false,
+        16,          /* queue_len    */
+        3,           /* max_attempts */
+        1000,        /* retry_min_ms */
+        5000,        /* retry_max_ms */
+        1000,        /* idle_ms      */
+        4096         /* stack_bytes  */
+    };
+
+    g_export_path = path;
+    return &sink;
+}
+#endif
+
+/************************* Log em setores brutos do SD ************************/
+
+#if UPLINK_ENABLE_SD_RAW
+/**
+ * @brief Acrescenta a leitura ao log; a partição é procurada na primeira entrega
+ *        (o cartão pode ter sido montado depois do registro do sink).
+ */
+static bool sd_raw_send(const SensorReading *r)
+{
+    return reclog_open() && reclog_append(r);
+}
+
+static void sd_raw_idle(uint32_t now_ms)
+{
+    reclog_tick(now_ms);
+}
+
+/**
+ * @brief Sink do log circular de leituras em partição própria do SD (@c record_log).
+ *
+ * @details Um setor é gravado a cada @c RECLOG_PER_BLOCK leituras ou a cada
+ *          @c RECLOG_FLUSH_MS, o que vier antes; as leituras ainda na RAM se perdem
+ *          em um reset, como as que estão na fila de qualquer sink.
+ */
+const UplinkSink *uplink_sd_raw_sink(void)
+{
+    static const UplinkSink sink = {
+        "SDR", sd_raw_send, sd_raw_idle, false,
+        16,          /* queue_len    */
+        3,           /* max_attempts */
+        1000,        /* retry_min_ms */
+        5000,        /* retry_max_ms */
+        1000,        /* idle_ms      */
+        4096         /* stack_bytes  */
+    };
+
+    return &sink;
+}
+#endif
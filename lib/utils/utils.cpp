@@ -57,3 +57,52 @@ uint32_t utils_rd_le_u32(const uint8_t *b)
 {
     return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
 }
+
+/**
+ * @brief Escreve um valor unsigned 16-bit em formato little-endian.
+ * @param b Destino (dois bytes).
+ * @param v Valor a escrever.
+ */
+void utils_wr_le_u16(uint8_t *b, uint16_t v)
+{
+    b[0] = (uint8_t)v;
+    b[1] = (uint8_t)(v >> 8);
+}
+
+/**
+ * @brief Escreve um valor unsigned 32-bit em formato little-endian.
+ * @param b Destino (quatro bytes).
+ * @param v Valor a escrever.
+ */
+void utils_wr_le_u32(uint8_t *b, uint32_t v)
+{
+    b[0] = (uint8_t)v;
+    b[1] = (uint8_t)(v >> 8);
+    b[2] = (uint8_t)(v >> 16);
+    b[3] = (uint8_t)(v >> 24);
+}
+
+/**
+ * @brief CRC-32 (IEEE 802.3, polinômio refletido 0xEDB88320), por nibble.
+ * @param data Ponteiro para os dados.
+ * @param len Tamanho dos dados.
+ * @return CRC dos dados (compatível com zlib/binascii.crc32).
+ */
+uint32_t utils_crc32(const uint8_t *data, size_t len)
+{
+    static const uint32_t kNibble[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+        0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    uint32_t crc = 0xFFFFFFFFu;
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ kNibble[crc & 0x0Fu];
+        crc = (crc >> 4) ^ kNibble[crc & 0x0Fu];
+    }
+
+    return ~crc;
+}
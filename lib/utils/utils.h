@@ -15,5 +15,8 @@ uint8_t utils_checksum8(const uint8_t *data, size_t len);
 uint16_t utils_rd_le_u16(const uint8_t *b);
 int16_t utils_rd_le_i16(const uint8_t *b);
 uint32_t utils_rd_le_u32(const uint8_t *b);
+void utils_wr_le_u16(uint8_t *b, uint16_t v);
+void utils_wr_le_u32(uint8_t *b, uint32_t v);
+uint32_t utils_crc32(const uint8_t *data, size_t len);
 
 #endif /* UTILS_H */
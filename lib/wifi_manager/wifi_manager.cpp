@@ -1,10 +1,24 @@
 /**
  * @file wifi_manager.cpp
- * @brief Implementação do gerenciador de Wi-Fi.
+ * @brief Implementação do gerenciador de Wi-Fi orientado a eventos.
+ *
+ * Os eventos do driver (IP obtido, desconexão) e o timer de nova tentativa apenas
+ * sinalizam bits em @c g_events; @c wifi_tick() consome esses bits no contexto do
+ * laço principal e avança a máquina de estados. Sem eventos pendentes, o custo de
+ * @c wifi_tick() é uma leitura atômica.
+ *
+ * Reconexão rápida: o último BSSID/canal (e, opcionalmente, o IP) que funcionou fica
+ * salvo em NVS e é tentado primeiro, sem varredura; se falhar, as redes configuradas
+ * são tentadas por varredura completa, em ordem de prioridade.
  */
 
 #include "wifi_manager.h"
 #include <WiFi.h>
+#include <esp_timer.h>
+#include <esp_wifi.h>
+#include <string.h>
+#include <Preferences.h>
+#include "fault_inject.h"
 #include "logger.h"
 #include "pins.h"
 
@@ -13,40 +27,124 @@
 #define BACKOFF_MAX_S       300000
 #define CONNECT_GUARD_MS    12000
 
+/* Reconexão rápida */
+#define FAST_RETRY_MS       250     /* atraso da 1a tentativa após queda        */
+#define FAST_GUARD_MS       4000    /* espera por IP antes do fallback completo */
+#define FAST_FALLBACK_MS    100     /* fallback após falha explícita da rápida  */
+#define WIFI_CACHE_VERSION  1
+
+/* Reaproveita o último IP obtido (configuração estática) na tentativa rápida. */
+#ifndef WIFI_USE_CACHED_IP
+#define WIFI_USE_CACHED_IP  0
+#endif
+
+/* Eventos pendentes (sinalizados pelo driver/timer, consumidos em wifi_tick) */
+#define EVT_GOT_IP          (1u << 0)
+#define EVT_DISCONNECTED    (1u << 1)
+#define EVT_RETRY           (1u << 2)
+
+/**
+ * @brief Estados da máquina de conexão.
+ */
+typedef enum
+{
+    WIFI_ST_IDLE,        /* sem SSID ou ainda não iniciado          */
+    WIFI_ST_CONNECTING,  /* tentativa emitida, aguardando IP/guarda */
+    WIFI_ST_CONNECTED,   /* IP obtido                               */
+    WIFI_ST_BACKOFF      /* desconectado, aguardando o timer        */
+} WifiState;
+
+/**
+ * @brief Último ponto de acesso que entregou IP (persistido em NVS).
+ */
+typedef struct
+{
+    uint8_t version;
+    uint8_t channel;
+    uint8_t bssid[6];
+    char ssid[33];
+    uint32_t ip, gw, mask, dns;
+} WifiCache;
+
 /* Estados */
-static String g_ssid, g_pass;
-static bool g_began = false;
-static uint32_t g_next_try_ms = 0;
+static char g_ssid[WIFI_MAX_NETWORKS][33], g_pass[WIFI_MAX_NETWORKS][65];
+static uint8_t g_n_networks = 0;
+static WifiCache g_cache;
+static bool g_cache_ok = false;
+static uint32_t g_try = 0;
+static bool g_last_fast = false;
+static uint32_t g_down_since_ms = 0;
+static WifiReconnectStats g_stats;
 static uint32_t g_backoff_ms = 0;
-static wl_status_t g_prev_status = (wl_status_t)0xFF;
+static WifiState g_state = WIFI_ST_IDLE;
+static esp_timer_handle_t g_retry_timer = nullptr;
+static volatile uint32_t g_events = 0;
+static volatile bool g_link_up = false;
+static volatile uint8_t g_disc_reason = 0;
 
 static const char *TAG = "WIFI";
-static const char *wl_status_to_str(wl_status_t s)
-{
-    switch (s)
-    {
-    case WL_IDLE_STATUS:
-        return "WL_IDLE_STATUS(0)";
-    case WL_NO_SSID_AVAIL:
-        return "WL_NO_SSID_AVAIL(1)";
-    case WL_SCAN_COMPLETED:
-        return "WL_SCAN_COMPLETED(2)";
-    case WL_CONNECTED:
-        return "WL_CONNECTED(3)";
-    case WL_CONNECT_FAILED:
-        return "WL_CONNECT_FAILED(4)";
-    case WL_CONNECTION_LOST:
-        return "WL_CONNECTION_LOST(5)";
-    case WL_DISCONNECTED:
-        return "WL_DISCONNECTED(6)";
-    case WL_NO_SHIELD:
-        return "WL_NO_SHIELD(255)";
+
+/****************************** Funções privadas ******************************/
+
+/**
+ * @brief Sinaliza um evento para o próximo @c wifi_tick().
+ * @param ev Máscara @c EVT_*.
+ */
+static inline void post_event(uint32_t ev)
+{
+    __atomic_fetch_or(&g_events, ev, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Callback de eventos do driver Wi-Fi (tarefa de eventos do sistema).
+ *
+ * @details Atualiza o estado de enlace em cache e apenas sinaliza o evento; log,
+ *          LED e agendamento ficam para @c wifi_tick().
+ */
+static void on_wifi_event(WiFiEvent_t event, WiFiEventInfo_t info)
+{
+    switch (event)
+    {
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+        g_link_up = true;
+        post_event(EVT_GOT_IP);
+        break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+        g_link_up = false;
+        g_disc_reason = info.wifi_sta_disconnected.reason;
+        post_event(EVT_DISCONNECTED);
+        break;
+    case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+        g_link_up = false;
+        post_event(EVT_DISCONNECTED);
+        break;
     default:
-        return "UNKNOWN";
+        break;
     }
 }
 
-/****************************** Funções privadas ******************************/
+/**
+ * @brief Callback do timer de nova tentativa (tarefa do esp_timer).
+ */
+static void on_retry_timer(void *)
+{
+    post_event(EVT_RETRY);
+}
+
+/**
+ * @brief Agenda (ou reagenda) a próxima tentativa de conexão.
+ * @param delay_ms Atraso até a tentativa, em milissegundos.
+ */
+static void schedule_retry(uint32_t delay_ms)
+{
+    if (!g_retry_timer)
+    {
+        return;
+    }
+
+    esp_timer_stop(g_retry_timer);
+    esp_timer_start_once(g_retry_timer, (uint64_t)delay_ms * 1000ULL);
+}
 
 /**
  * @brief Define o estado do LED indicador de conexão Wi-Fi.
@@ -58,26 +156,178 @@ static void wifi_set_led_pin(bool state)
 }
 
 /**
- * @brief Tenta conectar-se a rede Wi-Fi.
+ * @brief Procura uma rede configurada pelo SSID.
+ * @return Índice em @c g_ssid ou -1.
  */
-static void wifi_start_connect(void)
+static int find_network(const char *ssid)
 {
-    if (g_ssid.isEmpty())
+    for (uint8_t i = 0; i < g_n_networks; ++i)
+    {
+        if (strcmp(g_ssid[i], ssid) == 0)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Carrega da NVS o último AP bom, se ainda corresponder a uma rede configurada.
+ */
+static void cache_load(void)
+{
+    Preferences prefs;
+    g_cache_ok = false;
+
+    if (!prefs.begin("wifi", true))
+    {
+        return;
+    }
+
+    size_t n = prefs.getBytes("cache", &g_cache, sizeof(g_cache));
+    prefs.end();
+    g_cache.ssid[sizeof(g_cache.ssid) - 1] = '\0';
+    g_cache_ok = (n == sizeof(g_cache)) && g_cache.version == WIFI_CACHE_VERSION &&
+                 g_cache.channel != 0 && find_network(g_cache.ssid) >= 0;
+}
+
+/**
+ * @brief Salva na NVS o AP/IP atuais; só grava se algo mudou (desgaste de flash).
+ */
+static void cache_store(void)
+{
+    WifiCache c = {};
+    const uint8_t *bssid = WiFi.BSSID();
+
+    if (!bssid)
+    {
+        return;
+    }
+
+    c.version = WIFI_CACHE_VERSION;
+    c.channel = (uint8_t)WiFi.channel();
+    memcpy(c.bssid, bssid, sizeof(c.bssid));
+    wifi_config_t conf;
+
+    if (esp_wifi_get_config(WIFI_IF_STA, &conf) != ESP_OK)
     {
         return;
     }
 
-    if (!g_began)
+    strlcpy(c.ssid, (const char *)conf.sta.ssid, sizeof(c.ssid));
+    c.ip = (uint32_t)WiFi.localIP();
+    c.gw = (uint32_t)WiFi.gatewayIP();
+    c.mask = (uint32_t)WiFi.subnetMask();
+    c.dns = (uint32_t)WiFi.dnsIP();
+
+    if (g_cache_ok && memcmp(&c, &g_cache, sizeof(c)) == 0)
+    {
+        return;
+    }
+
+    Preferences prefs;
+
+    if (prefs.begin("wifi", false))
     {
-        LOG(TAG, "begin() tentando conectar a \"%s\"...", g_ssid.c_str());
-        WiFi.begin(g_ssid.c_str(), g_pass.c_str());
-        g_began = true;
+        prefs.putBytes("cache", &c, sizeof(c));
+        prefs.end();
+    }
+
+    g_cache = c;
+    g_cache_ok = true;
+}
+
+/**
+ * @brief Tenta conectar-se a rede Wi-Fi.
+ *
+ * @details A primeira tentativa após uma queda usa o BSSID/canal em cache (sem
+ *          varredura); as seguintes percorrem as redes configuradas em ordem.
+ * @return true se a tentativa emitida foi a rápida.
+ */
+static bool wifi_start_connect(void)
+{
+    if (g_n_networks == 0)
+    {
+        return false;
+    }
+
+    const bool fast = g_cache_ok && g_try == 0;
+
+    if (fast)
+    {
+        const int idx = find_network(g_cache.ssid);
+
+        if (WIFI_USE_CACHED_IP && g_cache.ip != 0)
+        {
+            WiFi.config(IPAddress(g_cache.ip), IPAddress(g_cache.gw),
+                        IPAddress(g_cache.mask), IPAddress(g_cache.dns));
+        }
+
+        LOG(TAG, "tentativa rapida: \"%s\" canal=%u BSSID=%02X:%02X:%02X:%02X:%02X:%02X",
+            g_cache.ssid, (unsigned)g_cache.channel,
+            g_cache.bssid[0], g_cache.bssid[1], g_cache.bssid[2],
+            g_cache.bssid[3], g_cache.bssid[4], g_cache.bssid[5]);
+        WiFi.begin(g_ssid[idx], g_pass[idx], g_cache.channel, g_cache.bssid);
     }
     else
     {
-        LOG(TAG, "reconnect() tentando reconectar...");
-        WiFi.reconnect();
+        const uint8_t idx = (uint8_t)((g_try - (g_cache_ok ? 1u : 0u)) % g_n_networks);
+
+        if (WIFI_USE_CACHED_IP)
+        {
+            WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+        }
+
+        LOG(TAG, "begin() varredura completa, rede %u/%u \"%s\"...",
+            (unsigned)(idx + 1), (unsigned)g_n_networks, g_ssid[idx]);
+        WiFi.begin(g_ssid[idx], g_pass[idx]);
     }
+
+    g_try++;
+    return fast;
+}
+
+/**
+ * @brief Registra a duração da reconexão concluída.
+ * @param now_ms Tempo corrente (millis()).
+ */
+static void record_reconnect(uint32_t now_ms)
+{
+    const uint32_t dur = now_ms - g_down_since_ms;
+    g_stats.count++;
+    g_stats.fast_count += g_last_fast ? 1u : 0u;
+    g_stats.last_ms = dur;
+    g_stats.total_ms += dur;
+    g_stats.min_ms = (g_stats.count == 1 || dur < g_stats.min_ms) ? dur : g_stats.min_ms;
+    g_stats.max_ms = (dur > g_stats.max_ms) ? dur : g_stats.max_ms;
+    LOG(TAG, "conectado em %lu ms (%s, %lu tentativa(s)); media=%lu ms, rapidas=%lu/%lu",
+        (unsigned long)dur, g_last_fast ? "rapida" : "completa", (unsigned long)g_try,
+        (unsigned long)(g_stats.total_ms / g_stats.count),
+        (unsigned long)g_stats.fast_count, (unsigned long)g_stats.count);
+}
+
+/**
+ * @brief Emite uma tentativa e agenda a seguinte.
+ *
+ * @details Após a tentativa rápida, a guarda é curta e sem backoff; as de varredura
+ *          completa usam guarda + jitter do backoff exponencial.
+ */
+static void attempt_and_reschedule(void)
+{
+    g_last_fast = wifi_start_connect();
+    g_state = WIFI_ST_CONNECTING;
+    uint32_t delay_ms = FAST_GUARD_MS;
+
+    if (!g_last_fast)
+    {
+        g_backoff_ms = (g_backoff_ms < BACKOFF_MAX_S) ? (g_backoff_ms * 2) : BACKOFF_MAX_S;
+        uint32_t jitter = g_backoff_ms / 10U;
+        delay_ms = CONNECT_GUARD_MS + (jitter ? random(0, jitter) : 0);
+    }
+
+    schedule_retry(delay_ms);
+    LOG(TAG, "proxima janela em ~%u ms", (unsigned)delay_ms);
 }
 
 /**
@@ -105,31 +355,85 @@ const char *wifi_ip_str(void)
 
 /**
  * @brief Inicializa o gerenciador de Wi-Fi.
- * @param ssid SSID da rede.
+ * @param ssid SSID da rede de maior prioridade.
  * @param pass Senha da rede.
  */
 void wifi_begin(const char *ssid, const char *pass)
 {
-    g_ssid = ssid ? ssid : "";
-    g_pass = pass ? pass : "";
+    g_n_networks = 0;
+    wifi_add_network(ssid, pass);
     WiFi.mode(WIFI_STA);
-    g_began = false;
+    WiFi.setAutoReconnect(false);  /* reconexão conduzida por esta máquina de estados */
+    g_try = 0;
     g_backoff_ms = 0;
-    g_next_try_ms = 0;
-    g_prev_status = (wl_status_t)0xFF;
+    g_state = WIFI_ST_IDLE;
+    g_link_up = false;
+    g_events = 0;
+    g_down_since_ms = millis();
+
+    if (!g_retry_timer)
+    {
+        esp_timer_create_args_t args = {};
+        args.callback = on_retry_timer;
+        args.name = "wifi_retry";
+        esp_timer_create(&args, &g_retry_timer);
+        WiFi.onEvent(on_wifi_event);
+    }
+
+    cache_load();
     randomSeed((uint32_t)esp_random());
     pinMode(WIFI_LED, OUTPUT);
     wifi_set_led_pin(false);
-    LOG(TAG, "init (SSID=\"%s\")", g_ssid.c_str());
+    LOG(TAG, "init (SSID=\"%s\", cache=%s)", g_ssid[0], g_cache_ok ? g_cache.ssid : "-");
+}
+
+/**
+ * @brief Acrescenta uma rede alternativa, tentada após as anteriores.
+ * @param ssid SSID da rede.
+ * @param pass Senha da rede.
+ * @return true se adicionada; false se a lista estiver cheia ou o SSID vazio.
+ *
+ * @note Chamar após @c wifi_begin(). O AP salvo só é usado se o seu SSID estiver
+ *       entre as redes configuradas.
+ */
+bool wifi_add_network(const char *ssid, const char *pass)
+{
+    if (!ssid || !*ssid || g_n_networks >= WIFI_MAX_NETWORKS)
+    {
+        return false;
+    }
+
+    strlcpy(g_ssid[g_n_networks], ssid, sizeof(g_ssid[0]));
+    strlcpy(g_pass[g_n_networks], pass ? pass : "", sizeof(g_pass[0]));
+    g_n_networks++;
+
+    if (!g_cache_ok && g_retry_timer)
+    {
+        cache_load();
+    }
+
+    return true;
 }
 
 /**
- * @brief Informa se está conectado ao AP.
- * @return true se WL_CONNECTED; false caso contrário.
+ * @brief Copia as estatísticas de reconexão.
+ * @param out Estrutura de destino.
+ */
+void wifi_get_reconnect_stats(WifiReconnectStats *out)
+{
+    if (out)
+    {
+        *out = g_stats;
+    }
+}
+
+/**
+ * @brief Informa se está conectado ao AP (estado em cache, atualizado pelos eventos).
+ * @return true se há IP válido; false caso contrário.
  */
 bool wifi_is_connected(void)
 {
-    return WiFi.status() == WL_CONNECTED;
+    return g_link_up;
 }
 
 /**
@@ -138,69 +442,94 @@ bool wifi_is_connected(void)
 void wifi_force_reconnect(void)
 {
     LOG(TAG, "force_reconnect()");
-    g_began = false;
-    g_backoff_ms = 0;
-    g_next_try_ms = 0;
+    g_try = 0;
+    g_backoff_ms = BACKOFF_MIN_S;
+
+    if (g_retry_timer)
+    {
+        esp_timer_stop(g_retry_timer);
+    }
+
+    post_event(EVT_RETRY);
 }
 
 /**
- * @brief Avança a máquina de estados de reconexão (chamar a cada loop).
- * @param now_ms Tempo corrente (millis()).
+ * @brief Consome eventos pendentes e avança a máquina de estados.
+ * @param now_ms Tempo corrente (millis()), usado na telemetria de reconexão.
+ *
+ * @details Sem eventos pendentes retorna imediatamente; as tentativas são disparadas
+ *          pelo timer agendado, não por comparação de tempo a cada chamada.
  */
 void wifi_tick(uint32_t now_ms)
 {
-    wl_status_t cur = WiFi.status();
+#if FAULT_INJECT
+    static uint32_t s_fault_ms = 0;
 
-    if (cur != g_prev_status)
+    if ((now_ms - s_fault_ms) >= 1000u)
     {
-        if (cur == WL_CONNECTED)
-        {
-            LOG(TAG, "CONECTADO  IP=%s  RSSI=%d dBm", wifi_ip_str(), (int)WiFi.RSSI());
-            wifi_set_led_pin(true);
-            g_backoff_ms = BACKOFF_MIN_S;
-            g_next_try_ms = now_ms + CONNECT_GUARD_MS;
-        }
-        else
-        {
-            LOG(TAG, "DESCONECTADO (%s)", wl_status_to_str(cur));
-            wifi_set_led_pin(false);
+        s_fault_ms = now_ms;
 
-            if (g_backoff_ms == 0)
-            {
-                g_backoff_ms = BACKOFF_MIN_S;
-            }
+        if (g_link_up && fault_hit(FAULT_WIFI))
+        {
+            LOG(TAG, "queda de Wi-Fi injetada");
+            WiFi.disconnect();
         }
-
-        g_prev_status = cur;
     }
+#endif
 
-    if (cur == WL_CONNECTED)
+    if (__atomic_load_n(&g_events, __ATOMIC_RELAXED) == 0)
     {
-        if (g_backoff_ms == 0)
-        {
-            g_backoff_ms = BACKOFF_MIN_S;
-        }
+        return;
+    }
+
+    const uint32_t ev = __atomic_exchange_n(&g_events, 0, __ATOMIC_ACQUIRE);
 
-        if (g_next_try_ms < now_ms + CONNECT_GUARD_MS)
+    if ((ev & EVT_GOT_IP) && g_link_up && g_state != WIFI_ST_CONNECTED)
+    {
+        if (g_retry_timer)
         {
-            g_next_try_ms = now_ms + CONNECT_GUARD_MS;
+            esp_timer_stop(g_retry_timer);
         }
 
-        return;
+        g_state = WIFI_ST_CONNECTED;
+        g_backoff_ms = BACKOFF_MIN_S;
+        wifi_set_led_pin(true);
+        LOG(TAG, "CONECTADO  IP=%s  RSSI=%d dBm", wifi_ip_str(), (int)WiFi.RSSI());
+        record_reconnect(now_ms);
+        cache_store();
+        g_try = 0;
     }
 
-    if (g_backoff_ms == 0)
+    if ((ev & EVT_DISCONNECTED) && !g_link_up && g_state == WIFI_ST_CONNECTED)
     {
-        g_backoff_ms = BACKOFF_MIN_S;
+        /* Queda de enlace: tenta logo o AP em cache. */
+        g_state = WIFI_ST_BACKOFF;
+        g_down_since_ms = now_ms;
+        g_try = 0;
+        wifi_set_led_pin(false);
+        LOG(TAG, "DESCONECTADO (reason=%u)", (unsigned)g_disc_reason);
+        schedule_retry(FAST_RETRY_MS);
     }
+    else if ((ev & EVT_DISCONNECTED) && g_state == WIFI_ST_CONNECTING)
+    {
+        LOG(TAG, "tentativa falhou (reason=%u)", (unsigned)g_disc_reason);
 
-    if ((int32_t)(now_ms - g_next_try_ms) >= 0)
+        /* Falha explícita da tentativa rápida: passa logo à varredura completa
+         * (ASSOC_LEAVE é a saída provocada pela própria troca de configuração). */
+        if (g_last_fast && g_disc_reason != WIFI_REASON_ASSOC_LEAVE)
+        {
+            g_last_fast = false;
+            schedule_retry(FAST_FALLBACK_MS);
+        }
+    }
+
+    if ((ev & EVT_RETRY) && !g_link_up)
     {
-        wifi_start_connect();
-        g_next_try_ms = now_ms + CONNECT_GUARD_MS;
-        g_backoff_ms = (g_backoff_ms < BACKOFF_MAX_S) ? (g_backoff_ms * 2) : BACKOFF_MAX_S;
-        uint32_t jitter = g_backoff_ms / 10U;
-        g_next_try_ms += (jitter ? random(0, jitter) : 0);
-        LOG(TAG, "proxima janela em ~%u ms", (unsigned)(g_next_try_ms - now_ms));
+        if (g_backoff_ms == 0)
+        {
+            g_backoff_ms = BACKOFF_MIN_S;
+        }
+
+        attempt_and_reschedule();
     }
 }
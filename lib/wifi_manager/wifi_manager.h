@@ -9,7 +9,24 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#define WIFI_MAX_NETWORKS 4
+
+/**
+ * @brief Telemetria de reconexão (queda/boot até obter IP).
+ */
+typedef struct
+{
+    uint32_t count;       /* reconexões concluídas                   */
+    uint32_t fast_count;  /* concluídas pela tentativa rápida        */
+    uint32_t last_ms;     /* duração da última                       */
+    uint32_t min_ms;
+    uint32_t max_ms;
+    uint32_t total_ms;    /* soma das durações (média = total/count) */
+} WifiReconnectStats;
+
 void wifi_begin(const char *ssid, const char *pass);
+bool wifi_add_network(const char *ssid, const char *pass);
+void wifi_get_reconnect_stats(WifiReconnectStats *out);
 bool wifi_is_connected(void);
 void wifi_force_reconnect(void);
 void wifi_tick(uint32_t now_ms);
@@ -3,150 +3,308 @@
  * @brief Nó receptor/datalogger LoRa com descriptografia AES e envio ao ThingSpeak.
  *
  * Este firmware executa no gateway (ESP32) e implementa o seguinte pipeline:
- * 1) Inicialização de logging e SD; tentativa de sincronizar RTC interno via DS1307.
- * 2) Inicialização da criptografia simétrica (chave AES), Wi-Fi (com reconexão)
- *    e rádio LoRa (SX1278).
- * 3) Recepção de pacotes LoRa por interrupção (callback onReceive), com leitura
- *    do payload para um buffer global e captura de metadados (RSSI/SNR).
- * 4) No laço principal, cópia atômica (seção crítica com interrupções desabilitadas)
- *    do buffer global para um buffer local, seguida de:
+ * 1) Inicialização do logging, da criptografia simétrica (chave AES) e do rádio
+ *    LoRa (SX1278) primeiro; montagem do SD e sincronização do RTC via DS1307 em
+ *    tarefas de segundo plano; Wi-Fi (com reconexão) e sinks de uplink.
+ * 2) Recepção de pacotes LoRa: a interrupção do DIO0 apenas acorda a tarefa do
+ *    rádio, que toma o barramento SPI (compartilhado com o SD) e lê o payload e os
+ *    metadados (RSSI/SNR) para um @c RxPacket.
+ * 3) O laço principal dorme em @c xTaskNotifyWait() e é acordado pela tarefa do
+ *    rádio a cada pacote, que chega por uma fila de uma posição (@c xQueueOverwrite:
+ *    o pacote mais novo substitui o não consumido), seguida de (em @c rx_pipeline):
  *      - Validações estruturais (tamanho mínimo, alinhamento a 16 bytes),
- *      - Descriptografia AES (conforme implementação da lib `crypto.h`),
+ *      - Descriptografia AES com a chave do nó (@c key_table) ou a da frota,
  *      - Validação e parse do payload (checksum/estrutura),
+ *      - Registro de qualidade de enlace por nó (@c link_quality, em @c /enlace);
+ *        uma sequência repetida (reenvio após ACK perdido) só recebe o ACK,
+ *      - ACK autenticado ao nó, opcional (@c LORA_ACK_ENABLE), com volta ao RX,
  *      - Log dos campos decodificados,
- *      - Upload condicional ao ThingSpeak (se Wi-Fi estiver conectado).
- * 5) Rotação diária de arquivo de log e flush periódico no SD.
- *
- * @note Apenas comentários no estilo Doxygen e explicativos foram adicionados; a lógica
- *       e o código original não foram alterados.
+ *      - Estatísticas móveis por nó e eventos de limiar/anomalia,
+ *      - Entrega da leitura às filas dos sinks de uplink (ThingSpeak, MQTT, UDP,
+ *        exportação no SD), cada um com tarefa própria.
+ * 4) Manutenção a cada @c HOUSEKEEPING_MS, pedida ao laço por um @c esp_timer.
+ *    Rotação diária de arquivo de log e flush no SD, feitos por uma tarefa de
+ *    gravação que retém as linhas em RAM enquanto o cartão estiver lento ou ausente.
+ *    Leituras e logs críticos ainda sem flush ficam também na memória RTC e são
+ *    repassados ao SD e aos sinks no boot seguinte a um reset.
  */
 
 #include <Arduino.h>
 #include <LoRa.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
 #include "credentials.h"
 #include "pins.h"
+#include "boot_timeline.h"
 #include "crypto.h"
 #include "ds1307_rtc.h"
+#include "key_table.h"
+#include "link_quality.h"
 #include "logger.h"
+#include "metrics.h"
+#include "payload_schema.h"
+#include "rtc_stage.h"
+#include "rx_pipeline.h"
 #include "sd_card.h"
+#include "spi_bus.h"
 #include "utils.h"
 #include "sx1278_lora.h"
-#include "thingspeak_client.h"
+#include "uplink.h"
 #include "wifi_manager.h"
 
+#if UPLINK_ENABLE_MQTT
+#include "mqtt_client.h"
+#endif
+
 static const char *TAG = "MAIN";
 
+/* Espera máxima pelo RTC antes de abrir o primeiro arquivo de log. */
+#define BOOT_RTC_WAIT_MS 1000
+
+/* Acima das tarefas de uplink e de boot, que gravam no SD. */
+#define RADIO_TASK_PRIO 3
+
+/* Período da manutenção do laço (rotação do SD, Wi-Fi, métricas, chaves). */
+#define HOUSEKEEPING_MS 100
+
+/* Bits de notificação do laço principal. */
+#define LOOP_EVT_PACKET       (1u << 0)  /* pacote em g_pkt_queue      */
+#define LOOP_EVT_HOUSEKEEPING (1u << 1)  /* timer de manutenção        */
+
+/**
+ * @brief Pacote lido pela tarefa do rádio, com os metadados da recepção.
+ */
+typedef struct
+{
+    uint8_t buf[LORA_MAX_PACKET_LEN];
+    uint16_t len;
+    int16_t rssi;     /* conforme @c LoRa.packetRssi()                   */
+    float snr;        /* conforme @c LoRa.packetSnr()                    */
+    int64_t rx_us;    /* RxDone (µs desde o boot), base da latência      */
+} RxPacket;
+
 /**
- * @brief Flag sinalizando que um pacote completo foi lido pela ISR.
+ * @brief Fila de uma posição entre a tarefa do rádio e o loop.
  *
- * @details Marcada como @c volatile por ser acessada em contexto de interrupção e no loop.
+ * @details A tarefa do rádio lê cada pacote em um buffer próprio e o copia para a
+ *          fila; o loop recebe uma cópia. Nenhum dos dois escreve no buffer que o
+ *          outro está lendo, e um pacote não consumido é substituído pelo novo.
  */
-static volatile bool g_pkt_ready = false;
+static QueueHandle_t g_pkt_queue = nullptr;
 
 /**
- * @brief Tamanho, em bytes, do payload bruto recebido (antes de qualquer processamento).
+ * @brief Instante da última borda do DIO0 (RxDone), marcado na ISR.
  */
-static volatile uint16_t g_pkt_len = 0;
+static volatile int64_t g_dio0_us = 0;
 
 /**
- * @brief RSSI do pacote no momento da recepção, conforme @c LoRa.packetRssi().
+ * @brief Pacotes substituídos na fila antes de o loop consumi-los.
  */
-static volatile int16_t g_pkt_rssi = 0;
+static uint32_t g_pkt_overruns = 0;
+static portMUX_TYPE g_pkt_mux = portMUX_INITIALIZER_UNLOCKED;
 
 /**
- * @brief SNR do pacote no momento da recepção, conforme @c LoRa.packetSnr().
+ * @brief Tarefa que lê o FIFO do rádio; acordada pela ISR do DIO0.
  */
-static volatile float g_pkt_snr = 0.0f;
+static TaskHandle_t g_radio_task = nullptr;
 
 /**
- * @brief Buffer circular/simples onde a ISR armazena os bytes recebidos.
- *
- * @warning Escrito no contexto de interrupção; a cópia para escopo local é feita
- *          com interrupções desabilitadas para evitar condições de corrida.
+ * @brief Tarefa de boot que monta o SD; notificada quando o RTC termina.
+ */
+static TaskHandle_t g_boot_sd_task = nullptr;
+
+/**
+ * @brief Tarefa do Arduino que executa @c setup() e @c loop(); acordada pela
+ *        tarefa do rádio e pelo timer de manutenção.
+ */
+static TaskHandle_t g_loop_task = nullptr;
+
+/**
+ * @brief Timer periódico (@c HOUSEKEEPING_MS) que pede a manutenção ao laço.
  */
-static uint8_t g_pkt_buf[128];
+static esp_timer_handle_t g_housekeeping_timer = nullptr;
 
 /******************************** Protótipos **********************************/
 
 /**
- * @brief Loga os campos decodificados de um @c PayloadPacked para depuração.
- *
- * @param p Ponteiro para estrutura preenchida após parse/validação.
+ * @brief ISR da borda de subida do DIO0 (RxDone): marca o instante e acorda a
+ *        tarefa do rádio, sem acessar o SPI.
+ */
+static void on_dio0_isr(void);
+
+/**
+ * @brief Tarefa do rádio: toma o barramento SPI, lê o pacote e volta a RX contínuo.
+ */
+static void radio_task(void *arg);
+
+/**
+ * @brief Callback do timer de manutenção: apenas acorda o laço.
+ */
+static void on_housekeeping_timer(void *arg);
+
+/**
+ * @brief Manutenção periódica, executada no laço entre pacotes.
+ */
+static void housekeeping(void);
+
+/**
+ * @brief Repassa uma leitura recuperada da memória RTC ao log e aos sinks.
+ */
+static void replay_reading(const SensorReading *r);
+
+/**
+ * @brief Regrava no log uma leitura estagiada cujas linhas o anel do SD descartou.
+ * @return true se o SD aceitou todas as linhas desta vez.
+ */
+static bool relog_reading(const SensorReading *r);
+
+/**
+ * @brief Repassa uma linha de log recuperada da memória RTC ao arquivo do SD.
+ */
+static void replay_log(const char *line, size_t len);
+
+/**
+ * @brief Nome curto do motivo do último reset.
  */
-static void print_decoded(const PayloadPacked *p);
+static const char *reset_reason_str(esp_reset_reason_t r);
 
 /**
- * @brief Callback de recepção LoRa (executada em contexto de interrupção).
- * @param packetSize Número de bytes disponíveis reportado pela lib LoRa.
+ * @brief Tarefa de boot: sincroniza o RTC interno a partir do DS1307.
  */
-static void on_lora_rx_isr(int packetSize);
+static void boot_rtc_task(void *arg);
+
+/**
+ * @brief Tarefa de boot: monta o SD, aguarda o RTC e abre o arquivo de log.
+ */
+static void boot_sd_task(void *arg);
 
 /******************************* Implementações ********************************/
 
-static void on_lora_rx_isr(int packetSize)
+static void IRAM_ATTR on_dio0_isr(void)
 {
-    if (packetSize <= 0)
-    {
-        return;
-    }
+    BaseType_t woken = pdFALSE;
+    g_dio0_us = esp_timer_get_time();
+    vTaskNotifyGiveFromISR(g_radio_task, &woken);
 
-    if (packetSize > (int)sizeof(g_pkt_buf))
+    if (woken)
     {
-        packetSize = sizeof(g_pkt_buf);  /* Trunca para caber no buffer. */
+        portYIELD_FROM_ISR();
     }
+}
+
+static void radio_task(void *arg)
+{
+    (void)arg;
 
-    int n = 0;
+    static RxPacket pkt;
 
-    /* Leitura rápida do FIFO do rádio; manter a ISR curta. */
-    while (LoRa.available() && n < packetSize)
+    for (;;)
     {
-        g_pkt_buf[n++] = (uint8_t)LoRa.read();
+        (void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        pkt.rx_us = g_dio0_us;
+        pkt.rssi = 0;
+        pkt.snr = 0.0f;
+
+        /* Prioridade sobre os escritores do SD: a espera é de no máximo um bloco. */
+        spi_bus_acquire(SPI_DEV_RADIO);
+        const uint32_t n = lora_read_packet(pkt.buf, sizeof(pkt.buf), &pkt.rssi, &pkt.snr);
+        LoRa.receive();  /* parsePacket() deixa o rádio em standby */
+        spi_bus_release(SPI_DEV_RADIO);
+
+        if (n == 0)
+        {
+            continue;  /* CRC inválido ou borda espúria */
+        }
+
+        pkt.len = (uint16_t)n;
+
+        if (xQueueSend(g_pkt_queue, &pkt, 0) != pdTRUE)
+        {
+            /* O loop ainda não havia consumido o pacote anterior: o novo o substitui. */
+            xQueueOverwrite(g_pkt_queue, &pkt);
+            portENTER_CRITICAL(&g_pkt_mux);
+            g_pkt_overruns++;
+            portEXIT_CRITICAL(&g_pkt_mux);
+        }
+
+        xTaskNotify(g_loop_task, LOOP_EVT_PACKET, eSetBits);
     }
+}
 
-    g_pkt_len  = (uint16_t)n;
-    g_pkt_rssi = LoRa.packetRssi();
-    g_pkt_snr  = LoRa.packetSnr();
-    g_pkt_ready = true;  /* Sinaliza ao loop principal que há dados prontos. */
+static void on_housekeeping_timer(void *arg)
+{
+    (void)arg;
+    xTaskNotify(g_loop_task, LOOP_EVT_HOUSEKEEPING, eSetBits);
 }
 
-static void print_decoded(const PayloadPacked *p)
+static void housekeeping(void)
 {
-    const bool  irr_error = (p->irradiance == 0xFFFF);
-    const float batt_V    = p->battery_voltage / 1000.0f; /* mV -> V */
-    const float temp_C    = p->internal_temperature / 10.0f; /* décimos -> °C */
+    /* Rotação diária do arquivo e andamento do gerenciador de Wi-Fi. */
+    sdcard_tick_rotate();
+    wifi_tick(millis());
+    metrics_tick(millis());
+    keytab_tick();
+    linkq_tick(millis());
 
-    LOG(TAG, "---- Pacote decodificado ----");
-    if (irr_error)
+    /* O estágio RTC confirma o que já passou por flush e pede flush se encher. */
+    if (rtc_stage_commit(sdcard_durable_pos(), relog_reading) >= RTC_STAGE_FLUSH_AT)
     {
-        LOG(TAG, "Irradiancia : ERRO (0xFFFF)");
+        sdcard_flush();
     }
-    else
+
+    static bool boot_logged = false;
+
+    if (!boot_logged && boot_timeline_complete())
     {
-        LOG(TAG, "Irradiancia : %u W/m^2", (unsigned)p->irradiance);
+        boot_timeline_log();
+        metrics_heap_baseline();
+        boot_logged = true;
     }
-    LOG(TAG, "Bateria     : %.3f V", batt_V);
-    LOG(TAG, "Temp. int.  : %.1f C", temp_C);
-    LOG(TAG, "Timestamp   : %lu s", (unsigned long)p->timestamp);
-    LOG(TAG, "Checksum    : 0x%02X", p->checksum);
-    LOG(TAG, "-----------------------------");
 }
 
-/**
- * @brief Rotina de inicialização do dispositivo (Arduino core).
- *
- * Passos principais:
- *  - Inicializa logger/SD e define o RTC interno em epoch0, depois tenta sincronizar via DS1307.
- *  - Inicializa criptografia com a @c AES_KEY fornecida em @c credentials.h.
- *  - Inicializa Wi-Fi e força reconexão imediata.
- *  - Inicializa o rádio LoRa via @c lora_begin(); em caso de falha, entra em laço infinito.
- *  - Registra o callback de recepção (@c on_lora_rx_isr) e coloca o rádio em modo RX contínuo.
- */
-void setup()
+static void replay_reading(const SensorReading *r)
 {
-    /* Logging e SD */
-    logger_init_epoch0();
-    sdcard_begin();
-    logger_begin();
+    LOG(TAG, "Leitura recuperada da memoria RTC");
+    payload_schema_log(TAG, r);
+    uplink_submit(r);
+}
+
+static bool relog_reading(const SensorReading *r)
+{
+    const uint32_t drops = sdcard_dropped_lines();
+    LOG(TAG, "Leitura regravada (linhas descartadas com o SD cheio)");
+    payload_schema_log(TAG, r);
+    return sdcard_dropped_lines() == drops;
+}
+
+static void replay_log(const char *line, size_t len)
+{
+    (void)sdcard_write(line, len);
+}
+
+static const char *reset_reason_str(esp_reset_reason_t r)
+{
+    switch (r)
+    {
+    case ESP_RST_POWERON:  return "power-on";
+    case ESP_RST_EXT:      return "externo";
+    case ESP_RST_SW:       return "software";
+    case ESP_RST_PANIC:    return "panico";
+    case ESP_RST_INT_WDT:  return "watchdog (int)";
+    case ESP_RST_TASK_WDT: return "watchdog (tarefa)";
+    case ESP_RST_WDT:      return "watchdog";
+    case ESP_RST_BROWNOUT: return "brownout";
+    default:               return "outro";
+    }
+}
+
+static void boot_rtc_task(void *arg)
+{
+    (void)arg;
+    boot_phase_start(BOOT_RTC);
 
     /* Tenta sincronizar o RTC interno com o DS1307 se disponível. */
     if (ds1307_rtc_sync_at_boot())
@@ -158,164 +316,223 @@ void setup()
         LOG(TAG, "DS1307 ausente/invalido, mantendo epoch0 ate ter hora valida");
     }
 
-    /* Criptografia simétrica — utiliza chave definida em credentials.h */
-    crypto_init(AES_KEY);
-
-    /* Wi-Fi e reconexão proativa */
-    wifi_begin(WIFI_SSID, WIFI_PASSWORD);
-    wifi_force_reconnect();
+    boot_phase_end(BOOT_RTC);
 
-    /* Rádio LoRa (SX1278): parâmetros e pinos definidos em sx1278_lora/pins */
-    if (!lora_begin())
+    if (g_boot_sd_task)
     {
-        LOG("LORA", "Falha ao inicializar LoRa");
-
-        /* Em sistemas embarcados, permanecer aqui evita seguir com estado inconsistente. */
-        for (;;)
-        {
-            delay(1000);
-        }
+        xTaskNotifyGive(g_boot_sd_task);
     }
 
-    /* Registra callback de RX e entra em modo de recepção contínua. */
-    LoRa.onReceive(on_lora_rx_isr);
-    LoRa.receive();
-    LOG(TAG, "LoRa inicializado, aguardando pacotes...");
+    vTaskDelete(nullptr);
 }
 
-/**
- * @brief Laço principal: trata pacotes recebidos, descriptografa, valida e envia ao ThingSpeak.
- *
- * Fluxo por iteração:
- *  1) Manutenção: rotação de SD e tick do gerenciador Wi-Fi.
- *  2) Seção crítica: copia estado do pacote da ISR para variáveis locais (sem interrupções).
- *  3) Caso haja pacote:
- *     - Loga metadados (RSSI/SNR) e hexdump.
- *     - Verifica tamanho mínimo (>= 32 B: 16 de IV + pelo menos 16 de CT).
- *     - Separa IV (16 B) e CT (restante). Checa se CT é múltiplo de 16 B (blocos AES).
- *     - Descriptografa em @c plain[] e valida tamanho final == sizeof(PayloadPacked).
- *     - Faz parse e valida (checksum). Loga campos decodificados.
- *     - Envia ao ThingSpeak se Wi-Fi conectado; loga sucesso/falha.
- *     - @c sdcard_flush() para persistir logs do evento.
- */
-void loop()
+static void boot_sd_task(void *arg)
 {
-    /* Manutenção: rotação diária do arquivo e andamento do gerenciador de Wi-Fi. */
-    sdcard_tick_rotate();
-    wifi_tick(millis());
+    (void)arg;
+    boot_phase_start(BOOT_SD_MOUNT);
+    const bool mounted = sdcard_mount();
+    boot_phase_end(BOOT_SD_MOUNT);
 
-    /* Buffers/variáveis locais evitam acessar diretamente os voláteis fora da seção crítica. */
-    uint8_t local_buf[128];
-    uint16_t local_len = 0;
-    int16_t  local_rssi = 0;
-    float    local_snr = 0.0f;
+    /* Aguarda o RTC (com limite) para nomear o primeiro arquivo com a data real. */
+    (void)ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(BOOT_RTC_WAIT_MS));
 
-    /* Seção crítica: copia os dados da ISR de forma atômica. */
-    noInterrupts();
+    boot_phase_start(BOOT_SD_OPEN);
+    sdcard_begin();
+    boot_phase_end(BOOT_SD_OPEN);
 
-    if (g_pkt_ready)
+    if (!mounted)
     {
-        local_len  = g_pkt_len;
-        local_rssi = g_pkt_rssi;
-        local_snr  = g_pkt_snr;
-
-        for (uint16_t i = 0; i < local_len; ++i)
-        {
-            local_buf[i] = g_pkt_buf[i];
-        }
-        g_pkt_ready = false;  /* Consome o pacote. */
+        LOG(TAG, "SD nao montado no boot");
     }
 
-    interrupts();
+    vTaskDelete(nullptr);
+}
 
-    /* Se não há pacote, cede CPU e retorna. */
-    if (local_len == 0)
-    {
-        delay(1);
-        return;
-    }
+/**
+ * @brief Rotina de inicialização do dispositivo (Arduino core).
+ *
+ * O rádio é colocado em escuta o quanto antes; o que é lento roda em paralelo:
+ *  - Logger sem esperar a Serial; linhas anteriores ao SD ficam retidas em RAM.
+ *  - Criptografia com a @c AES_KEY de @c credentials.h (quadros sem id de nó), tabela
+ *    de chaves por nó lida do SD (@c KEYTAB_PATH) e rádio LoRa em RX contínuo
+ *    (@c on_dio0_isr acorda @c radio_task). Se o rádio falhar, o boot segue até o SD gravar o log e
+ *    então para.
+ *  - Tarefas de boot: montagem do SD e sincronização do RTC via DS1307; o primeiro
+ *    arquivo de log é aberto após a sincronização (ou após @c BOOT_RTC_WAIT_MS).
+ *  - Wi-Fi orientado a eventos (redes alternativas opcionais @c WIFI_SSID_2/_3 em
+ *    @c credentials.h) com reconexão imediata, endpoint HTTP @c /metrics e sinks
+ *    de uplink habilitados.
+ *  - A duração de cada fase é registrada e logada quando todas terminam.
+ */
+void setup()
+{
+    /* Logging (retido em RAM até o SD abrir o arquivo) */
+    boot_phase_start(BOOT_LOGGER);
+    logger_init_epoch0();
+    sdcard_init();
+    logger_begin();
+    const uint16_t staged = rtc_stage_begin();
+    LOG_CRIT(TAG, "boot: reset=%s, %u registro(s) pendente(s) na memoria RTC",
+             reset_reason_str(esp_reset_reason()), (unsigned)staged);
+    boot_phase_end(BOOT_LOGGER);
 
-    /* Log dos metadados do pacote recebido. */
-    LOG("LORA", "RX [%u B]  RSSI=%d  SNR=%.1f", (unsigned)local_len, (int)local_rssi, local_snr);
-    LOGHEX("LORA", local_buf, local_len);
+    /* Criptografia simétrica — chave da frota de credentials.h; chaves por nó do SD */
+    boot_phase_start(BOOT_CRYPTO);
+    crypto_init(AES_KEY);
+    keytab_begin();
+    boot_phase_end(BOOT_CRYPTO);
 
-    /* Tamanho mínimo: 16 B de IV + ao menos 16 B de ciphertext. */
-    if (local_len < 32u)
+    /* Rádio LoRa (SX1278): parâmetros e pinos definidos em sx1278_lora/pins */
+    boot_phase_start(BOOT_RADIO);
+    linkq_begin();
+    g_loop_task = xTaskGetCurrentTaskHandle();
+    g_pkt_queue = xQueueCreate(1, sizeof(RxPacket));
+    spi_bus_init();
+    const bool radio_ok = lora_begin();
+
+    if (radio_ok)
     {
-        LOG(TAG, "Pacote curto (IV16 + CT16+), DESCARTADO");
-        sdcard_flush();
-        return;
+        /* Tarefa de leitura no núcleo do loop, ISR do DIO0 e recepção contínua. */
+        xTaskCreatePinnedToCore(radio_task, "radio", 3072, nullptr, RADIO_TASK_PRIO,
+                                &g_radio_task, xPortGetCoreID());
+        attachInterrupt(digitalPinToInterrupt(SX1278_DIO0), on_dio0_isr, RISING);
+        spi_bus_acquire(SPI_DEV_RADIO);
+        LoRa.receive();
+        spi_bus_release(SPI_DEV_RADIO);
+        LOG(TAG, "LoRa inicializado, aguardando pacotes...");
     }
-
-    /* Separação de IV e CT (modo de operação definido pela lib de crypto). */
-    const uint8_t *iv = &local_buf[0];
-    const uint8_t *ct = &local_buf[16];
-    const uint16_t ct_len = (uint16_t)(local_len - 16u);
-
-    /* AES opera em blocos de 16 bytes; ciphertext deve ser múltiplo de 16. */
-    if ((ct_len % 16u) != 0u)
+    else
     {
-        LOG(TAG, "Ciphertext nao multiplo de 16, DESCARTADO");
-        sdcard_flush();
-        return;
+        LOG_CRIT("LORA", "Falha ao inicializar LoRa");
     }
 
-    /* Descriptografia para buffer plano. */
-    uint8_t plain[128];
-    size_t  plain_len = 0;
+    boot_phase_end(BOOT_RADIO);
+
+    /* SD e RTC em segundo plano; o SPI já foi iniciado pelo rádio. */
+    xTaskCreate(boot_sd_task, "boot_sd", 4096, nullptr, 1, &g_boot_sd_task);
+    xTaskCreate(boot_rtc_task, "boot_rtc", 3072, nullptr, 1, nullptr);
 
-    if (!crypto_decrypt(ct, (size_t)ct_len, iv, plain, &plain_len))
+    if (!radio_ok)
     {
-        LOG(TAG, "AES fail, DESCARTADO");
-        sdcard_flush();
-        return;
+        /* Em sistemas embarcados, permanecer aqui evita seguir com estado inconsistente. */
+        for (;;)
+        {
+            delay(1000);
+        }
     }
 
-    /* Após remoção de padding, esperamos exatamente o tamanho de PayloadPacked. */
-    if (plain_len != sizeof(PayloadPacked))
+    /* Wi-Fi e reconexão proativa (associação ocorre em segundo plano) */
+    boot_phase_start(BOOT_WIFI);
+    wifi_begin(WIFI_SSID, WIFI_PASSWORD);
+#ifdef WIFI_SSID_2
+    wifi_add_network(WIFI_SSID_2, WIFI_PASSWORD_2);
+#endif
+#ifdef WIFI_SSID_3
+    wifi_add_network(WIFI_SSID_3, WIFI_PASSWORD_3);
+#endif
+    wifi_force_reconnect();
+    metrics_http_start(METRICS_HTTP_PORT);
+    boot_phase_end(BOOT_WIFI);
+
+    /* Sinks de uplink selecionados pelas macros UPLINK_ENABLE_* (platformio.ini). */
+    boot_phase_start(BOOT_UPLINK);
+#if UPLINK_ENABLE_THINGSPEAK
+    uplink_register(uplink_thingspeak_sink(THINGSPEAK_API_KEY));
+#endif
+#if UPLINK_ENABLE_MQTT
+    mqtt_begin(MQTT_HOST, MQTT_PORT, MQTT_CLIENT_ID, MQTT_USER, MQTT_PASS, MQTT_TOPIC);
+    uplink_register(uplink_mqtt_sink());
+#endif
+#if UPLINK_ENABLE_UDP
+    uplink_register(uplink_udp_sink(UDP_SINK_HOST, UDP_SINK_PORT));
+#endif
+#if UPLINK_ENABLE_SD_EXPORT
+    uplink_register(uplink_sd_export_sink("/leituras.txt"));
+#endif
+#if UPLINK_ENABLE_SD_RAW
+    uplink_register(uplink_sd_raw_sink());
+#endif
+    uplink_start();
+
+    /* Registros sem flush antes do último reset vão ao SD e aos sinks. */
+    if (staged)
     {
-        LOG(TAG, "Tamanho apos unpad invalido (%u), DESCARTADO", (unsigned)plain_len);
-        sdcard_flush();
-        return;
+        LOG(TAG, "%u registro(s) repassado(s) da memoria RTC",
+            (unsigned)rtc_stage_replay(replay_reading, replay_log));
     }
 
-    /* Validação estrutural e de checksum do payload. */
-    PayloadPacked p;
+    boot_phase_end(BOOT_UPLINK);
 
-    if (!lora_parse_payload(plain, plain_len, &p))
+    /* O laço dorme entre eventos; a manutenção chega por este timer. */
+    esp_timer_create_args_t args = {};
+    args.callback = on_housekeeping_timer;
+    args.name = "housekeeping";
+    esp_timer_create(&args, &g_housekeeping_timer);
+    esp_timer_start_periodic(g_housekeeping_timer, (uint64_t)HOUSEKEEPING_MS * 1000u);
+}
+
+/**
+ * @brief Laço principal: dorme até ser notificado; trata pacotes recebidos e a
+ *        manutenção periódica.
+ *
+ * Fluxo por despertar (bits de @c xTaskNotifyWait()):
+ *  1) @c LOOP_EVT_HOUSEKEEPING (a cada @c HOUSEKEEPING_MS): rotação de SD, tick do
+ *     gerenciador Wi-Fi, resumo periódico das métricas, aplicação de uma tabela de
+ *     chaves relida do SD, confirmação do estágio RTC e log único da linha do tempo
+ *     do boot.
+ *  2) @c LOOP_EVT_PACKET (enviado pela tarefa do rádio): recebe o pacote da fila
+ *     (pacotes substituídos antes disso são contados como perda) e
+ *     @c rx_pipeline_handle():
+ *     - Loga metadados (RSSI/SNR) e hexdump.
+ *     - Quadros com 2 B de id de nó antes do IV usam a chave do nó (@c key_table).
+ *     - Verifica tamanho mínimo (>= 32 B: 16 de IV + pelo menos 16 de CT).
+ *     - Separa IV (16 B) e CT (restante). Checa se CT é múltiplo de 16 B (blocos AES).
+ *     - Descriptografa em @c plain[] e seleciona o schema pelo tamanho/versão.
+ *     - Lotes (@c BATCH_FRAME_TYPE) são validados por inteiro e desempacotados em leituras.
+ *     - Faz parse e valida (checksum); com @c LORA_ACK_ENABLE, confirma o quadro ao nó
+ *       (só dentro de @c LORA_ACK_WINDOW_US após o RxDone).
+ *     - Loga campos decodificados e os copia para a
+ *       memória RTC (sem flush por pacote: o SD é gravado a cada 8 KiB ou 30 s).
+ *     - Enfileira a leitura em cada sink de uplink (sem bloquear o rádio).
+ *     - Registra a latência do DIO0 até o fim do processamento (percentis em /metrics).
+ *  3) Registra o atraso do RxDone até o início do processamento e o tempo acordado.
+ */
+void loop()
+{
+    uint32_t events = 0;
+    (void)xTaskNotifyWait(0, UINT32_MAX, &events, portMAX_DELAY);
+    const int64_t woke_us = esp_timer_get_time();
+
+    if (events & LOOP_EVT_HOUSEKEEPING)
     {
-        LOG(TAG, "Payload invalido (checksum/estrutura), DESCARTADO");
-        sdcard_flush();
-        return;
+        housekeeping();
     }
 
-    /* Log amigável dos campos decodificados. */
-    print_decoded(&p);
+    if (events & LOOP_EVT_PACKET)
+    {
+        static RxPacket pkt;
+        const bool have_pkt = xQueueReceive(g_pkt_queue, &pkt, 0) == pdTRUE;
 
-    /* Conversões/flags para envio ao canal IoT. */
-    const bool  irr_error = (p.irradiance == 0xFFFF);
-    const float irr_Wm2   = irr_error ? -1.0f : (float)p.irradiance;
-    const float batt_V    = p.battery_voltage / 1000.0f;
-    const float temp_C    = p.internal_temperature / 10.0f;
+        portENTER_CRITICAL(&g_pkt_mux);
+        const uint32_t overruns = g_pkt_overruns;
+        g_pkt_overruns = 0;
+        portEXIT_CRITICAL(&g_pkt_mux);
 
-    /* Envio condicional ao ThingSpeak (somente se rede estiver pronta). */
-    if (wifi_is_connected())
-    {
-        bool ok = thingspeak_update(THINGSPEAK_API_KEY, irr_Wm2, batt_V, temp_C, p.timestamp);
-        if (ok)
+        if (overruns)
         {
-            LOG("TS", "envio OK");
+            LOG(TAG, "%lu pacote(s) sobrescrito(s) antes do processamento",
+                (unsigned long)overruns);
+            metrics_drop_n(DROP_OVERRUN, overruns);
         }
-        else
+
+        if (have_pkt)
         {
-            LOG("TS", "FALHA no envio");
+            metrics_pickup_us((uint32_t)(woke_us - pkt.rx_us));
+
+            /* Log, validação, ACK, decodificação e entrega aos sinks. */
+            rx_pipeline_handle(pkt.buf, pkt.len, pkt.rssi, pkt.snr, pkt.rx_us);
         }
     }
-    else
-    {
-        LOG("TS", "sem conexao Wi-Fi, pacote NAO enviado");
-    }
 
-    /* Garante persistência do evento e mensagens no SD. */
-    sdcard_flush();
+    metrics_loop_wake((uint32_t)(esp_timer_get_time() - woke_us));
 }
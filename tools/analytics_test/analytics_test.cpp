@@ -0,0 +1,469 @@
+/**
+ * @file analytics_test.cpp
+ * @brief Testes de host das estatísticas móveis e regras de evento (@c lib/analytics).
+ *
+ * Uso:
+ *   analytics_test [-n amostras] [-s semente] [-v]
+ *
+ * Cobre:
+ *  - média/mínimo/máximo/último da janela conferidos a cada amostra contra uma
+ *    janela de força bruta, por mais de 2 x 65536 amostras válidas (a sequência
+ *    u16 das filas monotônicas dá a volta), com sentinelas fora da janela;
+ *  - EWMA: converge para uma entrada constante e segue um degrau com alfa = 1/8;
+ *  - anomalia: não dispara com a janela incompleta, dispara num pico depois do
+ *    sinal estável e normaliza na amostra seguinte;
+ *  - limiares com histerese (bateria baixa, temperatura alta), erro repetido e
+ *    valor travado: disparo, permanência dentro da histerese e normalização logada;
+ *  - leitura consolidada e substituição da origem menos recente.
+ *
+ * Sai com código 1 se algum caso falhar.
+ */
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "analytics.h"
+#include "logger.h"
+#include "payload_schema.h"
+
+#define F_IRR   0
+#define F_BAT   1
+#define F_TEMP  2
+#define IRR_ERR 0xFFFF
+
+/**
+ * @brief Janela de referência (força bruta) de um campo.
+ */
+typedef struct
+{
+    int32_t v[ANALYTICS_WINDOW];
+    uint32_t total;
+} RefWindow;
+
+static bool g_verbose = false;
+static uint32_t g_rng = 0xA5A5F00Du;
+static uint32_t g_ts = 1700000000u;
+static uint32_t g_raised;
+static uint32_t g_cleared;
+static uint32_t g_checks;
+static uint32_t g_failures;
+
+/****************************** Substitutos ***********************************/
+
+static void vlog(const char *tag, const char *fmt, va_list ap)
+{
+    if (!g_verbose)
+    {
+        return;
+    }
+
+    fprintf(stderr, "[%s] ", tag);
+    vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+}
+
+void logger_log(const char *tag, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    vlog(tag, fmt, ap);
+    va_end(ap);
+}
+
+/* Eventos chegam por LOG_CRIT: conta disparos e normalizações logados. */
+void logger_log_crit(const char *tag, const char *fmt, ...)
+{
+    char line[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+
+    g_raised += strstr(line, " ATIVO:") != nullptr;
+    g_cleared += strstr(line, " normalizado:") != nullptr;
+
+    if (g_verbose)
+    {
+        fprintf(stderr, "[%s] %s\n", tag, line);
+    }
+}
+
+/****************************** Funções privadas ******************************/
+
+#define CHECK(cond, ...)                                                     \
+    do                                                                       \
+    {                                                                        \
+        g_checks++;                                                          \
+        if (!(cond))                                                         \
+        {                                                                    \
+            g_failures++;                                                    \
+            if (g_failures <= 20)                                            \
+            {                                                                \
+                fprintf(stderr, "FALHA %s:%d: ", __FILE__, __LINE__);        \
+                fprintf(stderr, __VA_ARGS__);                                \
+                fputc('\n', stderr);                                         \
+            }                                                                \
+        }                                                                    \
+    } while (0)
+
+/**
+ * @brief xorshift32: reproduzível pela semente, sem depender da libc.
+ */
+static uint32_t rnd(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+/**
+ * @brief Entrega uma leitura v1 da origem @p source, 60 s depois da anterior.
+ */
+static void feed(uint16_t source, int32_t irr, int32_t bat, int32_t temp)
+{
+    SensorReading r;
+    memset(&r, 0, sizeof(r));
+    g_ts += 60u;
+    r.version = 1;
+    r.source = source;
+    r.value[F_IRR] = irr;
+    r.value[F_BAT] = bat;
+    r.value[F_TEMP] = temp;
+    r.value[3] = (int32_t)g_ts;
+    r.timestamp = g_ts;
+    r.error_mask = (irr == IRR_ERR) ? 1u << F_IRR : 0u;
+    (void)analytics_update(&r);
+}
+
+/**
+ * @brief Estatísticas de um campo da origem @p source, onde quer que esteja o slot.
+ */
+static bool field_of(uint16_t source, uint8_t field, AnalyticsField *out)
+{
+    for (uint8_t slot = 0; slot < ANALYTICS_MAX_SOURCES; ++slot)
+    {
+        uint16_t src;
+        uint8_t version;
+
+        if (analytics_get_field(slot, field, &src, &version, out) && src == source)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool active(uint16_t source, uint8_t field, AnalyticsEvent kind)
+{
+    AnalyticsField f;
+    return field_of(source, field, &f) && ((f.active >> kind) & 1u);
+}
+
+static uint32_t events(AnalyticsEvent kind)
+{
+    AnalyticsStats st;
+    analytics_get_stats(&st);
+    return st.events[kind];
+}
+
+static void ref_push(RefWindow *w, int32_t v)
+{
+    w->v[w->total % ANALYTICS_WINDOW] = v;
+    w->total++;
+}
+
+/**
+ * @brief Confere n/último/média/mínimo/máximo do campo contra a janela de referência.
+ */
+static void ref_check(const char *what, const RefWindow *w, const AnalyticsField *f,
+                      int32_t last)
+{
+    const uint32_t n = w->total < ANALYTICS_WINDOW ? w->total : ANALYTICS_WINDOW;
+    int64_t sum = 0;
+    int32_t lo = INT32_MAX, hi = INT32_MIN;
+
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        sum += w->v[i];
+        lo = w->v[i] < lo ? w->v[i] : lo;
+        hi = w->v[i] > hi ? w->v[i] : hi;
+    }
+
+    const int32_t mean = (int32_t)llround((double)sum / (double)n);
+    CHECK(f->n == n && f->last == last && f->mean == mean && f->min == lo && f->max == hi,
+          "%s apos %lu amostras: n %u/%lu ult %ld/%ld med %ld/%ld min %ld/%ld max %ld/%ld",
+          what, (unsigned long)w->total, f->n, (unsigned long)n, (long)f->last, (long)last,
+          (long)f->mean, (long)mean, (long)f->min, (long)lo, (long)f->max, (long)hi);
+}
+
+/**
+ * @brief Janela conferida a cada amostra por @p n amostras (n > 2 x 65536 cobre a
+ *        volta da sequência u16 duas vezes).
+ */
+static void test_window(uint16_t source, uint32_t n)
+{
+    RefWindow irr = {}, bat = {}, temp = {};
+    AnalyticsField f;
+
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        /* Trechos monotônicos e aleatórios exercitam as duas filas. */
+        const uint32_t phase = (i / 40u) % 3u;
+        const int32_t b = (phase == 0) ? (int32_t)(3000u + i % 40u * 10u)
+                        : (phase == 1) ? (int32_t)(4200u - i % 40u * 10u)
+                                       : (int32_t)(3000u + rnd() % 1201u);
+        const int32_t t = (int32_t)(rnd() % 1201u) - 400;
+        const int32_t ir = (rnd() % 5 == 0) ? IRR_ERR : (int32_t)(1u + rnd() % 2000u);
+
+        feed(source, ir, b, t);
+        ref_push(&bat, b);
+        ref_push(&temp, t);
+
+        if (ir != IRR_ERR)
+        {
+            ref_push(&irr, ir);
+        }
+
+        CHECK(field_of(source, F_BAT, &f), "bateria ausente");
+        ref_check("bateria", &bat, &f, b);
+        CHECK(field_of(source, F_TEMP, &f), "temperatura ausente");
+        ref_check("temperatura", &temp, &f, t);
+
+        if (irr.total)
+        {
+            CHECK(field_of(source, F_IRR, &f), "irradiancia ausente");
+            ref_check("irradiancia", &irr, &f, irr.v[(irr.total - 1u) % ANALYTICS_WINDOW]);
+        }
+    }
+
+    SensorReading agg;
+    AnalyticsField ft;
+    CHECK(analytics_take_aggregate(source, &agg), "sem leitura consolidada");
+    CHECK(field_of(source, F_BAT, &f) && field_of(source, F_TEMP, &ft) &&
+          agg.value[F_BAT] == f.mean && agg.value[F_TEMP] == ft.mean && agg.timestamp == g_ts,
+          "consolidada difere da media da janela");
+    CHECK(!analytics_take_aggregate(source, &agg), "consolidada repetida sem leituras novas");
+}
+
+/**
+ * @brief EWMA (alfa = 1/8): constante e degrau.
+ */
+static void test_ewma(uint16_t source)
+{
+    AnalyticsField f;
+
+    for (int i = 0; i < 64; ++i)
+    {
+        feed(source, 800, 3700, 250);
+    }
+
+    CHECK(field_of(source, F_TEMP, &f) && f.ewma == 250, "EWMA constante = %ld",
+          (long)f.ewma);
+
+    /* Degrau 250 -> 410: a distância cai para (7/8)^k, monotonicamente. */
+    int32_t prev = 250;
+
+    for (int k = 1; k <= 40; ++k)
+    {
+        feed(source, 800, 3700, 410);
+        CHECK(field_of(source, F_TEMP, &f), "temperatura ausente");
+        const double bound = 160.0 * pow(7.0 / 8.0, k) + 1.0;
+        CHECK(f.ewma >= prev && f.ewma <= 410 && 410 - f.ewma <= bound,
+              "EWMA no passo %d = %ld (anterior %ld, limite %.1f)", k, (long)f.ewma,
+              (long)prev, bound);
+        prev = f.ewma;
+    }
+}
+
+/**
+ * @brief Anomalia: silêncio na janela incompleta, disparo num pico e normalização.
+ */
+static void test_anomaly(uint16_t source)
+{
+    const uint32_t before = events(EVT_ANOMALY);
+
+    /* Janela incompleta: saltos grandes não contam. */
+    for (int i = 0; i < ANALYTICS_WINDOW - 1; ++i)
+    {
+        feed(source, (i & 1) ? 100 : 1900, 3700, 250);
+    }
+
+    CHECK(events(EVT_ANOMALY) == before, "anomalia com a janela incompleta");
+
+    /* Sinal estável com ruído de +-5 W/m^2. */
+    for (int i = 0; i < 64; ++i)
+    {
+        feed(source, 1000 + (int32_t)(rnd() % 11u) - 5, 3700, 250);
+    }
+
+    const uint32_t settled = events(EVT_ANOMALY);
+    CHECK(!active(source, F_IRR, EVT_ANOMALY), "anomalia ativa no sinal estavel");
+
+    const uint32_t raised = g_raised, cleared = g_cleared;
+    feed(source, 1500, 3700, 250);
+    CHECK(active(source, F_IRR, EVT_ANOMALY), "pico de +500 nao disparou anomalia");
+    CHECK(events(EVT_ANOMALY) == settled + 1, "contador de anomalias");
+    CHECK(g_raised == raised + 1, "disparo da anomalia nao logado");
+
+    feed(source, 1000, 3700, 250);
+    CHECK(!active(source, F_IRR, EVT_ANOMALY), "anomalia nao normalizou");
+    CHECK(g_cleared == cleared + 1, "normalizacao da anomalia nao logada");
+    CHECK(!active(source, F_BAT, EVT_ANOMALY) && !active(source, F_TEMP, EVT_ANOMALY),
+          "anomalia em campo sem pico");
+}
+
+/**
+ * @brief Uma leitura de bateria e a expectativa do evento @c EVT_BELOW.
+ */
+static void step_below(uint16_t source, int32_t bat, bool want)
+{
+    feed(source, 800, bat, 250);
+    CHECK(active(source, F_BAT, EVT_BELOW) == want, "bateria %ld: abaixo do limiar %s",
+          (long)bat, want ? "inativo" : "ativo");
+}
+
+static void step_above(uint16_t source, int32_t temp, bool want)
+{
+    feed(source, 800, 3700, temp);
+    CHECK(active(source, F_TEMP, EVT_ABOVE) == want, "temperatura %ld: acima do limiar %s",
+          (long)temp, want ? "inativo" : "ativo");
+}
+
+/**
+ * @brief Limiares com histerese, erro repetido e valor travado.
+ */
+static void test_rules(uint16_t source)
+{
+    const uint32_t below = events(EVT_BELOW);
+    uint32_t cleared = g_cleared;
+
+    /* Bateria < 3300 dispara; normaliza só em >= 3350. */
+    step_below(source, 3400, false);
+    step_below(source, 3299, true);
+    step_below(source, 3320, true);
+    step_below(source, 3349, true);
+    CHECK(g_cleared == cleared, "normalizacao dentro da histerese");
+    step_below(source, 3350, false);
+    CHECK(g_cleared == cleared + 1, "normalizacao da bateria nao logada");
+    step_below(source, 3310, false);
+    step_below(source, 3299, true);
+    CHECK(events(EVT_BELOW) == below + 2, "disparos de bateria baixa: %lu",
+          (unsigned long)(events(EVT_BELOW) - below));
+    step_below(source, 3700, false);
+
+    /* Temperatura > 600 dispara; normaliza só em <= 580. */
+    const uint32_t above = events(EVT_ABOVE);
+    cleared = g_cleared;
+    step_above(source, 600, false);
+    step_above(source, 601, true);
+    step_above(source, 590, true);
+    step_above(source, 581, true);
+    step_above(source, 580, false);
+    CHECK(events(EVT_ABOVE) == above + 1 && g_cleared == cleared + 1,
+          "temperatura: %lu disparos, %lu normalizacoes",
+          (unsigned long)(events(EVT_ABOVE) - above), (unsigned long)(g_cleared - cleared));
+
+    /* Sentinela em 3 leituras seguidas; uma leitura válida normaliza. */
+    const uint32_t err = events(EVT_ERROR_RUN);
+    feed(source, IRR_ERR, 3700, 250);
+    feed(source, IRR_ERR, 3700, 250);
+    CHECK(!active(source, F_IRR, EVT_ERROR_RUN), "erro repetido com 2 sentinelas");
+    feed(source, IRR_ERR, 3700, 250);
+    CHECK(active(source, F_IRR, EVT_ERROR_RUN), "erro repetido nao disparou");
+    feed(source, IRR_ERR, 3700, 250);
+    CHECK(events(EVT_ERROR_RUN) == err + 1, "erro repetido disparou de novo");
+    feed(source, 700, 3700, 250);
+    CHECK(!active(source, F_IRR, EVT_ERROR_RUN), "erro repetido nao normalizou");
+
+    /* Valor não nulo igual em 12 leituras seguidas; zero (noite) nunca trava. */
+    for (int i = 0; i < 20; ++i)
+    {
+        feed(source, 0, 3700, 250);
+    }
+
+    CHECK(!active(source, F_IRR, EVT_FLAT), "irradiancia zero tratada como travada");
+
+    for (int i = 1; i <= 12; ++i)
+    {
+        feed(source, 777, 3700, 250);
+        CHECK(active(source, F_IRR, EVT_FLAT) == (i >= 12), "travado apos %d leituras: %s", i,
+              (i >= 12) ? "inativo" : "ativo");
+    }
+
+    feed(source, 778, 3700, 250);
+    CHECK(!active(source, F_IRR, EVT_FLAT), "valor travado nao normalizou");
+}
+
+/**
+ * @brief A origem menos recente perde o slot quando todos estão ocupados.
+ */
+static void test_eviction(void)
+{
+    AnalyticsStats st;
+    analytics_get_stats(&st);
+    const uint32_t evicted = st.evicted;
+    AnalyticsField f;
+
+    for (uint16_t s = 100; s < 100 + ANALYTICS_MAX_SOURCES; ++s)
+    {
+        feed(s, 500, 3700, 250);
+    }
+
+    feed(100, 500, 3700, 250);                        /* 100 volta a ser recente */
+    feed(100 + ANALYTICS_MAX_SOURCES, 500, 3700, 250); /* substitui a 101       */
+
+    analytics_get_stats(&st);
+    /* As origens dos casos anteriores ocupavam todos os slots. */
+    CHECK(st.evicted == evicted + ANALYTICS_MAX_SOURCES + 1 &&
+          st.sources == ANALYTICS_MAX_SOURCES,
+          "substituicoes %lu, origens %u", (unsigned long)(st.evicted - evicted), st.sources);
+    CHECK(field_of(100, F_BAT, &f) && !field_of(101, F_BAT, &f) &&
+          field_of(100 + ANALYTICS_MAX_SOURCES, F_BAT, &f), "origem substituida errada");
+}
+
+/****************************** Funções públicas ******************************/
+
+int main(int argc, char **argv)
+{
+    unsigned long n = 140000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:v")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            n = strtoul(optarg, nullptr, 0);
+            break;
+        case 's':
+            g_rng = (uint32_t)strtoul(optarg, nullptr, 0);
+            break;
+        case 'v':
+            g_verbose = true;
+            break;
+        default:
+            fprintf(stderr, "uso: %s [-n amostras] [-s semente] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (g_rng == 0)
+    {
+        g_rng = 1;
+    }
+
+    test_window(1, (uint32_t)n);
+    test_ewma(2);
+    test_anomaly(3);
+    test_rules(4);
+    test_eviction();
+
+    printf("analytics: %lu verificacoes, %lu falhas\n", (unsigned long)g_checks,
+           (unsigned long)g_failures);
+    return g_failures ? 1 : 0;
+}
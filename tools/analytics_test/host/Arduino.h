@@ -0,0 +1,13 @@
+/**
+ * @file Arduino.h
+ * @brief Substituto vazio do core Arduino para os testes de analytics: as bibliotecas
+ *        testadas só usam tipos de @c stdint.h.
+ */
+
+#ifndef ANALYTICS_TEST_ARDUINO_H
+#define ANALYTICS_TEST_ARDUINO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#endif /* ANALYTICS_TEST_ARDUINO_H */
@@ -0,0 +1,333 @@
+/**
+ * @file batch_frame_test.cpp
+ * @brief Testes de host do codificador/decodificador de lotes (@c lib/batch_frame).
+ *
+ * Uso:
+ *   batch_frame_test [-n iteracoes] [-s semente] [-v]
+ *
+ * Cobre:
+ *  - ida e volta @c batch_frame_encode() -> @c batch_decoder_next() para lotes de
+ *    1, 2 e @c BATCH_MAX_SAMPLES amostras, com valores aleatórios (inclusive a
+ *    sentinela de erro e temperaturas negativas) e deltas de timestamp de 0 até
+ *    larguras de varint de 1 a 5 bytes;
+ *  - quadro legado de 11 bytes cujo primeiro byte vale @c BATCH_FRAME_TYPE
+ *    (irradiância 176 W/m^2): não é lote e decodifica pelo schema v1;
+ *  - lotes corrompidos (qualquer byte alterado, contagem errada, byte a mais,
+ *    truncados) são recusados por inteiro em @c batch_decoder_init();
+ *  - o codificador recusa timestamps decrescentes, @c n fora de 1..32 e buffer curto.
+ *
+ * Sai com código 1 se algum caso falhar.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "batch_frame.h"
+#include "logger.h"
+#include "payload_schema.h"
+#include "utils.h"
+
+#define FRAME_MAX 512
+
+static bool g_verbose = false;
+static uint32_t g_rng = 0x12345678u;
+static uint32_t g_checks;
+static uint32_t g_failures;
+
+/****************************** Substitutos ***********************************/
+
+void logger_log(const char *tag, const char *fmt, ...)
+{
+    if (!g_verbose)
+    {
+        return;
+    }
+
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "[%s] ", tag);
+    vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+    va_end(ap);
+}
+
+/****************************** Funções privadas ******************************/
+
+#define CHECK(cond, ...)                                                     \
+    do                                                                       \
+    {                                                                        \
+        g_checks++;                                                          \
+        if (!(cond))                                                         \
+        {                                                                    \
+            g_failures++;                                                    \
+            fprintf(stderr, "FALHA %s:%d: ", __FILE__, __LINE__);            \
+            fprintf(stderr, __VA_ARGS__);                                    \
+            fputc('\n', stderr);                                             \
+        }                                                                    \
+    } while (0)
+
+/**
+ * @brief xorshift32: reproduzível pela semente, sem depender da libc.
+ */
+static uint32_t rnd(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+/**
+ * @brief Delta de timestamp cobrindo 0 e todas as larguras de varint (1..5 bytes).
+ */
+static uint32_t rnd_delta(uint32_t room)
+{
+    static const uint32_t kLimits[] = {0u, 0x7Fu, 0x3FFFu, 0x1FFFFFu, 0xFFFFFFFu, 0xFFFFFFFFu};
+    const uint32_t lim = kLimits[rnd() % (sizeof(kLimits) / sizeof(kLimits[0]))];
+    const uint32_t d = lim ? rnd() % lim + 1u : 0u;
+    return d < room ? d : room;
+}
+
+/**
+ * @brief Leitura v1 aleatória com o timestamp dado.
+ */
+static void rnd_reading(const PayloadSchema *s, uint32_t ts, SensorReading *r)
+{
+    memset(r, 0, sizeof(*r));
+    r->value[0] = (rnd() % 8 == 0) ? 0xFFFF : (int32_t)(rnd() % 2001u);
+    r->value[1] = (int32_t)(rnd() & 0xFFFFu);
+    r->value[2] = (int32_t)(int16_t)(rnd() & 0xFFFFu);
+    r->value[s->ts_index] = (int32_t)ts;
+    r->timestamp = ts;
+}
+
+/**
+ * @brief Codifica @p n leituras aleatórias, decodifica e compara campo a campo.
+ */
+static void test_round_trip(const PayloadSchema *s, uint8_t n)
+{
+    SensorReading in[BATCH_MAX_SAMPLES];
+    uint8_t frame[FRAME_MAX];
+    uint32_t ts = rnd();
+
+    for (uint8_t i = 0; i < n; ++i)
+    {
+        if (i)
+        {
+            ts += rnd_delta(UINT32_MAX - ts);
+        }
+
+        rnd_reading(s, ts, &in[i]);
+    }
+
+    const size_t len = batch_frame_encode(s, in, n, frame, sizeof(frame));
+    CHECK(len > 0, "encode de %u amostras falhou", n);
+    CHECK(batch_frame_is_batch(frame, len), "lote de %zu bytes nao reconhecido", len);
+
+    BatchDecoder d;
+    CHECK(batch_decoder_init(&d, frame, len), "init recusou lote valido de %u amostras", n);
+
+    SensorReading out;
+    uint8_t got = 0;
+
+    while (batch_decoder_next(&d, &out))
+    {
+        const SensorReading *r = &in[got];
+        CHECK(got < n, "amostra extra %u", got);
+        CHECK(out.timestamp == r->timestamp, "amostra %u: ts %lu != %lu", got,
+              (unsigned long)out.timestamp, (unsigned long)r->timestamp);
+        CHECK(out.version == s->version, "amostra %u: versao %u", got, out.version);
+        CHECK(out.checksum == frame[len - 1], "amostra %u: checksum", got);
+
+        for (uint8_t f = 0; f < s->n_fields; ++f)
+        {
+            CHECK(out.value[f] == r->value[f], "amostra %u campo %u: %ld != %ld", got, f,
+                  (long)out.value[f], (long)r->value[f]);
+        }
+
+        CHECK(payload_schema_field_error(&out, 0) == (r->value[0] == 0xFFFF),
+              "amostra %u: mascara de erro 0x%lX", got, (unsigned long)out.error_mask);
+        got++;
+    }
+
+    CHECK(got == n, "decodificadas %u de %u amostras", got, n);
+}
+
+/**
+ * @brief Quadro legado de 11 bytes com irradiância 176 (primeiro byte 0xB0).
+ */
+static void test_legacy_b0(const PayloadSchema *s)
+{
+    uint8_t frame[11] = {BATCH_FRAME_TYPE, 0x00, 0x10, 0x0E, 0xF6, 0xFF, 0x78, 0x56, 0x34, 0x12};
+    frame[10] = utils_checksum8(frame, 10);
+
+    CHECK(!batch_frame_is_batch(frame, sizeof(frame)), "quadro legado 0xB0 tratado como lote");
+
+    BatchDecoder d;
+    CHECK(!batch_decoder_init(&d, frame, sizeof(frame)), "init aceitou quadro legado");
+
+    const PayloadSchema *sel = payload_schema_select(frame, sizeof(frame));
+    CHECK(sel == s, "quadro legado nao selecionou o schema v1");
+
+    SensorReading r;
+    CHECK(sel && payload_schema_decode(sel, frame, sizeof(frame), &r), "decode legado falhou");
+    CHECK(r.value[0] == 176 && r.value[1] == 3600 && r.value[2] == -10 &&
+          r.timestamp == 0x12345678u, "valores legados: %ld %ld %ld %lu", (long)r.value[0],
+          (long)r.value[1], (long)r.value[2], (unsigned long)r.timestamp);
+}
+
+/**
+ * @brief Qualquer alteração num lote válido deve recusá-lo por inteiro.
+ */
+static void test_corruption(const PayloadSchema *s)
+{
+    SensorReading in[4];
+    uint8_t frame[FRAME_MAX];
+    uint8_t bad[FRAME_MAX];
+    uint32_t ts = 1700000000u;
+
+    for (uint8_t i = 0; i < 4; ++i)
+    {
+        rnd_reading(s, ts, &in[i]);
+        ts += 300u + i * 20000u;
+    }
+
+    const size_t len = batch_frame_encode(s, in, 4, frame, sizeof(frame));
+    CHECK(len > 0, "encode do lote de referencia falhou");
+
+    BatchDecoder d;
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        memcpy(bad, frame, len);
+        bad[i] ^= (uint8_t)(1u << (rnd() % 8));
+        CHECK(!batch_decoder_init(&d, bad, len), "byte %zu alterado aceito", i);
+    }
+
+    /* Contagem errada com checksum refeito: o tamanho não fecha. */
+    for (uint8_t count = 0; count <= BATCH_MAX_SAMPLES + 1; ++count)
+    {
+        if (count == 4)
+        {
+            continue;
+        }
+
+        memcpy(bad, frame, len);
+        bad[2] = count;
+        bad[len - 1] = utils_checksum8(bad, len - 1);
+        CHECK(!batch_decoder_init(&d, bad, len), "contagem %u aceita", count);
+    }
+
+    /* Byte a mais antes do checksum. */
+    memcpy(bad, frame, len - 1);
+    bad[len - 1] = 0;
+    bad[len] = utils_checksum8(bad, len);
+    CHECK(!batch_decoder_init(&d, bad, len + 1), "byte a mais aceito");
+
+    /* Truncado, com checksum refeito para isolar a validação de tamanho. */
+    for (size_t cut = 1; cut < len; ++cut)
+    {
+        memcpy(bad, frame, cut);
+        bad[cut - 1] = utils_checksum8(bad, cut - 1);
+        CHECK(!batch_decoder_init(&d, bad, cut), "lote truncado em %zu aceito", cut);
+    }
+
+    /* Versão desconhecida. */
+    memcpy(bad, frame, len);
+    bad[1] = 0xEE;
+    bad[len - 1] = utils_checksum8(bad, len - 1);
+    CHECK(!batch_decoder_init(&d, bad, len), "versao desconhecida aceita");
+}
+
+/**
+ * @brief Parâmetros inválidos do codificador.
+ */
+static void test_encoder_rejects(const PayloadSchema *s)
+{
+    SensorReading in[BATCH_MAX_SAMPLES + 1];
+    uint8_t frame[FRAME_MAX];
+
+    for (uint8_t i = 0; i <= BATCH_MAX_SAMPLES; ++i)
+    {
+        rnd_reading(s, 1000u + i, &in[i]);
+    }
+
+    CHECK(batch_frame_encode(s, in, 0, frame, sizeof(frame)) == 0, "n = 0 aceito");
+    CHECK(batch_frame_encode(s, in, BATCH_MAX_SAMPLES + 1, frame, sizeof(frame)) == 0,
+          "n = %u aceito", BATCH_MAX_SAMPLES + 1);
+
+    in[1].timestamp = in[0].timestamp - 1u;
+    CHECK(batch_frame_encode(s, in, 2, frame, sizeof(frame)) == 0, "ts decrescente aceito");
+    in[1].timestamp = in[0].timestamp;
+
+    const size_t len = batch_frame_encode(s, in, 2, frame, sizeof(frame));
+    CHECK(len > 0, "encode de 2 amostras falhou");
+
+    for (size_t outlen = 0; outlen < len; ++outlen)
+    {
+        CHECK(batch_frame_encode(s, in, 2, frame, outlen) == 0, "outlen %zu < %zu aceito",
+              outlen, len);
+    }
+}
+
+/****************************** Funções públicas ******************************/
+
+int main(int argc, char **argv)
+{
+    unsigned long iters = 2000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:v")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            iters = strtoul(optarg, nullptr, 0);
+            break;
+        case 's':
+            g_rng = (uint32_t)strtoul(optarg, nullptr, 0);
+            break;
+        case 'v':
+            g_verbose = true;
+            break;
+        default:
+            fprintf(stderr, "uso: %s [-n iteracoes] [-s semente] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (g_rng == 0)
+    {
+        g_rng = 1;
+    }
+
+    const PayloadSchema *s = payload_schema_by_version(1);
+
+    if (!s)
+    {
+        fprintf(stderr, "schema v1 ausente\n");
+        return 1;
+    }
+
+    static const uint8_t kSizes[] = {1, 2, BATCH_MAX_SAMPLES};
+
+    for (unsigned long it = 0; it < iters; ++it)
+    {
+        for (size_t k = 0; k < sizeof(kSizes); ++k)
+        {
+            test_round_trip(s, kSizes[k]);
+        }
+
+        test_round_trip(s, (uint8_t)(rnd() % BATCH_MAX_SAMPLES + 1u));
+    }
+
+    test_legacy_b0(s);
+    test_corruption(s);
+    test_encoder_rejects(s);
+
+    printf("batch_frame: %lu verificacoes, %lu falhas\n", (unsigned long)g_checks,
+           (unsigned long)g_failures);
+    return g_failures ? 1 : 0;
+}
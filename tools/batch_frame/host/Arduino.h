@@ -0,0 +1,13 @@
+/**
+ * @file Arduino.h
+ * @brief Substituto vazio do core Arduino para os testes de lote: as bibliotecas
+ *        testadas só usam tipos de @c stdint.h.
+ */
+
+#ifndef BATCH_FRAME_ARDUINO_H
+#define BATCH_FRAME_ARDUINO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#endif /* BATCH_FRAME_ARDUINO_H */
@@ -0,0 +1,480 @@
+/**
+ * @file fmt_test.cpp
+ * @brief Testes de host da formatação sem printf (@c lib/fmt) contra os formatos
+ *        @c snprintf que ela substituiu, e microbenchmark dos dois caminhos.
+ *
+ * Uso:
+ *   fmt_test [-n iteracoes] [-s semente] [-b] [-v]
+ *
+ * Byte a byte contra as referências antigas:
+ *  - campos do schema v1 (faixas completas de 16 bits) no log (@c "%lu" / @c "%.*f"
+ *    do valor em float) e no corpo de upload (@c "%sfield%u=..." por campo);
+ *  - SNR do rádio (@c "%.1f" do float, passos de 0,25 dB do SX1278);
+ *  - @c fmt_u32 / @c fmt_i32 / @c fmt_u32_pad contra @c "%lu" / @c "%ld" / @c "%0*lu";
+ *  - @c fmt_fixed contra @c "%.*f" em valores exatos em binário, inclusive empates
+ *    de arredondamento (meio para o par) e "-0";
+ *  - linha de hexdump (@c "%02X " por byte) e data/hora do prefixo do log.
+ *
+ * @c -b mede, por operação, o caminho antigo (snprintf/float) e o novo.
+ * Sai com código 1 se alguma saída divergir.
+ */
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "fmt.h"
+#include "logger.h"
+#include "payload_schema.h"
+
+#define BUF_LEN 128
+
+static bool g_verbose = false;
+static uint32_t g_rng = 0x9E3779B9u;
+static uint32_t g_checks;
+static uint32_t g_failures;
+static volatile uint32_t g_sink;
+
+/****************************** Substitutos ***********************************/
+
+void logger_log(const char *tag, const char *fmt, ...)
+{
+    if (!g_verbose)
+    {
+        return;
+    }
+
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "[%s] ", tag);
+    vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+    va_end(ap);
+}
+
+/****************************** Funções privadas ******************************/
+
+/**
+ * @brief Compara duas saídas; conta e reporta a divergência.
+ */
+static void expect_same(const char *what, const char *got, size_t got_len, const char *want)
+{
+    g_checks++;
+
+    if (got_len != strlen(want) || memcmp(got, want, got_len) != 0)
+    {
+        g_failures++;
+
+        if (g_failures <= 20)
+        {
+            fprintf(stderr, "FALHA %s: \"%.*s\" != \"%s\"\n", what, (int)got_len, got, want);
+        }
+    }
+}
+
+/**
+ * @brief xorshift32: reproduzível pela semente, sem depender da libc.
+ */
+static uint32_t rnd(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* ---- Referências: o código anterior ao módulo fmt ---- */
+
+static const float kPow10f[] = {1.0f, 10.0f, 100.0f, 1000.0f, 10000.0f};
+
+static float ref_field_value(const FieldDesc *f, int32_t v)
+{
+    const float raw = (f->type == FIELD_U32) ? (float)(uint32_t)v : (float)v;
+    return raw / kPow10f[f->scale_exp];
+}
+
+static void ref_field_log(const FieldDesc *f, int32_t v, char *out, size_t outlen)
+{
+    if (f->type == FIELD_U32)
+    {
+        snprintf(out, outlen, "%lu", (unsigned long)(uint32_t)v);
+    }
+    else
+    {
+        snprintf(out, outlen, "%.*f", (int)f->log_decimals, ref_field_value(f, v));
+    }
+}
+
+static size_t ref_upload_fields(const SensorReading *r, char *out, size_t outlen)
+{
+    const PayloadSchema *s = payload_schema_by_version(r->version);
+    size_t pos = 0;
+    out[0] = '\0';
+
+    for (uint8_t i = 0; i < s->n_fields; ++i)
+    {
+        const FieldDesc *f = &s->fields[i];
+
+        if (f->upload_field == 0)
+        {
+            continue;
+        }
+
+        const char *sep = (pos == 0) ? "" : "&";
+        int n;
+
+        if (f->type == FIELD_U32 && !payload_schema_field_error(r, i))
+        {
+            n = snprintf(out + pos, outlen - pos, "%sfield%u=%lu", sep,
+                         (unsigned)f->upload_field, (unsigned long)(uint32_t)r->value[i]);
+        }
+        else
+        {
+            const float v = payload_schema_field_error(r, i) ? -1.0f
+                                                            : ref_field_value(f, r->value[i]);
+            n = snprintf(out + pos, outlen - pos, "%sfield%u=%.*f", sep,
+                         (unsigned)f->upload_field, (int)f->upload_decimals, v);
+        }
+
+        if (n < 0 || (size_t)n >= outlen - pos)
+        {
+            return 0;
+        }
+
+        pos += (size_t)n;
+    }
+
+    return pos;
+}
+
+static size_t ref_hex_row(const uint8_t *buf, size_t len, char *out, size_t outlen)
+{
+    size_t pos = 0;
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        pos += (size_t)snprintf(out + pos, outlen - pos, "%02X ", buf[i]);
+    }
+
+    return pos;
+}
+
+static void ref_datetime(const struct tm *tm, uint32_t ms, char *out, size_t outlen)
+{
+    snprintf(out, outlen, "%04d/%02d/%02d %02d:%02d:%02d.%03u", tm->tm_year + 1900,
+             tm->tm_mon + 1, tm->tm_mday, tm->tm_hour, tm->tm_min, tm->tm_sec, (unsigned)ms);
+}
+
+/* ---- Casos ---- */
+
+/**
+ * @brief Faixas completas de 16 bits de cada campo v1, no log e no upload.
+ */
+static void test_schema_fields(const PayloadSchema *s)
+{
+    char got[BUF_LEN], want[BUF_LEN];
+
+    for (uint8_t i = 0; i < s->n_fields; ++i)
+    {
+        const FieldDesc *f = &s->fields[i];
+
+        if (f->type == FIELD_U32)
+        {
+            continue;
+        }
+
+        const int32_t lo = (f->type == FIELD_I16) ? INT16_MIN : 0;
+        const int32_t hi = (f->type == FIELD_I16) ? INT16_MAX : UINT16_MAX;
+
+        for (int32_t v = lo; v <= hi; ++v)
+        {
+            char *p = payload_schema_render(f, v, f->log_decimals, got);
+            ref_field_log(f, v, want, sizeof(want));
+            expect_same(f->label, got, (size_t)(p - got), want);
+        }
+    }
+
+    for (uint32_t it = 0; it < 200000; ++it)
+    {
+        SensorReading r;
+        memset(&r, 0, sizeof(r));
+        r.version = s->version;
+        r.value[0] = (rnd() % 8 == 0) ? 0xFFFF : (int32_t)(rnd() & 0xFFFFu);
+        r.value[1] = (int32_t)(rnd() & 0xFFFFu);
+        r.value[2] = (int32_t)(int16_t)rnd();
+        r.value[3] = (int32_t)rnd();
+        r.error_mask = (r.value[0] == 0xFFFF) ? 1u : 0u;
+        r.timestamp = (uint32_t)r.value[3];
+
+        const size_t n = payload_schema_upload_fields(&r, got, sizeof(got));
+        ref_upload_fields(&r, want, sizeof(want));
+        expect_same("upload", got, n, want);
+    }
+}
+
+/**
+ * @brief SNR do SX1278 (int8 / 4 dB): @c "%.1f" do float contra o caminho em centésimos.
+ */
+static void test_snr(void)
+{
+    char got[BUF_LEN], want[BUF_LEN];
+
+    for (int q = INT8_MIN; q <= INT8_MAX; ++q)
+    {
+        const float snr = (float)q * 0.25f;
+        char *p = fmt_fixed(got, (int32_t)lroundf(snr * 100.0f), 2, 1);
+        snprintf(want, sizeof(want), "%.1f", snr);
+        expect_same("snr", got, (size_t)(p - got), want);
+    }
+}
+
+/**
+ * @brief Inteiros: bordas e valores aleatórios de todas as larguras.
+ */
+static void test_integers(uint32_t iters)
+{
+    static const uint32_t kEdges[] = {0u, 1u, 9u, 10u, 99u, 100u, 999u, 1000u, 65535u,
+                                      99999999u, 100000000u, 999999999u, 1000000000u,
+                                      2147483647u, 2147483648u, 4294967295u};
+    char got[BUF_LEN], want[BUF_LEN];
+
+    for (uint32_t it = 0; it < iters + sizeof(kEdges) / sizeof(kEdges[0]); ++it)
+    {
+        const uint32_t u = (it < sizeof(kEdges) / sizeof(kEdges[0]))
+                               ? kEdges[it]
+                               : rnd() >> (rnd() % 32);
+        char *p = fmt_u32(got, u);
+        snprintf(want, sizeof(want), "%lu", (unsigned long)u);
+        expect_same("u32", got, (size_t)(p - got), want);
+
+        p = fmt_i32(got, (int32_t)u);
+        snprintf(want, sizeof(want), "%ld", (long)(int32_t)u);
+        expect_same("i32", got, (size_t)(p - got), want);
+
+        const uint8_t width = (uint8_t)(rnd() % 13);
+        p = fmt_u32_pad(got, u, width);
+        snprintf(want, sizeof(want), "%0*lu", (int)width, (unsigned long)u);
+        expect_same("u32_pad", got, (size_t)(p - got), want);
+    }
+}
+
+/**
+ * @brief @c fmt_fixed contra @c "%.*f" de valores exatos em double.
+ *
+ * Sem redução de casas, qualquer valor com até 15 dígitos significativos é exato o
+ * bastante; com redução, só múltiplos de 2^-k são exatos, e neles os empates
+ * aparecem de verdade (0,125 -> "0.12", 0,375 -> "0.38", -0,5 -> "-0").
+ */
+static void test_fixed(uint32_t iters)
+{
+    char got[BUF_LEN], want[BUF_LEN];
+
+    for (uint32_t it = 0; it < iters; ++it)
+    {
+        const uint8_t exp = (uint8_t)(rnd() % 10);
+        const uint8_t dec = (uint8_t)(exp + rnd() % (10u - exp));
+        const int32_t raw = (int32_t)(rnd() % 2000001u) - 1000000;
+
+        if (dec - exp > 6)
+        {
+            continue;
+        }
+
+        char *p = fmt_fixed(got, raw, exp, dec);
+        snprintf(want, sizeof(want), "%.*f", (int)dec, (double)raw / pow(10.0, exp));
+        expect_same("fixed", got, (size_t)(p - got), want);
+    }
+
+    /* (escala, passo bruto exato em binário, casas abaixo da escala) */
+    static const struct { uint8_t exp; int32_t step; } kExact[] = {{1, 5}, {2, 25}, {3, 125}};
+
+    for (size_t e = 0; e < sizeof(kExact) / sizeof(kExact[0]); ++e)
+    {
+        for (int32_t k = -4000; k <= 4000; ++k)
+        {
+            const int32_t raw = k * kExact[e].step;
+
+            for (uint8_t dec = 0; dec < kExact[e].exp; ++dec)
+            {
+                char *p = fmt_fixed(got, raw, kExact[e].exp, dec);
+                snprintf(want, sizeof(want), "%.*f", (int)dec,
+                         (double)raw / pow(10.0, kExact[e].exp));
+                expect_same("fixed (empate)", got, (size_t)(p - got), want);
+            }
+        }
+    }
+
+    char *p = fmt_fixed(got, INT32_MIN, 0, 9);
+    g_checks++;
+
+    if ((size_t)(p - got) > FMT_FIXED_MAX)
+    {
+        g_failures++;
+        fprintf(stderr, "FALHA fixed: %u caracteres > FMT_FIXED_MAX\n", (unsigned)(p - got));
+    }
+}
+
+static void test_hex_and_datetime(uint32_t iters)
+{
+    char got[BUF_LEN], want[BUF_LEN];
+    uint8_t row[16];
+
+    for (uint32_t it = 0; it < iters; ++it)
+    {
+        const size_t n = 1u + rnd() % 16u;
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            row[i] = (uint8_t)rnd();
+        }
+
+        char *p = fmt_hex_bytes(got, row, n);
+        ref_hex_row(row, n, want, sizeof(want));
+        expect_same("hex", got, (size_t)(p - got), want);
+
+        p = fmt_hex8(got, row[0]);
+        snprintf(want, sizeof(want), "%02X", row[0]);
+        expect_same("hex8", got, (size_t)(p - got), want);
+
+        const time_t t = (time_t)(rnd() % 4102444800u);  /* 1970..2100 */
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        const uint32_t ms = rnd() % 1000u;
+        p = fmt_datetime(got, &tm, ms);
+        ref_datetime(&tm, ms, want, sizeof(want));
+        expect_same("datetime", got, (size_t)(p - got), want);
+    }
+}
+
+/**
+ * @brief Tempo por operação de cada caminho, em ns.
+ */
+static void bench(const PayloadSchema *s, uint32_t n)
+{
+    SensorReading r;
+    memset(&r, 0, sizeof(r));
+    r.version = s->version;
+    r.value[0] = 734;
+    r.value[1] = 3712;
+    r.value[2] = -57;
+    r.value[3] = 1700000123;
+    r.timestamp = 1700000123u;
+
+    const time_t t = 1700000123;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    uint8_t row[16];
+
+    for (size_t i = 0; i < sizeof(row); ++i)
+    {
+        row[i] = (uint8_t)(i * 37u);
+    }
+
+    char buf[BUF_LEN];
+    double t0, t_old, t_new;
+
+    printf("%-22s %12s %12s %8s\n", "operacao", "snprintf ns", "fmt ns", "ganho");
+
+#define BENCH(name, old_expr, new_expr)                                             \
+    do                                                                              \
+    {                                                                               \
+        t0 = now_s();                                                               \
+        for (uint32_t i = 0; i < n; ++i)                                            \
+        {                                                                           \
+            r.value[2] = -(int32_t)(i & 511u);                                      \
+            old_expr;                                                               \
+            g_sink += (uint8_t)buf[0];                                              \
+        }                                                                           \
+        t_old = (now_s() - t0) * 1e9 / n;                                           \
+        t0 = now_s();                                                               \
+        for (uint32_t i = 0; i < n; ++i)                                            \
+        {                                                                           \
+            r.value[2] = -(int32_t)(i & 511u);                                      \
+            new_expr;                                                               \
+            g_sink += (uint8_t)buf[0];                                              \
+        }                                                                           \
+        t_new = (now_s() - t0) * 1e9 / n;                                           \
+        printf("%-22s %12.1f %12.1f %7.1fx\n", name, t_old, t_new, t_old / t_new);  \
+    } while (0)
+
+    BENCH("corpo de upload", ref_upload_fields(&r, buf, sizeof(buf)),
+          payload_schema_upload_fields(&r, buf, sizeof(buf)));
+    BENCH("campo no log", ref_field_log(&s->fields[2], r.value[2], buf, sizeof(buf)),
+          *payload_schema_render(&s->fields[2], r.value[2], s->fields[2].log_decimals, buf) = 0);
+    BENCH("data/hora do prefixo", ref_datetime(&tm, i % 1000u, buf, sizeof(buf)),
+          *fmt_datetime(buf, &tm, i % 1000u) = 0);
+    BENCH("linha de hexdump", ref_hex_row(row, sizeof(row), buf, sizeof(buf)),
+          *fmt_hex_bytes(buf, row, sizeof(row)) = 0);
+
+#undef BENCH
+}
+
+/****************************** Funções públicas ******************************/
+
+int main(int argc, char **argv)
+{
+    unsigned long iters = 1000000;
+    bool run_bench = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:bv")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            iters = strtoul(optarg, nullptr, 0);
+            break;
+        case 's':
+            g_rng = (uint32_t)strtoul(optarg, nullptr, 0);
+            break;
+        case 'b':
+            run_bench = true;
+            break;
+        case 'v':
+            g_verbose = true;
+            break;
+        default:
+            fprintf(stderr, "uso: %s [-n iteracoes] [-s semente] [-b] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (g_rng == 0)
+    {
+        g_rng = 1;
+    }
+
+    const PayloadSchema *s = payload_schema_by_version(1);
+
+    if (!s)
+    {
+        fprintf(stderr, "schema v1 ausente\n");
+        return 1;
+    }
+
+    test_schema_fields(s);
+    test_snr();
+    test_integers((uint32_t)iters);
+    test_fixed((uint32_t)iters);
+    test_hex_and_datetime((uint32_t)iters / 4u);
+
+    printf("fmt: %lu verificacoes, %lu falhas\n", (unsigned long)g_checks,
+           (unsigned long)g_failures);
+
+    if (run_bench)
+    {
+        bench(s, (uint32_t)iters);
+    }
+
+    return g_failures ? 1 : 0;
+}
@@ -0,0 +1,13 @@
+/**
+ * @file Arduino.h
+ * @brief Substituto vazio do core Arduino para os testes do fmt: as bibliotecas
+ *        testadas só usam tipos de @c stdint.h.
+ */
+
+#ifndef FMT_TEST_ARDUINO_H
+#define FMT_TEST_ARDUINO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#endif /* FMT_TEST_ARDUINO_H */
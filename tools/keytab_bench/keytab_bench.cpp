@@ -0,0 +1,266 @@
+/**
+ * @file keytab_bench.cpp
+ * @brief Benchmark de host da tabela de chaves por nó (@c lib/key_table): custo de
+ *        decifrar um quadro em função do tamanho da frota.
+ *
+ * Uso:
+ *   keytab_bench [-n 1,16,64,256,1024] [-f quadros] [-r repetições] [-c blocos]
+ *
+ * Para cada tamanho de frota, carrega uma tabela com chaves aleatórias pelo mesmo
+ * caminho do arquivo do SD (@c keytab_load + @c keytab_tick) e decifra quadros de
+ * nós sorteados de duas formas:
+ *  - tabela: @c keytab_decrypt(), com os key schedules já expandidos;
+ *  - ingênuo: busca da chave crua em um mapa e @c mbedtls_aes_setkey_dec() por quadro.
+ * Imprime ns por quadro (melhor de @c -r repetições) e o tamanho de uma @c CryptoKey.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <mbedtls/aes.h>
+#include "crypto.h"
+#include "key_table.h"
+#include "logger.h"
+#include "sd_card.h"
+
+/**
+ * @brief Quadro de teste já cifrado com a chave do nó.
+ */
+struct BenchFrame
+{
+    uint16_t node;
+    uint8_t iv[CRYPTO_BLOCK_SIZE];
+    std::vector<uint8_t> ct;
+};
+
+/****************************** Substitutos ***********************************/
+
+void logger_log(const char *, const char *, ...) {}
+void logger_log_crit(const char *, const char *, ...) {}
+void logger_hexdump(const char *, const uint8_t *, size_t) {}
+
+bool sdcard_read(const char *, char *, size_t, size_t *out_len)
+{
+    *out_len = 0;
+    return false;
+}
+
+/****************************** Funções privadas ******************************/
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static std::vector<uint32_t> parse_list(const char *s)
+{
+    std::vector<uint32_t> out;
+
+    for (const char *p = s; *p;)
+    {
+        char *end;
+        out.push_back((uint32_t)strtoul(p, &end, 10));
+
+        if (end == p)
+        {
+            break;
+        }
+
+        p = (*end == ',') ? end + 1 : end;
+    }
+
+    return out;
+}
+
+static void encrypt(const uint8_t *key, const uint8_t *iv, const uint8_t *in, size_t len,
+                    uint8_t *out)
+{
+    uint8_t iv_copy[CRYPTO_BLOCK_SIZE];
+    memcpy(iv_copy, iv, sizeof(iv_copy));
+    mbedtls_aes_context ctx;
+    mbedtls_aes_init(&ctx);
+    mbedtls_aes_setkey_enc(&ctx, key, 128);
+    mbedtls_aes_crypt_cbc(&ctx, MBEDTLS_AES_ENCRYPT, len, iv_copy, in, out);
+    mbedtls_aes_free(&ctx);
+}
+
+/**
+ * @brief Decifra como o gateway fazia antes da tabela: expande a chave a cada quadro.
+ */
+static bool naive_decrypt(const std::unordered_map<uint16_t, std::vector<uint8_t>> &keys,
+                          const BenchFrame &f, uint8_t *out, size_t *out_len)
+{
+    const auto it = keys.find(f.node);
+
+    if (it == keys.end())
+    {
+        return false;
+    }
+
+    uint8_t iv_copy[CRYPTO_BLOCK_SIZE];
+    memcpy(iv_copy, f.iv, sizeof(iv_copy));
+    mbedtls_aes_context ctx;
+    mbedtls_aes_init(&ctx);
+    mbedtls_aes_setkey_dec(&ctx, it->second.data(), 128);
+    const int rc = mbedtls_aes_crypt_cbc(&ctx, MBEDTLS_AES_DECRYPT, f.ct.size(), iv_copy,
+                                         f.ct.data(), out);
+    mbedtls_aes_free(&ctx);
+    const uint8_t pad = out[f.ct.size() - 1u];
+    *out_len = f.ct.size() - pad;
+    return rc == 0 && pad >= 1 && pad <= CRYPTO_BLOCK_SIZE;
+}
+
+/****************************** Funções públicas ******************************/
+
+int main(int argc, char **argv)
+{
+    std::vector<uint32_t> fleets = {1, 16, 64, 256, 1024};
+    uint32_t n_frames = 1u << 16;
+    uint32_t reps = 5;
+    uint32_t blocks = 1;   /* payload v1 (11 B) cabe em um bloco */
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:f:r:c:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n': fleets = parse_list(optarg); break;
+        case 'f': n_frames = (uint32_t)strtoul(optarg, nullptr, 10); break;
+        case 'r': reps = (uint32_t)strtoul(optarg, nullptr, 10); break;
+        case 'c': blocks = (uint32_t)strtoul(optarg, nullptr, 10); break;
+        default:
+            fprintf(stderr, "uso: keytab_bench [-n 1,16,64,256,1024] [-f quadros] "
+                            "[-r repeticoes] [-c blocos]\n");
+            return 2;
+        }
+    }
+
+    if (n_frames == 0 || reps == 0 || blocks == 0 || blocks > 15)
+    {
+        fprintf(stderr, "parametros invalidos\n");
+        return 2;
+    }
+
+    std::mt19937_64 rng(42);
+    const size_t ct_len = (size_t)blocks * CRYPTO_BLOCK_SIZE;
+
+    printf("# %u quadros de %u B por frota, melhor de %u; KEYTAB_MAX_NODES=%u, "
+           "CryptoKey=%u B\n",
+           (unsigned)n_frames, (unsigned)(ct_len + 18u), (unsigned)reps,
+           (unsigned)KEYTAB_MAX_NODES, (unsigned)sizeof(CryptoKey));
+    printf("# %6s %12s %12s %8s\n", "nos", "tabela ns", "ingenuo ns", "razao");
+
+    for (uint32_t nodes : fleets)
+    {
+        if (nodes == 0 || nodes > KEYTAB_MAX_NODES)
+        {
+            fprintf(stderr, "frota de %u nos fora de 1..%u\n", (unsigned)nodes,
+                    (unsigned)KEYTAB_MAX_NODES);
+            return 1;
+        }
+
+        /* Tabela carregada pelo mesmo caminho de um arquivo lido do SD. */
+        std::unordered_map<uint16_t, std::vector<uint8_t>> raw;
+        std::string text;
+        char line[48];
+
+        for (uint32_t n = 1; n <= nodes; ++n)
+        {
+            std::vector<uint8_t> key(CRYPTO_KEY_SIZE);
+            int k = snprintf(line, sizeof(line), "%u ", (unsigned)n);
+
+            for (uint8_t &b : key)
+            {
+                b = (uint8_t)rng();
+                k += snprintf(line + k, sizeof(line) - (size_t)k, "%02x", b);
+            }
+
+            raw[(uint16_t)n] = key;
+            text += line;
+            text += '\n';
+        }
+
+        if (!keytab_load(text.data(), text.size()))
+        {
+            fprintf(stderr, "tabela recusada\n");
+            return 1;
+        }
+
+        keytab_tick();
+
+        /* Quadros de nós sorteados, cifrados com PKCS#7 como no nó. */
+        std::vector<BenchFrame> frames(n_frames);
+        std::vector<uint8_t> plain(ct_len);
+
+        for (BenchFrame &f : frames)
+        {
+            f.node = (uint16_t)(1u + rng() % nodes);
+
+            for (uint8_t &b : f.iv)
+            {
+                b = (uint8_t)rng();
+            }
+
+            const size_t body = ct_len - 5u;
+
+            for (size_t i = 0; i < ct_len; ++i)
+            {
+                plain[i] = (i < body) ? (uint8_t)rng() : (uint8_t)(ct_len - body);
+            }
+
+            f.ct.resize(ct_len);
+            encrypt(raw[f.node].data(), f.iv, plain.data(), ct_len, f.ct.data());
+        }
+
+        double best_tab = 1e30;
+        double best_naive = 1e30;
+        uint8_t out[16 * CRYPTO_BLOCK_SIZE];
+        size_t out_len = 0;
+        uint32_t ok = 0;
+
+        for (uint32_t r = 0; r < reps; ++r)
+        {
+            double t0 = now_ns();
+
+            for (const BenchFrame &f : frames)
+            {
+                CryptoKey *used = nullptr;
+                ok += keytab_decrypt(f.node, f.ct.data(), f.ct.size(), f.iv, out, &out_len, &used)
+                      ? 1u : 0u;
+            }
+
+            const double t_tab = (now_ns() - t0) / n_frames;
+            t0 = now_ns();
+
+            for (const BenchFrame &f : frames)
+            {
+                ok += naive_decrypt(raw, f, out, &out_len) ? 1u : 0u;
+            }
+
+            const double t_naive = (now_ns() - t0) / n_frames;
+            best_tab = (t_tab < best_tab) ? t_tab : best_tab;
+            best_naive = (t_naive < best_naive) ? t_naive : best_naive;
+        }
+
+        if (ok != 2u * reps * n_frames)
+        {
+            fprintf(stderr, "falha ao decifrar (%u de %u)\n", (unsigned)ok,
+                    (unsigned)(2u * reps * n_frames));
+            return 1;
+        }
+
+        printf("  %6u %12.1f %12.1f %7.2fx\n", (unsigned)nodes, best_tab, best_naive,
+               best_naive / best_tab);
+        fflush(stdout);
+    }
+
+    return 0;
+}
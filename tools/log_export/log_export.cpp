@@ -0,0 +1,1106 @@
+/**
+ * @file log_export.cpp
+ * @brief Ferramenta de host: reconstrói os pacotes registrados nos logs do gateway
+ *        (arquivos do SD ou capturas do @c parser.py) e exporta CSV ou colunar.
+ *
+ * Uso:
+ *   log_export [-j N] [-o saida] [--format csv|col] arquivo.log...
+ *   log_export --bench [-j N] [-r repeticoes] arquivo.log...
+ *   log_export --synth MB arquivo.log
+ *
+ * - Cada arquivo é mapeado em memória e dividido em blocos de @c CHUNK_BYTES; os
+ *   blocos são processados em paralelo. Um bloco é dono dos pacotes cuja linha
+ *   "RX [...]" começa nele e lê além do seu fim só até completar o último pacote.
+ * - Um pacote reúne: instante e metadados do RX, bytes do hexdump, desfecho
+ *   (ok, motivo do descarte ou replay da memória RTC) e os campos decodificados
+ *   de cada leitura (várias em um lote). Há uma linha de saída por leitura, ou
+ *   uma só para pacotes sem leitura.
+ * - Linhas de outras tarefas (TS, UPLINK, METRICS...) intercaladas são ignoradas.
+ *
+ * Formato colunar (little-endian):
+ *   "LGXCOL01", u32 colunas, u64 linhas;
+ *   por coluna: u8 tipo (1 = i64, 2 = f64, 3 = texto), u16 tamanho do nome, nome;
+ *   depois, por coluna: i64/f64 -> linhas * 8 bytes; texto -> u64 offsets[linhas+1]
+ *   seguidos dos bytes. Campos ausentes ou com erro de sensor são NaN.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CHUNK_BYTES     (8u << 20)
+#define LOOKAHEAD_MAX   (256u << 10)  /* leitura máxima após o fim do bloco */
+#define TS_LEN          23            /* "YYYY/MM/DD HH:MM:SS.mmm"          */
+#define PC_PREFIX_LEN   26            /* "[YYYY-MM-DD HH:MM:SS.mmm] " (parser.py) */
+
+/**
+ * @brief Desfecho de um pacote; os nomes seguem os motivos de descarte do firmware.
+ */
+enum Outcome : uint8_t
+{
+    OUT_UNKNOWN,
+    OUT_OK,
+    OUT_SHORT,
+    OUT_CT_ALIGN,
+    OUT_AES,
+    OUT_BATCH,
+    OUT_UNPAD,
+    OUT_CHECKSUM,
+    OUT_INJECTED,
+    OUT_REPLAY,
+    OUT_N
+};
+
+static const char *const kOutcomeNames[OUT_N] = {
+    "unknown", "ok", "short", "ct_align", "aes", "batch", "unpad", "checksum",
+    "injected", "replay",
+};
+
+/**
+ * @brief Texto do desfecho nas linhas "[MAIN] ..., DESCARTADO" do firmware.
+ */
+static const struct
+{
+    const char *prefix;
+    Outcome outcome;
+} kDropLines[] = {
+    {"Pacote curto", OUT_SHORT},
+    {"Ciphertext nao multiplo", OUT_CT_ALIGN},
+    {"AES fail", OUT_AES},
+    {"Lote invalido", OUT_BATCH},
+    {"Tamanho apos unpad", OUT_UNPAD},
+    {"Payload invalido", OUT_CHECKSUM},
+    {"Perda de pacote injetada", OUT_INJECTED},
+};
+
+/**
+ * @brief Um campo decodificado; o texto aponta para o arquivo mapeado.
+ */
+struct Value
+{
+    uint16_t label;     /* índice no vetor de rótulos do bloco */
+    bool error;         /* sentinela de erro do sensor         */
+    double num;
+    const char *txt;
+    uint16_t txt_len;
+};
+
+struct Reading
+{
+    uint32_t first_value;
+    uint16_t n_values;
+    int16_t checksum;   /* -1 = ausente */
+};
+
+struct Packet
+{
+    const char *ts;     /* texto "YYYY/MM/DD HH:MM:SS.mmm" */
+    int64_t t_ms;
+    uint64_t offset;    /* byte da linha RX no arquivo */
+    uint32_t file;
+    int32_t len;
+    int32_t rssi;
+    double snr;
+    uint32_t hex_off;   /* bytes do hexdump em Chunk::bytes */
+    uint32_t hex_len;
+    uint32_t hex_expected;
+    uint32_t first_reading;
+    uint32_t n_readings;
+    int32_t batch_count;  /* -1 = não é lote */
+    Outcome outcome;
+};
+
+/**
+ * @brief Trabalho e resultado de um bloco.
+ */
+struct Chunk
+{
+    uint32_t file;
+    const char *base;   /* início do arquivo */
+    size_t file_len;
+    size_t begin;
+    size_t end;
+
+    std::vector<Packet> packets;
+    std::vector<Reading> readings;
+    std::vector<Value> values;
+    std::vector<uint8_t> bytes;
+    std::vector<std::string> labels;
+    std::vector<uint16_t> label_map;  /* rótulo local -> coluna global */
+    std::string out;                  /* CSV formatado */
+    uint64_t rows;
+    uint64_t row0;
+};
+
+struct MappedFile
+{
+    std::string path;
+    const char *data;
+    size_t len;
+};
+
+/****************************** Funções privadas ******************************/
+
+/**
+ * @brief Dias desde 1970-01-01 para a data civil (algoritmo de H. Hinnant).
+ */
+static int64_t days_from_civil(int64_t y, unsigned m, unsigned d)
+{
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = (unsigned)(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+static inline unsigned dig2(const char *p)
+{
+    return (unsigned)(p[0] - '0') * 10u + (unsigned)(p[1] - '0');
+}
+
+/**
+ * @brief Converte "YYYY/MM/DD HH:MM:SS.mmm" em ms desde a época (hora local do gateway).
+ */
+static int64_t parse_ts_ms(const char *p)
+{
+    const int64_t y = (int64_t)dig2(p) * 100 + dig2(p + 2);
+    const int64_t days = days_from_civil(y, dig2(p + 5), dig2(p + 8));
+    const int64_t secs = days * 86400 + dig2(p + 11) * 3600 + dig2(p + 14) * 60 + dig2(p + 17);
+    const int64_t ms = (p[20] - '0') * 100 + dig2(p + 21);
+    return secs * 1000 + ms;
+}
+
+static inline bool starts_with(const char *p, const char *end, const char *lit)
+{
+    const size_t n = strlen(lit);
+    return (size_t)(end - p) >= n && memcmp(p, lit, n) == 0;
+}
+
+static inline int hexval(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+/**
+ * @brief Linha de log decomposta.
+ */
+struct Line
+{
+    const char *ts;
+    const char *tag;
+    size_t tag_len;
+    const char *msg;
+    const char *end;   /* sem '\r'/'\n' */
+};
+
+/**
+ * @brief Decompõe "timestamp [TAG] msg", aceitando o prefixo do @c parser.py.
+ */
+static bool split_line(const char *p, const char *end, Line *out)
+{
+    if (end - p > PC_PREFIX_LEN && p[0] == '[' && p[PC_PREFIX_LEN - 2] == ']')
+    {
+        p += PC_PREFIX_LEN;
+    }
+
+    if (end - p < TS_LEN + 4 || p[4] != '/' || p[TS_LEN] != ' ' || p[TS_LEN + 1] != '[')
+    {
+        return false;
+    }
+
+    const char *tag = p + TS_LEN + 2;
+    const char *close = (const char *)memchr(tag, ']', (size_t)(end - tag));
+
+    if (!close || close + 1 >= end)
+    {
+        return false;
+    }
+
+    while (end > p && (end[-1] == '\r' || end[-1] == '\n'))
+    {
+        --end;
+    }
+
+    out->ts = p;
+    out->tag = tag;
+    out->tag_len = (size_t)(close - tag);
+    out->msg = (close + 2 <= end) ? close + 2 : end;
+    out->end = end;
+    return true;
+}
+
+static inline bool tag_is(const Line &l, const char *t, size_t n)
+{
+    return l.tag_len == n && memcmp(l.tag, t, n) == 0;
+}
+
+static uint16_t intern_label(Chunk *c, const char *p, size_t n)
+{
+    for (size_t i = 0; i < c->labels.size(); ++i)
+    {
+        if (c->labels[i].size() == n && memcmp(c->labels[i].data(), p, n) == 0)
+        {
+            return (uint16_t)i;
+        }
+    }
+
+    c->labels.emplace_back(p, n);
+    return (uint16_t)(c->labels.size() - 1);
+}
+
+/**
+ * @brief Informa se o pacote já tem tudo o que o firmware registraria para ele.
+ */
+static bool packet_complete(const Chunk *c, const Packet *pk)
+{
+    if (pk->hex_len < pk->hex_expected)
+    {
+        return false;
+    }
+
+    if (pk->outcome != OUT_UNKNOWN && pk->outcome != OUT_OK)
+    {
+        return true;
+    }
+
+    if (pk->batch_count >= 0)
+    {
+        return pk->n_readings >= (uint32_t)pk->batch_count;
+    }
+
+    /* Leitura simples: completa quando o bloco "---- ... ----" fechou. */
+    return pk->n_readings > 0 && c->readings.back().checksum >= 0;
+}
+
+/**
+ * @brief Percorre o bloco reconstruindo os pacotes que começam nele.
+ */
+static void parse_chunk(Chunk *c)
+{
+    const char *const base = c->base;
+    const char *const file_end = base + c->file_len;
+    const char *p = base + c->begin;
+    const char *const own_end = base + c->end;
+    const char *const hard_end = (c->end + LOOKAHEAD_MAX < c->file_len)
+                                     ? base + c->end + LOOKAHEAD_MAX : file_end;
+
+    Packet *cur = nullptr;
+    bool in_reading = false;
+
+    while (p < file_end)
+    {
+        const char *nl = (const char *)memchr(p, '\n', (size_t)(file_end - p));
+        const char *eol = nl ? nl : file_end;
+        const char *line_start = p;
+        p = nl ? nl + 1 : file_end;
+
+        if (line_start >= own_end && (!cur || packet_complete(c, cur) || line_start >= hard_end))
+        {
+            break;
+        }
+
+        Line l;
+
+        if (!split_line(line_start, eol, &l))
+        {
+            continue;
+        }
+
+        const bool lora = tag_is(l, "LORA", 4);
+        const bool main_tag = tag_is(l, "MAIN", 4);
+
+        if (!lora && !main_tag)
+        {
+            continue;
+        }
+
+        const bool rx = lora && starts_with(l.msg, l.end, "RX [");
+        const bool replay = main_tag && starts_with(l.msg, l.end, "Leitura recuperada");
+
+        if (rx || replay)
+        {
+            if (line_start >= own_end)
+            {
+                break;  /* pertence ao próximo bloco */
+            }
+
+            c->packets.push_back(Packet());
+            cur = &c->packets.back();
+            memset(cur, 0, sizeof(*cur));
+            cur->ts = l.ts;
+            cur->t_ms = parse_ts_ms(l.ts);
+            cur->offset = (uint64_t)(line_start - base);
+            cur->file = c->file;
+            cur->len = -1;
+            cur->hex_off = (uint32_t)c->bytes.size();
+            cur->first_reading = (uint32_t)c->readings.size();
+            cur->batch_count = -1;
+            cur->outcome = replay ? OUT_REPLAY : OUT_UNKNOWN;
+            in_reading = false;
+
+            if (rx)
+            {
+                /* "RX [%u B]  RSSI=%d  SNR=%s" */
+                char *q;
+                cur->len = (int32_t)strtol(l.msg + 4, &q, 10);
+                const char *r = strstr(q, "RSSI=");
+                const char *s = strstr(q, "SNR=");
+                cur->rssi = r ? (int32_t)strtol(r + 5, nullptr, 10) : 0;
+                cur->snr = s ? strtod(s + 4, nullptr) : NAN;
+            }
+
+            continue;
+        }
+
+        if (!cur)
+        {
+            continue;  /* cauda do pacote do bloco anterior */
+        }
+
+        if (lora)
+        {
+            if (starts_with(l.msg, l.end, "HEXDUMP ("))
+            {
+                cur->hex_expected = (uint32_t)strtoul(l.msg + 9, nullptr, 10);
+                continue;
+            }
+
+            /* Linha de dump: "0A 1B 2C ..." */
+            for (const char *h = l.msg; h + 1 < l.end && cur->hex_len < cur->hex_expected; h += 3)
+            {
+                const int hi = hexval(h[0]), lo = hexval(h[1]);
+
+                if (hi < 0 || lo < 0)
+                {
+                    break;
+                }
+
+                c->bytes.push_back((uint8_t)(hi << 4 | lo));
+                cur->hex_len++;
+            }
+
+            continue;
+        }
+
+        /* MAIN */
+        if (starts_with(l.msg, l.end, "---- Pacote decodificado"))
+        {
+            c->readings.push_back(Reading{(uint32_t)c->values.size(), 0, -1});
+            cur->n_readings++;
+            in_reading = true;
+
+            if (cur->outcome == OUT_UNKNOWN)
+            {
+                cur->outcome = OUT_OK;
+            }
+
+            continue;
+        }
+
+        if (starts_with(l.msg, l.end, "-----------"))
+        {
+            in_reading = false;
+            continue;
+        }
+
+        if (starts_with(l.msg, l.end, "Lote com "))
+        {
+            cur->batch_count = (int32_t)strtol(l.msg + 9, nullptr, 10);
+            continue;
+        }
+
+        if (in_reading)
+        {
+            /* "%-12s: valor unidade" ou "%-12s: ERRO (0x...)" */
+            const char *colon = (const char *)memchr(l.msg, ':', (size_t)(l.end - l.msg));
+
+            if (!colon || colon + 2 > l.end)
+            {
+                continue;
+            }
+
+            const char *lab_end = colon;
+
+            while (lab_end > l.msg && lab_end[-1] == ' ')
+            {
+                --lab_end;
+            }
+
+            const char *v = colon + 2;
+            const char *v_end = (const char *)memchr(v, ' ', (size_t)(l.end - v));
+            v_end = v_end ? v_end : l.end;
+            Reading &rd = c->readings.back();
+
+            if (lab_end - l.msg == 8 && memcmp(l.msg, "Checksum", 8) == 0)
+            {
+                rd.checksum = (int16_t)strtol(v, nullptr, 16);
+                continue;
+            }
+
+            Value val;
+            val.label = intern_label(c, l.msg, (size_t)(lab_end - l.msg));
+            val.error = starts_with(v, l.end, "ERRO");
+            val.num = val.error ? NAN : strtod(v, nullptr);
+            val.txt = v;
+            val.txt_len = (uint16_t)(v_end - v);
+            c->values.push_back(val);
+            rd.n_values++;
+            continue;
+        }
+
+        if ((size_t)(l.end - l.msg) > 10 && memcmp(l.end - 10, "DESCARTADO", 10) == 0)
+        {
+            for (const auto &d : kDropLines)
+            {
+                if (starts_with(l.msg, l.end, d.prefix))
+                {
+                    cur->outcome = d.outcome;
+                    break;
+                }
+            }
+        }
+    }
+
+    c->rows = 0;
+
+    for (const Packet &pk : c->packets)
+    {
+        c->rows += pk.n_readings ? pk.n_readings : 1u;
+    }
+}
+
+/**
+ * @brief Divide os arquivos em blocos alinhados a início de linha.
+ */
+static std::vector<Chunk> make_chunks(const std::vector<MappedFile> &files)
+{
+    std::vector<Chunk> chunks;
+
+    for (uint32_t f = 0; f < files.size(); ++f)
+    {
+        const MappedFile &mf = files[f];
+        size_t pos = 0;
+
+        while (pos < mf.len)
+        {
+            size_t end = pos + CHUNK_BYTES;
+
+            if (end >= mf.len)
+            {
+                end = mf.len;
+            }
+            else
+            {
+                const char *nl = (const char *)memchr(mf.data + end, '\n', mf.len - end);
+                end = nl ? (size_t)(nl - mf.data) + 1u : mf.len;
+            }
+
+            Chunk c;
+            c.file = f;
+            c.base = mf.data;
+            c.file_len = mf.len;
+            c.begin = pos;
+            c.end = end;
+            c.rows = 0;
+            c.row0 = 0;
+            chunks.push_back(std::move(c));
+            pos = end;
+        }
+    }
+
+    return chunks;
+}
+
+/**
+ * @brief Executa @p fn(i) para i em [0, n) em @p threads threads.
+ */
+template <typename Fn>
+static void parallel_for(size_t n, unsigned threads, Fn fn)
+{
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> pool;
+
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        pool.emplace_back([&]() {
+            for (size_t i; (i = next.fetch_add(1)) < n;)
+            {
+                fn(i);
+            }
+        });
+    }
+
+    for (std::thread &th : pool)
+    {
+        th.join();
+    }
+}
+
+/**
+ * @brief Une os rótulos de todos os blocos, na ordem de primeira ocorrência.
+ */
+static std::vector<std::string> merge_labels(std::vector<Chunk> &chunks)
+{
+    std::vector<std::string> cols;
+    std::unordered_map<std::string, uint16_t> idx;
+
+    for (Chunk &c : chunks)
+    {
+        c.label_map.resize(c.labels.size());
+
+        for (size_t i = 0; i < c.labels.size(); ++i)
+        {
+            auto it = idx.find(c.labels[i]);
+
+            if (it == idx.end())
+            {
+                it = idx.emplace(c.labels[i], (uint16_t)cols.size()).first;
+                cols.push_back(c.labels[i]);
+            }
+
+            c.label_map[i] = it->second;
+        }
+    }
+
+    return cols;
+}
+
+static void csv_put_hex(std::string &out, const uint8_t *b, size_t n)
+{
+    static const char kHex[] = "0123456789ABCDEF";
+    const size_t at = out.size();
+    out.resize(at + n * 2);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        out[at + 2 * i] = kHex[b[i] >> 4];
+        out[at + 2 * i + 1] = kHex[b[i] & 0x0F];
+    }
+}
+
+/**
+ * @brief Formata as linhas CSV de um bloco.
+ */
+static void format_csv(Chunk *c, const std::vector<MappedFile> &files, size_t n_cols)
+{
+    std::vector<const Value *> row(n_cols);
+    char num[64];
+    std::string &o = c->out;
+    o.reserve((size_t)c->rows * 96u);
+
+    for (const Packet &pk : c->packets)
+    {
+        const uint32_t n = pk.n_readings ? pk.n_readings : 1u;
+
+        for (uint32_t k = 0; k < n; ++k)
+        {
+            const Reading *rd = pk.n_readings ? &c->readings[pk.first_reading + k] : nullptr;
+            o += files[pk.file].path;
+            int w = snprintf(num, sizeof(num), ",%llu,%lld,", (unsigned long long)pk.offset,
+                             (long long)pk.t_ms);
+            o.append(num, (size_t)w);
+            o.append(pk.ts, TS_LEN);
+
+            if (pk.len >= 0)
+            {
+                w = snprintf(num, sizeof(num), ",%d,%d,%.2f,", pk.len, pk.rssi, pk.snr);
+            }
+            else
+            {
+                w = snprintf(num, sizeof(num), ",,,,");
+            }
+
+            o.append(num, (size_t)w);
+            o += kOutcomeNames[pk.outcome];
+            w = rd ? snprintf(num, sizeof(num), ",%u,", k) : snprintf(num, sizeof(num), ",,");
+            o.append(num, (size_t)w);
+            csv_put_hex(o, c->bytes.data() + pk.hex_off, pk.hex_len);
+            o += ',';
+
+            if (rd && rd->checksum >= 0)
+            {
+                w = snprintf(num, sizeof(num), "%d", rd->checksum);
+                o.append(num, (size_t)w);
+            }
+
+            std::fill(row.begin(), row.end(), nullptr);
+
+            for (uint16_t v = 0; rd && v < rd->n_values; ++v)
+            {
+                const Value *val = &c->values[rd->first_value + v];
+                row[c->label_map[val->label]] = val;
+            }
+
+            for (const Value *val : row)
+            {
+                o += ',';
+
+                if (val)
+                {
+                    val->error ? (void)(o += "ERR") : (void)o.append(val->txt, val->txt_len);
+                }
+            }
+
+            o += '\n';
+        }
+    }
+}
+
+static bool write_all(FILE *f, const void *p, size_t n)
+{
+    return fwrite(p, 1, n, f) == n;
+}
+
+/**
+ * @brief Escreve o arquivo colunar (formato no cabeçalho deste arquivo).
+ */
+static bool write_columnar(FILE *f, std::vector<Chunk> &chunks,
+                           const std::vector<MappedFile> &files,
+                           const std::vector<std::string> &labels, unsigned threads)
+{
+    uint64_t rows = 0;
+
+    for (Chunk &c : chunks)
+    {
+        c.row0 = rows;
+        rows += c.rows;
+    }
+
+    enum { I64 = 1, F64 = 2, STR = 3 };
+    struct Col { const char *name; uint8_t type; };
+    std::vector<Col> cols = {
+        {"file", I64}, {"offset", I64}, {"time_ms", I64}, {"len", I64}, {"rssi", I64},
+        {"snr", F64}, {"outcome", STR}, {"reading", I64}, {"payload", STR}, {"checksum", I64},
+    };
+
+    for (const std::string &l : labels)
+    {
+        cols.push_back({l.c_str(), F64});
+    }
+
+    const size_t n_fixed_num = 6;  /* file, offset, time_ms, len, rssi, snr */
+    std::vector<std::vector<int64_t>> num(n_fixed_num + 2);  /* + reading, checksum */
+    std::vector<std::vector<double>> fld(labels.size());
+
+    for (auto &v : num) v.resize(rows);
+    for (auto &v : fld) v.resize(rows);
+
+    parallel_for(chunks.size(), threads, [&](size_t i) {
+        const Chunk &c = chunks[i];
+        uint64_t r = c.row0;
+
+        for (const Packet &pk : c.packets)
+        {
+            const uint32_t n = pk.n_readings ? pk.n_readings : 1u;
+
+            for (uint32_t k = 0; k < n; ++k, ++r)
+            {
+                const Reading *rd = pk.n_readings ? &c.readings[pk.first_reading + k] : nullptr;
+                double snr = pk.snr;
+                num[0][r] = pk.file;
+                num[1][r] = (int64_t)pk.offset;
+                num[2][r] = pk.t_ms;
+                num[3][r] = pk.len;
+                num[4][r] = pk.rssi;
+                memcpy(&num[5][r], &snr, sizeof(snr));
+                num[6][r] = rd ? (int64_t)k : -1;
+                num[7][r] = rd ? rd->checksum : -1;
+
+                for (size_t j = 0; j < fld.size(); ++j)
+                {
+                    fld[j][r] = NAN;
+                }
+
+                for (uint16_t v = 0; rd && v < rd->n_values; ++v)
+                {
+                    const Value &val = c.values[rd->first_value + v];
+                    fld[c.label_map[val.label]][r] = val.num;
+                }
+            }
+        }
+    });
+
+    /* Textos: desfecho e payload em hexadecimal. */
+    std::vector<uint64_t> out_off(rows + 1), pay_off(rows + 1);
+    std::string out_blob, pay_blob;
+    uint64_t r = 0;
+
+    for (const Chunk &c : chunks)
+    {
+        for (const Packet &pk : c.packets)
+        {
+            const uint32_t n = pk.n_readings ? pk.n_readings : 1u;
+
+            for (uint32_t k = 0; k < n; ++k, ++r)
+            {
+                out_off[r] = out_blob.size();
+                out_blob += kOutcomeNames[pk.outcome];
+                pay_off[r] = pay_blob.size();
+                csv_put_hex(pay_blob, c.bytes.data() + pk.hex_off, pk.hex_len);
+            }
+        }
+    }
+
+    out_off[rows] = out_blob.size();
+    pay_off[rows] = pay_blob.size();
+    (void)files;
+
+    const uint32_t n_cols = (uint32_t)cols.size();
+    bool ok = write_all(f, "LGXCOL01", 8) && write_all(f, &n_cols, 4) && write_all(f, &rows, 8);
+
+    for (const Col &c : cols)
+    {
+        const uint16_t nl = (uint16_t)strlen(c.name);
+        ok = ok && write_all(f, &c.type, 1) && write_all(f, &nl, 2) && write_all(f, c.name, nl);
+    }
+
+    const size_t bytes = (size_t)rows * 8u;
+
+    for (size_t j = 0; j < n_fixed_num; ++j)
+    {
+        ok = ok && write_all(f, num[j].data(), bytes);
+    }
+
+    ok = ok && write_all(f, out_off.data(), (rows + 1) * 8u) && write_all(f, out_blob.data(), out_blob.size());
+    ok = ok && write_all(f, num[6].data(), bytes);
+    ok = ok && write_all(f, pay_off.data(), (rows + 1) * 8u) && write_all(f, pay_blob.data(), pay_blob.size());
+    ok = ok && write_all(f, num[7].data(), bytes);
+
+    for (const auto &v : fld)
+    {
+        ok = ok && write_all(f, v.data(), bytes);
+    }
+
+    return ok;
+}
+
+static bool map_file(const char *path, MappedFile *out)
+{
+    const int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+    {
+        perror(path);
+        return false;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0)
+    {
+        perror(path);
+        close(fd);
+        return false;
+    }
+
+    out->path = path;
+    out->len = (size_t)st.st_size;
+    out->data = "";
+
+    if (out->len)
+    {
+        void *m = mmap(nullptr, out->len, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (m == MAP_FAILED)
+        {
+            perror(path);
+            close(fd);
+            return false;
+        }
+
+        (void)madvise(m, out->len, MADV_SEQUENTIAL | MADV_WILLNEED);
+        out->data = (const char *)m;
+    }
+
+    close(fd);
+    return true;
+}
+
+/**
+ * @brief Gera um log sintético no formato do gateway, para o benchmark.
+ */
+static int synth(const char *path, uint64_t mb)
+{
+    FILE *f = fopen(path, "wb");
+
+    if (!f)
+    {
+        perror(path);
+        return 1;
+    }
+
+    const uint64_t target = mb << 20;
+    uint64_t written = 0;
+    uint32_t seq = 0;
+    int64_t t = days_from_civil(2025, 1, 1) * 86400000LL;
+    char buf[4096];
+
+    while (written < target)
+    {
+        size_t n = 0;
+        const int kind = (int)(seq % 16u);
+        const int len = (kind == 15) ? 20 : (kind >= 12 ? 96 : 48);
+        char ts[48];
+
+        auto stamp = [&]() {
+            const int64_t s = t / 1000;
+            const int64_t days = s / 86400;
+            int64_t z = days + 719468;
+            const int64_t era = z / 146097;
+            const unsigned doe = (unsigned)(z - era * 146097);
+            const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+            const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+            const unsigned mp = (5 * doy + 2) / 153;
+            const unsigned d = doy - (153 * mp + 2) / 5 + 1;
+            const unsigned m = mp < 10 ? mp + 3 : mp - 9;
+            const int64_t y = (int64_t)yoe + era * 400 + (m <= 2);
+            const int64_t sod = s % 86400;
+            snprintf(ts, sizeof(ts), "%04d/%02u/%02u %02d:%02d:%02d.%03d", (int)y, m, d,
+                     (int)(sod / 3600), (int)(sod / 60 % 60), (int)(sod % 60), (int)(t % 1000));
+            t += 7;
+        };
+
+        stamp();
+        n += (size_t)snprintf(buf + n, sizeof(buf) - n, "%s [LORA] RX [%d B]  RSSI=%d  SNR=%d.%d\n",
+                              ts, len, -60 - (int)(seq % 50u), (int)(seq % 12u), (int)(seq % 10u));
+        n += (size_t)snprintf(buf + n, sizeof(buf) - n, "%s [LORA] HEXDUMP (%d bytes):\n", ts, len);
+
+        for (int off = 0; off < len; off += 16)
+        {
+            n += (size_t)snprintf(buf + n, sizeof(buf) - n, "%s [LORA] ", ts);
+
+            for (int i = off; i < off + 16 && i < len; ++i)
+            {
+                n += (size_t)snprintf(buf + n, sizeof(buf) - n, "%02X ", (unsigned)((seq * 31u + (unsigned)i) & 0xFFu));
+            }
+
+            buf[n++] = '\n';
+        }
+
+        if (kind == 15)
+        {
+            n += (size_t)snprintf(buf + n, sizeof(buf) - n,
+                                  "%s [MAIN] Pacote curto (IV16 + CT16+), DESCARTADO\n", ts);
+        }
+        else
+        {
+            const int samples = (kind >= 12) ? 3 : 1;
+
+            if (samples > 1)
+            {
+                n += (size_t)snprintf(buf + n, sizeof(buf) - n, "%s [MAIN] Lote com %d amostras\n", ts, samples);
+            }
+
+            for (int s = 0; s < samples; ++s)
+            {
+                stamp();
+                n += (size_t)snprintf(buf + n, sizeof(buf) - n,
+                    "%s [MAIN] ---- Pacote decodificado ----\n"
+                    "%s [MAIN] Irradiancia : %u W/m^2\n"
+                    "%s [MAIN] Bateria     : 3.%03u V\n"
+                    "%s [MAIN] Temp. int.  : 2%u.%u C\n"
+                    "%s [MAIN] Timestamp   : %u s\n"
+                    "%s [MAIN] Checksum    : 0x%02X\n"
+                    "%s [MAIN] -----------------------------\n",
+                    ts, ts, seq % 1200u, ts, seq % 1000u, ts, seq % 10u, seq % 7u, ts,
+                    1700000000u + seq, ts, seq & 0xFFu, ts);
+            }
+        }
+
+        if (seq % 5u == 0)
+        {
+            n += (size_t)snprintf(buf + n, sizeof(buf) - n,
+                                  "%s [UPLINK] sink TS ativo (fila=8)\n", ts);
+        }
+
+        if (fwrite(buf, 1, n, f) != n)
+        {
+            perror(path);
+            fclose(f);
+            return 1;
+        }
+
+        written += n;
+        seq++;
+    }
+
+    fclose(f);
+    fprintf(stderr, "%s: %llu bytes, %u pacotes\n", path, (unsigned long long)written, seq);
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "uso: log_export [-j N] [-o saida] [--format csv|col] arquivo.log...\n"
+            "     log_export --bench [-j N] [-r repeticoes] arquivo.log...\n"
+            "     log_export --synth MB arquivo.log\n");
+}
+
+/****************************** Funções públicas ******************************/
+
+int main(int argc, char **argv)
+{
+    unsigned threads = std::thread::hardware_concurrency();
+    const char *out_path = nullptr;
+    bool columnar = false;
+    bool bench = false;
+    int reps = 3;
+    std::vector<const char *> inputs;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string a = argv[i];
+
+        if (a == "-j" && i + 1 < argc)
+        {
+            threads = (unsigned)atoi(argv[++i]);
+        }
+        else if (a == "-o" && i + 1 < argc)
+        {
+            out_path = argv[++i];
+        }
+        else if (a == "--format" && i + 1 < argc)
+        {
+            columnar = std::string(argv[++i]) == "col";
+        }
+        else if (a == "--bench")
+        {
+            bench = true;
+        }
+        else if (a == "-r" && i + 1 < argc)
+        {
+            reps = atoi(argv[++i]);
+        }
+        else if (a == "--synth" && i + 2 < argc)
+        {
+            return synth(argv[i + 2], strtoull(argv[i + 1], nullptr, 10));
+        }
+        else if (a == "-h" || a == "--help" || (a.size() > 1 && a[0] == '-'))
+        {
+            usage();
+            return 2;
+        }
+        else
+        {
+            inputs.push_back(argv[i]);
+        }
+    }
+
+    if (inputs.empty())
+    {
+        usage();
+        return 2;
+    }
+
+    threads = threads ? threads : 1u;
+    std::vector<MappedFile> files(inputs.size());
+    uint64_t total = 0;
+
+    for (size_t i = 0; i < inputs.size(); ++i)
+    {
+        if (!map_file(inputs[i], &files[i]))
+        {
+            return 1;
+        }
+
+        total += files[i].len;
+    }
+
+    std::vector<Chunk> chunks;
+    double best = 1e30;
+
+    for (int rep = 0; rep < (bench ? std::max(reps, 1) : 1); ++rep)
+    {
+        chunks = make_chunks(files);
+        const auto t0 = std::chrono::steady_clock::now();
+        parallel_for(chunks.size(), threads, [&](size_t i) { parse_chunk(&chunks[i]); });
+        const double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        best = std::min(best, s);
+    }
+
+    uint64_t packets = 0, rows = 0;
+
+    for (const Chunk &c : chunks)
+    {
+        packets += c.packets.size();
+        rows += c.rows;
+    }
+
+    fprintf(stderr, "%llu bytes, %llu pacotes, %llu linhas, %u threads: %.3f s (%.2f GB/s)\n",
+            (unsigned long long)total, (unsigned long long)packets, (unsigned long long)rows,
+            threads, best, best > 0 ? (double)total / best / 1e9 : 0.0);
+
+    if (bench)
+    {
+        return 0;
+    }
+
+    const std::vector<std::string> labels = merge_labels(chunks);
+    FILE *f = out_path ? fopen(out_path, "wb") : stdout;
+
+    if (!f)
+    {
+        perror(out_path);
+        return 1;
+    }
+
+    bool ok;
+
+    if (columnar)
+    {
+        ok = write_columnar(f, chunks, files, labels, threads);
+    }
+    else
+    {
+        std::string hdr = "file,offset,time_ms,time,len,rssi,snr,outcome,reading,payload,checksum";
+
+        for (const std::string &l : labels)
+        {
+            hdr += ',';
+            hdr += l;
+        }
+
+        hdr += '\n';
+        ok = write_all(f, hdr.data(), hdr.size());
+        parallel_for(chunks.size(), threads, [&](size_t i) {
+            format_csv(&chunks[i], files, labels.size());
+        });
+
+        for (const Chunk &c : chunks)
+        {
+            ok = ok && write_all(f, c.out.data(), c.out.size());
+        }
+    }
+
+    if (f != stdout)
+    {
+        ok = (fclose(f) == 0) && ok;
+    }
+
+    if (!ok)
+    {
+        fprintf(stderr, "falha ao gravar a saida\n");
+        return 1;
+    }
+
+    return 0;
+}
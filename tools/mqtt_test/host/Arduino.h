@@ -0,0 +1,34 @@
+/**
+ * @file Arduino.h
+ * @brief Substituto mínimo do core Arduino para o teste do cliente MQTT:
+ *        @c millis() é o relógio simulado do teste e @c delay() o avança.
+ */
+
+#ifndef MQTT_TEST_ARDUINO_H
+#define MQTT_TEST_ARDUINO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+uint32_t millis(void);
+void delay(uint32_t ms);
+
+/* O newlib do ESP32 tem strlcpy; a glibc, só a partir da 2.38. */
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+static inline size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    const size_t n = strlen(src);
+
+    if (size)
+    {
+        const size_t k = (n < size) ? n : size - 1u;
+        memcpy(dst, src, k);
+        dst[k] = '\0';
+    }
+
+    return n;
+}
+#endif
+
+#endif /* MQTT_TEST_ARDUINO_H */
@@ -0,0 +1,23 @@
+/**
+ * @file WiFi.h
+ * @brief Substituto de @c WiFi.h: @c WiFiClient ligado ao broker simulado do teste.
+ */
+
+#ifndef MQTT_TEST_WIFI_H
+#define MQTT_TEST_WIFI_H
+
+#include <Arduino.h>
+
+class WiFiClient
+{
+public:
+    int connect(const char *host, uint16_t port, int32_t timeout_ms);
+    int setNoDelay(bool nodelay);
+    size_t write(const uint8_t *buf, size_t len);
+    int available(void);
+    int read(void);
+    uint8_t connected(void);
+    void stop(void);
+};
+
+#endif /* MQTT_TEST_WIFI_H */
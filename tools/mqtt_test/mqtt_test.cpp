@@ -0,0 +1,1087 @@
+/**
+ * @file mqtt_test.cpp
+ * @brief Teste de host da sessão do cliente MQTT (@c lib/mqtt_client) contra um
+ *        broker MQTT 3.1.1 simulado.
+ *
+ * Uso:
+ *   mqtt_test [-n passos da rodada aleatória] [-s semente] [-v]
+ *
+ * O cliente real é compilado sem alterações; o @c WiFiClient de @c host/WiFi.h
+ * entrega cada byte escrito ao broker simulado abaixo, que decodifica CONNECT,
+ * PUBLISH e PINGREQ e responde com CONNACK, PUBACK e PINGRESP. O broker pode
+ * recusar o TCP, recusar ou não responder o CONNECT, reter PUBACKs, ignorar
+ * PINGREQ, esquecer a sessão e fechar a conexão a qualquer momento. @c delay()
+ * avança o relógio simulado.
+ *
+ * Cobre:
+ *  - campos do CONNECT (MQTT 3.1.1, Clean Session = 0, keep-alive, credenciais);
+ *  - PUBLISH QoS 1 com o corpo de @c payload_schema_upload_fields() e o tamanho
+ *    exato do pacote;
+ *  - janela de @c MQTT_WINDOW publicações sem PUBACK e recusa da seguinte;
+ *  - PUBACK atrasado, socket fechado e Wi-Fi fora: reconexão só após 5 s, sessão
+ *    retomada e reenvio com DUP, mesmo packet id e mesmo corpo;
+ *  - PINGREQ após 30 s sem tráfego e queda após 60 s sem PINGRESP;
+ *  - CONNACK recusado, CONNACK ausente (timeout de 3 s) e TCP recusado;
+ *  - sessão perdida no broker (reenvio da janela mesmo sem sessão presente);
+ *  - bytes por leitura contra o cabeçalho de um POST HTTP equivalente;
+ *  - rodada aleatória com falhas: toda leitura aceita chega ao broker ao menos
+ *    uma vez, nenhum reenvio depois de um PUBACK entregue e contadores coerentes.
+ *
+ * Sai com código 1 se algum caso falhar.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <WiFi.h>
+#include "logger.h"
+#include "mqtt_client.h"
+#include "payload_schema.h"
+#include "wifi_manager.h"
+
+#define BROKER_HOST   "broker.teste"
+#define BROKER_PORT   1883
+#define CLIENT_ID     "estacao-01"
+#define MQTT_USER     "usuario"
+#define MQTT_PASS     "senha"
+#define TOPIC         "estacao/leituras"
+#define MAX_READINGS  16384
+#define TICK_MS       100
+
+/**
+ * @brief Broker MQTT simulado (uma conexão por vez, sessão por client id).
+ */
+typedef struct
+{
+    /* comportamento */
+    bool listening;         /* aceita conexões TCP                      */
+    bool mute;              /* não responde ao CONNECT                  */
+    uint8_t rc;             /* código de retorno do próximo CONNACK     */
+    bool ack;               /* responde PUBLISH com PUBACK              */
+    bool pong;              /* responde PINGREQ                         */
+    bool session;           /* há sessão guardada para o cliente        */
+
+    /* conexão corrente */
+    bool open;
+    bool online;            /* CONNECT aceito nesta conexão             */
+    bool nodelay;
+    uint8_t in[512];
+    size_t in_len;
+    uint8_t out[256];
+    size_t out_len;
+    size_t out_pos;
+    uint16_t pend_ack[64];  /* PUBACKs ainda não lidos pelo cliente     */
+    uint8_t n_pend;
+
+    /* último CONNECT */
+    char proto[8];
+    uint8_t level;
+    uint8_t flags;
+    uint16_t keepalive;
+    char client_id[32];
+    char user[32];
+    char pass[64];
+
+    /* contadores */
+    uint32_t tcp;           /* tentativas de conexão TCP                */
+    uint32_t connects;      /* CONNECT recebidos                        */
+    uint32_t publishes;
+    uint32_t dups;
+    uint32_t pings;
+    uint32_t bad;           /* pacotes fora do protocolo                */
+    uint32_t bytes_in;
+} Broker;
+
+/**
+ * @brief Estado de um packet id no broker.
+ */
+typedef struct
+{
+    uint16_t count;         /* PUBLISH recebidos com este id            */
+    bool acked;             /* PUBACK lido pelo cliente                 */
+    int32_t idx;            /* leitura correspondente em g_expect       */
+} Delivery;
+
+static bool g_verbose = false;
+static bool g_wifi_up = true;
+static uint32_t g_now_ms = 1000;
+static uint32_t g_rng = 0x2545F491u;
+static Broker g_brk;
+static Delivery g_deliv[65536];
+static char g_expect[MAX_READINGS][MQTT_MAX_PAYLOAD];
+static int32_t g_expect_pid[MAX_READINGS];
+static uint32_t g_n_expect;
+static uint32_t g_attempts;
+static const PayloadSchema *g_schema;
+static uint32_t g_checks;
+static uint32_t g_failures;
+
+#define CHECK(cond, ...)                                                     \
+    do                                                                       \
+    {                                                                        \
+        g_checks++;                                                          \
+        if (!(cond))                                                         \
+        {                                                                    \
+            g_failures++;                                                    \
+            fprintf(stderr, "FALHA %s:%d: ", __FILE__, __LINE__);            \
+            fprintf(stderr, __VA_ARGS__);                                    \
+            fputc('\n', stderr);                                             \
+        }                                                                    \
+    } while (0)
+
+/****************************** Broker simulado *******************************/
+
+/**
+ * @brief Fecha a conexão do lado do broker; bytes ainda não lidos se perdem.
+ */
+static void broker_close(void)
+{
+    g_brk.open = false;
+    g_brk.online = false;
+    g_brk.in_len = 0;
+    g_brk.out_len = 0;
+    g_brk.out_pos = 0;
+    g_brk.n_pend = 0;
+}
+
+static void broker_reply(const uint8_t *buf, size_t len)
+{
+    CHECK(g_brk.out_len + len <= sizeof(g_brk.out), "fila do broker cheia");
+
+    if (g_brk.out_len + len <= sizeof(g_brk.out))
+    {
+        memcpy(&g_brk.out[g_brk.out_len], buf, len);
+        g_brk.out_len += len;
+    }
+}
+
+/**
+ * @brief Lê uma string MQTT (u16 big-endian + bytes) do corpo de um pacote.
+ * @return false se não couber no corpo ou no destino.
+ */
+static bool get_str(const uint8_t *body, size_t len, size_t *pos, char *out, size_t outlen)
+{
+    if (*pos + 2u > len)
+    {
+        return false;
+    }
+
+    const size_t n = ((size_t)body[*pos] << 8) | body[*pos + 1];
+
+    if (*pos + 2u + n > len || n >= outlen)
+    {
+        return false;
+    }
+
+    memcpy(out, &body[*pos + 2], n);
+    out[n] = '\0';
+    *pos += 2u + n;
+    return true;
+}
+
+static void broker_connect(const uint8_t *body, size_t len)
+{
+    size_t pos = 0;
+    bool ok = !g_brk.online && get_str(body, len, &pos, g_brk.proto, sizeof(g_brk.proto)) &&
+              pos + 4u <= len;
+
+    if (ok)
+    {
+        g_brk.level = body[pos];
+        g_brk.flags = body[pos + 1];
+        g_brk.keepalive = (uint16_t)((body[pos + 2] << 8) | body[pos + 3]);
+        pos += 4;
+        g_brk.user[0] = '\0';
+        g_brk.pass[0] = '\0';
+        ok = get_str(body, len, &pos, g_brk.client_id, sizeof(g_brk.client_id)) &&
+             (!(g_brk.flags & 0x80) || get_str(body, len, &pos, g_brk.user, sizeof(g_brk.user))) &&
+             (!(g_brk.flags & 0x40) || get_str(body, len, &pos, g_brk.pass, sizeof(g_brk.pass))) &&
+             pos == len;
+    }
+
+    g_brk.connects++;
+
+    if (!ok)
+    {
+        g_brk.bad++;
+        broker_close();
+        return;
+    }
+
+    if (g_brk.mute)
+    {
+        return;
+    }
+
+    const bool clean = (g_brk.flags & 0x02) != 0;
+    const bool present = g_brk.rc == 0 && g_brk.session && !clean;
+    const uint8_t connack[4] = {0x20, 0x02, (uint8_t)(present ? 1 : 0), g_brk.rc};
+    broker_reply(connack, sizeof(connack));
+
+    if (g_brk.rc == 0)
+    {
+        g_brk.online = true;
+        g_brk.session = !clean;
+    }
+}
+
+/**
+ * @brief Procura a leitura aceita cujo corpo é @p payload (das mais recentes às antigas).
+ */
+static int32_t find_expected(const char *payload)
+{
+    for (int32_t i = (int32_t)g_n_expect - 1; i >= 0; --i)
+    {
+        if (strcmp(g_expect[i], payload) == 0)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static void broker_publish(uint8_t type, const uint8_t *body, size_t len)
+{
+    char topic[MQTT_MAX_TOPIC];
+    char payload[MQTT_MAX_PAYLOAD + 1];
+    size_t pos = 0;
+    const bool dup = (type & 0x08) != 0;
+
+    if (!g_brk.online || (type & 0x06) != 0x02 || (type & 0x01) ||
+        !get_str(body, len, &pos, topic, sizeof(topic)) || pos + 2u > len ||
+        len - pos - 2u > MQTT_MAX_PAYLOAD)
+    {
+        g_brk.bad++;
+        return;
+    }
+
+    const uint16_t pid = (uint16_t)((body[pos] << 8) | body[pos + 1]);
+    pos += 2;
+    memcpy(payload, &body[pos], len - pos);
+    payload[len - pos] = '\0';
+
+    g_brk.publishes++;
+    g_brk.dups += dup ? 1u : 0u;
+    CHECK(strcmp(topic, TOPIC) == 0, "PUBLISH no topico '%s'", topic);
+    CHECK(pid != 0, "PUBLISH QoS 1 com packet id 0");
+
+    Delivery *d = &g_deliv[pid];
+
+    if (d->count == 0)
+    {
+        d->idx = find_expected(payload);
+        CHECK(d->idx >= 0, "PUBLISH pid %u com corpo inesperado: %s", pid, payload);
+        CHECK(!dup, "primeiro PUBLISH do pid %u com DUP", pid);
+
+        if (d->idx >= 0)
+        {
+            CHECK(g_expect_pid[d->idx] < 0, "leitura %ld publicada com dois pids",
+                  (long)d->idx);
+            g_expect_pid[d->idx] = pid;
+        }
+    }
+    else
+    {
+        CHECK(dup, "reenvio do pid %u sem DUP", pid);
+        CHECK(!d->acked, "reenvio do pid %u depois do PUBACK", pid);
+        CHECK(d->idx < 0 || strcmp(g_expect[d->idx], payload) == 0,
+              "reenvio do pid %u com outro corpo: %s", pid, payload);
+    }
+
+    d->count++;
+
+    if (g_brk.ack)
+    {
+        const uint8_t puback[4] = {0x40, 0x02, (uint8_t)(pid >> 8), (uint8_t)pid};
+        broker_reply(puback, sizeof(puback));
+
+        if (g_brk.n_pend < sizeof(g_brk.pend_ack) / sizeof(g_brk.pend_ack[0]))
+        {
+            g_brk.pend_ack[g_brk.n_pend++] = pid;
+        }
+    }
+}
+
+/**
+ * @brief Processa os pacotes completos recebidos do cliente.
+ */
+static void broker_poll(void)
+{
+    while (g_brk.open && g_brk.in_len >= 2)
+    {
+        uint32_t rem = 0;
+        size_t hdr = 1;
+        uint8_t shift = 0;
+        uint8_t b;
+
+        do
+        {
+            if (hdr >= g_brk.in_len)
+            {
+                return;
+            }
+
+            b = g_brk.in[hdr++];
+            rem |= (uint32_t)(b & 0x7F) << shift;
+            shift += 7;
+        } while ((b & 0x80) && hdr < 5);
+
+        if (g_brk.in_len < hdr + rem)
+        {
+            return;
+        }
+
+        const uint8_t type = g_brk.in[0];
+        const uint8_t *body = &g_brk.in[hdr];
+
+        switch (type & 0xF0)
+        {
+        case 0x10:
+            broker_connect(body, rem);
+            break;
+        case 0x30:
+            broker_publish(type, body, rem);
+            break;
+        case 0xC0:
+            g_brk.pings++;
+
+            if (g_brk.pong && g_brk.online)
+            {
+                const uint8_t pingresp[2] = {0xD0, 0x00};
+                broker_reply(pingresp, sizeof(pingresp));
+            }
+
+            break;
+        default:
+            g_brk.bad++;
+            break;
+        }
+
+        if (!g_brk.open)
+        {
+            return;
+        }
+
+        memmove(g_brk.in, &g_brk.in[hdr + rem], g_brk.in_len - hdr - rem);
+        g_brk.in_len -= hdr + rem;
+    }
+}
+
+/****************************** Substitutos ***********************************/
+
+void logger_log(const char *tag, const char *fmt, ...)
+{
+    if (!g_verbose)
+    {
+        return;
+    }
+
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "[%s] ", tag);
+    vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+    va_end(ap);
+}
+
+uint32_t millis(void)
+{
+    return g_now_ms;
+}
+
+void delay(uint32_t ms)
+{
+    g_now_ms += ms;
+}
+
+bool wifi_is_connected(void)
+{
+    return g_wifi_up;
+}
+
+int WiFiClient::connect(const char *host, uint16_t port, int32_t timeout_ms)
+{
+    CHECK(g_wifi_up, "conexao TCP sem Wi-Fi");
+    CHECK(!g_brk.open, "conexao TCP com outra ainda aberta");
+    CHECK(strcmp(host, BROKER_HOST) == 0 && port == BROKER_PORT, "TCP para %s:%u", host,
+          (unsigned)port);
+    CHECK(timeout_ms > 0 && timeout_ms <= 5000, "timeout TCP de %ld ms", (long)timeout_ms);
+    g_brk.tcp++;
+
+    if (!g_brk.listening)
+    {
+        return 0;
+    }
+
+    broker_close();
+    g_brk.open = true;
+    g_brk.nodelay = false;
+    return 1;
+}
+
+int WiFiClient::setNoDelay(bool nodelay)
+{
+    g_brk.nodelay = nodelay;
+    return 0;
+}
+
+size_t WiFiClient::write(const uint8_t *buf, size_t len)
+{
+    if (!g_brk.open || g_brk.in_len + len > sizeof(g_brk.in))
+    {
+        return 0;
+    }
+
+    memcpy(&g_brk.in[g_brk.in_len], buf, len);
+    g_brk.in_len += len;
+    g_brk.bytes_in += (uint32_t)len;
+    broker_poll();
+    return len;
+}
+
+int WiFiClient::available(void)
+{
+    return g_brk.open ? (int)(g_brk.out_len - g_brk.out_pos) : 0;
+}
+
+int WiFiClient::read(void)
+{
+    if (!g_brk.open || g_brk.out_pos >= g_brk.out_len)
+    {
+        return -1;
+    }
+
+    const int b = g_brk.out[g_brk.out_pos++];
+
+    /* Fila esvaziada: os PUBACKs enfileirados chegaram ao cliente. */
+    if (g_brk.out_pos == g_brk.out_len)
+    {
+        for (uint8_t i = 0; i < g_brk.n_pend; ++i)
+        {
+            g_deliv[g_brk.pend_ack[i]].acked = true;
+        }
+
+        g_brk.n_pend = 0;
+        g_brk.out_len = 0;
+        g_brk.out_pos = 0;
+    }
+
+    return b;
+}
+
+uint8_t WiFiClient::connected(void)
+{
+    return g_brk.open ? 1 : 0;
+}
+
+void WiFiClient::stop(void)
+{
+    broker_close();
+}
+
+/****************************** Funções privadas ******************************/
+
+/**
+ * @brief xorshift32: reproduzível pela semente, sem depender da libc.
+ */
+static uint32_t rnd(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+static void broker_defaults(void)
+{
+    g_brk.listening = true;
+    g_brk.mute = false;
+    g_brk.rc = 0;
+    g_brk.ack = true;
+    g_brk.pong = true;
+}
+
+static MqttStats stats(void)
+{
+    MqttStats st;
+    mqtt_get_stats(&st);
+    return st;
+}
+
+/**
+ * @brief Avança o relógio chamando @c mqtt_tick() a cada @c TICK_MS.
+ */
+static void advance(uint32_t ms)
+{
+    for (uint32_t t = 0; t < ms; t += TICK_MS)
+    {
+        g_now_ms += TICK_MS;
+        mqtt_tick(g_now_ms);
+    }
+}
+
+/**
+ * @brief Gera uma leitura v1 de timestamp único e a entrega ao cliente.
+ * @return Resultado de @c mqtt_publish_reading(); se aceita, o corpo entra no modelo.
+ */
+static bool publish(void)
+{
+    static uint32_t ts = 1700000000u;
+    SensorReading r;
+    memset(&r, 0, sizeof(r));
+    r.version = g_schema->version;
+    r.value[0] = (int32_t)(rnd() % 2001u);
+    r.value[1] = (int32_t)(3000u + rnd() % 1201u);
+    r.value[2] = (int32_t)(rnd() % 1201u) - 400;
+    ts += 1u + rnd() % 30u;
+    r.value[g_schema->ts_index] = (int32_t)ts;
+    r.timestamp = ts;
+
+    if (g_n_expect >= MAX_READINGS)
+    {
+        return false;
+    }
+
+    char *body = g_expect[g_n_expect];
+    const size_t len = payload_schema_upload_fields(&r, body, MQTT_MAX_PAYLOAD);
+    CHECK(len > 0, "corpo da leitura nao gerado");
+    g_attempts++;
+
+    /* O PUBLISH sai dentro da chamada quando há sessão: o modelo já precisa tê-lo. */
+    g_expect_pid[g_n_expect++] = -1;
+
+    if (!mqtt_publish_reading(&r))
+    {
+        g_n_expect--;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Bytes de um PUBLISH QoS 1 no tópico de teste com corpo de @p len bytes.
+ */
+static uint32_t publish_size(size_t len)
+{
+    const uint32_t rem = 2u + (uint32_t)strlen(TOPIC) + 2u + (uint32_t)len;
+    return 1u + (rem > 127u ? 2u : 1u) + rem;
+}
+
+static void test_connect(void)
+{
+    g_wifi_up = false;
+    advance(10000);
+    CHECK(g_brk.tcp == 0, "TCP com Wi-Fi fora");
+
+    g_wifi_up = true;
+    advance(TICK_MS);
+    CHECK(mqtt_is_connected(), "sem sessao com Wi-Fi e broker disponiveis");
+    CHECK(g_brk.tcp == 1 && g_brk.connects == 1, "TCP %lu, CONNECT %lu",
+          (unsigned long)g_brk.tcp, (unsigned long)g_brk.connects);
+    CHECK(g_brk.nodelay, "socket sem TCP_NODELAY");
+    CHECK(strcmp(g_brk.proto, "MQTT") == 0 && g_brk.level == 4, "protocolo %s nivel %u",
+          g_brk.proto, g_brk.level);
+    CHECK(g_brk.flags == 0xC0, "flags do CONNECT 0x%02X (esperado usuario+senha, sessao "
+          "persistente)", g_brk.flags);
+    CHECK(g_brk.keepalive == MQTT_KEEPALIVE_S, "keep-alive %u", g_brk.keepalive);
+    CHECK(strcmp(g_brk.client_id, CLIENT_ID) == 0, "client id '%s'", g_brk.client_id);
+    CHECK(strcmp(g_brk.user, MQTT_USER) == 0 && strcmp(g_brk.pass, MQTT_PASS) == 0,
+          "credenciais '%s'/'%s'", g_brk.user, g_brk.pass);
+
+    const MqttStats st = stats();
+    CHECK(st.connects == 1 && st.resumed == 0, "connects %lu, resumed %lu",
+          (unsigned long)st.connects, (unsigned long)st.resumed);
+    CHECK(g_brk.bad == 0, "%lu pacotes invalidos", (unsigned long)g_brk.bad);
+}
+
+static void test_publish_ack(void)
+{
+    const MqttStats before = stats();
+    const uint32_t bytes = g_brk.bytes_in;
+    uint32_t want = 0;
+
+    for (int i = 0; i < 5; ++i)
+    {
+        CHECK(publish(), "leitura %d recusada com a janela vazia", i);
+        want += publish_size(strlen(g_expect[g_n_expect - 1]));
+        CHECK(g_deliv[g_expect_pid[g_n_expect - 1] & 0xFFFF].count == 1,
+              "leitura %d nao publicada imediatamente", i);
+        advance(TICK_MS);
+    }
+
+    const MqttStats st = stats();
+    CHECK(st.published - before.published == 5 && st.acked - before.acked == 5,
+          "publicadas %lu, confirmadas %lu", (unsigned long)(st.published - before.published),
+          (unsigned long)(st.acked - before.acked));
+    CHECK(st.inflight == 0, "%u em voo apos os PUBACKs", st.inflight);
+    CHECK(g_brk.bytes_in - bytes == want, "%lu bytes para 5 PUBLISH, esperado %lu",
+          (unsigned long)(g_brk.bytes_in - bytes), (unsigned long)want);
+    CHECK(g_brk.dups == 0, "%lu DUP sem reconexao", (unsigned long)g_brk.dups);
+}
+
+/**
+ * @brief Janela cheia sem PUBACK, recusa da leitura seguinte e PUBACK atrasado.
+ */
+static void test_window_and_ack_timeout(void)
+{
+    const MqttStats before = stats();
+    const uint32_t pubs = g_brk.publishes;
+    const uint32_t tcp = g_brk.tcp;
+    const uint32_t first = g_n_expect;
+    g_brk.ack = false;
+
+    for (int i = 0; i < MQTT_WINDOW; ++i)
+    {
+        CHECK(publish(), "leitura %d recusada com a janela incompleta", i);
+    }
+
+    CHECK(!publish(), "leitura aceita com a janela cheia");
+    MqttStats st = stats();
+    CHECK(st.rejected == before.rejected + 1, "rejected %lu", (unsigned long)st.rejected);
+    CHECK(st.inflight == MQTT_WINDOW, "%u em voo", st.inflight);
+    CHECK(g_brk.publishes - pubs == MQTT_WINDOW, "%lu PUBLISH",
+          (unsigned long)(g_brk.publishes - pubs));
+
+    g_brk.ack = true;
+    advance(20000 - TICK_MS);
+    CHECK(mqtt_is_connected(), "sessao derrubada antes do timeout de PUBACK");
+    advance(2 * TICK_MS);
+    CHECK(!mqtt_is_connected(), "PUBACK atrasado nao derrubou a sessao");
+
+    advance(5000 - 2 * TICK_MS);
+    CHECK(g_brk.tcp == tcp, "reconexao antes de 5 s");
+    advance(2 * TICK_MS);
+    CHECK(g_brk.tcp == tcp + 1 && mqtt_is_connected(), "sem reconexao apos 5 s");
+    advance(TICK_MS);
+
+    st = stats();
+    CHECK(st.resumed == before.resumed + 1, "sessao nao retomada");
+    CHECK(st.retransmitted - before.retransmitted == MQTT_WINDOW, "%lu reenvios",
+          (unsigned long)(st.retransmitted - before.retransmitted));
+    CHECK(st.inflight == 0 && st.acked - before.acked == MQTT_WINDOW,
+          "%u em voo, %lu confirmadas apos reenvio", st.inflight,
+          (unsigned long)(st.acked - before.acked));
+
+    for (uint32_t i = first; i < g_n_expect; ++i)
+    {
+        const Delivery *d = &g_deliv[g_expect_pid[i] & 0xFFFF];
+        CHECK(g_expect_pid[i] > 0 && d->count == 2 && d->acked,
+              "leitura %lu: %u entregas, ack %d", (unsigned long)i, d->count, d->acked);
+    }
+}
+
+/**
+ * @brief Socket fechado pelo broker com publicações em voo e outras ainda não enviadas.
+ */
+static void test_socket_drop(void)
+{
+    const MqttStats before = stats();
+    const uint32_t pubs = g_brk.publishes;
+    g_brk.ack = false;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        CHECK(publish(), "leitura %d recusada", i);
+    }
+
+    broker_close();
+    g_brk.ack = true;
+    advance(TICK_MS);
+    CHECK(!mqtt_is_connected(), "socket fechado nao detectado");
+
+    for (int i = 0; i < 2; ++i)
+    {
+        CHECK(publish(), "leitura %d recusada sem sessao", i);
+    }
+
+    CHECK(g_brk.publishes - pubs == 3, "PUBLISH sem sessao");
+    advance(5000 + TICK_MS);
+    CHECK(mqtt_is_connected(), "sem reconexao");
+
+    const MqttStats st = stats();
+    CHECK(st.retransmitted - before.retransmitted == 3, "%lu reenvios com DUP (esperado 3)",
+          (unsigned long)(st.retransmitted - before.retransmitted));
+    CHECK(st.published - before.published == 5, "%lu primeiras publicacoes (esperado 5)",
+          (unsigned long)(st.published - before.published));
+    CHECK(st.inflight == 0, "%u em voo", st.inflight);
+}
+
+static void test_wifi_loss(void)
+{
+    const MqttStats before = stats();
+    const uint32_t tcp = g_brk.tcp;
+
+    g_wifi_up = false;
+    advance(TICK_MS);
+    CHECK(!mqtt_is_connected(), "sessao mantida sem Wi-Fi");
+    CHECK(!g_brk.open, "socket nao fechado sem Wi-Fi");
+
+    for (int i = 0; i < 4; ++i)
+    {
+        CHECK(publish(), "leitura %d recusada sem Wi-Fi", i);
+    }
+
+    advance(30000);
+    CHECK(g_brk.tcp == tcp, "TCP sem Wi-Fi");
+
+    g_wifi_up = true;
+    advance(TICK_MS);
+    CHECK(mqtt_is_connected() && g_brk.tcp == tcp + 1, "sem reconexao com o Wi-Fi de volta");
+    advance(TICK_MS);
+
+    const MqttStats st = stats();
+    CHECK(st.published - before.published == 4 && st.inflight == 0,
+          "%lu publicadas, %u em voo", (unsigned long)(st.published - before.published),
+          st.inflight);
+}
+
+static void test_keepalive(void)
+{
+    const uint32_t pings = g_brk.pings;
+
+    /* Tráfego regular dispensa o PINGREQ. */
+    for (int i = 0; i < 12; ++i)
+    {
+        CHECK(publish(), "leitura %d recusada", i);
+        advance(10000);
+    }
+
+    CHECK(g_brk.pings == pings, "PINGREQ com trafego a cada 10 s");
+
+    advance(20000 - TICK_MS);
+    CHECK(g_brk.pings == pings, "PINGREQ antes de 30 s ociosos");
+    advance(TICK_MS);
+    CHECK(g_brk.pings == pings + 1, "sem PINGREQ apos 30 s ociosos");
+    advance(30000);
+    CHECK(g_brk.pings == pings + 2 && mqtt_is_connected(), "keep-alive com PINGRESP");
+
+    g_brk.pong = false;
+    uint32_t waited = 0;
+
+    while (g_brk.pings == pings + 2 && waited < 31000)
+    {
+        advance(TICK_MS);
+        waited += TICK_MS;
+    }
+
+    CHECK(g_brk.pings == pings + 3, "sem PINGREQ");
+    advance(60000);
+    CHECK(mqtt_is_connected() && g_brk.pings == pings + 3,
+          "sessao derrubada ou PINGREQ repetido antes de 60 s sem PINGRESP");
+    advance(2 * TICK_MS);
+    CHECK(!mqtt_is_connected(), "PINGRESP ausente nao derrubou a sessao");
+
+    g_brk.pong = true;
+    advance(5000 + TICK_MS);
+    CHECK(mqtt_is_connected(), "sem reconexao apos PINGRESP ausente");
+}
+
+/**
+ * @brief CONNACK recusado, CONNACK ausente e TCP recusado, com a janela preservada.
+ */
+static void test_connect_failures(void)
+{
+    const MqttStats before = stats();
+    const uint32_t tcp = g_brk.tcp;
+
+    g_brk.rc = 5;
+    broker_close();
+    advance(TICK_MS);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        CHECK(publish(), "leitura %d recusada", i);
+    }
+
+    advance(5000 + TICK_MS);
+    CHECK(g_brk.tcp == tcp + 1 && !mqtt_is_connected(), "CONNACK rc=5 aceito");
+    CHECK(!g_brk.open, "socket aberto apos CONNACK recusado");
+
+    g_brk.rc = 0;
+    g_brk.mute = true;
+    uint32_t t0 = g_now_ms;
+    advance(5000 + TICK_MS);
+    CHECK(g_brk.tcp == tcp + 2 && !mqtt_is_connected(), "CONNACK ausente aceito");
+    CHECK(g_now_ms - t0 >= 5000 + 3000 && g_now_ms - t0 <= 5000 + 3000 + 2 * TICK_MS,
+          "espera do CONNACK de %lu ms", (unsigned long)(g_now_ms - t0 - 5000));
+
+    g_brk.mute = false;
+    g_brk.listening = false;
+    advance(5000 + TICK_MS);
+    CHECK(g_brk.tcp == tcp + 3 && !mqtt_is_connected(), "TCP recusado aceito");
+
+    g_brk.listening = true;
+    advance(5000 + TICK_MS);
+    CHECK(g_brk.tcp == tcp + 4 && mqtt_is_connected(), "sem reconexao apos as recusas");
+
+    const MqttStats st = stats();
+    CHECK(st.connects == before.connects + 1, "connects %lu", (unsigned long)st.connects);
+    CHECK(st.published - before.published == 2 && st.inflight == 0,
+          "%lu publicadas, %u em voo apos as recusas",
+          (unsigned long)(st.published - before.published), st.inflight);
+}
+
+/**
+ * @brief Broker sem a sessão: CONNACK sem "session present", janela reenviada mesmo assim.
+ */
+static void test_session_lost(void)
+{
+    const MqttStats before = stats();
+    g_brk.ack = false;
+    CHECK(publish() && publish(), "leituras recusadas");
+    broker_close();
+    g_brk.session = false;
+    g_brk.ack = true;
+    advance(5000 + 2 * TICK_MS);
+
+    const MqttStats st = stats();
+    CHECK(mqtt_is_connected(), "sem reconexao");
+    CHECK(st.resumed == before.resumed, "sessao dada como retomada sem sessao no broker");
+    CHECK(st.retransmitted - before.retransmitted == 2 && st.inflight == 0,
+          "%lu reenvios, %u em voo", (unsigned long)(st.retransmitted - before.retransmitted),
+          st.inflight);
+}
+
+/**
+ * @brief Bytes enviados por leitura contra o cabeçalho de um POST HTTP equivalente.
+ */
+static void test_overhead(void)
+{
+    const MqttStats before = stats();
+    static uint8_t lens[1000];
+    const uint32_t n = sizeof(lens);
+    uint32_t payload = 0;
+    uint32_t want = 0;
+    uint32_t http = 0;
+    struct timespec t0, t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        CHECK(publish(), "leitura %lu recusada", (unsigned long)i);
+        lens[i] = (uint8_t)strlen(g_expect[g_n_expect - 1]);
+        g_now_ms += TICK_MS;
+        mqtt_tick(g_now_ms);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        /* Mesmo cabeçalho do POST em /update do cliente ThingSpeak. */
+        char hdr[256];
+        payload += lens[i];
+        want += publish_size(lens[i]);
+        http += (uint32_t)snprintf(hdr, sizeof(hdr),
+                                   "POST /update HTTP/1.0\r\n"
+                                   "Host: api.thingspeak.com\r\n"
+                                   "Connection: close\r\n"
+                                   "Content-Type: application/x-www-form-urlencoded\r\n"
+                                   "Content-Length: %u\r\n\r\napi_key=XXXXXXXXXXXXXXXX&",
+                                   (unsigned)(lens[i] + 25u));
+    }
+
+    const MqttStats st = stats();
+    const uint32_t bytes = st.bytes_out - before.bytes_out;
+    const double mqtt_per = (double)(bytes - payload) / n;
+    const double http_per = (double)http / n;
+    const double ns =
+        ((double)(t1.tv_sec - t0.tv_sec) * 1e9 + (double)(t1.tv_nsec - t0.tv_nsec)) / n;
+
+    CHECK(st.acked - before.acked == n && st.inflight == 0, "%lu confirmadas de %lu",
+          (unsigned long)(st.acked - before.acked), (unsigned long)n);
+    CHECK(bytes == want, "%lu bytes para %lu PUBLISH, esperado %lu", (unsigned long)bytes,
+          (unsigned long)n, (unsigned long)want);
+    CHECK(mqtt_per * 4.0 < http_per, "%.1f B de cabecalho MQTT por leitura contra %.1f B HTTP",
+          mqtt_per, http_per);
+    printf("# sobrecarga por leitura: MQTT %.1f B, cabecalho HTTP %.1f B (sem TCP/TLS); "
+           "%.0f ns de CPU por leitura\n", mqtt_per, http_per, ns);
+}
+
+/**
+ * @brief Rodada aleatória com falhas do broker, do Wi-Fi e da rede.
+ */
+static void test_random(uint32_t steps)
+{
+    uint32_t hold = 0;
+
+    for (uint32_t i = 0; i < steps; ++i)
+    {
+        if (rnd() % 100 < 45)
+        {
+            (void)publish();
+        }
+
+        if (hold > 0 && --hold == 0)
+        {
+            broker_defaults();
+            g_wifi_up = true;
+        }
+        else if (hold == 0 && rnd() % 100 < 4)
+        {
+            hold = 1 + rnd() % 40;
+
+            switch (rnd() % 6)
+            {
+            case 0:
+                g_brk.ack = false;
+                break;
+            case 1:
+                g_brk.pong = false;
+                break;
+            case 2:
+                g_brk.rc = (uint8_t)(1 + rnd() % 5);
+                break;
+            case 3:
+                g_brk.mute = true;
+                break;
+            case 4:
+                g_brk.listening = false;
+                break;
+            default:
+                g_wifi_up = false;
+                break;
+            }
+        }
+
+        if (rnd() % 100 < 2)
+        {
+            broker_close();
+        }
+
+        if (rnd() % 500 == 0)
+        {
+            g_brk.session = false;
+        }
+
+        g_now_ms += 1u + rnd() % 3000u;
+        mqtt_tick(g_now_ms);
+
+        const MqttStats st = stats();
+        CHECK(st.inflight <= MQTT_WINDOW, "%u em voo", st.inflight);
+        CHECK(st.acked + st.inflight == g_n_expect, "passo %lu: %lu confirmadas + %u em voo "
+              "!= %lu aceitas", (unsigned long)i, (unsigned long)st.acked, st.inflight,
+              (unsigned long)g_n_expect);
+    }
+
+    broker_defaults();
+    g_wifi_up = true;
+
+    for (uint32_t waited = 0; stats().inflight > 0 && waited < 120000; waited += TICK_MS)
+    {
+        advance(TICK_MS);
+    }
+}
+
+/**
+ * @brief Confere o modelo inteiro: toda leitura aceita entregue e confirmada.
+ */
+static void check_all(void)
+{
+    const MqttStats st = stats();
+    uint32_t lost = 0;
+    uint32_t distinct = 0;
+
+    for (uint32_t i = 0; i < g_n_expect; ++i)
+    {
+        if (g_expect_pid[i] <= 0 || !g_deliv[g_expect_pid[i]].acked)
+        {
+            lost++;
+        }
+    }
+
+    for (uint32_t pid = 1; pid < 65536; ++pid)
+    {
+        distinct += g_deliv[pid].count ? 1u : 0u;
+    }
+
+    CHECK(lost == 0, "%lu de %lu leituras aceitas sem entrega confirmada", (unsigned long)lost,
+          (unsigned long)g_n_expect);
+    CHECK(st.inflight == 0 && st.acked == g_n_expect, "%lu confirmadas de %lu, %u em voo",
+          (unsigned long)st.acked, (unsigned long)g_n_expect, st.inflight);
+    CHECK(st.published == distinct, "published %lu, pids distintos no broker %lu",
+          (unsigned long)st.published, (unsigned long)distinct);
+    CHECK(st.retransmitted == g_brk.dups, "retransmitted %lu, DUP no broker %lu",
+          (unsigned long)st.retransmitted, (unsigned long)g_brk.dups);
+    CHECK(st.published + st.retransmitted == g_brk.publishes, "PUBLISH: %lu + %lu != %lu",
+          (unsigned long)st.published, (unsigned long)st.retransmitted,
+          (unsigned long)g_brk.publishes);
+    CHECK(st.rejected + g_n_expect == g_attempts, "%lu recusadas + %lu aceitas != %lu",
+          (unsigned long)st.rejected, (unsigned long)g_n_expect, (unsigned long)g_attempts);
+    CHECK(st.bytes_out == g_brk.bytes_in, "bytes_out %lu, recebidos pelo broker %lu",
+          (unsigned long)st.bytes_out, (unsigned long)g_brk.bytes_in);
+    CHECK(g_brk.bad == 0, "%lu pacotes invalidos", (unsigned long)g_brk.bad);
+}
+
+/****************************** Funções públicas ******************************/
+
+int main(int argc, char **argv)
+{
+    unsigned long steps = 4000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:v")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            steps = strtoul(optarg, nullptr, 0);
+            break;
+        case 's':
+            g_rng = (uint32_t)strtoul(optarg, nullptr, 0);
+            break;
+        case 'v':
+            g_verbose = true;
+            break;
+        default:
+            fprintf(stderr, "uso: %s [-n passos] [-s semente] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (g_rng == 0)
+    {
+        g_rng = 1;
+    }
+
+    /* Cada passo aceita no máximo uma leitura; o modelo guarda MAX_READINGS. */
+    if (steps > MAX_READINGS - 2000)
+    {
+        steps = MAX_READINGS - 2000;
+    }
+
+    g_schema = payload_schema_by_version(1);
+
+    if (!g_schema)
+    {
+        fprintf(stderr, "schema v1 ausente\n");
+        return 1;
+    }
+
+    broker_defaults();
+    mqtt_begin(BROKER_HOST, BROKER_PORT, CLIENT_ID, MQTT_USER, MQTT_PASS, TOPIC);
+
+    test_connect();
+    test_publish_ack();
+    test_window_and_ack_timeout();
+    test_socket_drop();
+    test_wifi_loss();
+    test_keepalive();
+    test_connect_failures();
+    test_session_lost();
+    test_overhead();
+    test_random((uint32_t)steps);
+    check_all();
+
+    const MqttStats st = stats();
+    printf("mqtt: %lu leituras, %lu reenvios, %lu conexoes, %lu verificacoes, %lu falhas\n",
+           (unsigned long)g_n_expect, (unsigned long)st.retransmitted,
+           (unsigned long)st.connects, (unsigned long)g_checks, (unsigned long)g_failures);
+    return g_failures ? 1 : 0;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file Arduino.h
+ * @brief Substituto mínimo do core Arduino para o simulador de rede: relógio
+ *        simulado e Serial com o custo de transmissão da UART.
+ */
+
+#ifndef NETSIM_ARDUINO_H
+#define NETSIM_ARDUINO_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include "sim.h"
+
+#define IRAM_ATTR
+#define OUTPUT 0x03
+#define RISING 0x01
+
+static inline uint32_t millis(void) { return (uint32_t)(sim_now_us() / 1000); }
+static inline uint32_t micros(void) { return (uint32_t)sim_now_us(); }
+static inline void delay(uint32_t ms) { sim_block_us((int64_t)ms * 1000); }
+static inline void pinMode(uint8_t, uint8_t) {}
+static inline void noInterrupts(void) {}
+static inline void interrupts(void) {}
+static inline uint32_t esp_random(void) { return sim_random(); }
+
+/* O newlib do ESP32 tem strlcpy; a glibc, só a partir da 2.38. */
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+static inline size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    const size_t n = strlen(src);
+
+    if (size)
+    {
+        const size_t k = (n < size) ? n : size - 1u;
+        memcpy(dst, src, k);
+        dst[k] = '\0';
+    }
+
+    return n;
+}
+#endif
+
+/**
+ * @brief Serial: cada byte custa o tempo de UART configurado no simulador.
+ */
+class HardwareSerial
+{
+public:
+    void begin(unsigned long) {}
+    explicit operator bool() const { return true; }
+    size_t write(const uint8_t *buf, size_t len)
+    {
+        sim_uart_write(buf, len);
+        return len;
+    }
+};
+
+extern HardwareSerial Serial;
+
+#endif /* NETSIM_ARDUINO_H */
@@ -0,0 +1,52 @@
+/**
+ * @file LoRa.h
+ * @brief Substituto do driver LoRa para o simulador: a transmissão (ACK) ocupa o
+ *        rádio simulado pelo tempo no ar e bloqueia o chamador; os bytes vão ao
+ *        simulador, que confere a etiqueta do ACK como o nó faria.
+ */
+
+#ifndef NETSIM_LORA_H
+#define NETSIM_LORA_H
+
+#include <Arduino.h>
+#include <SPI.h>
+
+class LoRaClass
+{
+public:
+    void setSPI(SPIClass &) {}
+    void setPins(int, int, int) {}
+    int begin(long) { return 1; }
+    void setSyncWord(int) {}
+    int parsePacket(int = 0) { return 0; }
+    int available(void) { return 0; }
+    int read(void) { return -1; }
+    int packetRssi(void) { return 0; }
+    float packetSnr(void) { return 0.0f; }
+    void receive(int = 0) {}
+    int beginPacket(int = 0)
+    {
+        m_len = 0;
+        return 1;
+    }
+    size_t write(const uint8_t *buf, size_t len)
+    {
+        if (len > sizeof(m_buf) - m_len)
+        {
+            len = sizeof(m_buf) - m_len;
+        }
+
+        memcpy(m_buf + m_len, buf, len);
+        m_len += len;
+        return len;
+    }
+    int endPacket(bool = false) { return sim_radio_tx(m_buf, m_len) ? 1 : 0; }
+
+private:
+    uint8_t m_buf[256];
+    size_t m_len = 0;
+};
+
+extern LoRaClass LoRa;
+
+#endif /* NETSIM_LORA_H */
@@ -0,0 +1,20 @@
+/**
+ * @file Preferences.h
+ * @brief Substituto da NVS do Arduino-ESP32: nada é lido nem gravado.
+ */
+
+#ifndef NETSIM_PREFERENCES_H
+#define NETSIM_PREFERENCES_H
+
+#include <stddef.h>
+
+class Preferences
+{
+public:
+    bool begin(const char *, bool) { return false; }
+    void end(void) {}
+    size_t getBytes(const char *, void *, size_t) { return 0; }
+    size_t putBytes(const char *, const void *, size_t len) { return len; }
+};
+
+#endif /* NETSIM_PREFERENCES_H */
@@ -0,0 +1,17 @@
+/**
+ * @file SPI.h
+ * @brief Substituto do barramento SPI para o simulador (sem efeito).
+ */
+
+#ifndef NETSIM_SPI_H
+#define NETSIM_SPI_H
+
+class SPIClass
+{
+public:
+    void begin(int, int, int, int) {}
+};
+
+extern SPIClass SPI;
+
+#endif /* NETSIM_SPI_H */
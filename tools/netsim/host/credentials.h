@@ -0,0 +1,15 @@
+/**
+ * @file credentials.h
+ * @brief Chave usada pelos nós e pelo gateway simulados (não é a do campo).
+ */
+
+#ifndef CREDENTIALS_H
+#define CREDENTIALS_H
+
+#include <stdint.h>
+
+static const uint8_t AES_KEY[16] = {
+    0x00, 0x01, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+    0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x5E, 0x0F, 0x10};
+
+#endif /* CREDENTIALS_H */
@@ -0,0 +1,14 @@
+/**
+ * @file esp_timer.h
+ * @brief Substituto do esp_timer para o simulador: relógio simulado em µs.
+ */
+
+#ifndef NETSIM_ESP_TIMER_H
+#define NETSIM_ESP_TIMER_H
+
+#include <stdint.h>
+#include "sim.h"
+
+static inline int64_t esp_timer_get_time(void) { return sim_now_us(); }
+
+#endif /* NETSIM_ESP_TIMER_H */
@@ -0,0 +1,26 @@
+/**
+ * @file task.h
+ * @brief Substituto das tarefas do FreeRTOS: o simulador não cria tarefas; as
+ *        rotinas que elas executariam são chamadas diretamente pelo motor.
+ */
+
+#ifndef NETSIM_TASK_H
+#define NETSIM_TASK_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define pdMS_TO_TICKS(ms) (ms)
+
+static inline int xTaskCreate(TaskFunction_t, const char *, uint32_t, void *, unsigned,
+                              TaskHandle_t *)
+{
+    return 1;
+}
+
+static inline void vTaskDelay(uint32_t) {}
+
+#endif /* NETSIM_TASK_H */
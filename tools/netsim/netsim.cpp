@@ -0,0 +1,1081 @@
+/**
+ * @file netsim.cpp
+ * @brief Simulador de eventos discretos de uma rede LoRa de N nós alimentando o
+ *        pipeline real do gateway (@c rx_pipeline_handle()).
+ *
+ * Uso:
+ *   netsim [--nodes 10,50,100,200] [--interval s] [--jitter f] [--batch k]
+ *          [--sf 7..12] [--bw hz] [--duration s] [--rssi-mean dBm] [--rssi-sd dB]
+ *          [--fade-sd dB] [--capture-db dB] [--cpu-scale x] [--baud bps]
+ *          [--net-ms ms] [--queue n] [--seed n] [--node-keys 0|1] [--seq 0|1]
+ *          [--poll-ms ms] [--corrupt 0|1] [--check 0|1] [--log arquivo]
+ *          [--fault-sd err,dly,min,max] [--fault-http err,dly,min,max]
+ *          [--fault-radio err,dly,min,max] [--max-loss %] [--max-p99-ms ms]
+ *          [--max-p999-ms ms]
+ *
+ * Modelo:
+ * - Cada nó transmite a cada @c interval s (com jitter uniforme), um quadro real:
+ *   IV + AES-128-CBC de um payload v1 ou de um lote com @c batch amostras. Com
+ *   @c --node-keys 1, cada nó tem chave própria (tabela de @c key_table) e o
+ *   quadro leva o id do nó em claro; com @c --seq 1, também a sequência do nó, e a
+ *   perda estimada pelo registro de enlace (@c link_quality) é comparada à real.
+ * - Canal único: quadros sobrepostos colidem; o mais forte sobrevive se a diferença
+ *   for de pelo menos @c capture-db. Abaixo da sensibilidade/SNR do SF, o quadro
+ *   é perdido. Enquanto o gateway transmite um ACK, nada é recebido. Com
+ *   @c --corrupt 1, o quadro que perde a colisão chega ao gateway com bytes
+ *   trocados (CRC que não detectou o erro), em vez de sumir.
+ * - Rádio do gateway: um buffer de um pacote, como @c g_pkt_buf; um RxDone com o
+ *   buffer ainda ocupado sobrescreve o anterior (overrun).
+ * - O laço principal é acordado pela tarefa do rádio (@c SIM_WAKE_US) e chama o
+ *   pipeline real; a duração da chamada é a CPU medida no host vezes @c cpu-scale,
+ *   mais o bloqueio na UART do log e o tempo no ar do ACK (ver @c standins.cpp).
+ *   Com @c --poll-ms, modela o laço antigo, que consultava o buffer a cada
+ *   @c delay(poll-ms).
+ * - Falhas: @c --fault-sd, @c --fault-http e @c --fault-radio recebem os campos de
+ *   @c FaultConfig (erro e atraso em partes por mil, atraso mínimo e máximo em ms).
+ *   No SD, valem por bloco gravado pela tarefa do anel (erro = cartão removido até
+ *   a remontagem); no HTTP, por tentativa de entrega do uplink (erro = timeout,
+ *   com retentativa); no rádio, passam pelo @c fault_hit() real do pipeline
+ *   (erro = pacote descartado, atraso = laço parado).
+ *
+ * Cada valor de @c --nodes roda em um processo filho (estado estático limpo) e
+ * gera uma linha da tabela: perdas no ar, overruns, leituras entregues, fila do
+ * uplink, ocupação do laço (orçamento de CPU) e latência do RxDone ao fim.
+ *
+ * Com ACK (@c make ACK=1), cada ACK transmitido é conferido como o nó faria, por
+ * uma implementação própria do AES-CMAC (autoteste com a RFC 4493) sobre os bytes
+ * que o nó enviou. @c --check 1 transforma a execução em teste: imprime cada
+ * verificação e sai com código 1 se alguma falhar (etiqueta errada, quadro válido
+ * sem ACK, ACK tarde ou fora de @c LORA_ACK_WINDOW_US, ACK aceito pelo nó para um
+ * quadro corrompido, ACK de quadro corrompido que o pipeline não validou).
+ * Com ou sem ACK, @c --check 1 também limita a perda no gateway (leituras que
+ * chegaram intactas ao rádio e não saíram pelo uplink) a @c --max-loss e o p99/p999
+ * do processamento (RxDone até o fim do pipeline) a @c --max-p99-ms/--max-p999-ms,
+ * e confere que as falhas pedidas foram de fato injetadas.
+ */
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+#include <mbedtls/aes.h>
+#include "sim.h"
+#include "batch_frame.h"
+#include "crypto.h"
+#include "credentials.h"
+#include "fault_inject.h"
+#include "key_table.h"
+#include "link_quality.h"
+#include "logger.h"
+#include "metrics.h"
+#include "payload_schema.h"
+#include "rx_pipeline.h"
+#include "sx1278_lora.h"
+#include "utils.h"
+
+/* Da notificação da tarefa do rádio ao laço rodando (troca de contexto no ESP32). */
+#define SIM_WAKE_US 20
+
+/* Despertares da manutenção por segundo (HOUSEKEEPING_MS = 100 em main.cpp). */
+#define SIM_HOUSEKEEPING_HZ 10
+
+/* Relógio dos nós (s); longe de zero para que as amostras antigas do lote não voltem antes da época. */
+#define SIM_EPOCH_BASE 1700000000u
+
+/**
+ * @brief Parâmetros da rede simulada.
+ */
+struct NetConfig
+{
+    double interval_s = 60.0;
+    double jitter = 0.1;
+    uint8_t batch = 1;
+    double duration_s = 3600.0;
+    double rssi_mean = -100.0;
+    double rssi_sd = 8.0;
+    double fade_sd = 3.0;
+    double capture_db = 6.0;
+    bool node_keys = false;
+    bool seq = false;       /* sequência no cabeçalho (exige node_keys) */
+    double poll_ms = 0.0;   /* 0 = laço acordado por notificação */
+    bool corrupt = false;   /* colisões entregues corrompidas */
+    bool check = false;     /* verificações de aprovação/falha ao fim */
+    FaultConfig radio_fault = {0, 0, 0, 0};
+    double max_loss_pct = 1.0;                      /* perda no gateway       */
+    double max_p99_ms = LORA_ACK_WINDOW_US / 1000.0;
+    double max_p999_ms = LORA_ACK_WINDOW_US / 1000.0;
+    uint32_t seed = 1;
+};
+
+enum EventType : uint8_t
+{
+    EV_TX_START,
+    EV_TX_END,
+    EV_LOOP
+};
+
+struct Event
+{
+    int64_t t_us;
+    EventType type;
+    uint32_t id;    /* nó (TX_START) ou quadro (TX_END) */
+
+    bool operator>(const Event &o) const { return t_us > o.t_us; }
+};
+
+/**
+ * @brief Quadro no ar.
+ */
+struct Frame
+{
+    uint32_t node;
+    int64_t start_us;
+    int64_t end_us;
+    double rssi;
+    double snr;
+    bool collided;
+    bool corrupted;         /* entregue com bytes trocados (--corrupt) */
+    uint16_t len;
+    uint8_t bytes[LORA_MAX_PACKET_LEN];
+};
+
+/**
+ * @brief Contadores do lado da rede (os do gateway estão em @c g_sim_stats).
+ */
+struct NetStats
+{
+    uint32_t frames_sent = 0;
+    uint32_t readings_sent = 0;
+    uint32_t readings_rx = 0;        /* em quadros íntegros entregues ao rádio    */
+    uint32_t lost_weak = 0;
+    uint32_t lost_collision = 0;
+    uint32_t lost_half_duplex = 0;
+    uint32_t overruns = 0;
+    double airtime_us = 0.0;
+    uint32_t ack_ok = 0;             /* quadro válido com ACK aceito pelo nó      */
+    uint32_t ack_bad_tag = 0;        /* ACK que o nó recusaria                    */
+    uint32_t ack_missing = 0;        /* quadro validado sem ACK nem ACK tarde     */
+    uint32_t ack_extra = 0;          /* mais de um ACK por quadro                 */
+    uint32_t ack_over_window = 0;    /* transmitido após LORA_ACK_WINDOW_US       */
+    int64_t ack_turnaround_max_us = 0;
+    uint32_t corrupt_rx = 0;         /* quadros corrompidos entregues ao pipeline */
+    uint32_t corrupt_accepted = 0;   /* ... que o pipeline validou (checksum)     */
+    uint32_t corrupt_acked = 0;      /* ... que receberam ACK                     */
+    uint32_t corrupt_ack_valid = 0;  /* ... cujo ACK o nó aceitaria              */
+};
+
+static NetConfig g_net;
+static NetStats g_stats;
+static std::mt19937_64 g_rng;
+static std::priority_queue<Event, std::vector<Event>, std::greater<Event>> g_events;
+static std::vector<Frame> g_frames;      /* por id; reaproveitados via g_free  */
+static std::vector<uint32_t> g_free;
+static std::vector<uint32_t> g_on_air;   /* ids dos quadros em transmissão      */
+static std::vector<double> g_node_rssi;
+static std::vector<std::vector<uint8_t>> g_node_key;  /* com --node-keys */
+static std::vector<uint16_t> g_node_seq;              /* com --seq       */
+
+/* Buffer de um pacote da tarefa do rádio. */
+static bool g_slot_full = false;
+static Frame g_slot;
+static uint8_t g_slot_sent[LORA_MAX_PACKET_LEN];   /* bytes como o nó os enviou */
+static int64_t g_slot_rx_us = 0;
+static bool g_loop_busy = false;
+static bool g_loop_scheduled = false;
+static std::vector<uint32_t> g_pickup_us;   /* RxDone -> início do processamento */
+
+/****************************** Funções privadas ******************************/
+
+/* Sensibilidade (dBm, 125 kHz) e SNR mínimo (dB) por SF, conforme o datasheet do SX1276/78. */
+static const double kSensitivity[13] = {0, 0, 0, 0, 0, 0, 0, -123, -126, -129, -132, -134.5, -137};
+static const double kSnrMin[13] = {0, 0, 0, 0, 0, 0, 0, -7.5, -10, -12.5, -15, -17.5, -20};
+
+/**
+ * @brief Tempo no ar de um quadro LoRa (CR 4/5, cabeçalho explícito, CRC, preâmbulo 8).
+ */
+double lora_airtime_us(size_t len, uint8_t sf, uint32_t bw_hz)
+{
+    const double t_sym = (double)(1u << sf) / bw_hz * 1e6;
+    const int de = (sf >= 11 && bw_hz <= 125000) ? 1 : 0;
+    const double num = 8.0 * len - 4.0 * sf + 28 + 16;
+    const double n_payload = 8 + std::max(ceil(num / (4.0 * (sf - 2 * de))) * 5.0, 0.0);
+    return (8 + 4.25) * t_sym + n_payload * t_sym;
+}
+
+static double uniform(double lo, double hi)
+{
+    return std::uniform_real_distribution<double>(lo, hi)(g_rng);
+}
+
+static double normal(double mean, double sd)
+{
+    return sd > 0 ? std::normal_distribution<double>(mean, sd)(g_rng) : mean;
+}
+
+/**
+ * @brief AES-CMAC (RFC 4493) do lado do nó, escrito à parte de @c lib/crypto para
+ *        que a conferência do ACK não herde um erro do gateway.
+ */
+static void node_cmac(const uint8_t key[16], const uint8_t *msg, size_t len, uint8_t out[16])
+{
+    mbedtls_aes_context ctx;
+    uint8_t l[16] = {0}, k[16], x[16] = {0}, last[16];
+    mbedtls_aes_init(&ctx);
+    mbedtls_aes_setkey_enc(&ctx, key, 128);
+    mbedtls_aes_crypt_ecb(&ctx, MBEDTLS_AES_ENCRYPT, l, l);
+
+    /* K1 = dbl(L); K2 = dbl(K1), no GF(2^128). */
+    const size_t n = len ? (len + 15u) / 16u : 1u;
+    const bool complete = len && len % 16u == 0;
+
+    for (int round = complete ? 1 : 2; round > 0; --round)
+    {
+        const uint8_t carry = l[0] >> 7;
+
+        for (int i = 0; i < 15; ++i)
+        {
+            l[i] = (uint8_t)((l[i] << 1) | (l[i + 1] >> 7));
+        }
+
+        l[15] = (uint8_t)((l[15] << 1) ^ (carry ? 0x87 : 0x00));
+    }
+
+    memcpy(k, l, 16);
+    memset(last, 0, sizeof(last));
+    const size_t tail = len - (n - 1u) * 16u;
+    memcpy(last, msg + (n - 1u) * 16u, complete ? 16u : tail);
+
+    if (!complete)
+    {
+        last[tail] = 0x80;
+    }
+
+    for (size_t b = 0; b < n; ++b)
+    {
+        const uint8_t *blk = (b + 1u < n) ? msg + b * 16u : last;
+
+        for (int i = 0; i < 16; ++i)
+        {
+            x[i] ^= blk[i] ^ ((b + 1u < n) ? 0 : k[i]);
+        }
+
+        mbedtls_aes_crypt_ecb(&ctx, MBEDTLS_AES_ENCRYPT, x, x);
+    }
+
+    memcpy(out, x, 16);
+    mbedtls_aes_free(&ctx);
+}
+
+/**
+ * @brief Confere @c node_cmac() com os exemplos 1, 2 e 4 da RFC 4493.
+ */
+static bool node_cmac_selftest(void)
+{
+    static const uint8_t kKey[16] = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+                                     0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c};
+    static const uint8_t kMsg[64] = {
+        0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93,
+        0x17, 0x2a, 0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac,
+        0x45, 0xaf, 0x8e, 0x51, 0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb,
+        0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef, 0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17,
+        0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10};
+    static const struct { size_t len; uint8_t tag[16]; } kCases[] = {
+        {0, {0xbb, 0x1d, 0x69, 0x29, 0xe9, 0x59, 0x37, 0x28,
+             0x7f, 0xa3, 0x7d, 0x12, 0x9b, 0x75, 0x67, 0x46}},
+        {16, {0x07, 0x0a, 0x16, 0xb4, 0x6b, 0x4d, 0x41, 0x44,
+              0xf7, 0x9b, 0xdd, 0x9d, 0xd0, 0x4a, 0x28, 0x7c}},
+        {64, {0x51, 0xf0, 0xbe, 0xbf, 0x7e, 0x3b, 0x9d, 0x92,
+              0xfc, 0x49, 0x74, 0x17, 0x79, 0x36, 0x3c, 0xfe}},
+    };
+
+    for (const auto &c : kCases)
+    {
+        uint8_t tag[16];
+        node_cmac(kKey, kMsg, c.len, tag);
+
+        if (memcmp(tag, c.tag, 16) != 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Confere um ACK como o nó: etiqueta = CMAC_{K_ack}(IV + ciphertext enviados),
+ *        com K_ack = CMAC_{K}("LORA-ACK-KEY-v1").
+ */
+static bool node_accepts_ack(uint32_t node, const uint8_t *sent, uint16_t len,
+                             const std::vector<uint8_t> &ack)
+{
+    static const char kLabel[] = "LORA-ACK-KEY-v1";
+    const size_t hdr = len % 16u;
+    uint8_t ack_key[16], tag[16];
+
+    if (ack.size() != LORA_ACK_LEN || ack[0] != LORA_ACK_TYPE)
+    {
+        return false;
+    }
+
+    node_cmac(g_net.node_keys ? g_node_key[node].data() : AES_KEY, (const uint8_t *)kLabel,
+              sizeof(kLabel) - 1u, ack_key);
+    node_cmac(ack_key, sent + hdr, len - hdr, tag);
+    return memcmp(tag, ack.data() + 1, 16) == 0;
+}
+
+/**
+ * @brief Monta um quadro cifrado como o nó faria: IV aleatório + AES-CBC/PKCS#7,
+ *        precedido do id do nó (e da sequência) quando cada nó tem chave própria.
+ */
+static uint16_t build_frame(uint32_t node, int64_t now_us, uint8_t *out)
+{
+    const PayloadSchema *s = payload_schema_by_version(1);
+    uint8_t plain[LORA_MAX_PACKET_LEN];
+    size_t plain_len;
+    SensorReading samples[BATCH_MAX_SAMPLES];
+    const uint32_t ts = SIM_EPOCH_BASE + (uint32_t)(now_us / 1000000);
+
+    for (uint8_t i = 0; i < g_net.batch; ++i)
+    {
+        SensorReading &r = samples[i];
+        memset(&r, 0, sizeof(r));
+        r.version = 1;
+        r.value[0] = (int32_t)(g_rng() % 1200u);
+        r.value[1] = 3600 + (int32_t)(g_rng() % 500u) - (int32_t)(node % 200u);
+        r.value[2] = 200 + (int32_t)(g_rng() % 150u);
+        r.value[3] = (int32_t)(ts - (uint32_t)(g_net.batch - 1u - i) * 60u);
+        r.timestamp = (uint32_t)r.value[3];
+    }
+
+    if (g_net.batch > 1)
+    {
+        plain_len = batch_frame_encode(s, samples, g_net.batch, plain, sizeof(plain) - 16u);
+    }
+    else
+    {
+        const SensorReading &r = samples[0];
+        PayloadPacked p;
+        p.irradiance = (uint16_t)r.value[0];
+        p.battery_voltage = (uint16_t)r.value[1];
+        p.internal_temperature = (int16_t)r.value[2];
+        p.timestamp = (uint32_t)r.value[3];
+        memcpy(plain, &p, sizeof(p));
+        plain[sizeof(p) - 1u] = utils_checksum8(plain, sizeof(p) - 1u);
+        plain_len = sizeof(p);
+    }
+
+    const uint8_t pad = (uint8_t)(16u - plain_len % 16u);
+    memset(plain + plain_len, pad, pad);
+    plain_len += pad;
+
+    uint8_t iv[16];
+
+    for (uint8_t &b : iv)
+    {
+        b = (uint8_t)g_rng();
+    }
+
+    size_t hdr = 0;
+
+    if (g_net.node_keys)
+    {
+        out[0] = (uint8_t)(node + 1u);
+        out[1] = (uint8_t)((node + 1u) >> 8);
+        hdr = KEYTAB_HDR_LEN;
+
+        if (g_net.seq)
+        {
+            const uint16_t seq = g_node_seq[node]++;
+            out[2] = (uint8_t)seq;
+            out[3] = (uint8_t)(seq >> 8);
+            hdr += LINKQ_SEQ_LEN;
+        }
+    }
+
+    memcpy(out + hdr, iv, 16);
+
+    mbedtls_aes_context ctx;
+    mbedtls_aes_init(&ctx);
+    mbedtls_aes_setkey_enc(&ctx, g_net.node_keys ? g_node_key[node].data() : AES_KEY, 128);
+    mbedtls_aes_crypt_cbc(&ctx, MBEDTLS_AES_ENCRYPT, plain_len, iv, plain, out + hdr + 16);
+    mbedtls_aes_free(&ctx);
+    return (uint16_t)(hdr + 16u + plain_len);
+}
+
+static uint32_t frame_alloc(void)
+{
+    if (!g_free.empty())
+    {
+        const uint32_t id = g_free.back();
+        g_free.pop_back();
+        return id;
+    }
+
+    g_frames.emplace_back();
+    return (uint32_t)(g_frames.size() - 1u);
+}
+
+static void schedule(int64_t t_us, EventType type, uint32_t id)
+{
+    g_events.push(Event{t_us, type, id});
+}
+
+static int64_t next_period_us(void)
+{
+    return (int64_t)(g_net.interval_s * 1e6 * uniform(1.0 - g_net.jitter, 1.0 + g_net.jitter));
+}
+
+static void on_tx_start(uint32_t node, int64_t now)
+{
+    const uint32_t id = frame_alloc();
+    Frame &f = g_frames[id];
+    f.node = node;
+    f.len = build_frame(node, now, f.bytes);
+    f.start_us = now;
+    f.end_us = now + (int64_t)lora_airtime_us(f.len, g_sim_cfg.sf, g_sim_cfg.bw_hz);
+    f.rssi = normal(g_node_rssi[node], g_net.fade_sd);
+    f.snr = std::min(f.rssi - (-174.0 + 10.0 * log10((double)g_sim_cfg.bw_hz) + 6.0), 12.0);
+    f.collided = false;
+    f.corrupted = false;
+
+    for (uint32_t other : g_on_air)
+    {
+        Frame &g = g_frames[other];
+        const double diff = f.rssi - g.rssi;
+
+        if (diff < g_net.capture_db)
+        {
+            f.collided = true;
+        }
+
+        if (diff > -g_net.capture_db)
+        {
+            g.collided = true;
+        }
+    }
+
+    g_on_air.push_back(id);
+    g_stats.frames_sent++;
+    g_stats.readings_sent += g_net.batch;
+    g_stats.airtime_us += (double)(f.end_us - f.start_us);
+    schedule(f.end_us, EV_TX_END, id);
+    schedule(now + next_period_us(), EV_TX_START, node);
+}
+
+static bool overlaps_gateway_tx(const Frame &f)
+{
+    for (const SimTxInterval &iv : g_sim_gw_tx)
+    {
+        if (iv.start_us < f.end_us && iv.end_us > f.start_us)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void on_tx_end(uint32_t id, int64_t now)
+{
+    const Frame &f = g_frames[id];
+    g_on_air.erase(std::find(g_on_air.begin(), g_on_air.end(), id));
+
+    const double sens = kSensitivity[g_sim_cfg.sf] + 10.0 * log10(g_sim_cfg.bw_hz / 125000.0);
+
+    if (f.rssi < sens || f.snr < kSnrMin[g_sim_cfg.sf])
+    {
+        g_stats.lost_weak++;
+    }
+    else if (f.collided && !g_net.corrupt)
+    {
+        g_stats.lost_collision++;
+    }
+    else if (overlaps_gateway_tx(f))
+    {
+        g_stats.lost_half_duplex++;
+    }
+    else
+    {
+        /* RxDone: a tarefa do rádio copia para o buffer único. */
+        if (g_slot_full)
+        {
+            g_stats.overruns++;
+        }
+
+        g_slot = f;
+        memcpy(g_slot_sent, f.bytes, f.len);
+        g_slot_rx_us = now;
+        g_slot_full = true;
+
+        /* Colisão não detectada pelo CRC: de 1 a 8 bytes trocados em qualquer posição. */
+        if (f.collided)
+        {
+            const uint32_t n = 1u + (uint32_t)(g_rng() % 8u);
+
+            for (uint32_t i = 0; i < n; ++i)
+            {
+                g_slot.bytes[g_rng() % f.len] ^= (uint8_t)(1u + g_rng() % 255u);
+            }
+
+            /* Só a sequência (fora da etiqueta) trocada: id, IV e ciphertext chegaram
+             * íntegros e o ACK é devido. */
+            const size_t hdr = f.len % 16u;
+            g_slot.corrupted = memcmp(g_slot.bytes, f.bytes, KEYTAB_HDR_LEN) != 0 ||
+                               memcmp(g_slot.bytes + hdr, f.bytes + hdr, f.len - hdr) != 0;
+        }
+
+        g_stats.readings_rx += g_slot.corrupted ? 0u : g_net.batch;
+
+        if (!g_loop_busy && !g_loop_scheduled)
+        {
+            g_loop_scheduled = true;
+            const double wait_us = (g_net.poll_ms > 0) ? uniform(0.0, g_net.poll_ms * 1000.0)
+                                                       : (double)SIM_WAKE_US;
+            schedule(now + (int64_t)wait_us, EV_LOOP, 0);
+        }
+    }
+
+    g_free.push_back(id);
+}
+
+/**
+ * @brief Classifica os ACKs transmitidos durante o processamento de um quadro.
+ * @param f Quadro entregue ao pipeline.
+ * @param sent Bytes do quadro como o nó os enviou.
+ * @param rx_us RxDone do quadro.
+ * @param tx0 Primeira transmissão do gateway feita nesta chamada.
+ * @param accepted true se o pipeline entregou leituras do quadro.
+ * @param late true se o pipeline desistiu do ACK por ter passado da janela.
+ */
+static void check_acks(const Frame &f, const uint8_t *sent, int64_t rx_us, size_t tx0,
+                       bool accepted, bool late)
+{
+    if (!LORA_ACK_ENABLE)
+    {
+        return;
+    }
+
+    uint32_t acks = 0;
+    uint32_t valid = 0;
+
+    for (size_t i = tx0; i < g_sim_gw_tx.size(); ++i)
+    {
+        const SimTxInterval &tx = g_sim_gw_tx[i];
+        const int64_t turnaround = tx.start_us - rx_us;
+        acks++;
+        valid += node_accepts_ack(f.node, sent, f.len, tx.bytes) ? 1u : 0u;
+        g_stats.ack_turnaround_max_us = std::max(g_stats.ack_turnaround_max_us, turnaround);
+        g_stats.ack_over_window += (turnaround > LORA_ACK_WINDOW_US) ? 1u : 0u;
+    }
+
+    if (f.corrupted)
+    {
+        g_stats.corrupt_rx++;
+        g_stats.corrupt_accepted += accepted ? 1u : 0u;
+        g_stats.corrupt_acked += acks ? 1u : 0u;
+        g_stats.corrupt_ack_valid += valid;
+        return;
+    }
+
+    g_stats.ack_extra += (acks > 1u) ? 1u : 0u;
+    g_stats.ack_bad_tag += acks - valid;
+
+    if (accepted && acks == 0 && !late)
+    {
+        g_stats.ack_missing++;
+    }
+    else if (valid)
+    {
+        g_stats.ack_ok++;
+    }
+}
+
+static void on_loop(int64_t now)
+{
+    g_loop_scheduled = false;
+    g_loop_busy = false;
+
+    if (!g_slot_full)
+    {
+        return;
+    }
+
+    const Frame f = g_slot;
+    uint8_t sent[LORA_MAX_PACKET_LEN];
+    memcpy(sent, g_slot_sent, f.len);
+    const int64_t rx_us = g_slot_rx_us;
+    g_slot_full = false;
+    g_pickup_us.push_back((uint32_t)(now - rx_us));
+
+    /* Transmissões do gateway que já não afetam quadros no ar podem sair da lista. */
+    int64_t oldest = now;
+
+    for (uint32_t id : g_on_air)
+    {
+        oldest = std::min(oldest, g_frames[id].start_us);
+    }
+
+    g_sim_gw_tx.erase(std::remove_if(g_sim_gw_tx.begin(), g_sim_gw_tx.end(),
+                                     [&](const SimTxInterval &iv) { return iv.end_us < oldest; }),
+                      g_sim_gw_tx.end());
+
+    const size_t tx0 = g_sim_gw_tx.size();
+    const uint32_t readings0 = g_sim_stats.readings;
+    const uint32_t late0 = g_sim_stats.acks[ACK_LATE];
+
+    sim_call_begin(now);
+    rx_pipeline_handle(f.bytes, f.len, (int16_t)lround(f.rssi), (float)f.snr, rx_us);
+    const int64_t done = sim_call_end();
+
+    check_acks(f, sent, rx_us, tx0, g_sim_stats.readings != readings0,
+               g_sim_stats.acks[ACK_LATE] != late0);
+
+    g_loop_busy = true;
+    g_loop_scheduled = true;
+    schedule(done, EV_LOOP, 0);
+}
+
+template <typename T>
+static double percentile_ms(std::vector<T> v, double p)
+{
+    if (v.empty())
+    {
+        return 0.0;
+    }
+
+    const size_t k = std::min(v.size() - 1u, (size_t)(p * (double)v.size()));
+    std::nth_element(v.begin(), v.begin() + (long)k, v.end());
+    return v[k] / 1000.0;
+}
+
+/**
+ * @brief Imprime o resultado de uma verificação de @c --check.
+ * @return @p ok.
+ */
+static bool verify(bool ok, const char *what, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+static bool verify(bool ok, const char *what, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    printf("#   %-5s %-34s ", ok ? "ok" : "FALHA", what);
+    vprintf(fmt, ap);
+    putchar('\n');
+    va_end(ap);
+    return ok;
+}
+
+/**
+ * @brief Verificações de aprovação/falha do ACK (só com @c LORA_ACK_ENABLE).
+ * @return true se todas passaram.
+ */
+static bool check_ack_run(void)
+{
+    const SimGatewayStats &gw = g_sim_stats;
+    bool ok = true;
+
+    ok &= verify(node_cmac_selftest(), "CMAC do no (RFC 4493)", "exemplos 1, 2 e 4");
+    ok &= verify(g_stats.ack_ok > 0, "ACKs conferidos pelo no", "%u", g_stats.ack_ok);
+    ok &= verify(g_stats.ack_bad_tag == 0, "etiqueta recusada pelo no", "%u",
+                 g_stats.ack_bad_tag);
+    ok &= verify(g_stats.ack_extra == 0, "mais de um ACK por quadro", "%u", g_stats.ack_extra);
+    ok &= verify(g_stats.ack_missing == 0, "quadro validado sem ACK", "%u",
+                 g_stats.ack_missing);
+    ok &= verify(gw.acks[ACK_LATE] == 0 && gw.acks[ACK_FAILED] == 0, "ACK tarde ou com falha",
+                 "%u tarde, %u falhas", gw.acks[ACK_LATE], gw.acks[ACK_FAILED]);
+    ok &= verify(g_stats.ack_over_window == 0 &&
+                     g_stats.ack_turnaround_max_us <= LORA_ACK_WINDOW_US,
+                 "turnaround <= LORA_ACK_WINDOW_US", "max %.1f ms (janela %.0f ms)",
+                 g_stats.ack_turnaround_max_us / 1000.0, LORA_ACK_WINDOW_US / 1000.0);
+
+    if (g_net.corrupt)
+    {
+        ok &= verify(g_stats.corrupt_rx > 0, "colisoes entregues corrompidas", "%u",
+                     g_stats.corrupt_rx);
+        ok &= verify(g_stats.corrupt_acked == g_stats.corrupt_accepted,
+                     "ACK so de corrompido validado", "%u ACKs, %u validados",
+                     g_stats.corrupt_acked, g_stats.corrupt_accepted);
+        ok &= verify(g_stats.corrupt_ack_valid == 0, "ACK de corrompido aceito pelo no", "%u",
+                     g_stats.corrupt_ack_valid);
+    }
+
+    return ok;
+}
+
+static bool fault_enabled(const FaultConfig &c)
+{
+    return c.error_permille || c.delay_permille;
+}
+
+/**
+ * @brief Verificações de aprovação/falha de perda e latência, com ou sem falhas.
+ * @param lost Leituras de quadros íntegros que não saíram pelo uplink.
+ * @return true se todas passaram.
+ */
+static bool check_fault_run(uint32_t lost)
+{
+    const SimGatewayStats &gw = g_sim_stats;
+    const double loss = g_stats.readings_rx ? 100.0 * lost / g_stats.readings_rx : 0.0;
+    const double p99 = percentile_ms(gw.latency_us, 0.99);
+    const double p999 = percentile_ms(gw.latency_us, 0.999);
+    bool ok = true;
+
+    ok &= verify(loss <= g_net.max_loss_pct, "perda no gateway",
+                 "%.2f%% de %u (limite %.2f%%)", loss, g_stats.readings_rx, g_net.max_loss_pct);
+    ok &= verify(p99 <= g_net.max_p99_ms, "p99 do processamento", "%.1f ms (limite %.1f ms)",
+                 p99, g_net.max_p99_ms);
+    ok &= verify(p999 <= g_net.max_p999_ms, "p999 do processamento",
+                 "%.1f ms (limite %.1f ms)", p999, g_net.max_p999_ms);
+
+    if (fault_enabled(g_sim_cfg.sd_fault))
+    {
+        ok &= verify(gw.sd_stalls + gw.sd_card_lost > 0, "falhas do SD injetadas",
+                     "%u travamentos, %u remocoes", gw.sd_stalls, gw.sd_card_lost);
+        ok &= verify(gw.sd_dropped_lines == 0 || gw.rtc_pending > 0,
+                     "log perdido fica no estagio RTC", "%u linhas, %u leituras pendentes",
+                     gw.sd_dropped_lines, gw.rtc_pending);
+    }
+
+    if (fault_enabled(g_sim_cfg.http_fault))
+    {
+        ok &= verify(gw.uplink_retries + gw.uplink_failed > 0, "falhas HTTP injetadas",
+                     "%u retentativas, %u abandonadas", gw.uplink_retries, gw.uplink_failed);
+    }
+
+    if (g_net.radio_fault.error_permille)
+    {
+        ok &= verify(gw.drops[DROP_INJECTED] > 0, "perdas de radio injetadas", "%u",
+                     gw.drops[DROP_INJECTED]);
+    }
+
+    return ok;
+}
+
+/**
+ * @brief Roda uma simulação com @p nodes nós e imprime uma linha da tabela.
+ * @return false se alguma verificação de @c --check falhar.
+ */
+static bool run(uint32_t nodes)
+{
+    g_rng.seed(g_net.seed * 7919u + nodes);
+    g_node_rssi.resize(nodes);
+
+    for (uint32_t n = 0; n < nodes; ++n)
+    {
+        g_node_rssi[n] = normal(g_net.rssi_mean, g_net.rssi_sd);
+        schedule((int64_t)uniform(0.0, g_net.interval_s * 1e6), EV_TX_START, n);
+    }
+
+    logger_begin();
+    crypto_init(AES_KEY);
+
+    if (fault_enabled(g_net.radio_fault))
+    {
+        fault_configure(FAULT_RADIO, &g_net.radio_fault);
+    }
+
+    /* Chave própria por nó (id = índice + 1), carregada como se viesse do SD. */
+    if (g_net.node_keys)
+    {
+        std::string text;
+        char line[48];
+        g_node_key.assign(nodes, std::vector<uint8_t>(CRYPTO_KEY_SIZE));
+        g_node_seq.assign(nodes, 0);
+
+        for (uint32_t n = 0; n < nodes; ++n)
+        {
+            int k = snprintf(line, sizeof(line), "%u ", (unsigned)(n + 1u));
+
+            for (uint8_t &b : g_node_key[n])
+            {
+                b = (uint8_t)g_rng();
+                k += snprintf(line + k, sizeof(line) - (size_t)k, "%02x", b);
+            }
+
+            text += line;
+            text += '\n';
+        }
+
+        if (!keytab_load(text.data(), text.size()))
+        {
+            fprintf(stderr, "tabela de chaves recusada (%u nos, maximo %u)\n",
+                    (unsigned)nodes, (unsigned)KEYTAB_MAX_NODES);
+            _exit(1);
+        }
+
+        keytab_tick();
+    }
+
+    const int64_t end_us = (int64_t)(g_net.duration_s * 1e6);
+
+    while (!g_events.empty() && g_events.top().t_us < end_us)
+    {
+        const Event ev = g_events.top();
+        g_events.pop();
+
+        switch (ev.type)
+        {
+        case EV_TX_START: on_tx_start(ev.id, ev.t_us); break;
+        case EV_TX_END:   on_tx_end(ev.id, ev.t_us); break;
+        case EV_LOOP:     on_loop(ev.t_us); break;
+        }
+    }
+
+    const SimGatewayStats &gw = g_sim_stats;
+    const double dur_us = (double)end_us;
+    uint32_t other_drops = 0;
+
+    for (uint8_t i = 0; i < DROP_N_REASONS; ++i)
+    {
+        other_drops += gw.drops[i];
+    }
+
+    const uint32_t delivered = gw.uplink_submitted - gw.uplink_dropped - gw.uplink_failed;
+    const double busy = (double)(gw.cpu_us + gw.uart_us + gw.air_us);
+
+    /* Despertares do laço: um por pacote, mais a manutenção ou as consultas ociosas. */
+    const double wakeups_s = (double)g_pickup_us.size() / g_net.duration_s +
+        ((g_net.poll_ms > 0) ? (1.0 - busy / dur_us) * 1000.0 / g_net.poll_ms
+                             : (double)SIM_HOUSEKEEPING_HZ);
+
+    printf("%6u %6.3f %7u %6u %6u %5u %6u %5u %8u %6.1f%% %4u %5.1f %5u %5.1f%% %5.1f%% %5.1f%% "
+           "%7.1f %7.1f %7.0f %6.1f %6u %5u\n",
+           nodes, g_stats.airtime_us / dur_us, g_stats.frames_sent, g_stats.lost_weak,
+           g_stats.lost_collision, g_stats.lost_half_duplex, g_stats.overruns, other_drops,
+           delivered, g_stats.readings_sent ? 100.0 * delivered / g_stats.readings_sent : 0.0,
+           gw.uplink_depth_max, gw.uplink_submitted ? (double)gw.uplink_depth_sum / gw.uplink_submitted : 0.0,
+           gw.uplink_dropped, 100.0 * busy / dur_us, 100.0 * gw.cpu_us / dur_us,
+           100.0 * gw.uart_us / dur_us, percentile_ms(gw.latency_us, 0.5),
+           percentile_ms(gw.latency_us, 0.99), percentile_ms(g_pickup_us, 0.99) * 1000.0,
+           wakeups_s, gw.acks[ACK_SENT], gw.acks[ACK_LATE]);
+
+    /* Perda estimada pelas lacunas de sequência contra a real (quadros que não chegaram
+     * ao pipeline ou não decifraram), nos nós que couberam no registro de enlace. */
+    if (g_net.seq)
+    {
+        uint64_t est_frames = 0;
+        uint64_t est_lost = 0;
+        uint32_t sent = 0;
+        uint8_t tracked = 0;
+        LinkSource ls;
+
+        for (uint8_t slot = 0; slot < LINKQ_MAX_SOURCES; ++slot)
+        {
+            if (linkq_get(slot, &ls) && ls.node >= 1 && ls.node <= nodes)
+            {
+                est_frames += ls.frames;
+                est_lost += ls.lost;
+                sent += g_node_seq[ls.node - 1u];
+                tracked++;
+            }
+        }
+
+        printf("#   enlace: %u nos acompanhados, perda estimada %.2f%%, real %.2f%%\n",
+               (unsigned)tracked,
+               (est_frames + est_lost) ? 100.0 * est_lost / (est_frames + est_lost) : 0.0,
+               sent ? 100.0 * (sent - est_frames) / sent : 0.0);
+    }
+
+    const uint32_t lost = (delivered < g_stats.readings_rx) ? g_stats.readings_rx - delivered : 0u;
+
+    if (fault_enabled(g_sim_cfg.sd_fault) || fault_enabled(g_sim_cfg.http_fault) ||
+        fault_enabled(g_net.radio_fault))
+    {
+        printf("#   falhas: SD %u travamentos, %u remocoes, anel max %u B, %u linhas recusadas; "
+               "HTTP %u retentativas, %u abandonadas; radio %u perdidos; perda no gateway "
+               "%u (%.2f%%), p999 %.1f ms\n",
+               gw.sd_stalls, gw.sd_card_lost, gw.sd_ring_peak, gw.sd_dropped_lines,
+               gw.uplink_retries, gw.uplink_failed, gw.drops[DROP_INJECTED], lost,
+               g_stats.readings_rx ? 100.0 * lost / g_stats.readings_rx : 0.0,
+               percentile_ms(gw.latency_us, 0.999));
+    }
+
+    bool ok = true;
+
+    if (g_net.check)
+    {
+        ok &= check_fault_run(lost);
+    }
+
+    if (g_net.check && LORA_ACK_ENABLE)
+    {
+        ok &= check_ack_run();
+    }
+
+    fflush(stdout);
+    return ok;
+}
+
+static std::vector<uint32_t> parse_list(const char *s)
+{
+    std::vector<uint32_t> out;
+
+    for (const char *p = s; *p;)
+    {
+        char *end;
+        out.push_back((uint32_t)strtoul(p, &end, 10));
+        p = (*end == ',') ? end + 1 : end;
+
+        if (end == p && *p)
+        {
+            break;
+        }
+    }
+
+    return out;
+}
+
+/**
+ * @brief Lê "erro,atraso,min,max" (partes por mil e ms) para um @c FaultConfig.
+ */
+static bool parse_fault(const char *s, FaultConfig *out)
+{
+    const std::vector<uint32_t> v = parse_list(s);
+
+    if (v.size() != 4 || v[0] > 1000 || v[1] > 1000 || v[2] > v[3])
+    {
+        return false;
+    }
+
+    *out = FaultConfig{(uint16_t)v[0], (uint16_t)v[1], v[2], v[3]};
+    return true;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "uso: netsim [--nodes 10,50,100,200] [--interval s] [--jitter f] [--batch k]\n"
+            "            [--sf 7..12] [--bw hz] [--duration s] [--rssi-mean dBm] [--rssi-sd dB]\n"
+            "            [--fade-sd dB] [--capture-db dB] [--cpu-scale x] [--baud bps]\n"
+            "            [--net-ms ms] [--queue n] [--seed n] [--node-keys 0|1] [--seq 0|1]\n"
+            "            [--poll-ms ms] [--corrupt 0|1] [--check 0|1] [--log arquivo]\n"
+            "            [--fault-sd err,dly,min,max] [--fault-http err,dly,min,max]\n"
+            "            [--fault-radio err,dly,min,max] [--max-loss %%] [--max-p99-ms ms]\n"
+            "            [--max-p999-ms ms]\n");
+}
+
+/****************************** Funções públicas ******************************/
+
+int main(int argc, char **argv)
+{
+    std::vector<uint32_t> sweep = {10, 50, 100, 200, 400};
+    const char *log_path = nullptr;
+
+    g_sim_cfg.cpu_scale = 20.0;
+    g_sim_cfg.baud = 115200;
+    g_sim_cfg.sf = 7;
+    g_sim_cfg.bw_hz = 125000;
+    g_sim_cfg.sink_queue_len = 16;
+    g_sim_cfg.net_ms = 200.0;
+    g_sim_cfg.log = nullptr;
+    g_sim_cfg.sd_fault = FaultConfig{0, 0, 0, 0};
+    g_sim_cfg.http_fault = FaultConfig{0, 0, 0, 0};
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+
+        if (!v || a.compare(0, 2, "--") != 0)
+        {
+            usage();
+            return 2;
+        }
+
+        ++i;
+
+        if (a == "--nodes") sweep = parse_list(v);
+        else if (a == "--interval") g_net.interval_s = atof(v);
+        else if (a == "--jitter") g_net.jitter = atof(v);
+        else if (a == "--batch") g_net.batch = (uint8_t)std::min(std::max(atoi(v), 1), BATCH_MAX_SAMPLES);
+        else if (a == "--sf") g_sim_cfg.sf = (uint8_t)std::min(std::max(atoi(v), 7), 12);
+        else if (a == "--bw") g_sim_cfg.bw_hz = (uint32_t)atol(v);
+        else if (a == "--duration") g_net.duration_s = atof(v);
+        else if (a == "--rssi-mean") g_net.rssi_mean = atof(v);
+        else if (a == "--rssi-sd") g_net.rssi_sd = atof(v);
+        else if (a == "--fade-sd") g_net.fade_sd = atof(v);
+        else if (a == "--capture-db") g_net.capture_db = atof(v);
+        else if (a == "--node-keys") g_net.node_keys = atoi(v) != 0;
+        else if (a == "--seq") g_net.seq = atoi(v) != 0;
+        else if (a == "--poll-ms") g_net.poll_ms = atof(v);
+        else if (a == "--corrupt") g_net.corrupt = atoi(v) != 0;
+        else if (a == "--check") g_net.check = atoi(v) != 0;
+        else if (a == "--cpu-scale") g_sim_cfg.cpu_scale = atof(v);
+        else if (a == "--baud") g_sim_cfg.baud = (uint32_t)atol(v);
+        else if (a == "--net-ms") g_sim_cfg.net_ms = atof(v);
+        else if (a == "--queue") g_sim_cfg.sink_queue_len = (uint8_t)atoi(v);
+        else if (a == "--seed") g_net.seed = (uint32_t)atol(v);
+        else if (a == "--log") log_path = v;
+        else if (a == "--max-loss") g_net.max_loss_pct = atof(v);
+        else if (a == "--max-p99-ms") g_net.max_p99_ms = atof(v);
+        else if (a == "--max-p999-ms") g_net.max_p999_ms = atof(v);
+        else if (a == "--fault-sd" && parse_fault(v, &g_sim_cfg.sd_fault)) {}
+        else if (a == "--fault-http" && parse_fault(v, &g_sim_cfg.http_fault)) {}
+        else if (a == "--fault-radio" && parse_fault(v, &g_net.radio_fault)) {}
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+
+    g_net.seq = g_net.seq && g_net.node_keys;   /* a sequência vai após o id do nó */
+    printf("# SF%u/%lu Hz, intervalo %.0f s, lote %u, %.0f s simulados, ACK %s, UART %lu bps, "
+           "CPU x%.0f, chaves %s, laco %s\n",
+           (unsigned)g_sim_cfg.sf, (unsigned long)g_sim_cfg.bw_hz, g_net.interval_s,
+           (unsigned)g_net.batch, g_net.duration_s, LORA_ACK_ENABLE ? "ligado" : "desligado",
+           (unsigned long)g_sim_cfg.baud, g_sim_cfg.cpu_scale,
+           g_net.node_keys ? "por no" : "da frota",
+           (g_net.poll_ms > 0) ? "por consulta" : "por notificacao");
+    printf("# %5s %6s %7s %6s %6s %5s %6s %5s %8s %7s %4s %5s %5s %6s %6s %6s %7s %7s %7s %6s "
+           "%6s %5s\n",
+           "nos", "carga", "quadros", "fraco", "colis", "half", "overr", "desc", "entregue",
+           "taxa", "fmax", "fmed", "fdrop", "laco", "cpu", "uart", "p50ms", "p99ms", "peg99us",
+           "desp/s", "acks", "tarde");
+    fflush(stdout);
+
+    for (uint32_t nodes : sweep)
+    {
+        const pid_t pid = fork();
+
+        if (pid == 0)
+        {
+            if (log_path)
+            {
+                const std::string path = std::string(log_path) + "." + std::to_string(nodes);
+                g_sim_cfg.log = fopen(path.c_str(), "w");
+            }
+
+            const bool ok = run(nodes);
+
+            if (g_sim_cfg.log)
+            {
+                fclose(g_sim_cfg.log);
+            }
+
+            _exit(ok ? 0 : 1);
+        }
+
+        int status = 0;
+        waitpid(pid, &status, 0);
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            fprintf(stderr, "simulacao com %u nos falhou%s\n", (unsigned)nodes,
+                    g_net.check ? " (verificacoes)" : "");
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,89 @@
+/**
+ * @file sim.h
+ * @brief Interface entre o motor de eventos do simulador e os substitutos de
+ *        plataforma (relógio, UART, rádio, métricas, SD, estágio RTC e uplink).
+ *
+ * As falhas do SD e do HTTP usam os mesmos parâmetros de @c FaultConfig do
+ * firmware, mas são sorteadas nos substitutos, que rodam fora do laço; as do rádio
+ * passam pelo @c fault_hit() real, dentro do pipeline.
+ */
+
+#ifndef NETSIM_SIM_H
+#define NETSIM_SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include "fault_inject.h"
+
+int64_t sim_now_us(void);
+void sim_block_us(int64_t us);
+uint32_t sim_random(void);
+void sim_uart_write(const uint8_t *buf, size_t len);
+bool sim_radio_tx(const uint8_t *buf, size_t len);
+
+/**
+ * @brief Parâmetros do gateway simulado.
+ */
+struct SimGatewayConfig
+{
+    double cpu_scale;        /* tempo de CPU no ESP32 / tempo medido no host   */
+    uint32_t baud;           /* UART do log; 0 = Serial desligada              */
+    uint8_t sf;              /* para o tempo no ar do ACK                      */
+    uint32_t bw_hz;
+    uint8_t sink_queue_len;  /* profundidade da fila do sink de uplink         */
+    double net_ms;           /* tempo médio de entrega de uma leitura          */
+    FILE *log;               /* cópia das linhas de log (opcional)             */
+    FaultConfig sd_fault;    /* por bloco gravado pela tarefa do SD            */
+    FaultConfig http_fault;  /* por tentativa de entrega do uplink             */
+};
+
+/**
+ * @brief Contadores preenchidos pelos substitutos durante a simulação.
+ */
+struct SimGatewayStats
+{
+    uint32_t rx_packets;
+    uint32_t readings;
+    uint32_t drops[16];              /* por DropReason                        */
+    uint32_t acks[4];                /* por AckResult                         */
+    std::vector<uint32_t> latency_us;
+    std::vector<uint32_t> ack_turnaround_us;
+    uint64_t log_bytes;
+    uint64_t cpu_us;                 /* CPU (escalada) gasto no pipeline      */
+    uint64_t uart_us;                /* bloqueado na Serial                   */
+    uint64_t air_us;                 /* bloqueado transmitindo ACK            */
+    uint32_t uplink_submitted;
+    uint32_t uplink_dropped;
+    uint32_t uplink_failed;          /* abandonadas após as tentativas        */
+    uint32_t uplink_retries;
+    uint32_t uplink_depth_max;
+    uint64_t uplink_depth_sum;       /* soma das profundidades a cada envio   */
+    uint32_t rtc_staged;
+    uint32_t rtc_pending;            /* leituras cujo log o anel do SD perdeu */
+    uint32_t sd_dropped_lines;       /* linhas recusadas com o anel cheio     */
+    uint32_t sd_ring_peak;
+    uint32_t sd_stalls;              /* blocos acima de SIM_SD_STALL_MS       */
+    uint32_t sd_card_lost;           /* erros de gravação (cartão removido)   */
+};
+
+/**
+ * @brief Intervalo em que o gateway transmitiu (half-duplex: não recebe) e o quadro.
+ */
+struct SimTxInterval
+{
+    int64_t start_us;
+    int64_t end_us;
+    std::vector<uint8_t> bytes;
+};
+
+extern SimGatewayConfig g_sim_cfg;
+extern SimGatewayStats g_sim_stats;
+extern std::vector<SimTxInterval> g_sim_gw_tx;
+
+void sim_call_begin(int64_t now_us);
+int64_t sim_call_end(void);
+double lora_airtime_us(size_t len, uint8_t sf, uint32_t bw_hz);
+
+#endif /* NETSIM_SIM_H */
@@ -0,0 +1,396 @@
+/**
+ * @file standins.cpp
+ * @brief Substitutos de plataforma ligados ao pipeline real do gateway no simulador.
+ *
+ * - Relógio: dentro de uma chamada ao pipeline, o tempo simulado avança com a CPU
+ *   medida no host (multiplicada por @c cpu_scale) e com os bloqueios modelados
+ *   (UART do log e tempo no ar do ACK).
+ * - UART: FIFO de 128 B; a escrita bloqueia enquanto o restante não couber.
+ * - Métricas e estágio RTC apenas contabilizam.
+ * - SD: anel de @c SIM_SD_RING_LEN bytes esvaziado por uma tarefa de gravação, como
+ *   em @c sd_card.cpp; atrasos e erros de @c sd_fault atingem só essa tarefa, e o
+ *   laço só os sente quando o anel enche e linhas são recusadas.
+ * - Uplink: fila limitada servida por uma rede com tempo de entrega exponencial;
+ *   cada tentativa pode atrasar ou falhar (@c http_fault), com as retentativas e o
+ *   limite de tentativas dos sinks UDP/SD.
+ */
+
+#include <time.h>
+#include <algorithm>
+#include <deque>
+#include <random>
+#include "sim.h"
+#include <Arduino.h>
+#include <LoRa.h>
+#include <SPI.h>
+#include "metrics.h"
+#include "rtc_stage.h"
+#include "sd_card.h"
+#include "spi_bus.h"
+#include "uplink.h"
+
+#define UART_FIFO_BYTES 128
+
+/* Como em sd_card.cpp. */
+#define SIM_SD_RING_LEN      16384
+#define SIM_SD_WRITER_MS     250
+#define SIM_SD_REMOUNT_MS    5000
+#define SIM_SD_STALL_MS      500
+#define SIM_SD_BYTES_PER_US  0.4    /* ~400 kB/s gravando blocos no cartão */
+
+/* Política de retentativa dos sinks UDP e de exportação no SD (uplink_sinks.cpp). */
+#define SIM_UPLINK_ATTEMPTS      3
+#define SIM_UPLINK_RETRY_MIN_MS  1000
+#define SIM_UPLINK_RETRY_MAX_MS  5000
+
+/**
+ * @brief Resultado sorteado de um ponto de falha, sem bloquear quem sorteia.
+ */
+struct FaultDraw
+{
+    int64_t delay_us;
+    bool error;
+};
+
+/**
+ * @brief Entrega prevista de uma leitura na fila do sink.
+ */
+struct UplinkDone
+{
+    int64_t t_us;
+    bool failed;    /* esgotou as tentativas */
+};
+
+HardwareSerial Serial;
+LoRaClass LoRa;
+SPIClass SPI;
+
+SimGatewayConfig g_sim_cfg;
+SimGatewayStats g_sim_stats;
+std::vector<SimTxInterval> g_sim_gw_tx;
+
+static int64_t g_base_us = 0;
+static bool g_in_call = false;
+static int64_t g_cpu0_ns = 0;
+static int64_t g_blocked_us = 0;
+static int64_t g_uart_busy_until = 0;
+static std::deque<UplinkDone> g_uplink_done;   /* fim de entrega de cada leitura na fila */
+static std::mt19937 g_rng(1);
+
+static uint32_t g_sd_ring = 0;          /* bytes no anel                           */
+static uint32_t g_sd_inflight = 0;      /* bytes do bloco em gravação              */
+static int64_t g_sd_next_us = 0;        /* próxima ação da tarefa de gravação      */
+static bool g_sd_card_ok = true;
+
+/****************************** Funções privadas ******************************/
+
+static int64_t cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int64_t cpu_scaled_us(void)
+{
+    return (int64_t)((double)(cpu_ns() - g_cpu0_ns) * g_sim_cfg.cpu_scale / 1000.0);
+}
+
+/**
+ * @brief Sorteia atraso e erro como @c fault_hit(), mas devolve o atraso em vez de
+ *        bloquear: os substitutos do SD e do uplink rodam fora do laço.
+ */
+static FaultDraw fault_draw(const FaultConfig &c)
+{
+    FaultDraw d = {0, false};
+
+    if (c.delay_permille && g_rng() % 1000u < c.delay_permille)
+    {
+        const uint32_t span = (c.delay_max_ms > c.delay_min_ms) ? c.delay_max_ms - c.delay_min_ms
+                                                                : 0;
+        d.delay_us = (int64_t)(c.delay_min_ms + (span ? g_rng() % (span + 1u) : 0)) * 1000;
+    }
+
+    d.error = c.error_permille && g_rng() % 1000u < c.error_permille;
+    return d;
+}
+
+/**
+ * @brief Avança a tarefa de gravação do SD até @p now.
+ *
+ * @details A cada @c SIM_SD_WRITER_MS (ou ao fim de um bloco) a tarefa grava tudo o
+ *          que está no anel; os bytes só saem do anel ao fim da gravação. Um erro
+ *          tira o cartão, e o anel retém tudo até a remontagem.
+ */
+static void sd_advance(int64_t now)
+{
+    while (g_sd_next_us <= now)
+    {
+        const int64_t t = g_sd_next_us;
+        g_sd_ring -= g_sd_inflight;
+        g_sd_inflight = 0;
+        g_sd_card_ok = true;
+
+        if (g_sd_ring == 0)
+        {
+            g_sd_next_us = t + SIM_SD_WRITER_MS * 1000;
+            continue;
+        }
+
+        const FaultDraw d = fault_draw(g_sim_cfg.sd_fault);
+
+        if (d.error)
+        {
+            g_sd_card_ok = false;
+            g_sim_stats.sd_card_lost++;
+            g_sd_next_us = t + d.delay_us + SIM_SD_REMOUNT_MS * 1000;
+            continue;
+        }
+
+        const int64_t dur = d.delay_us + (int64_t)(g_sd_ring / SIM_SD_BYTES_PER_US);
+        g_sim_stats.sd_stalls += (dur > SIM_SD_STALL_MS * 1000) ? 1u : 0u;
+        g_sd_inflight = g_sd_ring;
+        g_sd_next_us = t + dur;
+    }
+}
+
+/****************************** Relógio e rádio *******************************/
+
+int64_t sim_now_us(void)
+{
+    return g_in_call ? g_base_us + cpu_scaled_us() + g_blocked_us : g_base_us;
+}
+
+void sim_block_us(int64_t us)
+{
+    g_blocked_us += us;
+}
+
+uint32_t sim_random(void)
+{
+    return (uint32_t)g_rng();
+}
+
+/**
+ * @brief Inicia uma chamada ao pipeline no instante simulado @p now_us.
+ */
+void sim_call_begin(int64_t now_us)
+{
+    g_base_us = now_us;
+    g_blocked_us = 0;
+    g_in_call = true;
+    g_cpu0_ns = cpu_ns();
+}
+
+/**
+ * @brief Encerra a chamada e devolve o instante simulado em que ela terminou.
+ */
+int64_t sim_call_end(void)
+{
+    const int64_t cpu = cpu_scaled_us();
+    g_sim_stats.cpu_us += (uint64_t)cpu;
+    g_in_call = false;
+    g_base_us += cpu + g_blocked_us;
+    return g_base_us;
+}
+
+void sim_uart_write(const uint8_t *buf, size_t len)
+{
+    (void)buf;
+
+    if (g_sim_cfg.baud == 0)
+    {
+        return;
+    }
+
+    const double byte_us = 10e6 / g_sim_cfg.baud;
+    const int64_t now = sim_now_us();
+    const int64_t start = (g_uart_busy_until > now) ? g_uart_busy_until : now;
+    g_uart_busy_until = start + (int64_t)(len * byte_us);
+
+    const int64_t block = g_uart_busy_until - now - (int64_t)(UART_FIFO_BYTES * byte_us);
+
+    if (block > 0)
+    {
+        g_blocked_us += block;
+        g_sim_stats.uart_us += (uint64_t)block;
+    }
+}
+
+bool sim_radio_tx(const uint8_t *buf, size_t len)
+{
+    const int64_t air = (int64_t)lora_airtime_us(len, g_sim_cfg.sf, g_sim_cfg.bw_hz);
+    const int64_t start = sim_now_us();
+    g_sim_gw_tx.push_back(SimTxInterval{start, start + air,
+                                        std::vector<uint8_t>(buf, buf + len)});
+    g_blocked_us += air;
+    g_sim_stats.air_us += (uint64_t)air;
+    return true;
+}
+
+/********************************* Métricas ***********************************/
+
+void metrics_rx_packet(uint16_t, int16_t, int32_t)
+{
+    g_sim_stats.rx_packets++;
+}
+
+void metrics_drop(DropReason reason)
+{
+    g_sim_stats.drops[reason]++;
+}
+
+void metrics_drop_n(DropReason reason, uint32_t n)
+{
+    g_sim_stats.drops[reason] += n;
+}
+
+void metrics_latency_us(uint32_t us)
+{
+    g_sim_stats.latency_us.push_back(us);
+}
+
+void metrics_readings(uint32_t n)
+{
+    g_sim_stats.readings += n;
+}
+
+void metrics_ack(AckResult result, uint32_t turnaround_us, uint32_t)
+{
+    g_sim_stats.acks[result]++;
+
+    if (result == ACK_SENT)
+    {
+        g_sim_stats.ack_turnaround_us.push_back(turnaround_us);
+    }
+}
+
+/***************************** SD e estágio RTC *******************************/
+
+void sdcard_lock() {}
+void sdcard_unlock() {}
+
+/**
+ * @brief Põe a linha no anel; cheio, recusa a linha inteira, como @c ring_append_line().
+ */
+bool sdcard_write(const char *buf, size_t len)
+{
+    g_sim_stats.log_bytes += len;
+
+    if (g_sim_cfg.log)
+    {
+        fwrite(buf, 1, len, g_sim_cfg.log);
+    }
+
+    const int64_t now = sim_now_us();
+    sd_advance(now);
+
+    if (g_sd_ring + len > SIM_SD_RING_LEN)
+    {
+        g_sim_stats.sd_dropped_lines++;
+        return false;
+    }
+
+    g_sd_ring += (uint32_t)len;
+    g_sim_stats.sd_ring_peak = std::max(g_sim_stats.sd_ring_peak, g_sd_ring);
+
+    /* Acima da metade, a tarefa ociosa é acordada na hora. */
+    if (g_sd_ring >= SIM_SD_RING_LEN / 2u && g_sd_inflight == 0 && g_sd_card_ok)
+    {
+        g_sd_next_us = std::min(g_sd_next_us, now);
+    }
+
+    return true;
+}
+
+uint32_t sdcard_dropped_lines()
+{
+    return g_sim_stats.sd_dropped_lines;
+}
+
+bool sdcard_read(const char *, char *, size_t, size_t *out_len)
+{
+    *out_len = 0;
+    return false;
+}
+
+void rtc_stage_reading(const SensorReading *, bool logged)
+{
+    g_sim_stats.rtc_staged++;
+    g_sim_stats.rtc_pending += logged ? 0u : 1u;
+}
+
+void rtc_stage_log(const char *, size_t, bool)
+{
+    g_sim_stats.rtc_staged++;
+}
+
+void spi_bus_acquire(SpiDevice) {}
+void spi_bus_release(SpiDevice) {}
+
+/********************************** Uplink ************************************/
+
+/**
+ * @brief Fila do sink com entregas encadeadas; cheia, perde uma leitura.
+ *
+ * @details A fila real descarta a mais antiga ainda não servida; para a contagem
+ *          de perdas e a ocupação, descartar a última entrega prevista é equivalente.
+ *          Cada tentativa sorteia @c http_fault: o atraso soma ao tempo de entrega
+ *          e o erro leva à espera exponencial e a uma nova tentativa.
+ */
+void uplink_submit(const SensorReading *)
+{
+    const int64_t now = sim_now_us();
+
+    while (!g_uplink_done.empty() && g_uplink_done.front().t_us <= now)
+    {
+        g_uplink_done.pop_front();
+    }
+
+    if (g_uplink_done.size() >= g_sim_cfg.sink_queue_len)
+    {
+        /* Já contada como falha, a leitura descartada não é perdida duas vezes. */
+        g_sim_stats.uplink_failed -= g_uplink_done.back().failed ? 1u : 0u;
+        g_uplink_done.pop_back();
+        g_sim_stats.uplink_dropped++;
+    }
+
+    std::exponential_distribution<double> service(1.0 / (g_sim_cfg.net_ms * 1000.0));
+    int64_t t = g_uplink_done.empty() ? now : g_uplink_done.back().t_us;
+    int64_t backoff_us = SIM_UPLINK_RETRY_MIN_MS * 1000;
+    bool failed = false;
+
+    for (uint8_t attempt = 1;; ++attempt)
+    {
+        const FaultDraw d = fault_draw(g_sim_cfg.http_fault);
+        t += d.delay_us;
+
+        if (!d.error)
+        {
+            t += (int64_t)service(g_rng);
+            break;
+        }
+
+        if (attempt >= SIM_UPLINK_ATTEMPTS)
+        {
+            failed = true;
+            g_sim_stats.uplink_failed++;
+            break;
+        }
+
+        g_sim_stats.uplink_retries++;
+        t += backoff_us;
+        backoff_us = std::min<int64_t>(backoff_us * 2, SIM_UPLINK_RETRY_MAX_MS * 1000);
+    }
+
+    g_uplink_done.push_back(UplinkDone{t, failed});
+    g_sim_stats.uplink_submitted++;
+
+    const uint32_t depth = (uint32_t)g_uplink_done.size();
+    g_sim_stats.uplink_depth_sum += depth;
+
+    if (depth > g_sim_stats.uplink_depth_max)
+    {
+        g_sim_stats.uplink_depth_max = depth;
+    }
+}
@@ -0,0 +1,27 @@
+/**
+ * @file Arduino.h
+ * @brief Substituto mínimo do core Arduino para a ferramenta do log bruto:
+ *        relógio do host e @c esp_random().
+ */
+
+#ifndef RECLOG_ARDUINO_H
+#define RECLOG_ARDUINO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+static inline uint32_t millis(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static inline uint32_t esp_random(void)
+{
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+#endif /* RECLOG_ARDUINO_H */
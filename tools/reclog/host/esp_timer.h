@@ -0,0 +1,19 @@
+/**
+ * @file esp_timer.h
+ * @brief Substituto do esp_timer no host: relógio monotônico em µs.
+ */
+
+#ifndef RECLOG_ESP_TIMER_H
+#define RECLOG_ESP_TIMER_H
+
+#include <stdint.h>
+#include <time.h>
+
+static inline int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif /* RECLOG_ESP_TIMER_H */
@@ -0,0 +1,15 @@
+/**
+ * @file FreeRTOS.h
+ * @brief Substituto das seções críticas do FreeRTOS (a ferramenta é de uma thread).
+ */
+
+#ifndef RECLOG_FREERTOS_H
+#define RECLOG_FREERTOS_H
+
+typedef int portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(m) ((void)(m))
+#define portEXIT_CRITICAL(m) ((void)(m))
+
+#endif /* RECLOG_FREERTOS_H */
@@ -0,0 +1,543 @@
+/**
+ * @file reclog.cpp
+ * @brief Ferramenta de host do log em setores brutos (@c lib/record_log): extrai as
+ *        leituras de um cartão ou imagem e mede vazão e tempo de recuperação.
+ *
+ * Uso:
+ *   reclog extract <imagem|/dev/sdX> <diretorio>
+ *   reclog bench [-f imagem] [-m MB da particao] [-n voltas] [-s] [-w us] [-r us]
+ *
+ * @c extract abre o dispositivo só para leitura, percorre os blocos da janela
+ * válida (do mais antigo à cabeça) e grava um CSV por nó e versão de payload,
+ * @c no_<id>_v<versao>.csv, com os campos renderizados pela tabela do schema.
+ *
+ * @c bench cria uma imagem esparsa com MBR (uma partição FAT vazia, só para o
+ * layout, e a partição do log), grava leituras sintéticas por @c reclog_append()
+ * até @c -n voltas do anel e, em pontos fixos, reabre o log medindo a busca
+ * binária contra uma varredura linear. No fim, simula uma gravação interrompida
+ * e confere todas as leituras da janela. @c -s faz @c fdatasync() a cada setor.
+ *
+ * O tempo no cartão é estimado pelas operações de setor contadas vezes a latência
+ * de @c -w (gravação) e @c -r (leitura) por setor. A coluna FAT é um MODELO das
+ * operações de setor do caminho de @c sdcard_append() (FatFs: abrir, buscar o fim
+ * pela cadeia de clusters, ler-modificar-gravar o setor de dados, atualizar a
+ * entrada de diretório); não é medida, pois não há FatFs no host.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <map>
+#include <string>
+#include <esp_timer.h>
+#include "fmt.h"
+#include "logger.h"
+#include "payload_schema.h"
+#include "record_log.h"
+#include "sd_card.h"
+#include "utils.h"
+
+#define IMG_FAT_START   2048u                   /* alinhamento usual de 1 MiB   */
+#define IMG_FAT_SECTORS (16u * 2048u)           /* 16 MiB, só para o layout     */
+#define FAT_LINE_LEN    60u                     /* linha típica do sink SDX     */
+#define FAT_CLUSTER     (32u * 1024u)
+#define FAT_ENTRIES_PER_SECTOR 128u             /* FAT32                        */
+
+static int g_fd = -1;
+static bool g_sync = false;
+static bool g_verbose = false;
+static uint64_t g_reads;
+static uint64_t g_writes;
+
+/****************************** Substitutos ***********************************/
+
+void logger_log(const char *tag, const char *fmt, ...)
+{
+    if (!g_verbose)
+    {
+        return;
+    }
+
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "[%s] ", tag);
+    vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+    va_end(ap);
+}
+
+bool sdcard_read_raw(uint32_t sector, uint8_t *buf)
+{
+    g_reads++;
+    return pread(g_fd, buf, RECLOG_SECTOR, (off_t)sector * RECLOG_SECTOR) == RECLOG_SECTOR;
+}
+
+bool sdcard_write_raw(uint32_t sector, const uint8_t *buf)
+{
+    g_writes++;
+
+    if (pwrite(g_fd, buf, RECLOG_SECTOR, (off_t)sector * RECLOG_SECTOR) != RECLOG_SECTOR)
+    {
+        return false;
+    }
+
+    return !g_sync || fdatasync(g_fd) == 0;
+}
+
+/****************************** Funções privadas ******************************/
+
+/**
+ * @brief Leitura sintética determinística número @p k (bloco k / RECLOG_PER_BLOCK).
+ */
+static void synth(uint64_t k, SensorReading *r)
+{
+    memset(r, 0, sizeof(*r));
+    r->version = 1;
+    r->checksum = (uint8_t)k;
+    r->source = (uint16_t)(1u + k % 7u);
+    r->timestamp = (uint32_t)(1700000000u + k * 60u);
+    r->value[0] = (int32_t)(k % 2000u);
+    r->value[1] = (int32_t)(3300u + k % 900u);
+    r->value[2] = (int32_t)(k % 700u) - 200;
+    r->value[3] = (int32_t)r->timestamp;
+
+    if (k % 97u == 0)
+    {
+        r->value[0] = 0xFFFF;
+        r->error_mask = 1u;
+    }
+}
+
+/**
+ * @brief Escreve a MBR com a partição FAT de enfeite e a do log no resto da imagem.
+ */
+static bool write_mbr(uint32_t raw_sectors)
+{
+    uint8_t mbr[RECLOG_SECTOR];
+    memset(mbr, 0, sizeof(mbr));
+
+    uint8_t *e = mbr + 446;
+    e[4] = 0x0C;                                     /* FAT32 LBA */
+    utils_wr_le_u32(e + 8, IMG_FAT_START);
+    utils_wr_le_u32(e + 12, IMG_FAT_SECTORS);
+
+    e += 16;
+    e[4] = RECLOG_PART_TYPE;
+    utils_wr_le_u32(e + 8, IMG_FAT_START + IMG_FAT_SECTORS);
+    utils_wr_le_u32(e + 12, raw_sectors);
+
+    mbr[510] = 0x55;
+    mbr[511] = 0xAA;
+    return pwrite(g_fd, mbr, sizeof(mbr), 0) == (ssize_t)sizeof(mbr);
+}
+
+/**
+ * @brief Cabeça achada lendo todos os blocos (a alternativa à busca binária).
+ * @return Próxima sequência; @p reads recebe os setores lidos.
+ */
+static uint32_t linear_head(const RecLogStats *st, uint64_t *reads)
+{
+    uint8_t sec[RECLOG_SECTOR];
+    const uint64_t r0 = g_reads;
+    bool any = false;
+    uint32_t best = 0;
+
+    if (!sdcard_read_raw(st->part_start, sec))
+    {
+        return 0;
+    }
+
+    const uint32_t id = utils_rd_le_u32(sec + 8);
+
+    for (uint32_t i = 0; i < st->blocks; ++i)
+    {
+        if (!sdcard_read_raw(st->part_start + 1u + i, sec) ||
+            utils_rd_le_u32(sec + RECLOG_SECTOR - 4) != utils_crc32(sec, RECLOG_SECTOR - 4) ||
+            memcmp(sec, "RLOG", 4) != 0 || utils_rd_le_u32(sec + 4) != id)
+        {
+            continue;
+        }
+
+        const uint32_t s = utils_rd_le_u32(sec + 8);
+        best = (!any || s > best) ? s : best;
+        any = true;
+    }
+
+    *reads = g_reads - r0;
+    return any ? best + 1u : 0;
+}
+
+/**
+ * @brief Reabre o log e imprime a recuperação binária contra a linear.
+ * @return false se alguma das duas não achou @p expect.
+ */
+static bool reopen_and_compare(const char *label, uint32_t expect, double read_us)
+{
+    reclog_close();
+
+    if (!reclog_open())
+    {
+        fprintf(stderr, "reclog_open falhou\n");
+        return false;
+    }
+
+    RecLogStats st;
+    reclog_get_stats(&st);
+
+    uint64_t lin_reads = 0;
+    const int64_t t0 = esp_timer_get_time();
+    const uint32_t lin = linear_head(&st, &lin_reads);
+    const int64_t lin_us = esp_timer_get_time() - t0;
+    const bool ok = st.next_seq == expect && lin == expect;
+
+    printf("  %-22s %10lu %8lu %9lu %11.1f %10llu %9lld %11.1f %s\n", label,
+           (unsigned long)expect, (unsigned long)st.recovery_reads,
+           (unsigned long)st.recovery_us, st.recovery_reads * read_us / 1000.0,
+           (unsigned long long)lin_reads, (long long)lin_us, lin_reads * read_us / 1000.0,
+           ok ? "ok" : "ERRO");
+    return ok;
+}
+
+/**
+ * @brief Operações de setor do modelo FatFs para @p n linhas de @c FAT_LINE_LEN B,
+ *        uma por @c sdcard_append() (abrir, acrescentar e fechar o arquivo).
+ */
+static void fat_model(uint64_t n, uint64_t *reads, uint64_t *writes)
+{
+    uint64_t size = 0;
+    *reads = 0;
+    *writes = 0;
+
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        const uint64_t clusters = size / FAT_CLUSTER;
+        const bool partial = (size % RECLOG_SECTOR) != 0;
+        const bool new_cluster = (size % FAT_CLUSTER) + FAT_LINE_LEN > FAT_CLUSTER ||
+                                 size == 0;
+
+        *reads += 1;                                          /* diretório (open)    */
+        *reads += (clusters + FAT_ENTRIES_PER_SECTOR - 1u) /
+                  FAT_ENTRIES_PER_SECTOR;                     /* cadeia até o fim    */
+        *reads += partial ? 1u : 0u;                          /* setor de dados (RMW)*/
+        *writes += 1u + ((size % RECLOG_SECTOR) + FAT_LINE_LEN > RECLOG_SECTOR ? 1u : 0u);
+
+        if (new_cluster)
+        {
+            *reads += 1;                                      /* procura cluster livre */
+            *writes += 3;                                     /* 2 FATs + FSInfo       */
+        }
+
+        *reads += 1;                                          /* diretório (close)   */
+        *writes += 1;                                         /* tamanho do arquivo  */
+        size += FAT_LINE_LEN;
+    }
+}
+
+static int cmd_extract(const char *dev, const char *dir)
+{
+    g_fd = open(dev, O_RDONLY);
+
+    if (g_fd < 0)
+    {
+        fprintf(stderr, "nao foi possivel abrir %s: %s\n", dev, strerror(errno));
+        return 1;
+    }
+
+    if (!reclog_open())
+    {
+        fprintf(stderr, "log nao encontrado em %s (particao 0x%02X sem superbloco?)\n", dev,
+                (unsigned)RECLOG_PART_TYPE);
+        return 1;
+    }
+
+    RecLogStats st;
+    reclog_get_stats(&st);
+    printf("# %lu blocos na particao, janela %lu..%lu\n", (unsigned long)st.blocks,
+           (unsigned long)st.oldest_seq, (unsigned long)st.next_seq);
+
+    std::map<uint32_t, FILE *> files;   /* (nó << 8) | versão */
+    uint64_t records = 0;
+    uint32_t bad = 0;
+    SensorReading r[RECLOG_PER_BLOCK];
+
+    for (uint32_t seq = st.oldest_seq; seq < st.next_seq; ++seq)
+    {
+        uint8_t count = 0;
+
+        if (!reclog_read_block(seq, r, &count))
+        {
+            bad++;
+            continue;
+        }
+
+        for (uint8_t i = 0; i < count; ++i)
+        {
+            const PayloadSchema *s = payload_schema_by_version(r[i].version);
+
+            if (!s)
+            {
+                bad++;
+                continue;
+            }
+
+            FILE *&f = files[((uint32_t)r[i].source << 8) | r[i].version];
+
+            if (!f)
+            {
+                const std::string path = std::string(dir) + "/no_" +
+                                         std::to_string(r[i].source) + "_v" +
+                                         std::to_string(r[i].version) + ".csv";
+                struct stat sb;
+                const bool exists = stat(path.c_str(), &sb) == 0 && sb.st_size > 0;
+                f = fopen(path.c_str(), "a");
+
+                if (!f)
+                {
+                    fprintf(stderr, "nao foi possivel criar %s\n", path.c_str());
+                    return 1;
+                }
+
+                if (!exists)
+                {
+                    fprintf(f, "bloco,checksum");
+
+                    for (uint8_t j = 0; j < s->n_fields; ++j)
+                    {
+                        fprintf(f, ",%s (%s)", s->fields[j].label, s->fields[j].unit);
+                    }
+
+                    fputc('\n', f);
+                }
+            }
+
+            fprintf(f, "%lu,%u", (unsigned long)seq, (unsigned)r[i].checksum);
+
+            for (uint8_t j = 0; j < s->n_fields; ++j)
+            {
+                char v[FMT_FIXED_MAX + 1];
+
+                if (payload_schema_field_error(&r[i], j))
+                {
+                    fputs(",ERRO", f);
+                    continue;
+                }
+
+                *payload_schema_render(&s->fields[j], r[i].value[j], s->fields[j].log_decimals,
+                                       v) = '\0';
+                fprintf(f, ",%s", v);
+            }
+
+            fputc('\n', f);
+            records++;
+        }
+    }
+
+    for (const auto &kv : files)
+    {
+        fclose(kv.second);
+    }
+
+    printf("# %llu leituras extraidas para %s, %u bloco(s)/leitura(s) invalido(s)\n",
+           (unsigned long long)records, dir, (unsigned)bad);
+    close(g_fd);
+    return bad ? 2 : 0;
+}
+
+static int cmd_bench(int argc, char **argv)
+{
+    const char *img = "reclog_bench.img";
+    uint32_t part_mb = 64;
+    double laps = 1.5;
+    double write_us = 1500.0;
+    double read_us = 400.0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:m:n:sw:r:v")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f': img = optarg; break;
+        case 'm': part_mb = (uint32_t)strtoul(optarg, nullptr, 10); break;
+        case 'n': laps = atof(optarg); break;
+        case 's': g_sync = true; break;
+        case 'w': write_us = atof(optarg); break;
+        case 'r': read_us = atof(optarg); break;
+        case 'v': g_verbose = true; break;
+        default:
+            fprintf(stderr, "uso: reclog bench [-f imagem] [-m MB] [-n voltas] [-s] [-w us] "
+                            "[-r us] [-v]\n");
+            return 2;
+        }
+    }
+
+    const uint32_t raw_sectors = part_mb * 2048u;
+    g_fd = open(img, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (g_fd < 0 || raw_sectors < 64 ||
+        ftruncate(g_fd, (off_t)(IMG_FAT_START + IMG_FAT_SECTORS + raw_sectors) *
+                            RECLOG_SECTOR) != 0 ||
+        !write_mbr(raw_sectors) || !reclog_open())
+    {
+        fprintf(stderr, "nao foi possivel preparar %s\n", img);
+        return 1;
+    }
+
+    RecLogStats st;
+    reclog_get_stats(&st);
+    const uint32_t n = st.blocks;
+    const uint32_t total = (uint32_t)(laps * n);
+    const uint32_t marks[] = { 0, 1, n / 3u, n - 1u, n, n + n / 2u, total };
+    const char *labels[] = { "vazio", "1 bloco", "1/3 da volta", "volta - 1", "volta completa",
+                             "1,5 volta", "fim" };
+
+    printf("# particao de %u MiB: %lu blocos de %u leituras (%u B/leitura), %s\n",
+           (unsigned)part_mb, (unsigned long)n, (unsigned)RECLOG_PER_BLOCK,
+           (unsigned)RECLOG_REC_LEN, g_sync ? "fdatasync por setor" : "sem fdatasync");
+    printf("# latencia assumida no cartao: gravacao %.0f us, leitura %.0f us por setor\n",
+           write_us, read_us);
+    printf("# recuperacao da cabeca          binaria                    linear\n");
+    printf("  %-22s %10s %8s %9s %11s %10s %9s %11s\n", "ponto", "cabeca", "setores", "host us",
+           "cartao ms", "setores", "host us", "cartao ms");
+
+    SensorReading r;
+    uint64_t k = 0;
+    int64_t append_us = 0;
+    uint64_t append_writes = 0;
+    bool ok = true;
+
+    for (size_t m = 0; m < sizeof(marks) / sizeof(marks[0]); ++m)
+    {
+        if (marks[m] > total || (m && marks[m] <= marks[m - 1]))
+        {
+            continue;
+        }
+
+        const uint64_t target = (uint64_t)marks[m] * RECLOG_PER_BLOCK;
+        const uint64_t w0 = g_writes;
+        const int64_t t0 = esp_timer_get_time();
+
+        for (; k < target; ++k)
+        {
+            synth(k, &r);
+
+            if (!reclog_append(&r))
+            {
+                fprintf(stderr, "reclog_append falhou na leitura %llu\n", (unsigned long long)k);
+                return 1;
+            }
+        }
+
+        append_us += esp_timer_get_time() - t0;
+        append_writes += g_writes - w0;
+        ok = reopen_and_compare(labels[m], marks[m], read_us) && ok;
+    }
+
+    /* Gravação interrompida: o último bloco fica com CRC inválido e vira a cabeça. */
+    reclog_get_stats(&st);
+    const uint32_t last = st.next_seq - 1u;
+    uint8_t junk[RECLOG_SECTOR];
+    memset(junk, 0xA5, sizeof(junk));
+    (void)sdcard_write_raw(st.part_start + 1u + last % n, junk);
+    ok = reopen_and_compare("gravacao interrompida", last, read_us) && ok;
+
+    /* Regrava o bloco perdido e confere toda a janela contra o gerador. */
+    k = (uint64_t)last * RECLOG_PER_BLOCK;
+
+    for (uint32_t i = 0; i < RECLOG_PER_BLOCK; ++i, ++k)
+    {
+        synth(k, &r);
+        (void)reclog_append(&r);
+    }
+
+    reclog_get_stats(&st);
+    uint64_t checked = 0;
+    uint64_t mismatched = 0;
+    SensorReading got[RECLOG_PER_BLOCK];
+    SensorReading want;
+
+    for (uint32_t seq = st.oldest_seq; seq < st.next_seq; ++seq)
+    {
+        uint8_t count = 0;
+
+        if (!reclog_read_block(seq, got, &count) || count != RECLOG_PER_BLOCK)
+        {
+            mismatched++;
+            continue;
+        }
+
+        for (uint8_t i = 0; i < count; ++i, ++checked)
+        {
+            synth((uint64_t)seq * RECLOG_PER_BLOCK + i, &want);
+            mismatched += memcmp(&got[i], &want, sizeof(want)) != 0 ? 1u : 0u;
+        }
+    }
+
+    /* Bloco parcial: um flush com 3 leituras ocupa um bloco próprio. */
+    for (uint32_t i = 0; i < 3; ++i, ++k)
+    {
+        synth(k, &r);
+        (void)reclog_append(&r);
+    }
+
+    const uint32_t partial_seq = st.next_seq;
+    uint8_t partial_count = 0;
+    ok = reopen_and_compare("apos bloco parcial", partial_seq + 1u, read_us) && ok;
+    ok = reclog_read_block(partial_seq, got, &partial_count) && partial_count == 3 && ok;
+
+    printf("# janela conferida: %llu leituras, %llu divergente(s); bloco parcial com %u "
+           "leitura(s)\n",
+           (unsigned long long)checked, (unsigned long long)mismatched, (unsigned)partial_count);
+    ok = ok && mismatched == 0;
+
+    const uint64_t recs = (uint64_t)total * RECLOG_PER_BLOCK;
+    uint64_t fat_reads = 0;
+    uint64_t fat_writes = 0;
+    fat_model(recs, &fat_reads, &fat_writes);
+
+    const double raw_wpr = (double)append_writes / (double)recs;
+    const double raw_card_us = raw_wpr * write_us;
+    const double fat_card_us = ((double)fat_reads * read_us + (double)fat_writes * write_us) /
+                               (double)recs;
+
+    printf("# vazao, %llu leituras\n", (unsigned long long)recs);
+    printf("  %-34s %12s %12s %14s %12s\n", "", "set. grav.", "set. lidos", "cartao us",
+           "leituras/s");
+    printf("  %-34s %12s %12s %14s\n", "", "por leitura", "por leitura", "por leitura");
+    printf("  %-34s %12.3f %12.3f %14.1f %12.0f\n", "log bruto (medido)", raw_wpr, 0.0,
+           raw_card_us, 1e6 / raw_card_us);
+    printf("  %-34s %12.3f %12.3f %14.1f %12.0f\n", "FAT, sdcard_append (MODELO)",
+           (double)fat_writes / (double)recs, (double)fat_reads / (double)recs, fat_card_us,
+           1e6 / fat_card_us);
+    printf("# host: %.0f leituras/s no log bruto (%llu setores em %.2f s)\n",
+           append_us ? (double)recs * 1e6 / (double)append_us : 0.0,
+           (unsigned long long)append_writes, append_us / 1e6);
+
+    reclog_close();
+    close(g_fd);
+    return ok ? 0 : 1;
+}
+
+/****************************** Funções públicas ******************************/
+
+int main(int argc, char **argv)
+{
+    if (argc >= 4 && strcmp(argv[1], "extract") == 0)
+    {
+        return cmd_extract(argv[2], argv[3]);
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0)
+    {
+        return cmd_bench(argc - 1, argv + 1);
+    }
+
+    fprintf(stderr, "uso: reclog extract <imagem|/dev/sdX> <diretorio>\n"
+                    "     reclog bench [-f imagem] [-m MB] [-n voltas] [-s] [-w us] [-r us] "
+                    "[-v]\n");
+    return 2;
+}
@@ -0,0 +1,40 @@
+/**
+ * @file Arduino.h
+ * @brief Substituto mínimo do core Arduino para o teste do registro no SD:
+ *        @c millis() é o relógio simulado do teste.
+ */
+
+#ifndef SD_TEST_ARDUINO_H
+#define SD_TEST_ARDUINO_H
+
+#include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define HIGH   0x1
+#define OUTPUT 0x03
+
+uint32_t millis(void);
+static inline void pinMode(uint8_t, uint8_t) {}
+static inline void digitalWrite(uint8_t, uint8_t) {}
+
+/* O newlib do ESP32 tem strlcpy; a glibc, só a partir da 2.38. */
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+static inline size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    const size_t n = strlen(src);
+
+    if (size)
+    {
+        const size_t k = (n < size) ? n : size - 1u;
+        memcpy(dst, src, k);
+        dst[k] = '\0';
+    }
+
+    return n;
+}
+#endif
+
+#endif /* SD_TEST_ARDUINO_H */
@@ -0,0 +1,58 @@
+/**
+ * @file SD.h
+ * @brief Substituto de @c SD.h: sistema de arquivos em memória sobre um cartão
+ *        simulado que pode sumir no meio de uma gravação. Os métodos são definidos
+ *        no teste.
+ */
+
+#ifndef SD_TEST_SD_H
+#define SD_TEST_SD_H
+
+#include <Arduino.h>
+#include <SPI.h>
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+class File
+{
+public:
+    File() : m_id(-1), m_mount(0), m_next(0) {}
+    File(int id, uint32_t mount) : m_id(id), m_mount(mount), m_next(0) {}
+    explicit operator bool() const { return m_id != -1; }
+    size_t write(const uint8_t *buf, size_t len);
+    size_t print(const char *s);
+    void flush(void);
+    void close(void);
+    const char *name(void) const;
+    bool isDirectory(void) const;
+    File openNextFile(void);
+    size_t size(void) const;
+    int read(uint8_t *buf, size_t len);
+
+private:
+    int m_id;          /* índice do arquivo; -2 = diretório raiz */
+    uint32_t m_mount;  /* montagem em que foi aberto             */
+    int m_next;        /* próxima entrada de openNextFile()      */
+};
+
+class FS
+{
+public:
+    File open(const char *path, const char *mode = FILE_READ);
+    bool exists(const char *path);
+};
+
+class SDFS : public FS
+{
+public:
+    bool begin(uint8_t ss, SPIClass &spi, uint32_t frequency);
+    void end(void);
+    bool readRAW(uint8_t *buf, uint32_t sector);
+    bool writeRAW(uint8_t *buf, uint32_t sector);
+};
+
+extern SDFS SD;
+
+#endif /* SD_TEST_SD_H */
@@ -0,0 +1,15 @@
+/**
+ * @file SPI.h
+ * @brief Substituto do barramento SPI para o teste do registro no SD (sem efeito).
+ */
+
+#ifndef SD_TEST_SPI_H
+#define SD_TEST_SPI_H
+
+class SPIClass
+{
+};
+
+extern SPIClass SPI;
+
+#endif /* SD_TEST_SPI_H */
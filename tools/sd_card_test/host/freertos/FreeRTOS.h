@@ -0,0 +1,19 @@
+/**
+ * @file FreeRTOS.h
+ * @brief Substituto dos tipos básicos do FreeRTOS para o teste do registro no SD.
+ */
+
+#ifndef SD_TEST_FREERTOS_H
+#define SD_TEST_FREERTOS_H
+
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE            0
+#define pdTRUE             1
+#define portMAX_DELAY      0xFFFFFFFFu
+#define pdMS_TO_TICKS(ms)  ((TickType_t)(ms))
+
+#endif /* SD_TEST_FREERTOS_H */
@@ -0,0 +1,21 @@
+/**
+ * @file semphr.h
+ * @brief Substituto dos mutexes do FreeRTOS: o teste é de uma thread e só confere
+ *        o aninhamento (tomar um mutex não recursivo já tomado seria um deadlock).
+ */
+
+#ifndef SD_TEST_SEMPHR_H
+#define SD_TEST_SEMPHR_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct SimMutex *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t m, TickType_t wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t m);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t m, TickType_t wait);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t m);
+
+#endif /* SD_TEST_SEMPHR_H */
@@ -0,0 +1,21 @@
+/**
+ * @file task.h
+ * @brief Substituto das tarefas do FreeRTOS: a tarefa criada não roda sozinha; o
+ *        teste executa uma iteração dela por vez (ver @c writer_step() no teste).
+ */
+
+#ifndef SD_TEST_TASK_H
+#define SD_TEST_TASK_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                       unsigned prio, TaskHandle_t *out);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait);
+void xTaskNotifyGive(TaskHandle_t task);
+
+#endif /* SD_TEST_TASK_H */
@@ -0,0 +1,1085 @@
+/**
+ * @file sd_card_test.cpp
+ * @brief Teste de host do anel em RAM do registro no SD (@c lib/sd_card) com um
+ *        cartão simulado que some no meio da gravação.
+ *
+ * Uso:
+ *   sd_card_test [-n passos da rodada aleatória] [-s semente] [-v]
+ *
+ * O módulo real é compilado sem alterações. O cartão simulado guarda cada arquivo
+ * em memória, separando o que já passou por flush do que ainda não passou; ao ser
+ * retirado (inclusive no meio de um @c write()), tudo o que não teve flush se
+ * perde. A tarefa de gravação não roda sozinha: @c writer_step() executa uma
+ * iteração dela, e @c ulTaskNotifyTake() devolve o controle ao teste no início da
+ * iteração seguinte.
+ *
+ * Cobre:
+ *  - linhas retidas antes de @c sdcard_begin(), sem nenhum acesso ao cartão;
+ *  - @c sdcard_write() nunca toca o cartão e aceita/recusa exatamente quando a
+ *    linha (com a marca de lacuna pendente) cabe no anel;
+ *  - contadores @c held_bytes, @c dropped_bytes e @c dropped_lines contra um
+ *    modelo independente, e @c held_bytes == write_pos - durable_pos;
+ *  - retirada no meio da gravação, anel cheio, remontagem só a cada 5 s e
+ *    esvaziamento em ordem, com a marca "(N bytes de log perdidos)" no ponto exato;
+ *  - bytes gravados sem flush regravados no arquivo da remontagem, inclusive
+ *    quando o cartão some entre a gravação e o flush;
+ *  - gravação lenta contada em @c stalls, rotação à meia-noite;
+ *  - travas: cartão só com o barramento e a trava de E/S, nunca com a trava do anel;
+ *    serviço de hora só com @c sdcard_lock(), nunca com o barramento;
+ *  - tempo de posse do barramento por dispositivo, num custo simulado de cada
+ *    operação no cartão (comando + bytes): na rotação, na remontagem e no
+ *    esvaziamento em blocos nenhuma posse do SD passa de um bloco de
+ *    @c SPI_BUS_SD_CHUNK bytes, que cabe em @c SPI_BUS_RADIO_BUDGET_US (a espera
+ *    máxima do rádio);
+ *  - rodada aleatória: o conteúdo dos arquivos, sem os cabeçalhos, é exatamente o
+ *    fluxo de linhas aceitas, em ordem, sem perdas nem repetições.
+ *
+ * Sai com código 1 se algum caso falhar.
+ */
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <SD.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include "sd_card.h"
+#include "spi_bus.h"
+#include "time_service.h"
+
+/* Espelham as constantes privadas de sd_card.cpp. */
+#define RING_LEN      16384
+#define WRITER_MS     250
+#define REMOUNT_MS    5000
+#define STALL_MS      500
+
+/* Custo simulado de uma operação no cartão com o barramento tomado: comando e
+ * espera de ocupado, mais os bytes a ~2,5 MB/s. O atraso do cartão lento
+ * (write_ms) anda no relógio de ms e não entra aqui. */
+#define SD_CMD_US     1500
+#define SD_BYTE_NS    400
+#define SD_CHUNK_US   (SD_CMD_US + (SPI_BUS_SD_CHUNK * SD_BYTE_NS) / 1000)
+
+#if SD_CHUNK_US > SPI_BUS_RADIO_BUDGET_US
+#error "um bloco do SD nao cabe na espera maxima do radio"
+#endif
+
+#define MAX_FILES     2048
+#define MAX_MUTEXES   4
+#define HEADER_PREFIX "=== LOG START "
+
+/**
+ * @brief Arquivo do cartão simulado.
+ */
+typedef struct
+{
+    bool used;
+    char name[40];
+    char *data;
+    size_t len;       /* bytes que passaram por flush         */
+    size_t pending;   /* bytes gravados depois do último flush */
+    size_t cap;
+} SimFile;
+
+/**
+ * @brief Cartão simulado.
+ */
+typedef struct
+{
+    bool present;            /* fisicamente no slot                         */
+    bool mounted;            /* SD.begin() aceito desde a inserção          */
+    uint32_t mount_gen;      /* invalida arquivos abertos em montagem antiga */
+    long budget;             /* bytes até sumir no meio do write (<0: nunca) */
+    uint32_t write_ms;       /* atraso de cada write()                      */
+    uint32_t ops;            /* acessos ao cartão                           */
+    uint32_t begins;
+    bool last_begin_ok;
+    uint32_t last_begin_ms;
+    uint32_t fast_retries;   /* SD.begin() menos de 5 s após uma falha      */
+    uint32_t truncations;    /* FILE_WRITE sobre arquivo não vazio          */
+    SimFile files[MAX_FILES];
+    uint32_t n_files;
+} SimCard;
+
+struct SimMutex
+{
+    bool recursive;
+    int depth;
+};
+
+static bool g_verbose = false;
+static uint32_t g_now_ms = 1000;
+static time_t g_t0;
+static uint32_t g_rng = 0x2545F491u;
+static SimCard g_card;
+static SimMutex g_mutexes[MAX_MUTEXES];
+static uint8_t g_n_mutexes;
+static int g_bus_depth;
+static uint64_t g_bus_ns;                      /* custo acumulado no barramento */
+static uint64_t g_hold_t0;
+static uint32_t g_hold_bytes;
+static uint32_t g_hold_max_us[SPI_DEV_N];
+static uint32_t g_hold_max_bytes;
+static uint32_t g_holds;
+static uint32_t g_bus_worst_us;
+static struct tm g_tm;
+static int g_gen_ymd = -1;
+static uint32_t g_day_gen;
+
+static TaskFunction_t g_task_fn;
+static void *g_task_arg;
+static bool g_task_entry;
+static bool g_notified;
+static jmp_buf g_task_jmp;
+
+/* Modelo: fluxo esperado nos arquivos e contadores de descarte. */
+static char *g_model;
+static size_t g_model_len;
+static size_t g_model_cap;
+static uint32_t g_gap;
+static uint32_t g_drop_bytes;
+static uint32_t g_drop_lines;
+static uint32_t g_seq;
+
+static uint32_t g_checks;
+static uint32_t g_failures;
+
+#define CHECK(cond, ...)                                                     \
+    do                                                                       \
+    {                                                                        \
+        g_checks++;                                                          \
+        if (!(cond))                                                         \
+        {                                                                    \
+            g_failures++;                                                    \
+            fprintf(stderr, "FALHA %s:%d: ", __FILE__, __LINE__);            \
+            fprintf(stderr, __VA_ARGS__);                                    \
+            fputc('\n', stderr);                                             \
+        }                                                                    \
+    } while (0)
+
+/****************************** Cartão simulado *******************************/
+
+static int held_depth(bool recursive)
+{
+    int depth = 0;
+
+    for (uint8_t i = 0; i < g_n_mutexes; ++i)
+    {
+        depth += (g_mutexes[i].recursive == recursive) ? g_mutexes[i].depth : 0;
+    }
+
+    return depth;
+}
+
+/**
+ * @brief Conta um acesso ao cartão e confere as travas.
+ * @return true se o cartão está no slot e montado.
+ */
+static bool card_access(void)
+{
+    g_card.ops++;
+    g_bus_ns += SD_CMD_US * 1000ull;
+    CHECK(g_bus_depth == 1, "acesso ao cartao sem o barramento");
+    CHECK(held_depth(false) > 0, "acesso ao cartao sem a trava de E/S");
+    CHECK(held_depth(true) == 0, "acesso ao cartao com a trava do anel");
+    return g_card.present && g_card.mounted;
+}
+
+static void file_grow(SimFile *f, size_t extra)
+{
+    if (f->len + f->pending + extra > f->cap)
+    {
+        f->cap = (f->len + f->pending + extra) * 2u + 4096u;
+        f->data = (char *)realloc(f->data, f->cap);
+    }
+}
+
+/**
+ * @brief Retira o cartão: o que não passou por flush não chegou a ele.
+ */
+static void card_unplug(void)
+{
+    if (g_verbose)
+    {
+        fprintf(stderr, "[%lu] cartao retirado\n", (unsigned long)g_now_ms);
+    }
+
+    g_card.present = false;
+    g_card.mounted = false;
+
+    for (uint32_t i = 0; i < g_card.n_files; ++i)
+    {
+        g_card.files[i].pending = 0;
+    }
+}
+
+static void card_plug(void)
+{
+    if (g_verbose && !g_card.present)
+    {
+        fprintf(stderr, "[%lu] cartao inserido\n", (unsigned long)g_now_ms);
+    }
+
+    g_card.present = true;
+    g_card.budget = -1;
+}
+
+static SimFile *find_file(const char *path)
+{
+    for (uint32_t i = 0; i < g_card.n_files; ++i)
+    {
+        if (strcmp(g_card.files[i].name, path) == 0)
+        {
+            return &g_card.files[i];
+        }
+    }
+
+    return nullptr;
+}
+
+/****************************** Substitutos ***********************************/
+
+SPIClass SPI;
+SDFS SD;
+
+uint32_t millis(void)
+{
+    return g_now_ms;
+}
+
+size_t File::write(const uint8_t *buf, size_t len)
+{
+    if (m_id < 0 || !card_access() || m_mount != g_card.mount_gen)
+    {
+        return 0;
+    }
+
+    size_t n = len;
+
+    if (g_card.budget >= 0 && (long)n > g_card.budget)
+    {
+        n = (size_t)g_card.budget;
+    }
+
+    SimFile *f = &g_card.files[m_id];
+    file_grow(f, n);
+    memcpy(f->data + f->len + f->pending, buf, n);
+    f->pending += n;
+    g_bus_ns += (uint64_t)n * SD_BYTE_NS;
+    g_hold_bytes += (uint32_t)n;
+    g_now_ms += g_card.write_ms;
+
+    if (g_card.budget >= 0)
+    {
+        g_card.budget -= (long)n;
+
+        if (g_card.budget == 0)
+        {
+            card_unplug();
+        }
+    }
+
+    return n;
+}
+
+size_t File::print(const char *s)
+{
+    return write((const uint8_t *)s, strlen(s));
+}
+
+void File::flush(void)
+{
+    if (m_id >= 0 && card_access() && m_mount == g_card.mount_gen)
+    {
+        g_card.files[m_id].len += g_card.files[m_id].pending;
+        g_card.files[m_id].pending = 0;
+    }
+}
+
+void File::close(void)
+{
+    if (m_id == -1)
+    {
+        return;
+    }
+
+    if (m_id >= 0 && card_access() && m_mount == g_card.mount_gen)
+    {
+        g_card.files[m_id].len += g_card.files[m_id].pending;
+        g_card.files[m_id].pending = 0;
+    }
+
+    m_id = -1;
+}
+
+const char *File::name(void) const
+{
+    return (m_id >= 0) ? g_card.files[m_id].name + 1 : "/";
+}
+
+bool File::isDirectory(void) const
+{
+    return m_id == -2;
+}
+
+File File::openNextFile(void)
+{
+    if (m_id != -2 || !card_access() || m_mount != g_card.mount_gen ||
+        (uint32_t)m_next >= g_card.n_files)
+    {
+        return File();
+    }
+
+    return File(m_next++, m_mount);
+}
+
+size_t File::size(void) const
+{
+    return (m_id >= 0) ? g_card.files[m_id].len : 0;
+}
+
+int File::read(uint8_t *buf, size_t len)
+{
+    (void)buf;
+    (void)len;
+    return -1;
+}
+
+File FS::open(const char *path, const char *mode)
+{
+    if (!card_access())
+    {
+        return File();
+    }
+
+    if (strcmp(path, "/") == 0)
+    {
+        return File(-2, g_card.mount_gen);
+    }
+
+    SimFile *f = find_file(path);
+
+    if (!f && strcmp(mode, FILE_READ) != 0)
+    {
+        CHECK(g_card.n_files < MAX_FILES, "arquivos demais no cartao simulado");
+
+        if (g_card.n_files >= MAX_FILES)
+        {
+            return File();
+        }
+
+        f = &g_card.files[g_card.n_files++];
+        f->used = true;
+        snprintf(f->name, sizeof(f->name), "%s", path);
+    }
+
+    if (!f)
+    {
+        return File();
+    }
+
+    if (strcmp(mode, FILE_WRITE) == 0)
+    {
+        g_card.truncations += (f->len + f->pending) ? 1u : 0u;
+        f->len = 0;
+        f->pending = 0;
+    }
+
+    return File((int)(f - g_card.files), g_card.mount_gen);
+}
+
+bool FS::exists(const char *path)
+{
+    return card_access() && find_file(path) != nullptr;
+}
+
+bool SDFS::begin(uint8_t ss, SPIClass &spi, uint32_t frequency)
+{
+    (void)ss;
+    (void)spi;
+    (void)frequency;
+    card_access();
+
+    if (g_card.begins && !g_card.last_begin_ok && g_now_ms - g_card.last_begin_ms < REMOUNT_MS)
+    {
+        g_card.fast_retries++;
+    }
+
+    g_card.begins++;
+    g_card.last_begin_ms = g_now_ms;
+    g_card.mounted = g_card.present;
+    g_card.last_begin_ok = g_card.mounted;
+    g_card.mount_gen += g_card.mounted ? 1u : 0u;
+    return g_card.mounted;
+}
+
+void SDFS::end(void)
+{
+    card_access();
+    g_card.mounted = false;
+
+    for (uint32_t i = 0; i < g_card.n_files; ++i)
+    {
+        g_card.files[i].pending = 0;
+    }
+}
+
+bool SDFS::readRAW(uint8_t *, uint32_t)
+{
+    return false;
+}
+
+bool SDFS::writeRAW(uint8_t *, uint32_t)
+{
+    return false;
+}
+
+void spi_bus_acquire(SpiDevice dev)
+{
+    CHECK(dev == SPI_DEV_SD && g_bus_depth == 0, "barramento tomado de novo (profundidade %d)",
+          g_bus_depth);
+    g_bus_depth++;
+    g_hold_t0 = g_bus_ns;
+    g_hold_bytes = 0;
+}
+
+void spi_bus_release(SpiDevice dev)
+{
+    CHECK(dev == SPI_DEV_SD && g_bus_depth == 1, "barramento liberado sem ser tomado");
+    g_bus_depth--;
+
+    const uint32_t us = (uint32_t)((g_bus_ns - g_hold_t0) / 1000u);
+
+    if (dev < SPI_DEV_N && us > g_hold_max_us[dev])
+    {
+        g_hold_max_us[dev] = us;
+    }
+
+    if (g_hold_bytes > g_hold_max_bytes)
+    {
+        g_hold_max_bytes = g_hold_bytes;
+    }
+
+    g_holds++;
+}
+
+/* O serviço de hora só pode ser lido sob sdcard_lock() e sem o barramento. */
+const struct tm *timesvc_now_tm(void)
+{
+    CHECK(held_depth(true) > 0, "timesvc_now_tm() fora de sdcard_lock()");
+    CHECK(g_bus_depth == 0, "timesvc_now_tm() com o barramento tomado");
+    const time_t t = g_t0 + (time_t)(g_now_ms / 1000u);
+    gmtime_r(&t, &g_tm);
+    return &g_tm;
+}
+
+int timesvc_ymd(void)
+{
+    CHECK(held_depth(true) > 0, "timesvc_ymd() fora de sdcard_lock()");
+    CHECK(g_bus_depth == 0, "timesvc_ymd() com o barramento tomado");
+    const time_t t = g_t0 + (time_t)(g_now_ms / 1000u);
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    return (tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday;
+}
+
+uint32_t timesvc_day_generation(void)
+{
+    CHECK(held_depth(true) > 0, "timesvc_day_generation() fora de sdcard_lock()");
+    const int ymd = timesvc_ymd();
+
+    if (ymd != g_gen_ymd)
+    {
+        g_gen_ymd = ymd;
+        g_day_gen++;
+    }
+
+    return g_day_gen;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    g_mutexes[g_n_mutexes].recursive = false;
+    return &g_mutexes[g_n_mutexes++];
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void)
+{
+    g_mutexes[g_n_mutexes].recursive = true;
+    return &g_mutexes[g_n_mutexes++];
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t m, TickType_t)
+{
+    CHECK(!m->recursive && m->depth == 0, "mutex nao recursivo tomado de novo (deadlock)");
+    m->depth++;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t m)
+{
+    CHECK(!m->recursive && m->depth == 1, "mutex liberado sem ser tomado");
+    m->depth--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t m, TickType_t)
+{
+    CHECK(m->recursive, "mutex nao recursivo tomado como recursivo");
+    m->depth++;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t m)
+{
+    CHECK(m->recursive && m->depth > 0, "mutex recursivo liberado sem ser tomado");
+    m->depth--;
+    return pdTRUE;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *, uint32_t, void *arg, unsigned,
+                       TaskHandle_t *out)
+{
+    CHECK(!g_task_fn, "tarefa de gravacao criada duas vezes");
+    g_task_fn = fn;
+    g_task_arg = arg;
+
+    if (out)
+    {
+        *out = (TaskHandle_t)&g_task_fn;
+    }
+
+    return pdTRUE;
+}
+
+/* Na entrada de writer_step() devolve a notificação; na iteração seguinte, volta ao teste. */
+uint32_t ulTaskNotifyTake(BaseType_t, TickType_t)
+{
+    if (!g_task_entry)
+    {
+        longjmp(g_task_jmp, 1);
+    }
+
+    g_task_entry = false;
+    const uint32_t n = g_notified ? 1u : 0u;
+    g_notified = false;
+    return n;
+}
+
+void xTaskNotifyGive(TaskHandle_t)
+{
+    g_notified = true;
+}
+
+/****************************** Funções privadas ******************************/
+
+/**
+ * @brief xorshift32: reproduzível pela semente, sem depender da libc.
+ */
+static uint32_t rnd(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+/**
+ * @brief Executa uma iteração da tarefa de gravação.
+ */
+static void writer_step(void)
+{
+    if (!g_task_fn)
+    {
+        return;
+    }
+
+    g_task_entry = true;
+
+    if (setjmp(g_task_jmp) == 0)
+    {
+        g_task_fn(g_task_arg);
+    }
+
+    CHECK(g_bus_depth == 0 && held_depth(true) == 0 && held_depth(false) == 0,
+          "iteracao da tarefa terminou com travas tomadas (bus %d, anel %d, E/S %d)",
+          g_bus_depth, held_depth(true), held_depth(false));
+}
+
+/**
+ * @brief Avança o relógio em passos do período da tarefa de gravação.
+ */
+static void advance(uint32_t ms)
+{
+    for (uint32_t t = 0; t < ms; t += WRITER_MS)
+    {
+        g_now_ms += WRITER_MS;
+        sdcard_tick_rotate();
+        writer_step();
+    }
+}
+
+static void model_append(const char *buf, size_t len)
+{
+    if (g_model_len + len > g_model_cap)
+    {
+        g_model_cap = (g_model_len + len) * 2u + 65536u;
+        g_model = (char *)realloc(g_model, g_model_cap);
+    }
+
+    memcpy(g_model + g_model_len, buf, len);
+    g_model_len += len;
+}
+
+static SdStats stats(void)
+{
+    SdStats st;
+    sdcard_get_stats(&st);
+    return st;
+}
+
+/**
+ * @brief Escreve uma linha numerada de tamanho sorteado e confere a decisão e os
+ *        contadores contra o modelo.
+ * @return true se a linha foi aceita.
+ */
+static bool write_line(void)
+{
+    char line[256];
+    const size_t len = 24u + rnd() % 200u;
+    size_t n = (size_t)snprintf(line, sizeof(line), "L%08lu ", (unsigned long)g_seq++);
+
+    while (n < len - 1u)
+    {
+        line[n] = (char)('a' + (n + g_seq) % 26u);
+        n++;
+    }
+
+    line[len - 1u] = '\n';
+
+    char gap[64];
+    const size_t gap_len = g_gap ? (size_t)snprintf(gap, sizeof(gap),
+                                                    "(%lu bytes de log perdidos)\n",
+                                                    (unsigned long)g_gap)
+                                 : 0u;
+    const SdStats before = stats();
+    const bool want = gap_len + len <= RING_LEN - before.held_bytes;
+    const uint32_t ops = g_card.ops;
+    const bool got = sdcard_write(line, len);
+
+    CHECK(got == want, "linha %lu de %lu B com %lu B retidos: %s", (unsigned long)(g_seq - 1),
+          (unsigned long)len, (unsigned long)before.held_bytes, got ? "aceita" : "recusada");
+    CHECK(g_card.ops == ops, "sdcard_write() acessou o cartao");
+
+    if (got)
+    {
+        model_append(gap, gap_len);
+        model_append(line, len);
+        g_gap = 0;
+    }
+    else
+    {
+        g_gap += (uint32_t)len;
+        g_drop_bytes += (uint32_t)len;
+        g_drop_lines++;
+    }
+
+    const SdStats after = stats();
+    const uint32_t grew = got ? (uint32_t)(gap_len + len) : 0u;
+    CHECK(after.held_bytes == before.held_bytes + grew, "held_bytes %lu, esperado %lu",
+          (unsigned long)after.held_bytes, (unsigned long)(before.held_bytes + grew));
+    CHECK(after.dropped_bytes == g_drop_bytes && after.dropped_lines == g_drop_lines,
+          "descartes %lu B/%lu linhas, esperado %lu B/%lu linhas",
+          (unsigned long)after.dropped_bytes, (unsigned long)after.dropped_lines,
+          (unsigned long)g_drop_bytes, (unsigned long)g_drop_lines);
+    CHECK(sdcard_write_pos() == (uint32_t)g_model_len, "write_pos %lu, aceitos %lu",
+          (unsigned long)sdcard_write_pos(), (unsigned long)g_model_len);
+    CHECK(after.ring_peak <= RING_LEN, "pico do anel %lu", (unsigned long)after.ring_peak);
+    return got;
+}
+
+/**
+ * @brief Confere os contadores de ocupação contra as posições acumuladas.
+ */
+static void check_held(const char *what)
+{
+    const SdStats st = stats();
+    const uint32_t wpos = sdcard_write_pos();
+    const uint32_t dpos = sdcard_durable_pos();
+
+    CHECK(st.held_bytes == wpos - dpos, "%s: held_bytes %lu != %lu - %lu", what,
+          (unsigned long)st.held_bytes, (unsigned long)wpos, (unsigned long)dpos);
+    CHECK(st.held_bytes <= RING_LEN, "%s: %lu B retidos", what, (unsigned long)st.held_bytes);
+}
+
+/**
+ * @brief Compara os arquivos do cartão, na ordem de criação e sem os cabeçalhos,
+ *        com o fluxo do modelo.
+ */
+static void check_disk(const char *what)
+{
+    size_t off = 0;
+    bool same = true;
+
+    for (uint32_t i = 0; i < g_card.n_files && same; ++i)
+    {
+        const SimFile *f = &g_card.files[i];
+        const char *p = f->data;
+        size_t len = f->len;
+
+        if (len == 0)
+        {
+            continue;
+        }
+
+        CHECK(strncmp(p, HEADER_PREFIX, strlen(HEADER_PREFIX)) == 0,
+              "%s: %s sem cabecalho", what, f->name);
+        const char *nl = (const char *)memchr(p, '\n', len);
+
+        if (nl)
+        {
+            len -= (size_t)(nl + 1 - p);
+            p = nl + 1;
+        }
+
+        same = off + len <= g_model_len && memcmp(p, g_model + off, len) == 0;
+
+        if (!same)
+        {
+            size_t k = 0;
+
+            while (k < len && off + k < g_model_len && p[k] == g_model[off + k])
+            {
+                k++;
+            }
+
+            CHECK(false, "%s: %s diverge do esperado no byte %lu: '%.40s' x '%.40s'", what,
+                  f->name, (unsigned long)(off + k), p + k,
+                  (off + k < g_model_len) ? g_model + off + k : "(fim)");
+        }
+
+        off += len;
+    }
+
+    CHECK(!same || off == g_model_len, "%s: %lu de %lu bytes no cartao", what,
+          (unsigned long)off, (unsigned long)g_model_len);
+    CHECK(g_card.truncations == 0, "%s: %lu arquivos de log truncados", what,
+          (unsigned long)g_card.truncations);
+}
+
+/**
+ * @brief Confere a maior posse do barramento pelo SD desde a última chamada: no
+ *        máximo uma operação com um bloco, dentro da espera máxima do rádio.
+ */
+static void check_bus(const char *what)
+{
+    const uint32_t us = g_hold_max_us[SPI_DEV_SD];
+
+    CHECK(us <= SD_CHUNK_US && us <= SPI_BUS_RADIO_BUDGET_US,
+          "%s: SD tomou o barramento por %lu us (bloco: %u us, radio: %u us)", what,
+          (unsigned long)us, SD_CHUNK_US, SPI_BUS_RADIO_BUDGET_US);
+    CHECK(g_hold_max_bytes <= SPI_BUS_SD_CHUNK, "%s: %lu B numa so posse do barramento", what,
+          (unsigned long)g_hold_max_bytes);
+
+    if (g_verbose)
+    {
+        fprintf(stderr, "%s: %lu posses, maior %lu us / %lu B\n", what, (unsigned long)g_holds,
+                (unsigned long)us, (unsigned long)g_hold_max_bytes);
+    }
+
+    g_bus_worst_us = (us > g_bus_worst_us) ? us : g_bus_worst_us;
+    g_hold_max_us[SPI_DEV_SD] = 0;
+    g_hold_max_bytes = 0;
+    g_holds = 0;
+}
+
+/**
+ * @brief Pede flush, roda a tarefa até o anel esvaziar e confere o cartão.
+ */
+static void drain_all(const char *what)
+{
+    sdcard_flush();
+
+    for (uint32_t waited = 0; stats().held_bytes > 0 && waited < 60000; waited += WRITER_MS)
+    {
+        sdcard_flush();
+        advance(WRITER_MS);
+    }
+
+    const SdStats st = stats();
+    CHECK(st.card_ok && st.held_bytes == 0, "%s: cartao %d, %lu B retidos", what, st.card_ok,
+          (unsigned long)st.held_bytes);
+    CHECK(sdcard_durable_pos() == sdcard_write_pos(), "%s: durable_pos %lu, write_pos %lu",
+          what, (unsigned long)sdcard_durable_pos(), (unsigned long)sdcard_write_pos());
+    check_disk(what);
+    check_bus(what);
+}
+
+static void test_boot_hold(void)
+{
+    sdcard_init();
+
+    for (int i = 0; i < 40; ++i)
+    {
+        CHECK(write_line(), "linha %d recusada antes do sdcard_begin()", i);
+    }
+
+    CHECK(g_card.ops == 0, "%lu acessos ao cartao antes do sdcard_begin()",
+          (unsigned long)g_card.ops);
+    CHECK(stats().held_bytes == g_model_len, "linhas retidas %lu de %lu",
+          (unsigned long)stats().held_bytes, (unsigned long)g_model_len);
+
+    sdcard_begin();
+    CHECK(stats().card_ok, "cartao presente nao montado");
+    drain_all("linhas retidas antes do sdcard_begin()");
+}
+
+/**
+ * @brief Cartão retirado no meio de uma gravação, anel cheio e remontagem.
+ */
+static void test_unplug_mid_run(void)
+{
+    const SdStats before = stats();
+    g_card.budget = 3000 + rnd() % 1000;
+
+    for (int i = 0; i < 400; ++i)
+    {
+        (void)write_line();
+
+        if (i % 4 == 3)
+        {
+            advance(WRITER_MS);
+        }
+
+        check_held("retirada");
+    }
+
+    SdStats st = stats();
+    CHECK(!g_card.present, "cartao nao retirado pelo limite de bytes");
+    CHECK(!st.card_ok, "cartao retirado ainda marcado ok");
+    CHECK(st.write_errors == before.write_errors + 1, "write_errors %lu",
+          (unsigned long)st.write_errors);
+    CHECK(g_drop_lines > before.dropped_lines, "anel nunca encheu sem cartao");
+    CHECK(st.ring_peak > RING_LEN - 256u, "pico do anel %lu", (unsigned long)st.ring_peak);
+
+    const uint32_t begins = g_card.begins;
+    advance(3 * REMOUNT_MS);
+    CHECK(g_card.begins - begins >= 2 && g_card.begins - begins <= 4,
+          "%lu tentativas de montagem em 15 s", (unsigned long)(g_card.begins - begins));
+    CHECK(stats().remounts == before.remounts, "remontagem sem cartao");
+
+    card_plug();
+    const uint32_t t_plug = g_now_ms;
+    const uint32_t holds = g_holds;
+
+    while (!stats().card_ok && g_now_ms - t_plug <= 2 * REMOUNT_MS)
+    {
+        advance(WRITER_MS);
+    }
+
+    st = stats();
+    CHECK(st.card_ok && st.remounts == before.remounts + 1, "sem remontagem apos reinsercao");
+    CHECK(g_now_ms - t_plug <= REMOUNT_MS + WRITER_MS, "remontagem %lu ms apos a reinsercao",
+          (unsigned long)(g_now_ms - t_plug));
+    /* O anel cheio sai em blocos, cada um numa posse própria do barramento. */
+    CHECK(g_holds - holds >= RING_LEN / SPI_BUS_SD_CHUNK, "anel de %u B gravado em %lu posses",
+          RING_LEN, (unsigned long)(g_holds - holds));
+
+    for (int i = 0; i < 5; ++i)
+    {
+        (void)write_line();
+    }
+
+    CHECK(g_gap == 0, "marca de lacuna nao emitida");
+    CHECK(memmem(g_model, g_model_len, "bytes de log perdidos", 21) != nullptr,
+          "modelo sem marca de lacuna");
+    drain_all("remontagem apos retirada no meio da gravacao");
+}
+
+/**
+ * @brief Linhas gravadas sem flush quando o cartão some: regravadas após remontar.
+ */
+static void test_unplug_before_flush(void)
+{
+    const SdStats before = stats();
+
+    for (int i = 0; i < 20; ++i)
+    {
+        CHECK(write_line(), "linha %d recusada", i);
+    }
+
+    advance(4 * WRITER_MS);
+    SdStats st = stats();
+    CHECK(st.written_bytes > before.written_bytes, "linhas nao gravadas");
+    CHECK(st.held_bytes > 0, "linhas liberadas do anel antes do flush");
+
+    card_unplug();
+    (void)write_line();
+    advance(WRITER_MS);
+    st = stats();
+    CHECK(!st.card_ok && st.write_errors == before.write_errors + 1,
+          "falha de gravacao nao detectada");
+
+    card_plug();
+    advance(REMOUNT_MS + WRITER_MS);
+    drain_all("linhas sem flush regravadas apos a retirada");
+}
+
+static void test_stall(void)
+{
+    const SdStats before = stats();
+    g_card.write_ms = STALL_MS + 100;
+
+    for (int i = 0; i < 10; ++i)
+    {
+        const uint32_t t0 = g_now_ms;
+        (void)write_line();
+        CHECK(g_now_ms == t0, "sdcard_write() esperou pelo cartao lento");
+    }
+
+    advance(WRITER_MS);
+    CHECK(stats().stalls > before.stalls, "gravacao de %u ms nao contada", STALL_MS + 100);
+    g_card.write_ms = 0;
+    drain_all("cartao lento");
+}
+
+static void test_rotation(void)
+{
+    const uint32_t files = g_card.n_files;
+    const time_t now = g_t0 + (time_t)(g_now_ms / 1000u);
+
+    /* Leva o relógio a 5 s da meia-noite. */
+    g_t0 += 86400 - (now % 86400) - 5;
+
+    for (int i = 0; i < 10; ++i)
+    {
+        (void)write_line();
+        advance(1000);
+    }
+
+    CHECK(g_card.n_files == files + 1, "%lu arquivos novos na virada do dia",
+          (unsigned long)(g_card.n_files - files));
+    CHECK(strstr(g_card.files[g_card.n_files - 1].name, "_000") != nullptr,
+          "arquivo da virada: %s", g_card.files[g_card.n_files - 1].name);
+    drain_all("rotacao a meia-noite");
+}
+
+/**
+ * @brief Rodada aleatória: rajadas de linhas, retiradas (inclusive no meio de
+ *        gravações), gravações lentas e pedidos de flush.
+ */
+static void test_random(uint32_t steps)
+{
+    for (uint32_t i = 0; i < steps; ++i)
+    {
+        if (rnd() % 100 < 60)
+        {
+            for (uint32_t k = 1 + rnd() % 12; k > 0; --k)
+            {
+                (void)write_line();
+            }
+        }
+
+        if (g_card.present && rnd() % 150 == 0)
+        {
+            if (rnd() % 2)
+            {
+                card_unplug();
+            }
+            else
+            {
+                g_card.budget = (long)(rnd() % 6000u);
+            }
+        }
+        else if (!g_card.present && rnd() % 30 == 0)
+        {
+            card_plug();
+        }
+
+        if (rnd() % 40 == 0)
+        {
+            sdcard_flush();
+        }
+
+        g_card.write_ms = (rnd() % 100 == 0) ? STALL_MS + 100 : 0;
+        advance(WRITER_MS);
+        check_held("rodada aleatoria");
+    }
+
+    card_plug();
+    g_card.write_ms = 0;
+    advance(REMOUNT_MS + WRITER_MS);
+    (void)write_line();
+    drain_all("rodada aleatoria");
+
+    const SdStats st = stats();
+    CHECK(st.dropped_bytes == g_drop_bytes && st.dropped_lines == g_drop_lines,
+          "descartes %lu B/%lu, esperado %lu B/%lu", (unsigned long)st.dropped_bytes,
+          (unsigned long)st.dropped_lines, (unsigned long)g_drop_bytes,
+          (unsigned long)g_drop_lines);
+    CHECK(st.written_bytes >= g_model_len, "gravados %lu de %lu",
+          (unsigned long)st.written_bytes, (unsigned long)g_model_len);
+    CHECK(g_card.fast_retries == 0, "%lu montagens menos de 5 s apos uma falha",
+          (unsigned long)g_card.fast_retries);
+}
+
+/****************************** Funções públicas ******************************/
+
+int main(int argc, char **argv)
+{
+    unsigned long steps = 20000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:v")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            steps = strtoul(optarg, nullptr, 0);
+            break;
+        case 's':
+            g_rng = (uint32_t)strtoul(optarg, nullptr, 0);
+            break;
+        case 'v':
+            g_verbose = true;
+            break;
+        default:
+            fprintf(stderr, "uso: %s [-n passos] [-s semente] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (g_rng == 0)
+    {
+        g_rng = 1;
+    }
+
+    struct tm start;
+    memset(&start, 0, sizeof(start));
+    start.tm_year = 2026 - 1900;
+    start.tm_mon = 9;
+    start.tm_mday = 18;
+    start.tm_hour = 12;
+    g_t0 = timegm(&start);
+    g_card.present = true;
+    g_card.budget = -1;
+
+    test_boot_hold();
+    test_unplug_mid_run();
+    test_unplug_before_flush();
+    test_stall();
+    test_rotation();
+    test_random((uint32_t)steps);
+
+    const SdStats st = stats();
+    printf("sd_card: %lu linhas (%lu descartadas), %lu remontagens, %lu arquivos, "
+           "espera maxima do radio %lu us, %lu verificacoes, %lu falhas\n",
+           (unsigned long)g_seq, (unsigned long)st.dropped_lines, (unsigned long)st.remounts,
+           (unsigned long)g_card.n_files, (unsigned long)g_bus_worst_us,
+           (unsigned long)g_checks, (unsigned long)g_failures);
+    return g_failures ? 1 : 0;
+}
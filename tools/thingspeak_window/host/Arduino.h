@@ -0,0 +1,15 @@
+/**
+ * @file Arduino.h
+ * @brief Substituto mínimo do core Arduino para o teste da janela do ThingSpeak:
+ *        @c millis() é o relógio simulado do teste.
+ */
+
+#ifndef TS_WINDOW_ARDUINO_H
+#define TS_WINDOW_ARDUINO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint32_t millis(void);
+
+#endif /* TS_WINDOW_ARDUINO_H */
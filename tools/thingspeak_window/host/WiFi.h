@@ -0,0 +1,30 @@
+/**
+ * @file WiFi.h
+ * @brief Substituto de @c WiFi.h: endereço IPv4 e resolução de nomes simulada.
+ */
+
+#ifndef TS_WINDOW_WIFI_H
+#define TS_WINDOW_WIFI_H
+
+#include <Arduino.h>
+
+class IPAddress
+{
+public:
+    IPAddress() : m_addr(0) {}
+    explicit IPAddress(uint32_t addr) : m_addr(addr) {}
+    operator uint32_t() const { return m_addr; }
+
+private:
+    uint32_t m_addr;
+};
+
+class WiFiClass
+{
+public:
+    int hostByName(const char *host, IPAddress &out);
+};
+
+extern WiFiClass WiFi;
+
+#endif /* TS_WINDOW_WIFI_H */
@@ -0,0 +1,11 @@
+/**
+ * @file credentials.h
+ * @brief Credenciais do teste: host do servidor simulado (com ou sem TLS).
+ */
+
+#ifndef CREDENTIALS_H
+#define CREDENTIALS_H
+
+#define THINGSPEAK_HOST "ts.teste"
+
+#endif /* CREDENTIALS_H */
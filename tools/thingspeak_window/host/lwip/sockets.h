@@ -0,0 +1,31 @@
+/**
+ * @file sockets.h
+ * @brief Substituto de @c lwip/sockets.h: tipos do host e chamadas de socket
+ *        desviadas para o servidor simulado do teste (@c sim_*).
+ */
+
+#ifndef TS_WINDOW_LWIP_SOCKETS_H
+#define TS_WINDOW_LWIP_SOCKETS_H
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+int sim_socket(int domain, int type, int protocol);
+int sim_setsockopt(int fd, int level, int name, const void *val, socklen_t len);
+int sim_connect(int fd, const struct sockaddr *addr, socklen_t len);
+ssize_t sim_send(int fd, const void *buf, size_t len, int flags);
+ssize_t sim_recv(int fd, void *buf, size_t len, int flags);
+int sim_close(int fd);
+
+#define socket     sim_socket
+#define setsockopt sim_setsockopt
+#define connect    sim_connect
+#define send       sim_send
+#define recv       sim_recv
+#define close      sim_close
+
+#endif /* TS_WINDOW_LWIP_SOCKETS_H */
@@ -0,0 +1,41 @@
+/**
+ * @file tls_transport.h
+ * @brief Substituto de @c lib/tls_transport para o teste da janela do ThingSpeak:
+ *        o canal "TLS" é o socket simulado, e cada handshake aloca e libera um
+ *        bloco, como o estado temporário de handshake do mbedtls.
+ */
+
+#ifndef TS_WINDOW_TLS_TRANSPORT_H
+#define TS_WINDOW_TLS_TRANSPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t full;
+    uint32_t resumed;
+    uint32_t failed;
+    uint32_t full_ms_sum;
+    uint32_t resumed_ms_sum;
+    uint32_t full_max_ms;
+    uint32_t resumed_max_ms;
+    uint32_t last_ms;
+} TlsStats;
+
+typedef struct
+{
+    bool ready;
+    int fd;
+    TlsStats stats;
+} TlsTransport;
+
+bool tls_init(TlsTransport *t, const char *host, const char *ca_pem, bool insecure_no_verify);
+bool tls_connect(TlsTransport *t, int fd);
+bool tls_send_all(TlsTransport *t, const void *buf, size_t len);
+int tls_recv(TlsTransport *t, void *buf, size_t len);
+void tls_close(TlsTransport *t);
+void tls_get_stats(const TlsTransport *t, TlsStats *out);
+
+#endif /* TS_WINDOW_TLS_TRANSPORT_H */
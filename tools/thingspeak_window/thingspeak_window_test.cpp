@@ -0,0 +1,778 @@
+/**
+ * @file thingspeak_window_test.cpp
+ * @brief Teste de host da agregação por janela do cliente ThingSpeak
+ *        (@c lib/thingspeak_client) contra um servidor simulado.
+ *
+ * Uso:
+ *   thingspeak_window_test [-n leituras da janela grande] [-s semente] [-v]
+ *
+ * O cliente real é compilado como no firmware (@c THINGSPEAK_TLS=1, com o
+ * transporte TLS substituído por @c host/tls_transport.h) e também com
+ * @c THINGSPEAK_TLS=0. As chamadas de socket vão para o servidor simulado abaixo,
+ * que guarda o corpo de cada POST e responde, em pedaços de tamanho sorteado e com
+ * cabeçalhos longos como os do canal real, com o id da entrada, "0" (recusa) ou
+ * HTTP 500. Cada POST é conferido campo a campo contra um modelo independente da
+ * janela (média em ponto flutuante arredondada, timestamp da última leitura, -1
+ * para campo sem amostra válida), e o @c status contra o mínimo e o máximo de
+ * cada campo.
+ *
+ * Casos: Wi-Fi fora, intervalo mínimo do canal, recusa e falha mantendo a janela,
+ * campo só com sentinelas, uma janela com mais de 65535 leituras e a conexão
+ * mantida entre envios (fechada pelo servidor por ociosidade ou por
+ * "Connection: close", com reconexão transparente). Depois de
+ * @c thingspeak_begin(), qualquer chamada a malloc/calloc/realloc fora de um
+ * handshake conta como falha, e envios pela conexão mantida não fazem handshake
+ * nem resolvem o nome de novo.
+ *
+ * Sai com código 1 se algum caso falhar.
+ */
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <WiFi.h>
+#include <lwip/sockets.h>
+#include "logger.h"
+#include "payload_schema.h"
+#include "thingspeak_client.h"
+#include "wifi_manager.h"
+
+#define SIM_FD        7
+#define API_KEY       "CHAVETESTE"
+#define N_UPLOAD      (SCHEMA_MAX_FIELDS + 1)
+
+extern "C" void *__libc_malloc(size_t n);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *p, size_t n);
+
+#define HS_BYTES      2048   /* estado de handshake alocado pelo substituto do TLS */
+
+/**
+ * @brief Servidor ThingSpeak simulado (keep-alive, uma conexão por vez).
+ */
+typedef struct
+{
+    int code;               /* status HTTP da próxima resposta            */
+    bool reject;            /* responde entry id 0                        */
+    bool close_after;       /* responde "Connection: close", sem tamanho  */
+    bool idle_closed;       /* fechou a conexão ociosa; o cliente não sabe */
+    uint32_t next_entry;
+    uint32_t posts;         /* requisições completas respondidas          */
+    uint32_t connects;
+    char req[1024];         /* última requisição                          */
+    size_t req_len;
+    char resp[768];
+    size_t resp_len;
+    size_t resp_off;
+    bool replied;           /* a requisição em req já foi respondida      */
+    bool open;              /* aberta do lado do cliente                  */
+} SimServer;
+
+/**
+ * @brief Modelo independente da janela pendente.
+ */
+typedef struct
+{
+    uint32_t count;
+    uint32_t valid[SCHEMA_MAX_FIELDS];
+    double sum[SCHEMA_MAX_FIELDS];
+    int32_t min[SCHEMA_MAX_FIELDS];
+    int32_t max[SCHEMA_MAX_FIELDS];
+    uint32_t timestamp;
+} Model;
+
+static bool g_verbose = false;
+static bool g_wifi_up = true;
+static uint32_t g_now_ms = 1000;
+static uint32_t g_rng = 0x2545F491u;
+static SimServer g_srv;
+static Model g_model;
+static const PayloadSchema *g_schema;
+static bool g_alloc_armed = false;
+static uint32_t g_allocs;
+static uint32_t g_hs_allocs;   /* alocações feitas dentro de um handshake */
+static uint32_t g_handshakes;
+static uint32_t g_dns;
+static uint32_t g_checks;
+static uint32_t g_failures;
+
+#define CHECK(cond, ...)                                                     \
+    do                                                                       \
+    {                                                                        \
+        g_checks++;                                                          \
+        if (!(cond))                                                         \
+        {                                                                    \
+            g_failures++;                                                    \
+            fprintf(stderr, "FALHA %s:%d: ", __FILE__, __LINE__);            \
+            fprintf(stderr, __VA_ARGS__);                                    \
+            fputc('\n', stderr);                                             \
+        }                                                                    \
+    } while (0)
+
+/**
+ * @brief xorshift32: reproduzível pela semente, sem depender da libc.
+ */
+static uint32_t rnd(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+/****************************** Substitutos ***********************************/
+
+WiFiClass WiFi;
+
+void logger_log(const char *tag, const char *fmt, ...)
+{
+    if (!g_verbose)
+    {
+        return;
+    }
+
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "[%s] ", tag);
+    vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+    va_end(ap);
+}
+
+uint32_t millis(void)
+{
+    return g_now_ms;
+}
+
+bool wifi_is_connected(void)
+{
+    return g_wifi_up;
+}
+
+int WiFiClass::hostByName(const char *host, IPAddress &out)
+{
+    (void)host;
+    g_dns++;
+    out = IPAddress((uint32_t)0x0100007Fu);
+    return 1;
+}
+
+int sim_socket(int, int, int)
+{
+    CHECK(!g_srv.open, "segunda conexao aberta sem fechar a anterior");
+    memset(&g_srv.req, 0, sizeof(g_srv.req));
+    g_srv.req_len = 0;
+    g_srv.resp_len = 0;
+    g_srv.resp_off = 0;
+    g_srv.replied = false;
+    g_srv.idle_closed = false;
+    g_srv.open = true;
+    g_srv.connects++;
+    return SIM_FD;
+}
+
+int sim_setsockopt(int, int, int, const void *, socklen_t)
+{
+    return 0;
+}
+
+int sim_connect(int fd, const struct sockaddr *, socklen_t)
+{
+    return fd == SIM_FD ? 0 : -1;
+}
+
+ssize_t sim_send(int fd, const void *buf, size_t len, int)
+{
+    if (fd != SIM_FD || !g_srv.open)
+    {
+        return -1;
+    }
+
+    /* Conexão já fechada pelo servidor: o TCP aceita, mas ninguém lê. */
+    if (g_srv.idle_closed)
+    {
+        return (ssize_t)len;
+    }
+
+    if (g_srv.replied)
+    {
+        g_srv.req_len = 0;
+        g_srv.replied = false;
+    }
+
+    if (g_srv.req_len + len >= sizeof(g_srv.req))
+    {
+        return -1;
+    }
+
+    memcpy(g_srv.req + g_srv.req_len, buf, len);
+    g_srv.req_len += len;
+    g_srv.req[g_srv.req_len] = '\0';
+    return (ssize_t)len;
+}
+
+/**
+ * @brief Monta a resposta à requisição completa em @c g_srv.req.
+ */
+static void sim_reply(void)
+{
+    const bool ok = g_srv.code == 200;
+    char body[24] = "";
+
+    if (ok)
+    {
+        snprintf(body, sizeof(body), "%lu",
+                 g_srv.reject ? 0ul : (unsigned long)++g_srv.next_entry);
+    }
+
+    const bool keep = !g_srv.close_after && strstr(g_srv.req, "Connection: keep-alive");
+    char len_hdr[48] = "";
+
+    if (keep)
+    {
+        snprintf(len_hdr, sizeof(len_hdr), "Content-Length: %u\r\n", (unsigned)strlen(body));
+    }
+
+    /* Cabeçalhos como os do canal real: a resposta passa de 256 bytes. */
+    const int n = snprintf(g_srv.resp, sizeof(g_srv.resp),
+                           "HTTP/1.1 %d %s\r\n"
+                           "Date: Sun, 18 Oct 2026 12:00:00 GMT\r\n"
+                           "Content-Type: text/plain; charset=utf-8\r\n"
+                           "%s"
+                           "Connection: %s\r\n"
+                           "Status: %d\r\n"
+                           "Cache-Control: max-age=0, private, must-revalidate\r\n"
+                           "Access-Control-Allow-Origin: *\r\n"
+                           "Access-Control-Max-Age: 1800\r\n"
+                           "X-Request-Id: 5d0c1e5e-2a7b-4c1e-9a57-5f1f8c0b9d31\r\n"
+                           "Access-Control-Allow-Headers: origin, content-type, X-Requested-With\r\n"
+                           "Access-Control-Allow-Methods: GET, POST, PUT, OPTIONS, DELETE, PATCH\r\n"
+                           "ETag: W/\"a94a8fe5ccb19ba61c4c0873d391e987\"\r\n"
+                           "X-Frame-Options: SAMEORIGIN\r\n"
+                           "\r\n%s",
+                           g_srv.code, ok ? "OK" : "Erro", len_hdr, keep ? "keep-alive" : "close",
+                           g_srv.code, body);
+    g_srv.resp_len = (size_t)n;
+    g_srv.resp_off = 0;
+    g_srv.replied = true;
+    g_srv.posts++;
+}
+
+ssize_t sim_recv(int fd, void *buf, size_t len, int)
+{
+    if (fd != SIM_FD || !g_srv.open || g_srv.idle_closed)
+    {
+        return 0;
+    }
+
+    if (!g_srv.replied)
+    {
+        const char *body = strstr(g_srv.req, "\r\n\r\n");
+        const char *cl = strstr(g_srv.req, "Content-Length: ");
+
+        if (!body || !cl || (size_t)(g_srv.req + g_srv.req_len - (body + 4)) <
+                                 strtoul(cl + 16, nullptr, 10))
+        {
+            return -1;   /* requisição incompleta: timeout */
+        }
+
+        sim_reply();
+    }
+
+    if (g_srv.resp_off == g_srv.resp_len)
+    {
+        /* Sem keep-alive, o servidor fecha ao fim da resposta. */
+        return strstr(g_srv.resp, "Connection: close") ? 0 : -1;
+    }
+
+    size_t m = 1u + rnd() % 200u;
+    m = (m < len) ? m : len;
+    m = (m < g_srv.resp_len - g_srv.resp_off) ? m : g_srv.resp_len - g_srv.resp_off;
+    memcpy(buf, g_srv.resp + g_srv.resp_off, m);
+    g_srv.resp_off += m;
+    return (ssize_t)m;
+}
+
+int sim_close(int fd)
+{
+    g_srv.open = false;
+    return fd == SIM_FD ? 0 : -1;
+}
+
+#if THINGSPEAK_TLS
+bool tls_init(TlsTransport *t, const char *, const char *ca_pem, bool)
+{
+    t->ready = ca_pem != nullptr;
+    t->fd = -1;
+    return t->ready;
+}
+
+bool tls_connect(TlsTransport *t, int fd)
+{
+    t->fd = fd;
+    g_handshakes++;
+
+    /* O mbedtls aloca o estado do handshake e o libera ao concluí-lo. */
+    const uint32_t before = g_allocs;
+    void *hs = malloc(HS_BYTES);
+    free(hs);
+    g_hs_allocs += g_allocs - before;
+    t->stats.full++;
+    return t->ready;
+}
+
+bool tls_send_all(TlsTransport *t, const void *buf, size_t len)
+{
+    return sim_send(t->fd, buf, len, 0) == (ssize_t)len;
+}
+
+int tls_recv(TlsTransport *t, void *buf, size_t len)
+{
+    return (int)sim_recv(t->fd, buf, len, 0);
+}
+
+void tls_close(TlsTransport *t)
+{
+    sim_close(t->fd);
+    t->fd = -1;
+}
+
+void tls_get_stats(const TlsTransport *t, TlsStats *out)
+{
+    *out = t->stats;
+}
+#endif
+
+/* Qualquer alocação depois de thingspeak_begin(), fora de um handshake, é uma falha. */
+extern "C" void *malloc(size_t n)
+{
+    g_allocs += g_alloc_armed;
+    return __libc_malloc(n);
+}
+
+extern "C" void *calloc(size_t n, size_t size)
+{
+    g_allocs += g_alloc_armed;
+    return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *p, size_t n)
+{
+    g_allocs += g_alloc_armed;
+    return __libc_realloc(p, n);
+}
+
+/****************************** Funções privadas ******************************/
+
+/**
+ * @brief Gera uma leitura v1, entrega ao cliente e acumula no modelo.
+ * @param irr_error true força a sentinela de irradiância.
+ */
+static void add_reading(bool irr_error)
+{
+    static uint32_t ts = 1700000000u;
+    SensorReading r;
+    memset(&r, 0, sizeof(r));
+    r.version = g_schema->version;
+    r.value[0] = (irr_error || rnd() % 8 == 0) ? 0xFFFF : (int32_t)(rnd() % 2001u);
+    r.value[1] = (int32_t)(3000u + rnd() % 1201u);
+    r.value[2] = (int32_t)(rnd() % 1201u) - 400;
+    ts += 1u + rnd() % 30u;
+    r.value[g_schema->ts_index] = (int32_t)ts;
+    r.timestamp = ts;
+
+    for (uint8_t i = 0; i < g_schema->n_fields; ++i)
+    {
+        const FieldDesc *f = &g_schema->fields[i];
+
+        if (f->has_sentinel && (uint32_t)r.value[i] == f->sentinel)
+        {
+            r.error_mask |= 1u << i;
+        }
+        else
+        {
+            const int32_t v = r.value[i];
+            g_model.min[i] = (g_model.valid[i] == 0 || v < g_model.min[i]) ? v : g_model.min[i];
+            g_model.max[i] = (g_model.valid[i] == 0 || v > g_model.max[i]) ? v : g_model.max[i];
+            g_model.sum[i] += v;
+            g_model.valid[i]++;
+        }
+    }
+
+    g_model.count++;
+    g_model.timestamp = ts;
+    thingspeak_add(&r);
+}
+
+/**
+ * @brief Lê os pares "fieldN=valor" do corpo do último POST.
+ * @return false se a requisição não tiver corpo ou a chave de escrita.
+ */
+static bool parse_post(double value[N_UPLOAD], bool present[N_UPLOAD])
+{
+    memset(present, 0, N_UPLOAD * sizeof(present[0]));
+    const char *body = strstr(g_srv.req, "\r\n\r\n");
+
+    if (!body || strncmp(body + 4, "api_key=" API_KEY "&", 9 + strlen(API_KEY)) != 0)
+    {
+        return false;
+    }
+
+    const char *p = body + 4;
+
+    const char *status = strstr(p, "&status=");
+
+    while ((p = strstr(p, "field")) != nullptr && (!status || p < status))
+    {
+        char *end;
+        const unsigned long n = strtoul(p + 5, &end, 10);
+
+        if (*end != '=' || n == 0 || n >= N_UPLOAD)
+        {
+            return false;
+        }
+
+        value[n] = strtod(end + 1, nullptr);
+        present[n] = true;
+        p = end;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Confere o @c status do último POST ("N+leituras%2C+min..max+f1+a..b%2C+f2+...")
+ *        contra o mínimo e o máximo do modelo.
+ */
+static void expect_status(const char *what)
+{
+    const char *st = strstr(g_srv.req, "&status=");
+    bool any = false;
+
+    for (uint8_t i = 0; i < g_schema->n_fields; ++i)
+    {
+        any = any || (g_schema->fields[i].upload_field && i != g_schema->ts_index &&
+                      g_model.valid[i]);
+    }
+
+    CHECK(!st == !any, "%s: status %s", what, st ? "sem campo com amostra" : "ausente");
+
+    if (!st || !any)
+    {
+        return;
+    }
+
+    CHECK(strtoul(st + 8, nullptr, 10) == g_model.count, "%s: status com %lu leituras, esperado %lu",
+          what, strtoul(st + 8, nullptr, 10), (unsigned long)g_model.count);
+
+    for (uint8_t i = 0; i < g_schema->n_fields; ++i)
+    {
+        const FieldDesc *f = &g_schema->fields[i];
+
+        if (f->upload_field == 0 || i == g_schema->ts_index)
+        {
+            continue;
+        }
+
+        char key[8];
+        snprintf(key, sizeof(key), "+f%u+", f->upload_field);
+        const char *k = strstr(st, key);
+        CHECK(!k == !g_model.valid[i], "%s: f%u %s no status", what, f->upload_field,
+              k ? "sem amostra" : "ausente");
+
+        if (!k || !g_model.valid[i])
+        {
+            continue;
+        }
+
+        char *end;
+        const double lo = strtod(k + strlen(key), &end);
+        CHECK(strncmp(end, "..", 2) == 0, "%s: f%u sem '..' no status", what, f->upload_field);
+        const double hi = strtod(end + 2, nullptr);
+        const double scale = pow(10.0, f->scale_exp);
+        const double tol = 0.5 * pow(10.0, -(double)f->upload_decimals);
+        CHECK(fabs(lo - g_model.min[i] / scale) < tol && fabs(hi - g_model.max[i] / scale) < tol,
+              "%s: f%u %g..%g no status, esperado %g..%g", what, f->upload_field, lo, hi,
+              g_model.min[i] / scale, g_model.max[i] / scale);
+    }
+}
+
+/**
+ * @brief Confere o último POST contra o modelo e zera o modelo.
+ */
+static void expect_post(const char *what)
+{
+    double value[N_UPLOAD];
+    bool present[N_UPLOAD];
+
+    CHECK(parse_post(value, present), "%s: POST sem corpo valido: %s", what, g_srv.req);
+
+    for (uint8_t i = 0; i < g_schema->n_fields; ++i)
+    {
+        const FieldDesc *f = &g_schema->fields[i];
+
+        if (f->upload_field == 0)
+        {
+            continue;
+        }
+
+        CHECK(present[f->upload_field], "%s: field%u ausente", what, f->upload_field);
+
+        if (!present[f->upload_field])
+        {
+            continue;
+        }
+
+        const double got = value[f->upload_field];
+        double want;
+
+        if (g_model.valid[i] == 0)
+        {
+            want = -1.0;
+        }
+        else if (i == g_schema->ts_index)
+        {
+            want = (double)g_model.timestamp;
+        }
+        else
+        {
+            want = (double)llround(g_model.sum[i] / g_model.valid[i]) / pow(10.0, f->scale_exp);
+        }
+
+        CHECK(fabs(got - want) < 0.5 * pow(10.0, -(double)f->upload_decimals),
+              "%s: field%u = %.*f, esperado %.*f (%lu leituras)", what, f->upload_field,
+              f->upload_decimals, got, f->upload_decimals, want, (unsigned long)g_model.count);
+    }
+
+    expect_status(what);
+    memset(&g_model, 0, sizeof(g_model));
+}
+
+/**
+ * @brief Avança o relógio até o canal aceitar a próxima atualização.
+ */
+static void wait_interval(void)
+{
+    g_now_ms += THINGSPEAK_MIN_INTERVAL_MS;
+}
+
+static void test_wifi_down(void)
+{
+    ThingSpeakStats st;
+    add_reading(false);
+    g_wifi_up = false;
+    const uint32_t posts = g_srv.posts;
+    CHECK(!thingspeak_tick(g_now_ms), "tick com Wi-Fi fora retornou true");
+    CHECK(!thingspeak_tick(g_now_ms + 500), "segundo tick com Wi-Fi fora retornou true");
+    CHECK(g_srv.posts == posts, "POST com Wi-Fi fora");
+    thingspeak_get_stats(&st);
+    CHECK(st.wifi_waits == 1, "esperas de Wi-Fi: %lu, esperado 1", (unsigned long)st.wifi_waits);
+
+    g_wifi_up = true;
+    CHECK(thingspeak_tick(g_now_ms), "primeiro envio nao aceito");
+    CHECK(g_srv.posts == posts + 1, "primeiro envio sem POST");
+    CHECK(g_srv.open, "conexao nao mantida apos o envio");
+    expect_post("primeiro envio");
+}
+
+static void test_rate_limit(void)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        add_reading(false);
+    }
+
+    const uint32_t posts = g_srv.posts;
+    g_now_ms += 1000;
+    CHECK(!thingspeak_tick(g_now_ms), "envio antes do intervalo minimo");
+    g_now_ms += THINGSPEAK_MIN_INTERVAL_MS - 1001;
+    CHECK(!thingspeak_tick(g_now_ms), "envio 1 ms antes do intervalo minimo");
+    CHECK(g_srv.posts == posts, "POST antes do intervalo minimo");
+
+    g_now_ms += 1;
+    CHECK(thingspeak_tick(g_now_ms), "envio no intervalo minimo nao aceito");
+    expect_post("intervalo minimo");
+
+    wait_interval();
+    CHECK(!thingspeak_tick(g_now_ms), "janela vazia enviada");
+}
+
+static void test_reject_and_fail(void)
+{
+    ThingSpeakStats before, after;
+    thingspeak_get_stats(&before);
+
+    add_reading(false);
+    add_reading(false);
+    wait_interval();
+    g_srv.reject = true;
+    CHECK(!thingspeak_tick(g_now_ms), "recusa do canal tratada como aceita");
+    g_srv.reject = false;
+
+    add_reading(false);
+    wait_interval();
+    g_srv.code = 500;
+    CHECK(!thingspeak_tick(g_now_ms), "HTTP 500 tratado como aceito");
+    g_srv.code = 200;
+
+    add_reading(false);
+    wait_interval();
+    CHECK(thingspeak_tick(g_now_ms), "envio apos recusa/falha nao aceito");
+    expect_post("janela mantida apos recusa e falha");
+
+    thingspeak_get_stats(&after);
+    CHECK(after.rejected == before.rejected + 1, "recusas: %lu", (unsigned long)after.rejected);
+    CHECK(after.failed == before.failed + 1, "falhas: %lu", (unsigned long)after.failed);
+    CHECK(after.accepted == before.accepted + 1, "aceitas: %lu", (unsigned long)after.accepted);
+}
+
+static void test_all_sentinel(void)
+{
+    for (int i = 0; i < 5; ++i)
+    {
+        add_reading(true);
+    }
+
+    wait_interval();
+    CHECK(thingspeak_tick(g_now_ms), "janela so com sentinelas nao aceita");
+    expect_post("campo so com sentinelas");
+}
+
+static void test_large_window(uint32_t n)
+{
+    ThingSpeakStats before, after;
+    thingspeak_get_stats(&before);
+
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        add_reading(false);
+    }
+
+    wait_interval();
+    CHECK(thingspeak_tick(g_now_ms), "janela de %lu leituras nao aceita", (unsigned long)n);
+    expect_post("janela grande");
+
+    thingspeak_get_stats(&after);
+    CHECK(after.aggregated - before.aggregated == n, "agregadas: %lu de %lu",
+          (unsigned long)(after.aggregated - before.aggregated), (unsigned long)n);
+}
+
+/**
+ * @brief Conexão mantida: envios seguidos sem connect, handshake, DNS nem alocação;
+ *        servidor que fecha a conexão ociosa ou responde "Connection: close".
+ */
+static void test_keep_alive(void)
+{
+    const uint32_t connects = g_srv.connects;
+    const uint32_t handshakes = g_handshakes;
+    const uint32_t allocs = g_allocs;
+    const uint32_t dns = g_dns;
+
+    for (int i = 0; i < 20; ++i)
+    {
+        add_reading(false);
+        wait_interval();
+        CHECK(thingspeak_tick(g_now_ms), "envio %d pela conexao mantida nao aceito", i);
+        expect_post("conexao mantida");
+    }
+
+    CHECK(g_srv.connects == connects && g_handshakes == handshakes,
+          "%lu conexoes e %lu handshakes em envios pela conexao mantida",
+          (unsigned long)(g_srv.connects - connects), (unsigned long)(g_handshakes - handshakes));
+    CHECK(g_allocs == allocs, "%lu alocacoes em envios pela conexao mantida",
+          (unsigned long)(g_allocs - allocs));
+    CHECK(g_dns == dns, "nome resolvido de novo com o endereco em cache");
+
+    /* O servidor fechou a conexão ociosa: o envio reconecta e não se perde. */
+    const uint32_t posts = g_srv.posts;
+    g_srv.idle_closed = true;
+    add_reading(false);
+    wait_interval();
+    CHECK(thingspeak_tick(g_now_ms), "envio apos fechamento ocioso nao aceito");
+    expect_post("reconexao apos fechamento ocioso");
+    CHECK(g_srv.connects == connects + 1 && g_srv.posts == posts + 1,
+          "fechamento ocioso: %lu conexoes, %lu POSTs", (unsigned long)(g_srv.connects - connects),
+          (unsigned long)(g_srv.posts - posts));
+    CHECK(g_handshakes == handshakes + (THINGSPEAK_TLS ? 1u : 0u), "handshakes: %lu",
+          (unsigned long)(g_handshakes - handshakes));
+
+    /* Sem keep-alive, o cliente fecha e reconecta no envio seguinte. */
+    g_srv.close_after = true;
+    add_reading(false);
+    wait_interval();
+    CHECK(thingspeak_tick(g_now_ms), "envio com Connection: close nao aceito");
+    expect_post("Connection: close");
+    CHECK(!g_srv.open, "conexao mantida apos Connection: close");
+    g_srv.close_after = false;
+
+    add_reading(false);
+    wait_interval();
+    CHECK(thingspeak_tick(g_now_ms), "envio apos Connection: close nao aceito");
+    expect_post("reconexao apos Connection: close");
+    CHECK(g_srv.connects == connects + 2 && g_srv.open, "Connection: close: %lu conexoes",
+          (unsigned long)(g_srv.connects - connects));
+}
+
+/****************************** Funções públicas ******************************/
+
+int main(int argc, char **argv)
+{
+    unsigned long large = 70000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:v")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            large = strtoul(optarg, nullptr, 0);
+            break;
+        case 's':
+            g_rng = (uint32_t)strtoul(optarg, nullptr, 0);
+            break;
+        case 'v':
+            g_verbose = true;
+            break;
+        default:
+            fprintf(stderr, "uso: %s [-n leituras] [-s semente] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (g_rng == 0)
+    {
+        g_rng = 1;
+    }
+
+    g_schema = payload_schema_by_version(1);
+
+    if (!g_schema)
+    {
+        fprintf(stderr, "schema v1 ausente\n");
+        return 1;
+    }
+
+    g_srv.code = 200;
+    thingspeak_begin(API_KEY);
+    g_alloc_armed = true;
+
+    test_wifi_down();
+    test_rate_limit();
+    test_reject_and_fail();
+    test_all_sentinel();
+    test_large_window((uint32_t)large);
+    test_keep_alive();
+
+    g_alloc_armed = false;
+    CHECK(g_allocs == g_hs_allocs, "%lu alocacoes fora de handshakes depois de "
+          "thingspeak_begin()", (unsigned long)(g_allocs - g_hs_allocs));
+    CHECK(g_dns == 1, "%lu resolucoes de nome", (unsigned long)g_dns);
+
+    printf("thingspeak_window (TLS=%d): %lu POSTs, %lu conexoes, %lu handshakes, "
+           "%lu verificacoes, %lu falhas\n", THINGSPEAK_TLS, (unsigned long)g_srv.posts,
+           (unsigned long)g_srv.connects, (unsigned long)g_handshakes,
+           (unsigned long)g_checks, (unsigned long)g_failures);
+    return g_failures ? 1 : 0;
+}
@@ -0,0 +1,14 @@
+/**
+ * @file sockets.h
+ * @brief Substituto do lwip no host: a API de sockets é a mesma do POSIX.
+ */
+
+#ifndef TLS_BENCH_LWIP_SOCKETS_H
+#define TLS_BENCH_LWIP_SOCKETS_H
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#endif /* TLS_BENCH_LWIP_SOCKETS_H */
@@ -0,0 +1,28 @@
+#!/bin/sh
+# Servidor TLS local para o tls_bench (ou para o gateway, com THINGSPEAK_HOST,
+# THINGSPEAK_PORT e THINGSPEAK_CA_PEM apontando para ele).
+#
+# Uso: ./standin.sh [host] [porta] [opções extras do s_server]
+#   ex.: ./standin.sh 192.168.0.10 8443 -no_ticket   (só retomada por id de sessão)
+#
+# Gera, na primeira vez, um certificado autoassinado ECDSA P-256 com CN = host em
+# $DIR/cert.pem; ele mesmo é a CA a passar ao cliente. O s_server -www responde a
+# qualquer GET e mantém cache de sessões por id e tickets, como um servidor real.
+set -e
+
+HOST=${1:-localhost}
+PORT=${2:-8443}
+DIR=${DIR:-standin}
+[ $# -gt 0 ] && shift
+[ $# -gt 0 ] && shift
+
+mkdir -p "$DIR"
+
+if [ ! -f "$DIR/cert.pem" ]; then
+    openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 -nodes \
+        -days 825 -subj "/CN=$HOST" -keyout "$DIR/key.pem" -out "$DIR/cert.pem" 2>/dev/null
+fi
+
+echo "standin: https://$HOST:$PORT, CA $DIR/cert.pem" >&2
+exec openssl s_server -quiet -accept "$PORT" -cert "$DIR/cert.pem" -key "$DIR/key.pem" \
+    -tls1_2 -www "$@"
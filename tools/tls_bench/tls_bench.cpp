@@ -0,0 +1,235 @@
+/**
+ * @file tls_bench.cpp
+ * @brief Medição de host do transporte TLS do uplink (@c lib/tls_transport):
+ *        tempo de handshake completo contra retomado.
+ *
+ * Uso:
+ *   tls_bench [-h host] [-p porta] [-c ca.pem | -k] [-n conexões] [-r 0|1] [-v]
+ *
+ * Abre @c -n conexões seguidas, como o cliente ThingSpeak faz a cada janela: TCP,
+ * @c tls_connect(), um GET HTTP/1.0, leitura até o fechamento e @c tls_close().
+ * Com @c -r 1 (padrão), a sessão da conexão anterior é oferecida; com @c -r 0,
+ * é descartada antes de cada conexão (todo handshake é completo). Imprime uma
+ * linha por conexão e as médias por tipo de handshake.
+ *
+ * O servidor de teste é o @c standin.sh (s_server com certificado autoassinado),
+ * cujo certificado é a CA a passar em @c -c. Como no gateway, sem CA o transporte
+ * recusa a conexão; @c -k aceita o servidor sem verificá-lo.
+ */
+
+#include <errno.h>
+#include <netdb.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <esp_timer.h>
+#include <lwip/sockets.h>
+#include "logger.h"
+#include "tls_transport.h"
+
+static bool g_verbose = false;
+
+/****************************** Substitutos ***********************************/
+
+void logger_log(const char *tag, const char *fmt, ...)
+{
+    if (!g_verbose)
+    {
+        return;
+    }
+
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "[%s] ", tag);
+    vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+    va_end(ap);
+}
+
+/****************************** Funções privadas ******************************/
+
+static bool read_file(const char *path, std::string *out)
+{
+    FILE *f = fopen(path, "rb");
+
+    if (!f)
+    {
+        return false;
+    }
+
+    char buf[4096];
+    size_t n;
+
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    {
+        out->append(buf, n);
+    }
+
+    fclose(f);
+    return true;
+}
+
+/**
+ * @brief Abre uma conexão TCP com timeouts de 5 s, como o cliente do gateway.
+ * @return Descritor do socket, ou -1.
+ */
+static int tcp_connect(const struct addrinfo *ai)
+{
+    const int fd = socket(ai->ai_family, SOCK_STREAM, IPPROTO_TCP);
+
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    const struct timeval tv = { 5, 0 };
+    (void)setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    (void)setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    if (connect(fd, ai->ai_addr, ai->ai_addrlen) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/****************************** Funções públicas ******************************/
+
+int main(int argc, char **argv)
+{
+    const char *host = "localhost";
+    const char *port = "8443";
+    const char *ca_path = nullptr;
+    uint32_t n_conn = 20;
+    bool resume = true;
+    bool insecure = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "h:p:c:kn:r:v")) != -1)
+    {
+        switch (opt)
+        {
+        case 'h': host = optarg; break;
+        case 'p': port = optarg; break;
+        case 'c': ca_path = optarg; break;
+        case 'k': insecure = true; break;
+        case 'n': n_conn = (uint32_t)strtoul(optarg, nullptr, 10); break;
+        case 'r': resume = atoi(optarg) != 0; break;
+        case 'v': g_verbose = true; break;
+        default:
+            fprintf(stderr, "uso: tls_bench [-h host] [-p porta] [-c ca.pem | -k] "
+                            "[-n conexoes] [-r 0|1] [-v]\n");
+            return 2;
+        }
+    }
+
+    std::string ca;
+
+    if (ca_path && !read_file(ca_path, &ca))
+    {
+        fprintf(stderr, "nao foi possivel ler %s\n", ca_path);
+        return 1;
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *ai = nullptr;
+
+    if (getaddrinfo(host, port, &hints, &ai) != 0 || !ai)
+    {
+        fprintf(stderr, "nao foi possivel resolver %s\n", host);
+        return 1;
+    }
+
+    static TlsTransport t;
+
+    if (!tls_init(&t, host, ca_path ? ca.c_str() : nullptr, insecure))
+    {
+        fprintf(stderr, "tls_init falhou\n");
+        return 1;
+    }
+
+    printf("# %s:%s, %u conexoes, retomada %s, CA %s\n", host, port, (unsigned)n_conn,
+           resume ? "ligada" : "desligada", ca_path ? ca_path : "(sem verificacao)");
+    printf("# %4s %-9s %12s %10s %7s\n", "con", "handshake", "handshake us", "total us",
+           "bytes");
+
+    const std::string req = std::string("GET / HTTP/1.0\r\nHost: ") + host + "\r\n\r\n";
+    uint64_t sum_us[2] = {0, 0};
+    uint32_t count[2] = {0, 0};
+    uint32_t failed = 0;
+
+    for (uint32_t i = 0; i < n_conn; ++i)
+    {
+        if (!resume)
+        {
+            tls_forget_session(&t);
+        }
+
+        const int64_t t0 = esp_timer_get_time();
+        const int fd = tcp_connect(ai);
+
+        if (fd < 0)
+        {
+            fprintf(stderr, "connect falhou: %s\n", strerror(errno));
+            failed++;
+            continue;
+        }
+
+        TlsStats before;
+        tls_get_stats(&t, &before);
+        const int64_t t1 = esp_timer_get_time();
+
+        if (!tls_connect(&t, fd))
+        {
+            fprintf(stderr, "handshake falhou (use -v para detalhes)\n");
+            failed++;
+            continue;
+        }
+
+        const int64_t hs_us = esp_timer_get_time() - t1;
+        TlsStats after;
+        tls_get_stats(&t, &after);
+        const int kind = (after.resumed > before.resumed) ? 1 : 0;
+        size_t bytes = 0;
+
+        if (tls_send_all(&t, req.data(), req.size()))
+        {
+            char buf[1024];
+            int n;
+
+            while ((n = tls_recv(&t, buf, sizeof(buf))) > 0)
+            {
+                bytes += (size_t)n;
+            }
+        }
+
+        tls_close(&t);
+        const int64_t total_us = esp_timer_get_time() - t0;
+        sum_us[kind] += (uint64_t)hs_us;
+        count[kind]++;
+        printf("  %4u %-9s %12lld %10lld %7zu\n", (unsigned)i, kind ? "retomado" : "completo",
+               (long long)hs_us, (long long)total_us, bytes);
+    }
+
+    freeaddrinfo(ai);
+
+    const double full = count[0] ? (double)sum_us[0] / count[0] : 0.0;
+    const double resumed = count[1] ? (double)sum_us[1] / count[1] : 0.0;
+    printf("# completos: %u (media %.0f us), retomados: %u (media %.0f us), falhas: %u",
+           (unsigned)count[0], full, (unsigned)count[1], resumed, (unsigned)failed);
+
+    if (count[0] && count[1])
+    {
+        printf(", completo/retomado %.1fx", full / resumed);
+    }
+
+    printf("\n");
+    return failed ? 1 : 0;
+}
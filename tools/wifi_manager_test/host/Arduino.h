@@ -0,0 +1,43 @@
+/**
+ * @file Arduino.h
+ * @brief Substituto mínimo do core Arduino para o teste do gerenciador de Wi-Fi:
+ *        relógio, LED e sorteio vêm do teste.
+ */
+
+#ifndef WIFI_TEST_ARDUINO_H
+#define WIFI_TEST_ARDUINO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define LOW    0x0
+#define HIGH   0x1
+#define OUTPUT 0x03
+
+uint32_t millis(void);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+long random(long lo, long hi);
+void randomSeed(unsigned long seed);
+uint32_t esp_random(void);
+
+/* O newlib do ESP32 tem strlcpy; a glibc, só a partir da 2.38. */
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+static inline size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    const size_t n = strlen(src);
+
+    if (size)
+    {
+        const size_t k = (n < size) ? n : size - 1u;
+        memcpy(dst, src, k);
+        dst[k] = '\0';
+    }
+
+    return n;
+}
+#endif
+
+#endif /* WIFI_TEST_ARDUINO_H */
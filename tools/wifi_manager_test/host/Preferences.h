@@ -0,0 +1,21 @@
+/**
+ * @file Preferences.h
+ * @brief Substituto da NVS do Arduino-ESP32: uma chave em memória, com as gravações
+ *        contadas pelo teste.
+ */
+
+#ifndef WIFI_TEST_PREFERENCES_H
+#define WIFI_TEST_PREFERENCES_H
+
+#include <stddef.h>
+
+class Preferences
+{
+public:
+    bool begin(const char *name, bool read_only);
+    void end(void);
+    size_t getBytes(const char *key, void *buf, size_t len);
+    size_t putBytes(const char *key, const void *buf, size_t len);
+};
+
+#endif /* WIFI_TEST_PREFERENCES_H */
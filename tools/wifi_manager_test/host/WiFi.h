@@ -0,0 +1,67 @@
+/**
+ * @file WiFi.h
+ * @brief Substituto de @c WiFi.h: driver simulado pelo teste, que conta cada chamada
+ *        e entrega os eventos pela callback registrada em @c onEvent().
+ */
+
+#ifndef WIFI_TEST_WIFI_H
+#define WIFI_TEST_WIFI_H
+
+#include <Arduino.h>
+
+#define WIFI_STA 1
+
+typedef enum
+{
+    ARDUINO_EVENT_WIFI_STA_CONNECTED,
+    ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+    ARDUINO_EVENT_WIFI_STA_GOT_IP,
+    ARDUINO_EVENT_WIFI_STA_LOST_IP
+} WiFiEvent_t;
+
+typedef struct
+{
+    struct
+    {
+        uint8_t reason;
+    } wifi_sta_disconnected;
+} WiFiEventInfo_t;
+
+typedef void (*WiFiEventFuncCb)(WiFiEvent_t event, WiFiEventInfo_t info);
+
+class IPAddress
+{
+public:
+    IPAddress() : m_addr(0) {}
+    explicit IPAddress(uint32_t addr) : m_addr(addr) {}
+    operator uint32_t() const { return m_addr; }
+    uint8_t operator[](int i) const { return (uint8_t)(m_addr >> (8 * i)); }
+
+private:
+    uint32_t m_addr;
+};
+
+static const IPAddress INADDR_NONE;
+
+class WiFiClass
+{
+public:
+    bool mode(int m);
+    void setAutoReconnect(bool on);
+    int onEvent(WiFiEventFuncCb cb);
+    int begin(const char *ssid, const char *pass = nullptr, int32_t channel = 0,
+              const uint8_t *bssid = nullptr);
+    bool config(IPAddress ip, IPAddress gw, IPAddress mask, IPAddress dns = IPAddress());
+    bool disconnect(void);
+    const uint8_t *BSSID(void);
+    int32_t channel(void);
+    int8_t RSSI(void);
+    IPAddress localIP(void);
+    IPAddress gatewayIP(void);
+    IPAddress subnetMask(void);
+    IPAddress dnsIP(void);
+};
+
+extern WiFiClass WiFi;
+
+#endif /* WIFI_TEST_WIFI_H */
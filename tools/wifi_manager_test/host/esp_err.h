@@ -0,0 +1,14 @@
+/**
+ * @file esp_err.h
+ * @brief Substituto de @c esp_err.h.
+ */
+
+#ifndef WIFI_TEST_ESP_ERR_H
+#define WIFI_TEST_ESP_ERR_H
+
+typedef int esp_err_t;
+
+#define ESP_OK    0
+#define ESP_FAIL  -1
+
+#endif /* WIFI_TEST_ESP_ERR_H */
@@ -0,0 +1,27 @@
+/**
+ * @file esp_timer.h
+ * @brief Substituto do esp_timer: um timer de disparo único, avançado pelo teste.
+ */
+
+#ifndef WIFI_TEST_ESP_TIMER_H
+#define WIFI_TEST_ESP_TIMER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct esp_timer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef struct
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    const char *name;
+} esp_timer_create_args_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+int64_t esp_timer_get_time(void);
+
+#endif /* WIFI_TEST_ESP_TIMER_H */
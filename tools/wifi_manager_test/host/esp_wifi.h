@@ -0,0 +1,37 @@
+/**
+ * @file esp_wifi.h
+ * @brief Substituto de @c esp_wifi.h: configuração da estação e códigos de queda.
+ */
+
+#ifndef WIFI_TEST_ESP_WIFI_H
+#define WIFI_TEST_ESP_WIFI_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum
+{
+    WIFI_IF_STA
+} wifi_interface_t;
+
+/* Valores de esp_wifi_types.h. */
+typedef enum
+{
+    WIFI_REASON_ASSOC_LEAVE = 8,
+    WIFI_REASON_BEACON_TIMEOUT = 200,
+    WIFI_REASON_NO_AP_FOUND = 201,
+    WIFI_REASON_AUTH_FAIL = 202
+} wifi_err_reason_t;
+
+typedef union
+{
+    struct
+    {
+        uint8_t ssid[32];
+        uint8_t password[64];
+    } sta;
+} wifi_config_t;
+
+esp_err_t esp_wifi_get_config(wifi_interface_t interface, wifi_config_t *conf);
+
+#endif /* WIFI_TEST_ESP_WIFI_H */
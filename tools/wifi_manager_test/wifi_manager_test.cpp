@@ -0,0 +1,781 @@
+/**
+ * @file wifi_manager_test.cpp
+ * @brief Teste de host da máquina de estados do gerenciador de Wi-Fi
+ *        (@c lib/wifi_manager), com driver, timer e NVS simulados.
+ *
+ * Uso:
+ *   wifi_manager_test [-n chamadas ociosas] [-s semente] [-v]
+ *
+ * O driver simulado registra cada @c WiFi.begin() e entrega os eventos (IP obtido,
+ * queda, IP perdido) pela callback que o gerenciador registrou; o timer de nova
+ * tentativa dispara no instante agendado, e então @c wifi_tick() roda, como no
+ * laço principal.
+ *
+ * Cobre:
+ *  - boot sem cache (varredura completa), conexão, LED e gravação do AP na NVS;
+ *  - queda seguida da tentativa rápida com BSSID/canal em cache após
+ *    @c FAST_RETRY_MS, sem regravar a NVS para o mesmo AP;
+ *  - falha explícita da rápida (fallback em @c FAST_FALLBACK_MS) e @c ASSOC_LEAVE
+ *    (espera a guarda), rodízio das redes e backoff exponencial com jitter, contra
+ *    um modelo da política original;
+ *  - eventos repetidos, fora de ordem ou coalescidos antes do @c wifi_tick();
+ *  - @c wifi_force_reconnect() no meio de um backoff longo e boot com cache;
+ *  - custo ocioso: @c wifi_tick() e @c wifi_is_connected() conectados ou à espera
+ *    do timer não chamam o driver, o timer, a NVS nem o log.
+ *
+ * Sai com código 1 se algum caso falhar.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <Arduino.h>
+#include <Preferences.h>
+#include <WiFi.h>
+#include <esp_timer.h>
+#include <esp_wifi.h>
+#include "logger.h"
+#include "pins.h"
+#include "wifi_manager.h"
+
+/* Como em wifi_manager.cpp. */
+#define BACKOFF_MIN_MS    3000u
+#define BACKOFF_MAX_MS    300000u
+#define CONNECT_GUARD_MS  12000u
+#define FAST_RETRY_MS     250u
+#define FAST_GUARD_MS     4000u
+#define FAST_FALLBACK_MS  100u
+
+#define MAX_ATTEMPTS      256
+
+/**
+ * @brief Uma chamada a @c WiFi.begin().
+ */
+typedef struct
+{
+    uint32_t t_ms;
+    bool fast;          /* com BSSID/canal (sem varredura) */
+    int32_t channel;
+    char ssid[33];
+} SimAttempt;
+
+/**
+ * @brief Driver Wi-Fi simulado.
+ */
+typedef struct
+{
+    WiFiEventFuncCb cb;
+    uint32_t calls;             /* chamadas ao driver (WiFi.* e esp_wifi_*) */
+    uint32_t n_attempts;
+    SimAttempt attempts[MAX_ATTEMPTS];
+    char cur_ssid[33];
+    uint8_t bssid[6];
+    int32_t channel;
+} SimDriver;
+
+struct esp_timer
+{
+    esp_timer_cb_t cb;
+    void *arg;
+    bool armed;
+    int64_t deadline_us;
+    uint32_t ops;               /* start/stop */
+};
+
+/**
+ * @brief NVS simulada: uma única chave.
+ */
+typedef struct
+{
+    bool has;
+    uint8_t data[128];
+    size_t len;
+    uint32_t reads;
+    uint32_t writes;
+} SimNvs;
+
+static bool g_verbose = false;
+static uint32_t g_rng = 0x9E3779B9u;
+static int64_t g_now_us = 5000000;
+static uint8_t g_led = 0xFF;
+static uint32_t g_log_lines;
+static SimDriver g_drv;
+static struct esp_timer g_timer;
+static SimNvs g_nvs;
+static uint32_t g_checks;
+static uint32_t g_failures;
+
+/****************************** Funções privadas ******************************/
+
+#define CHECK(cond, ...)                                                     \
+    do                                                                       \
+    {                                                                        \
+        g_checks++;                                                          \
+        if (!(cond))                                                         \
+        {                                                                    \
+            g_failures++;                                                    \
+            fprintf(stderr, "FALHA %s:%d: ", __FILE__, __LINE__);            \
+            fprintf(stderr, __VA_ARGS__);                                    \
+            fputc('\n', stderr);                                             \
+        }                                                                    \
+    } while (0)
+
+/**
+ * @brief xorshift32: reproduzível pela semente, sem depender da libc.
+ */
+static uint32_t rnd(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+/****************************** Substitutos ***********************************/
+
+WiFiClass WiFi;
+
+void logger_log(const char *tag, const char *fmt, ...)
+{
+    g_log_lines++;
+
+    if (!g_verbose)
+    {
+        return;
+    }
+
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "[%8.3f %s] ", g_now_us / 1e6, tag);
+    vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+    va_end(ap);
+}
+
+uint32_t millis(void)
+{
+    return (uint32_t)(g_now_us / 1000);
+}
+
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+    if (pin == WIFI_LED)
+    {
+        g_led = val;
+    }
+}
+
+long random(long lo, long hi)
+{
+    return (hi > lo) ? lo + (long)(rnd() % (uint32_t)(hi - lo)) : lo;
+}
+
+void randomSeed(unsigned long) {}
+
+uint32_t esp_random(void)
+{
+    return rnd();
+}
+
+bool WiFiClass::mode(int)
+{
+    g_drv.calls++;
+    return true;
+}
+
+void WiFiClass::setAutoReconnect(bool)
+{
+    g_drv.calls++;
+}
+
+int WiFiClass::onEvent(WiFiEventFuncCb cb)
+{
+    g_drv.calls++;
+    g_drv.cb = cb;
+    return 1;
+}
+
+int WiFiClass::begin(const char *ssid, const char *, int32_t channel, const uint8_t *bssid)
+{
+    g_drv.calls++;
+    strlcpy(g_drv.cur_ssid, ssid, sizeof(g_drv.cur_ssid));
+
+    if (g_drv.n_attempts < MAX_ATTEMPTS)
+    {
+        SimAttempt *a = &g_drv.attempts[g_drv.n_attempts];
+        a->t_ms = millis();
+        a->fast = bssid != nullptr;
+        a->channel = channel;
+        strlcpy(a->ssid, ssid, sizeof(a->ssid));
+        CHECK(!bssid || memcmp(bssid, g_drv.bssid, sizeof(g_drv.bssid)) == 0,
+              "tentativa rapida com BSSID diferente do salvo");
+    }
+
+    g_drv.n_attempts++;
+    return 0;
+}
+
+bool WiFiClass::config(IPAddress, IPAddress, IPAddress, IPAddress)
+{
+    g_drv.calls++;
+    return true;
+}
+
+bool WiFiClass::disconnect(void)
+{
+    g_drv.calls++;
+    return true;
+}
+
+const uint8_t *WiFiClass::BSSID(void)
+{
+    g_drv.calls++;
+    return g_drv.bssid;
+}
+
+int32_t WiFiClass::channel(void)
+{
+    g_drv.calls++;
+    return g_drv.channel;
+}
+
+int8_t WiFiClass::RSSI(void)
+{
+    g_drv.calls++;
+    return -61;
+}
+
+IPAddress WiFiClass::localIP(void)
+{
+    g_drv.calls++;
+    return IPAddress(0x0A00A8C0u);
+}
+
+IPAddress WiFiClass::gatewayIP(void)
+{
+    g_drv.calls++;
+    return IPAddress(0x0100A8C0u);
+}
+
+IPAddress WiFiClass::subnetMask(void)
+{
+    g_drv.calls++;
+    return IPAddress(0x00FFFFFFu);
+}
+
+IPAddress WiFiClass::dnsIP(void)
+{
+    g_drv.calls++;
+    return IPAddress(0x0100A8C0u);
+}
+
+esp_err_t esp_wifi_get_config(wifi_interface_t, wifi_config_t *conf)
+{
+    g_drv.calls++;
+    memset(conf, 0, sizeof(*conf));
+    memcpy(conf->sta.ssid, g_drv.cur_ssid, strlen(g_drv.cur_ssid));
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out)
+{
+    g_timer.cb = args->callback;
+    g_timer.arg = args->arg;
+    g_timer.armed = false;
+    *out = &g_timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    timer->ops++;
+    timer->armed = true;
+    timer->deadline_us = g_now_us + (int64_t)timeout_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    timer->ops++;
+    timer->armed = false;
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return g_now_us;
+}
+
+bool Preferences::begin(const char *, bool)
+{
+    return true;
+}
+
+void Preferences::end(void) {}
+
+size_t Preferences::getBytes(const char *, void *buf, size_t len)
+{
+    g_nvs.reads++;
+
+    if (!g_nvs.has || g_nvs.len != len)
+    {
+        return 0;
+    }
+
+    memcpy(buf, g_nvs.data, len);
+    return len;
+}
+
+size_t Preferences::putBytes(const char *, const void *buf, size_t len)
+{
+    g_nvs.writes++;
+
+    if (len > sizeof(g_nvs.data))
+    {
+        return 0;
+    }
+
+    memcpy(g_nvs.data, buf, len);
+    g_nvs.len = len;
+    g_nvs.has = true;
+    return len;
+}
+
+/*************************** Driver e relógio simulados ***********************/
+
+/**
+ * @brief Avança o relógio @p ms; o timer dispara no instante agendado e o
+ *        @c wifi_tick() roda logo depois, como a tarefa do esp_timer e o laço.
+ */
+static void advance(uint32_t ms)
+{
+    const int64_t end = g_now_us + (int64_t)ms * 1000;
+
+    while (g_timer.armed && g_timer.deadline_us <= end)
+    {
+        g_now_us = g_timer.deadline_us;
+        g_timer.armed = false;
+        g_timer.cb(g_timer.arg);
+        wifi_tick(millis());
+    }
+
+    g_now_us = end;
+    wifi_tick(millis());
+}
+
+/**
+ * @brief Entrega um evento do driver sem rodar o laço.
+ */
+static void post(WiFiEvent_t ev, uint8_t reason)
+{
+    WiFiEventInfo_t info;
+    memset(&info, 0, sizeof(info));
+    info.wifi_sta_disconnected.reason = reason;
+    g_drv.cb(ev, info);
+}
+
+/**
+ * @brief Entrega um evento do driver e roda o laço.
+ */
+static void event(WiFiEvent_t ev, uint8_t reason)
+{
+    post(ev, reason);
+    wifi_tick(millis());
+}
+
+/**
+ * @brief Tempo até o disparo do timer, em ms (-1 se desarmado).
+ */
+static int64_t timer_in_ms(void)
+{
+    return g_timer.armed ? (g_timer.deadline_us - g_now_us) / 1000 : -1;
+}
+
+static const SimAttempt *last_attempt(void)
+{
+    return g_drv.n_attempts ? &g_drv.attempts[(g_drv.n_attempts - 1u) % MAX_ATTEMPTS] : nullptr;
+}
+
+static void expect_connected(const char *where)
+{
+    CHECK(wifi_is_connected(), "%s: nao conectado", where);
+    CHECK(g_led == HIGH, "%s: LED apagado", where);
+    CHECK(!g_timer.armed, "%s: timer ainda armado", where);
+}
+
+static void expect_down(const char *where)
+{
+    CHECK(!wifi_is_connected(), "%s: ainda conectado", where);
+    CHECK(g_led == LOW, "%s: LED aceso", where);
+}
+
+/**
+ * @brief Queda do enlace e tentativa rápida após @c FAST_RETRY_MS.
+ */
+static void drop_and_fast_attempt(WiFiEvent_t ev, uint8_t reason)
+{
+    const uint32_t n0 = g_drv.n_attempts;
+    event(ev, reason);
+    expect_down("queda");
+    CHECK(timer_in_ms() == FAST_RETRY_MS, "queda: proxima tentativa em %lld ms",
+          (long long)timer_in_ms());
+
+    advance(FAST_RETRY_MS - 1u);
+    CHECK(g_drv.n_attempts == n0, "tentativa antes de FAST_RETRY_MS");
+    advance(1);
+    CHECK(g_drv.n_attempts == n0 + 1u, "sem tentativa rapida apos a queda");
+    CHECK(last_attempt()->fast && last_attempt()->channel == g_drv.channel,
+          "tentativa apos a queda nao usou BSSID/canal salvos");
+    CHECK(timer_in_ms() == FAST_GUARD_MS, "guarda da rapida = %lld ms",
+          (long long)timer_in_ms());
+}
+
+/****************************** Casos *****************************************/
+
+static void test_boot_and_connect(void)
+{
+    wifi_begin("rede-a", "senha-a");
+    CHECK(wifi_add_network("rede-b", "senha-b"), "rede-b recusada");
+    CHECK(wifi_add_network("rede-c", "senha-c"), "rede-c recusada");
+    CHECK(wifi_add_network("rede-d", "senha-d"), "rede-d recusada");
+    CHECK(!wifi_add_network("rede-e", "senha-e"), "mais de %u redes aceitas",
+          WIFI_MAX_NETWORKS);
+    CHECK(!wifi_add_network("", "x"), "SSID vazio aceito");
+    CHECK(g_drv.cb != nullptr, "callback de eventos nao registrada");
+    expect_down("boot");
+
+    const uint32_t boot_ms = millis();
+    advance(1000);
+    CHECK(g_drv.n_attempts == 0, "tentativa antes de wifi_force_reconnect()");
+
+    wifi_force_reconnect();
+    wifi_tick(millis());
+    CHECK(g_drv.n_attempts == 1, "force_reconnect nao tentou");
+    CHECK(!last_attempt()->fast && strcmp(last_attempt()->ssid, "rede-a") == 0,
+          "primeira tentativa sem cache: %s \"%s\"", last_attempt()->fast ? "rapida" : "completa",
+          last_attempt()->ssid);
+
+    /* Backoff 3000 -> 6000: guarda + jitter em [0, 600). */
+    CHECK(timer_in_ms() >= CONNECT_GUARD_MS && timer_in_ms() < CONNECT_GUARD_MS + 600,
+          "guarda da primeira tentativa = %lld ms", (long long)timer_in_ms());
+
+    advance(500);
+    event(ARDUINO_EVENT_WIFI_STA_GOT_IP, 0);
+    expect_connected("primeira conexao");
+
+    WifiReconnectStats st;
+    wifi_get_reconnect_stats(&st);
+    CHECK(st.count == 1 && st.fast_count == 0, "estatisticas %lu/%lu",
+          (unsigned long)st.count, (unsigned long)st.fast_count);
+    CHECK(st.last_ms == millis() - boot_ms, "duracao %lu != %lu", (unsigned long)st.last_ms,
+          (unsigned long)(millis() - boot_ms));
+    CHECK(g_nvs.writes == 1, "AP gravado %lu vezes na NVS", (unsigned long)g_nvs.writes);
+}
+
+static void test_fast_reconnect(void)
+{
+    const uint32_t writes0 = g_nvs.writes;
+    drop_and_fast_attempt(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_BEACON_TIMEOUT);
+    advance(300);
+    event(ARDUINO_EVENT_WIFI_STA_GOT_IP, 0);
+    expect_connected("reconexao rapida");
+
+    WifiReconnectStats st;
+    wifi_get_reconnect_stats(&st);
+    CHECK(st.count == 2 && st.fast_count == 1, "estatisticas %lu/%lu",
+          (unsigned long)st.count, (unsigned long)st.fast_count);
+    CHECK(st.last_ms == FAST_RETRY_MS + 300u, "duracao da rapida %lu ms",
+          (unsigned long)st.last_ms);
+    CHECK(g_nvs.writes == writes0, "mesmo AP regravado na NVS");
+
+    /* IP perdido conta como queda. */
+    drop_and_fast_attempt(ARDUINO_EVENT_WIFI_STA_LOST_IP, 0);
+    advance(50);
+    event(ARDUINO_EVENT_WIFI_STA_GOT_IP, 0);
+    expect_connected("reconexao apos IP perdido");
+}
+
+/**
+ * @brief Rápida recusada, fallback e sequência de varreduras sem resposta, contra
+ *        o modelo do backoff: b = (b < máx) ? 2b : máx; atraso = guarda + [0, b/10).
+ */
+static void test_fallback_and_backoff(void)
+{
+    static const char *const kOrder[] = {"rede-a", "rede-b", "rede-c", "rede-d"};
+    drop_and_fast_attempt(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_BEACON_TIMEOUT);
+
+    event(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_NO_AP_FOUND);
+    CHECK(timer_in_ms() == FAST_FALLBACK_MS, "fallback em %lld ms", (long long)timer_in_ms());
+
+    uint32_t model = BACKOFF_MIN_MS;
+    uint32_t n = g_drv.n_attempts;
+    advance(FAST_FALLBACK_MS);
+
+    for (uint8_t i = 0; i < 14; ++i)
+    {
+        CHECK(g_drv.n_attempts == n + 1u, "varredura %u nao emitida", i);
+        n = g_drv.n_attempts;
+
+        const SimAttempt *a = last_attempt();
+        CHECK(!a->fast && strcmp(a->ssid, kOrder[i % WIFI_MAX_NETWORKS]) == 0,
+              "varredura %u: %s \"%s\", esperada \"%s\"", i, a->fast ? "rapida" : "completa",
+              a->ssid, kOrder[i % WIFI_MAX_NETWORKS]);
+
+        model = (model < BACKOFF_MAX_MS) ? model * 2u : BACKOFF_MAX_MS;
+        const int64_t wait = timer_in_ms();
+        const int64_t jitter = model / 10u;
+        CHECK(wait >= CONNECT_GUARD_MS && wait < CONNECT_GUARD_MS + (jitter ? jitter : 1),
+              "varredura %u: espera %lld ms fora de [%u, %u + %lld)", i, (long long)wait,
+              CONNECT_GUARD_MS, CONNECT_GUARD_MS, (long long)jitter);
+
+        /* Sem eventos, nada acontece até o timer. */
+        advance((uint32_t)wait - 1u);
+        CHECK(g_drv.n_attempts == n, "tentativa antes do timer na varredura %u", i);
+        CHECK(g_led == LOW, "LED aceso sem conexao");
+        advance(1);
+    }
+
+    event(ARDUINO_EVENT_WIFI_STA_GOT_IP, 0);
+    expect_connected("conexao apos varreduras");
+
+    /* Conectado, o backoff volta ao mínimo. */
+    drop_and_fast_attempt(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_BEACON_TIMEOUT);
+    event(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_AUTH_FAIL);
+    advance(FAST_FALLBACK_MS);
+    CHECK(!last_attempt()->fast && timer_in_ms() >= CONNECT_GUARD_MS &&
+          timer_in_ms() < CONNECT_GUARD_MS + 600, "backoff nao reiniciado: espera %lld ms",
+          (long long)timer_in_ms());
+    event(ARDUINO_EVENT_WIFI_STA_GOT_IP, 0);
+    expect_connected("conexao apos backoff reiniciado");
+}
+
+/**
+ * @brief ASSOC_LEAVE é a saída provocada pela própria troca de configuração: a
+ *        rápida não é abandonada antes da guarda.
+ */
+static void test_assoc_leave(void)
+{
+    drop_and_fast_attempt(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_BEACON_TIMEOUT);
+    const uint32_t n = g_drv.n_attempts;
+
+    event(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_ASSOC_LEAVE);
+    CHECK(timer_in_ms() == FAST_GUARD_MS, "ASSOC_LEAVE reagendou para %lld ms",
+          (long long)timer_in_ms());
+    advance(FAST_GUARD_MS - 1u);
+    CHECK(g_drv.n_attempts == n, "tentativa antes da guarda da rapida");
+    advance(1);
+    CHECK(g_drv.n_attempts == n + 1u && !last_attempt()->fast,
+          "varredura nao emitida apos a guarda da rapida");
+
+    event(ARDUINO_EVENT_WIFI_STA_GOT_IP, 0);
+    expect_connected("conexao apos ASSOC_LEAVE");
+}
+
+static void test_stale_events(void)
+{
+    WifiReconnectStats st0, st;
+    wifi_get_reconnect_stats(&st0);
+    const uint32_t n = g_drv.n_attempts;
+    const uint32_t writes0 = g_nvs.writes;
+
+    /* Timer atrasado e IP repetido, conectado: nada muda. */
+    g_timer.cb(g_timer.arg);
+    wifi_tick(millis());
+    event(ARDUINO_EVENT_WIFI_STA_GOT_IP, 0);
+    wifi_get_reconnect_stats(&st);
+    CHECK(g_drv.n_attempts == n, "tentativa com o enlace ativo");
+    CHECK(st.count == st0.count, "IP repetido contado como reconexao");
+    CHECK(g_nvs.writes == writes0, "IP repetido gravou a NVS");
+    expect_connected("eventos repetidos");
+
+    /* Queda repetida antes da tentativa rápida: mesmo agendamento. */
+    event(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_BEACON_TIMEOUT);
+    advance(100);
+    const int64_t deadline = g_timer.deadline_us;
+    event(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_BEACON_TIMEOUT);
+    CHECK(g_timer.armed && g_timer.deadline_us == deadline, "queda repetida reagendou");
+    advance(FAST_RETRY_MS - 100u);
+    CHECK(g_drv.n_attempts == n + 1u && last_attempt()->fast, "rapida nao emitida");
+
+    /* IP e queda coalescidos num só wifi_tick(): vale o enlace em cache (caído). */
+    post(ARDUINO_EVENT_WIFI_STA_GOT_IP, 0);
+    post(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_ASSOC_LEAVE);
+    wifi_tick(millis());
+    expect_down("IP e queda coalescidos");
+    CHECK(timer_in_ms() == FAST_GUARD_MS, "coalescidos reagendaram para %lld ms",
+          (long long)timer_in_ms());
+
+    /* Queda e IP coalescidos: conecta. */
+    post(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_ASSOC_LEAVE);
+    post(ARDUINO_EVENT_WIFI_STA_GOT_IP, 0);
+    wifi_tick(millis());
+    expect_connected("queda e IP coalescidos");
+}
+
+/**
+ * @brief @c wifi_force_reconnect() no meio de um backoff longo tenta na hora.
+ */
+static void test_force_reconnect(void)
+{
+    drop_and_fast_attempt(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_BEACON_TIMEOUT);
+    event(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_NO_AP_FOUND);
+    advance(FAST_FALLBACK_MS);
+
+    for (uint8_t i = 0; i < 6; ++i)
+    {
+        advance((uint32_t)timer_in_ms());
+    }
+
+    CHECK(timer_in_ms() > CONNECT_GUARD_MS, "backoff curto demais para o caso: %lld ms",
+          (long long)timer_in_ms());
+
+    const uint32_t n = g_drv.n_attempts;
+    wifi_force_reconnect();
+    CHECK(!g_timer.armed, "force_reconnect manteve o timer");
+    wifi_tick(millis());
+    CHECK(g_drv.n_attempts == n + 1u && last_attempt()->fast,
+          "force_reconnect nao tentou o AP salvo na hora");
+
+    event(ARDUINO_EVENT_WIFI_STA_GOT_IP, 0);
+    expect_connected("conexao apos force_reconnect");
+}
+
+/**
+ * @brief Reinício: o AP salvo na NVS só é usado se o SSID estiver configurado.
+ */
+static void test_boot_with_cache(void)
+{
+    char saved[sizeof(g_drv.cur_ssid)];
+    memcpy(saved, g_drv.cur_ssid, sizeof(saved));
+
+    wifi_begin("rede-x", "senha-x");
+    wifi_force_reconnect();
+    wifi_tick(millis());
+    CHECK(!last_attempt()->fast && strcmp(last_attempt()->ssid, "rede-x") == 0,
+          "AP salvo de outra rede usado no boot");
+
+    wifi_begin("rede-d", "senha-d");
+    wifi_add_network("rede-c", "senha-c");
+    wifi_add_network("rede-b", "senha-b");
+    wifi_add_network("rede-a", "senha-a");
+    wifi_force_reconnect();
+    wifi_tick(millis());
+    CHECK(last_attempt()->fast && strcmp(last_attempt()->ssid, saved) == 0,
+          "AP salvo (\"%s\") nao usado no boot: \"%s\"", saved, last_attempt()->ssid);
+    event(ARDUINO_EVENT_WIFI_STA_GOT_IP, 0);
+    expect_connected("boot com cache");
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief Chama @c wifi_tick() e @c wifi_is_connected() @p n vezes, 1 ms a cada
+ *        iteração do laço, sem eventos nem disparo do timer.
+ * @return ns por iteração no host.
+ */
+static double idle_loop(unsigned long n, bool expect_up, const char *where)
+{
+    const uint32_t calls0 = g_drv.calls, ops0 = g_timer.ops, logs0 = g_log_lines;
+    const uint32_t nvs0 = g_nvs.reads + g_nvs.writes, n0 = g_drv.n_attempts;
+    uint32_t mismatch = 0;
+    const double t0 = now_ns();
+
+    for (unsigned long i = 0; i < n; ++i)
+    {
+        g_now_us += 1000;
+        wifi_tick(millis());
+        mismatch += (wifi_is_connected() != expect_up) ? 1u : 0u;
+    }
+
+    const double ns = (now_ns() - t0) / (double)(n ? n : 1);
+    CHECK(!g_timer.armed || g_timer.deadline_us > g_now_us, "%s: passou do timer", where);
+    CHECK(mismatch == 0, "%s: wifi_is_connected() mudou %lu vezes", where,
+          (unsigned long)mismatch);
+    CHECK(g_drv.calls == calls0, "%s: %lu chamadas ao driver", where,
+          (unsigned long)(g_drv.calls - calls0));
+    CHECK(g_timer.ops == ops0, "%s: %lu operacoes no timer", where,
+          (unsigned long)(g_timer.ops - ops0));
+    CHECK(g_nvs.reads + g_nvs.writes == nvs0, "%s: acesso a NVS", where);
+    CHECK(g_log_lines == logs0, "%s: %lu linhas de log", where,
+          (unsigned long)(g_log_lines - logs0));
+    CHECK(g_drv.n_attempts == n0, "%s: tentativa sem timer", where);
+    return ns;
+}
+
+static void test_idle_cost(unsigned long n)
+{
+    const double up_ns = idle_loop(n, true, "ocioso conectado");
+
+    /* À espera da guarda de uma varredura: também nada a fazer até o timer. */
+    drop_and_fast_attempt(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_BEACON_TIMEOUT);
+    event(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_NO_AP_FOUND);
+    advance(FAST_FALLBACK_MS);
+    const unsigned long wait = (unsigned long)timer_in_ms() - 1u;
+    const double down_ns = idle_loop(n < wait ? n : wait, false, "ocioso no backoff");
+
+    advance(1);
+    event(ARDUINO_EVENT_WIFI_STA_GOT_IP, 0);
+    expect_connected("conexao apos ocioso");
+
+    printf("# wifi_tick() + wifi_is_connected() ociosos: %.1f ns conectado, %.1f ns no "
+           "backoff (host)\n", up_ns, down_ns);
+}
+
+/****************************** Funções públicas ******************************/
+
+int main(int argc, char **argv)
+{
+    unsigned long idle = 1000000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:v")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            idle = strtoul(optarg, nullptr, 0);
+            break;
+        case 's':
+            g_rng = (uint32_t)strtoul(optarg, nullptr, 0);
+            break;
+        case 'v':
+            g_verbose = true;
+            break;
+        default:
+            fprintf(stderr, "uso: %s [-n chamadas ociosas] [-s semente] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (g_rng == 0)
+    {
+        g_rng = 1;
+    }
+
+    static const uint8_t kBssid[6] = {0x24, 0x0A, 0xC4, 0x12, 0x34, 0x56};
+    memcpy(g_drv.bssid, kBssid, sizeof(kBssid));
+    g_drv.channel = 6;
+
+    test_boot_and_connect();
+    test_fast_reconnect();
+    test_fallback_and_backoff();
+    test_assoc_leave();
+    test_stale_events();
+    test_force_reconnect();
+    test_idle_cost(idle);
+    test_boot_with_cache();
+
+    printf("wifi_manager: %lu verificacoes, %lu falhas\n", (unsigned long)g_checks,
+           (unsigned long)g_failures);
+    return g_failures ? 1 : 0;
+}